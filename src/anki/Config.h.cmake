@@ -142,6 +142,9 @@
 // Enable performance counters
 #define ANKI_ENABLE_TRACE ${_ANKI_ENABLE_TRACE}
 
+// Physics
+#define ANKI_PHYSICS_MULTITHREADED ${_ANKI_PHYSICS_MULTITHREADED}
+
 #define ANKI_FILE __FILE__
 #define ANKI_FUNC __func__
 
@@ -18,6 +18,7 @@
 #include <anki/scene/OccluderNode.h>
 #include <anki/scene/DecalNode.h>
 #include <anki/scene/Octree.h>
+#include <anki/scene/LodSelector.h>
 #include <anki/scene/PhysicsDebugNode.h>
 #include <anki/scene/TriggerNode.h>
 #include <anki/scene/FogDensityNode.h>
@@ -22,6 +22,8 @@
 #include <anki/script/ScriptManager.h>
 #include <anki/resource/ResourceFilesystem.h>
 #include <anki/resource/AsyncLoader.h>
+#include <anki/resource/TextureStreamer.h>
+#include <anki/resource/ResourceWatcher.h>
 #include <anki/core/StagingGpuMemoryManager.h>
 #include <anki/ui/UiManager.h>
 #include <anki/ui/Canvas.h>
@@ -415,7 +417,12 @@ Error App::initInternal(const ConfigSet& config_, AllocAlignedCallback allocCb,
 	//
 	m_physics = m_heapAlloc.newInstance<PhysicsWorld>();
 
-	ANKI_CHECK(m_physics->create(m_allocCb, m_allocCbData));
+	// The async update runs next to the ThreadHive tasks of the frame so it can't use the hive
+	const Bool physicsInHive = config.getNumber("physics.multithreaded") && !config.getNumber("physics.async");
+	ANKI_CHECK(m_physics->create(m_allocCb, m_allocCbData, (physicsInHive) ? m_threadHive : nullptr));
+	m_physics->setFixedTimeStep(1.0 / config.getNumber("physics.simulationRate"),
+		config.getNumber("physics.maxSubSteps"),
+		config.getNumber("physics.interpolateTransforms"));
 
 	//
 	// Resource FS
@@ -438,6 +445,11 @@ Error App::initInternal(const ConfigSet& config_, AllocAlignedCallback allocCb,
 
 	ANKI_CHECK(m_resources->init(rinit));
 
+	if(config.getNumber("rsrc.preprocessShaderPrograms"))
+	{
+		m_resources->preprocessShaderPrograms(*m_threadHive);
+	}
+
 	//
 	// UI
 	//
@@ -471,8 +483,15 @@ Error App::initInternal(const ConfigSet& config_, AllocAlignedCallback allocCb,
 	//
 	m_scene = m_heapAlloc.newInstance<SceneGraph>();
 
-	ANKI_CHECK(m_scene->init(
-		m_allocCb, m_allocCbData, m_threadHive, m_resources, m_input, m_script, &m_globalTimestamp, config));
+	ANKI_CHECK(m_scene->init(m_allocCb,
+		m_allocCbData,
+		m_threadHive,
+		m_resources,
+		m_input,
+		m_script,
+		m_stagingMem,
+		&m_globalTimestamp,
+		config));
 
 	// Inform the script engine about some subsystems
 	m_script->setRenderer(m_renderer);
@@ -548,6 +567,9 @@ Error App::mainLoop()
 	ANKI_CORE_LOGI("Entering main loop");
 	Bool quit = false;
 
+	// The programs of the renderer and the initial scene are loaded. Create their pipelines before the first frame
+	m_gr->prewarmPipelines(*m_threadHive);
+
 	Second prevUpdateTime = HighRezTimer::getCurrentTime();
 	Second crntTime = prevUpdateTime;
 
@@ -593,6 +615,15 @@ Error App::mainLoop()
 		ANKI_TRACE_INC_COUNTER(RESOURCE_ASYNC_TASKS, asyncTaskCount - m_resourceCompletedAsyncTaskCount);
 		m_resourceCompletedAsyncTaskCount = asyncTaskCount;
 
+		// Swap the streamed textures while no one uses them and schedule more streaming
+		m_resources->getTextureStreamer().update();
+
+		// Swap the resources that were reloaded and reload the ones that changed
+		if(m_resources->getResourceWatcher())
+		{
+			m_resources->getResourceWatcher()->update();
+		}
+
 		// Now resume the loader
 		m_resources->getAsyncLoader().resume();
 
@@ -147,6 +147,20 @@ public:
 		return m_displayStats;
 	}
 
+	/// The allocation callback that the App gives to the subsystems. It wraps the user's callback and keeps statistics.
+	class MemStats
+	{
+	public:
+		Atomic<PtrSize> m_allocatedMem = {0};
+		Atomic<U64> m_allocCount = {0};
+		Atomic<U64> m_freeCount = {0};
+
+		void* m_originalUserData = nullptr;
+		AllocAlignedCallback m_originalAllocCallback = nullptr;
+
+		static void* allocCallback(void* userData, void* ptr, PtrSize size, PtrSize alignment);
+	};
+
 private:
 	class StatsUi;
 
@@ -178,18 +192,7 @@ private:
 	Second m_timerTick;
 	U64 m_resourceCompletedAsyncTaskCount = 0;
 
-	class MemStats
-	{
-	public:
-		Atomic<PtrSize> m_allocatedMem = {0};
-		Atomic<U64> m_allocCount = {0};
-		Atomic<U64> m_freeCount = {0};
-
-		void* m_originalUserData = nullptr;
-		AllocAlignedCallback m_originalAllocCallback = nullptr;
-
-		static void* allocCallback(void* userData, void* ptr, PtrSize size, PtrSize alignment);
-	} m_memStats;
+	MemStats m_memStats;
 
 	void initMemoryCallbacks(AllocAlignedCallback allocCb, void* allocCbUserData);
 
@@ -13,8 +13,6 @@ Config::Config()
 {
 	// Renderer
 	newOption("r.renderingQuality", 1.0, "Rendering quality factor");
-	newOption("r.lodDistance0", 20.0, "Distance that will be used to calculate the LOD 0");
-	newOption("r.lodDistance1", 40.0, "Distance that will be used to calculate the LOD 1");
 	newOption("r.clusterSizeX", 32);
 	newOption("r.clusterSizeY", 26);
 	newOption("r.clusterSizeZ", 32);
@@ -28,6 +26,7 @@ Config::Config()
 	newOption("r.shadowMapping.resolution", 512);
 	newOption("r.shadowMapping.tileCountPerRowOrColumn", 8);
 	newOption("r.shadowMapping.scratchTileCount", 8);
+	newOption("r.shadowMapping.tileHierarchyCount", 3);
 
 	newOption("r.lensFlare.maxSpritesPerFlare", 8);
 	newOption("r.lensFlare.maxFlares", 16);
@@ -50,6 +49,11 @@ Config::Config()
 	// Scene
 	newOption("scene.imageReflectionMaxDistance", 30.0);
 	newOption("scene.earlyZDistance", 10.0, "Objects with distance lower than that will be used in early Z");
+	newOption("scene.lodScreenSize0", 0.25, "Objects smaller than that fraction of the screen will use LOD 1");
+	newOption("scene.lodScreenSize1", 0.1, "Objects smaller than that fraction of the screen will use LOD 2");
+	newOption("scene.lodHysteresis", 0.1, "Fraction of the LOD screen sizes that will be used to avoid popping");
+	newOption("scene.lodTriangleBudget", 0, "Max triangles of the main camera per frame. Zero means no budget");
+	newOption("scene.threadFrameAllocators", true, "Give every thread its own frame allocator for the visibility tests");
 
 	// Globals
 	newOption("width", 1280);
@@ -60,6 +64,21 @@ Config::Config()
 	newOption("rsrc.textureAnisotropy", 8);
 	newOption("rsrc.dataPaths", ".", "The engine loads assets only in from these paths. Separate them with :");
 	newOption("rsrc.transferScratchMemorySize", 256_MB);
+	newOption("rsrc.preprocessShaderPrograms", true, "Preprocess all the shader programs in parallel at startup");
+	newOption("rsrc.shaderProgramPackage", "", "A file with precompiled shader programs. See the shader_package tool");
+	newOption("rsrc.hotReload", false, "Reload the shader programs and the textures when their files change");
+	newOption("rsrc.textureStreaming", false, "Load only the small mips of the textures and stream the rest on demand");
+	newOption("rsrc.textureStreamingResidentSize", 64, "The mips up to that size are always resident");
+	newOption("rsrc.textureStreamingMemoryBudget", 512_MB, "The max memory of the streamed textures");
+	newOption("rsrc.textureStreamingEvictionFrameCount", 120, "Evict the mips of textures not used for that many frames");
+	newOption("rsrc.textureStreamingMaxUploadsPerFrame", 4, "Max number of textures to start streaming per frame");
+
+	// Physics
+	newOption("physics.multithreaded", true, "Step the physics world in the ThreadHive if the build supports it");
+	newOption("physics.simulationRate", 60.0, "The physics steps per second. The steps are fixed");
+	newOption("physics.maxSubSteps", 4, "Max physics steps per frame. The time of the longer frames is dropped");
+	newOption("physics.interpolateTransforms", true, "Interpolate the transforms of the bodies between the steps");
+	newOption("physics.async", false, "Step the physics in a thread while the frame renders. Adds a frame of latency");
 
 	// Window
 	newOption("window.fullscreen", false);
@@ -69,6 +88,8 @@ Config::Config()
 
 	// GR
 	newOption("gr.diskShaderCacheMaxSize", 10_MB);
+	newOption("gr.pipelineStateLogRecord", false, "Log the state of the new pipelines to the cache directory");
+	newOption("gr.pipelineStatePrewarm", true, "Create the logged pipelines of the shader programs before they are used");
 	newOption("gr.vkminor", 1);
 	newOption("gr.vkmajor", 1);
 	newOption("gr.glmajor", 4);
@@ -79,6 +100,7 @@ Config::Config()
 	newOption("core.storagePerFrameMemorySize", 16_MB);
 	newOption("core.vertexPerFrameMemorySize", 10_MB);
 	newOption("core.textureBufferPerFrameMemorySize", 1_MB);
+	newOption("core.stagingThreadWindowSize", 64_KB, "The size of the per-thread windows of the staging memory");
 	newOption("core.mainThreadCount", max(2u, getCpuCoresCount() / 2u - 1u));
 	newOption("core.displayStats", false);
 	newOption("core.clearCaches", false);
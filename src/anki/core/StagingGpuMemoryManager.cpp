@@ -30,6 +30,7 @@ Error StagingGpuMemoryManager::init(GrManager* gr, const ConfigSet& cfg)
 	m_perFrameBuffers[StagingGpuMemoryType::STORAGE].m_size = cfg.getNumber("core.storagePerFrameMemorySize");
 	m_perFrameBuffers[StagingGpuMemoryType::VERTEX].m_size = cfg.getNumber("core.vertexPerFrameMemorySize");
 	m_perFrameBuffers[StagingGpuMemoryType::TEXTURE].m_size = cfg.getNumber("core.textureBufferPerFrameMemorySize");
+	m_threadWindowSize = cfg.getNumber("core.stagingThreadWindowSize");
 
 	initBuffer(StagingGpuMemoryType::UNIFORM,
 		gr->getDeviceCapabilities().m_uniformBufferBindOffsetAlignment,
@@ -60,7 +61,7 @@ void StagingGpuMemoryManager::initBuffer(
 	auto& perframe = m_perFrameBuffers[type];
 
 	perframe.m_buff = gr.newBuffer(BufferInitInfo(perframe.m_size, usage, BufferMapAccessBit::WRITE, "Staging"));
-	perframe.m_alloc.init(perframe.m_size, alignment, maxAllocSize);
+	perframe.m_alloc.init(perframe.m_size, alignment, maxAllocSize, m_threadWindowSize);
 	perframe.m_mappedMem = static_cast<U8*>(perframe.m_buff->map(0, perframe.m_size, BufferMapAccessBit::WRITE));
 }
 
@@ -120,6 +121,24 @@ void StagingGpuMemoryManager::endFrame()
 			}
 
 			buff.m_alloc.endFrame();
+
+			switch(usage)
+			{
+			case StagingGpuMemoryType::UNIFORM:
+				ANKI_TRACE_INC_COUNTER(STAGING_UNIFORMS_HIGH_WATER_MARK, buff.m_alloc.getHighWaterMark());
+				break;
+			case StagingGpuMemoryType::STORAGE:
+				ANKI_TRACE_INC_COUNTER(STAGING_STORAGE_HIGH_WATER_MARK, buff.m_alloc.getHighWaterMark());
+				break;
+			case StagingGpuMemoryType::VERTEX:
+				ANKI_TRACE_INC_COUNTER(STAGING_VERTEX_HIGH_WATER_MARK, buff.m_alloc.getHighWaterMark());
+				break;
+			case StagingGpuMemoryType::TEXTURE:
+				ANKI_TRACE_INC_COUNTER(STAGING_TEXTURE_HIGH_WATER_MARK, buff.m_alloc.getHighWaterMark());
+				break;
+			default:
+				ANKI_ASSERT(0);
+			}
 		}
 	}
 }
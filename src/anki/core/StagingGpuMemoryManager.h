@@ -74,13 +74,19 @@ public:
 	void endFrame();
 
 	/// Allocate staging memory for various operations. The memory will be reclaimed at the begining of the
-	/// N-(MAX_FRAMES_IN_FLIGHT-1) frame.
+	/// N+MAX_FRAMES_IN_FLIGHT frame. The frames in flight share the memory of a type so a frame can use more than
+	/// its share if the others use less.
 	void* allocateFrame(PtrSize size, StagingGpuMemoryType usage, StagingGpuMemoryToken& token);
 
-	/// Allocate staging memory for various operations. The memory will be reclaimed at the begining of the
-	/// N-(MAX_FRAMES_IN_FLIGHT-1) frame.
+	/// Same as allocateFrame but it returns nullptr if there is no memory.
 	void* tryAllocateFrame(PtrSize size, StagingGpuMemoryType usage, StagingGpuMemoryToken& token);
 
+	/// Get the max memory of a type that was used by the frames in flight. Use it to tune the sizes in the config.
+	PtrSize getHighWaterMark(StagingGpuMemoryType usage) const
+	{
+		return m_perFrameBuffers[usage].m_alloc.getHighWaterMark();
+	}
+
 private:
 	class PerFrameBuffer
 	{
@@ -92,6 +98,7 @@ private:
 	};
 
 	GrManager* m_gr = nullptr;
+	PtrSize m_threadWindowSize = 0;
 	Array<PerFrameBuffer, U(StagingGpuMemoryType::COUNT)> m_perFrameBuffers;
 
 	void initBuffer(
@@ -146,6 +146,9 @@ public:
 template<typename T>
 using GrAllocator = HeapAllocator<T>;
 
+/// Called while the pipelines are prewarmed. See GrManager::prewarmPipelines.
+using PipelinePrewarmProgressCallback = void (*)(void* userData, U32 pipelinesDone, U32 pipelineCount);
+
 /// Clear values for textures or attachments.
 class ClearValue
 {
@@ -15,6 +15,7 @@ namespace anki
 // Forward
 class ConfigSet;
 class NativeWindow;
+class ThreadHive;
 
 /// @addtogroup graphics
 /// @{
@@ -66,6 +67,13 @@ public:
 	/// Wait for all work to finish.
 	void finish();
 
+	/// Create the pipelines that the previous runs logged for the shader programs that were created so far. Call it
+	/// once, after loading and before the first frame that uses the programs. The programs that are created after it
+	/// create their pipelines when they are first used.
+	/// @param hive The pipelines will be created in the threads of the hive.
+	/// @param callback Optional callback to report the progress. It's called from the thread that calls this method.
+	void prewarmPipelines(ThreadHive& hive, PipelinePrewarmProgressCallback callback = nullptr, void* userData = nullptr);
+
 	/// @name Object creation methods. They are thread-safe.
 	/// @{
 	ANKI_USE_RESULT BufferPtr newBuffer(const BufferInitInfo& init);
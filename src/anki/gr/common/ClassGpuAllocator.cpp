@@ -6,6 +6,8 @@
 #include <anki/gr/common/ClassGpuAllocator.h>
 #include <anki/util/List.h>
 #include <anki/util/BitSet.h>
+#include <anki/util/HighRezTimer.h>
+#include <algorithm>
 
 namespace anki
 {
@@ -176,55 +178,55 @@ void ClassGpuAllocator::destroyChunk(Class& cl, Chunk& chunk)
 	m_allocatedMem -= cl.m_chunkSize;
 }
 
-Error ClassGpuAllocator::allocate(PtrSize size, U alignment, ClassGpuAllocatorHandle& handle)
+Error ClassGpuAllocator::allocateFromClass(Class& cl, U alignment, ClassGpuAllocatorHandle& handle)
 {
 	ANKI_ASSERT(!handle);
 	ANKI_ASSERT(handle.valid());
 
-	// Find the class for the given size
-	Class* cl = findClass(size, alignment);
-
-	LockGuard<Mutex> lock(cl->m_mtx);
-	Chunk* chunk = findChunkWithUnusedSlot(*cl);
+	Chunk* chunk = findChunkWithUnusedSlot(cl);
 
 	// Create a new chunk if needed
 	if(chunk == nullptr)
 	{
-		ANKI_CHECK(createChunk(*cl, chunk));
+		ANKI_CHECK(createChunk(cl, chunk));
 	}
 
-	// Allocate from chunk
-	U bitCount = cl->m_slotsPerChunkCount;
+	allocateFromChunk(cl, *chunk, handle);
+	ANKI_ASSERT(isAligned(alignment, handle.m_offset));
+	return Error::NONE;
+}
+
+void ClassGpuAllocator::allocateFromChunk(Class& cl, Chunk& chunk, ClassGpuAllocatorHandle& handle)
+{
+	ANKI_ASSERT(chunk.m_inUseSlotCount < cl.m_slotsPerChunkCount);
+
+	U bitCount = cl.m_slotsPerChunkCount;
 	for(U i = 0; i < bitCount; ++i)
 	{
-		if(!chunk->m_inUseSlots.get(i))
+		if(!chunk.m_inUseSlots.get(i))
 		{
 			// Found an empty slot, allocate from it
-			chunk->m_inUseSlots.set(i);
-			++chunk->m_inUseSlotCount;
+			chunk.m_inUseSlots.set(i);
+			++chunk.m_inUseSlotCount;
 
-			handle.m_memory = chunk->m_mem;
-			handle.m_offset = i * cl->m_maxSlotSize;
-			handle.m_chunk = chunk;
+			handle.m_memory = chunk.m_mem;
+			handle.m_offset = i * cl.m_maxSlotSize;
+			handle.m_chunk = &chunk;
 
 			break;
 		}
 	}
 
 	ANKI_ASSERT(handle.m_memory && handle.m_chunk);
-	ANKI_ASSERT(isAligned(alignment, handle.m_offset));
-	return Error::NONE;
 }
 
-void ClassGpuAllocator::free(ClassGpuAllocatorHandle& handle)
+void ClassGpuAllocator::freeToClass(Class& cl, ClassGpuAllocatorHandle& handle)
 {
 	ANKI_ASSERT(handle);
 	ANKI_ASSERT(handle.valid());
 
 	Chunk& chunk = *handle.m_chunk;
-	Class& cl = *chunk.m_class;
-
-	LockGuard<Mutex> lock(cl.m_mtx);
+	ANKI_ASSERT(chunk.m_class == &cl);
 	U slotIdx = handle.m_offset / cl.m_maxSlotSize;
 
 	ANKI_ASSERT(chunk.m_inUseSlots.get(slotIdx));
@@ -240,4 +242,221 @@ void ClassGpuAllocator::free(ClassGpuAllocatorHandle& handle)
 	handle = {};
 }
 
+Error ClassGpuAllocator::allocate(PtrSize size, U alignment, ClassGpuAllocatorHandle& handle)
+{
+	// Find the class for the given size
+	Class* cl = findClass(size, alignment);
+
+	LockGuard<Mutex> lock(cl->m_mtx);
+	return allocateFromClass(*cl, alignment, handle);
+}
+
+void ClassGpuAllocator::free(ClassGpuAllocatorHandle& handle)
+{
+	ANKI_ASSERT(handle);
+	ANKI_ASSERT(handle.valid());
+
+	Class& cl = *handle.m_chunk->m_class;
+
+	LockGuard<Mutex> lock(cl.m_mtx);
+	freeToClass(cl, handle);
+}
+
+U ClassGpuAllocator::getClassIndex(PtrSize size, U alignment)
+{
+	return findClass(size, alignment) - &m_classes[0];
+}
+
+U ClassGpuAllocator::getClassIndex(const ClassGpuAllocatorHandle& handle) const
+{
+	ANKI_ASSERT(handle);
+	ANKI_ASSERT(handle.valid());
+	return handle.m_chunk->m_class - &m_classes[0];
+}
+
+Error ClassGpuAllocator::allocateBatch(U classIdx, WeakArray<ClassGpuAllocatorHandle> handles)
+{
+	Class& cl = m_classes[classIdx];
+
+	LockGuard<Mutex> lock(cl.m_mtx);
+	for(ClassGpuAllocatorHandle& handle : handles)
+	{
+		ANKI_CHECK(allocateFromClass(cl, 1, handle));
+	}
+
+	return Error::NONE;
+}
+
+void ClassGpuAllocator::freeBatch(WeakArray<ClassGpuAllocatorHandle> handles)
+{
+	// Group the handles per class to lock every class once
+	std::sort(handles.getBegin(),
+		handles.getEnd(),
+		[](const ClassGpuAllocatorHandle& a, const ClassGpuAllocatorHandle& b) {
+			return a.m_chunk->m_class < b.m_chunk->m_class;
+		});
+
+	U i = 0;
+	while(i < handles.getSize())
+	{
+		Class& cl = *handles[i].m_chunk->m_class;
+
+		LockGuard<Mutex> lock(cl.m_mtx);
+		while(i < handles.getSize() && handles[i].m_chunk->m_class == &cl)
+		{
+			freeToClass(cl, handles[i]);
+			++i;
+		}
+	}
+}
+
+void ClassGpuAllocator::getClassStats(U classIdx, F32 maxChunkOccupancy, ClassGpuAllocatorClassStats& stats)
+{
+	Class& cl = m_classes[classIdx];
+	const U32 maxSparseSlotCount = U32(maxChunkOccupancy * F32(cl.m_slotsPerChunkCount));
+
+	stats = {};
+	stats.m_slotSize = cl.m_maxSlotSize;
+	stats.m_slotsPerChunk = cl.m_slotsPerChunkCount;
+
+	LockGuard<Mutex> lock(cl.m_mtx);
+	for(const Chunk& chunk : cl.m_inUseChunks)
+	{
+		++stats.m_chunkCount;
+		stats.m_usedSlotCount += chunk.m_inUseSlotCount;
+
+		if(chunk.m_inUseSlotCount <= maxSparseSlotCount)
+		{
+			++stats.m_sparseChunkCount;
+			stats.m_movableSlotCount += chunk.m_inUseSlotCount;
+		}
+	}
+}
+
+void ClassGpuAllocator::compact(F32 maxChunkOccupancy,
+	Second timeBudget,
+	ClassGpuAllocatorMoveCallback moveCb,
+	void* moveCbUserData,
+	ClassGpuAllocatorCompactionStats& stats)
+{
+	ANKI_ASSERT(maxChunkOccupancy >= 0.0f && maxChunkOccupancy < 1.0f);
+	ANKI_ASSERT(moveCb);
+
+	stats = {};
+	const Second endTime = HighRezTimer::getCurrentTime() + timeBudget;
+
+	// Start from the class it stopped the last time
+	for(U i = 0; i < m_classes.getSize(); ++i)
+	{
+		Class& cl = m_classes[m_nextClassToCompact];
+
+		LockGuard<Mutex> lock(cl.m_mtx);
+		if(!compactClass(cl, maxChunkOccupancy, endTime, moveCb, moveCbUserData, stats))
+		{
+			stats.m_outOfTime = true;
+			break;
+		}
+
+		m_nextClassToCompact = (m_nextClassToCompact + 1) % m_classes.getSize();
+	}
+}
+
+Bool ClassGpuAllocator::compactClass(Class& cl,
+	F32 maxChunkOccupancy,
+	Second endTime,
+	ClassGpuAllocatorMoveCallback moveCb,
+	void* moveCbUserData,
+	ClassGpuAllocatorCompactionStats& stats)
+{
+	// Sort the chunks from the sparsest to the densest. The sparse ones will move to the dense ones
+	DynamicArrayAuto<Chunk*> chunks(m_alloc);
+	U32 freeSlotCount = 0;
+	for(Chunk& chunk : cl.m_inUseChunks)
+	{
+		chunks.emplaceBack(&chunk);
+		freeSlotCount += cl.m_slotsPerChunkCount - chunk.m_inUseSlotCount;
+	}
+
+	if(chunks.getSize() < 2)
+	{
+		return true;
+	}
+
+	std::sort(chunks.getBegin(), chunks.getEnd(), [](const Chunk* a, const Chunk* b) {
+		return a->m_inUseSlotCount < b->m_inUseSlotCount;
+	});
+
+	const U32 maxSparseSlotCount = U32(maxChunkOccupancy * F32(cl.m_slotsPerChunkCount));
+	U src = 0;
+	U dst = chunks.getSize() - 1;
+	while(src < dst)
+	{
+		Chunk& srcChunk = *chunks[src];
+
+		// The free slots of the chunks after the src. The chunks after the dst are full
+		freeSlotCount -= cl.m_slotsPerChunkCount - srcChunk.m_inUseSlotCount;
+
+		// Evacuate only if the whole chunk can go. The next chunks are denser so stop if this one can't go
+		if(srcChunk.m_inUseSlotCount > maxSparseSlotCount || srcChunk.m_inUseSlotCount > freeSlotCount)
+		{
+			break;
+		}
+
+		Bool evacuated = true;
+		for(U slotIdx = 0; slotIdx < cl.m_slotsPerChunkCount && srcChunk.m_inUseSlotCount > 0; ++slotIdx)
+		{
+			if(!srcChunk.m_inUseSlots.get(slotIdx))
+			{
+				continue;
+			}
+
+			if(HighRezTimer::getCurrentTime() >= endTime)
+			{
+				return false;
+			}
+
+			while(chunks[dst]->m_inUseSlotCount == cl.m_slotsPerChunkCount)
+			{
+				--dst;
+			}
+			ANKI_ASSERT(dst > src);
+
+			ClassGpuAllocatorHandle oldHandle;
+			oldHandle.m_memory = srcChunk.m_mem;
+			oldHandle.m_offset = slotIdx * cl.m_maxSlotSize;
+			oldHandle.m_chunk = &srcChunk;
+
+			ClassGpuAllocatorHandle newHandle;
+			allocateFromChunk(cl, *chunks[dst], newHandle);
+
+			if(!moveCb(oldHandle, newHandle, moveCbUserData))
+			{
+				// Can't move, leave the chunk alone. Give back the slot without releasing the chunk
+				Chunk& dstChunk = *newHandle.m_chunk;
+				dstChunk.m_inUseSlots.unset(newHandle.m_offset / cl.m_maxSlotSize);
+				--dstChunk.m_inUseSlotCount;
+
+				evacuated = false;
+				break;
+			}
+
+			srcChunk.m_inUseSlots.unset(slotIdx);
+			--srcChunk.m_inUseSlotCount;
+			--freeSlotCount;
+			++stats.m_moveCount;
+		}
+
+		if(evacuated)
+		{
+			ANKI_ASSERT(srcChunk.m_inUseSlotCount == 0);
+			destroyChunk(cl, srcChunk);
+			++stats.m_releasedChunkCount;
+		}
+
+		++src;
+	}
+
+	return true;
+}
+
 } // end namespace anki
@@ -6,6 +6,7 @@
 #pragma once
 
 #include <anki/gr/Common.h>
+#include <anki/util/WeakArray.h>
 
 namespace anki
 {
@@ -67,6 +68,41 @@ private:
 	}
 };
 
+/// Fragmentation statistics of a class of ClassGpuAllocator.
+class ClassGpuAllocatorClassStats
+{
+public:
+	PtrSize m_slotSize = 0;
+	U32 m_slotsPerChunk = 0;
+	U32 m_chunkCount = 0;
+	U32 m_usedSlotCount = 0;
+	U32 m_sparseChunkCount = 0; ///< The chunks that ClassGpuAllocator::compact will try to release.
+	U32 m_movableSlotCount = 0; ///< The used slots of the sparse chunks.
+
+	/// The fraction of the class' memory that is not used.
+	F32 getFragmentation() const
+	{
+		const U32 slotCount = m_chunkCount * m_slotsPerChunk;
+		return (slotCount) ? 1.0f - F32(m_usedSlotCount) / F32(slotCount) : 0.0f;
+	}
+};
+
+/// The output of ClassGpuAllocator::compact.
+class ClassGpuAllocatorCompactionStats
+{
+public:
+	U32 m_moveCount = 0;
+	U32 m_releasedChunkCount = 0;
+	Bool8 m_outOfTime = false; ///< If true there is more work to do in the next compact().
+};
+
+/// Called by ClassGpuAllocator::compact to move an allocation to another chunk. The callee should copy the contents and
+/// make the owner of oldHandle use newHandle. The ClassGpuAllocator is locked while it runs so it shouldn't allocate or
+/// free from it.
+/// @return False if the allocation can't move now. The compaction will skip its chunk.
+using ClassGpuAllocatorMoveCallback = Bool (*)(
+	const ClassGpuAllocatorHandle& oldHandle, const ClassGpuAllocatorHandle& newHandle, void* userData);
+
 /// Class based allocator.
 class ClassGpuAllocator : public NonCopyable
 {
@@ -85,11 +121,50 @@ public:
 	/// Free allocated memory.
 	void free(ClassGpuAllocatorHandle& handle);
 
+	/// Allocate a number of slots of a class. It locks the class only once.
+	/// @param classIdx The class. See getClassIndex.
+	/// @param[out] handles The new handles. On failure some of them might be valid and need to be freed.
+	ANKI_USE_RESULT Error allocateBatch(U classIdx, WeakArray<ClassGpuAllocatorHandle> handles);
+
+	/// Free a number of allocations of any class. It locks every class once.
+	void freeBatch(WeakArray<ClassGpuAllocatorHandle> handles);
+
+	/// Get the class that serves allocations of a given size and alignment. Every slot of that class can host them.
+	U getClassIndex(PtrSize size, U alignment);
+
+	/// Get the class of an allocation.
+	U getClassIndex(const ClassGpuAllocatorHandle& handle) const;
+
+	U getClassCount() const
+	{
+		return m_classes.getSize();
+	}
+
 	PtrSize getAllocatedMemory() const
 	{
 		return m_allocatedMem;
 	}
 
+	/// Get the fragmentation statistics of a class.
+	/// @param classIdx The class.
+	/// @param maxChunkOccupancy Chunks that use up to that fraction of their slots are considered sparse.
+	/// @param[out] stats The stats.
+	void getClassStats(U classIdx, F32 maxChunkOccupancy, ClassGpuAllocatorClassStats& stats);
+
+	/// Move allocations out of the sparse chunks and into the free slots of the other chunks in order to release the
+	/// sparse chunks. A chunk is evacuated only if the rest can host all of its allocations. It will continue from
+	/// where it stopped if it runs out of time.
+	/// @param maxChunkOccupancy Chunks that use up to that fraction of their slots are considered sparse.
+	/// @param timeBudget Stop moving allocations after that time.
+	/// @param moveCb The callback that moves an allocation.
+	/// @param moveCbUserData User data for moveCb.
+	/// @param[out] stats What happened.
+	void compact(F32 maxChunkOccupancy,
+		Second timeBudget,
+		ClassGpuAllocatorMoveCallback moveCb,
+		void* moveCbUserData,
+		ClassGpuAllocatorCompactionStats& stats);
+
 private:
 	using Class = ClassGpuAllocatorClass;
 	using Chunk = ClassGpuAllocatorChunk;
@@ -102,10 +177,30 @@ private:
 
 	PtrSize m_allocatedMem = 0; ///< An estimate.
 
+	U32 m_nextClassToCompact = 0;
+
 	Class* findClass(PtrSize size, U alignment);
 
 	Chunk* findChunkWithUnusedSlot(Class& cl);
 
+	/// Allocate a slot. The class should be locked.
+	ANKI_USE_RESULT Error allocateFromClass(Class& cl, U alignment, ClassGpuAllocatorHandle& handle);
+
+	/// Allocate a slot from a chunk that has free slots. The class should be locked.
+	void allocateFromChunk(Class& cl, Chunk& chunk, ClassGpuAllocatorHandle& handle);
+
+	/// Free a slot. The class should be locked.
+	void freeToClass(Class& cl, ClassGpuAllocatorHandle& handle);
+
+	/// Compact a class. It should be locked.
+	/// @return False if it ran out of time.
+	Bool compactClass(Class& cl,
+		F32 maxChunkOccupancy,
+		Second endTime,
+		ClassGpuAllocatorMoveCallback moveCb,
+		void* moveCbUserData,
+		ClassGpuAllocatorCompactionStats& stats);
+
 	/// Create a new chunk.
 	ANKI_USE_RESULT Error createChunk(Class& cl, Chunk*& chunk);
 
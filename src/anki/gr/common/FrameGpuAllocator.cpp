@@ -8,71 +8,154 @@
 namespace anki
 {
 
-void FrameGpuAllocator::init(PtrSize size, U32 alignment, PtrSize maxAllocationSize)
+static Atomic<U64> g_frameGpuAllocatorUuid = {0};
+
+class FrameGpuAllocator::ThreadWindow
+{
+public:
+	U64 m_allocatorUuid = 0;
+	U64 m_frame = 0;
+	PtrSize m_offset = 0;
+	PtrSize m_end = 0;
+};
+
+void FrameGpuAllocator::init(PtrSize size, U32 alignment, PtrSize maxAllocationSize, PtrSize threadWindowSize)
 {
 	ANKI_ASSERT(!isCreated());
 	ANKI_ASSERT(size > 0 && alignment > 0 && maxAllocationSize > 0);
 
-	PtrSize perFrameSize = size / MAX_FRAMES_IN_FLIGHT;
-	alignRoundDown(alignment, perFrameSize);
-	m_size = perFrameSize * MAX_FRAMES_IN_FLIGHT;
+	m_size = size;
+	alignRoundDown(alignment, m_size);
+	ANKI_ASSERT(m_size > 0);
 
 	m_alignment = alignment;
 	m_maxAllocationSize = maxAllocationSize;
+	m_uuid = g_frameGpuAllocatorUuid.fetchAdd(1) + 1;
+
+	// Don't let the windows take a big part of the buffer
+	m_threadWindowSize = min(threadWindowSize, m_size / (MAX_FRAMES_IN_FLIGHT * 16));
+	alignRoundDown(alignment, m_threadWindowSize);
 }
 
 PtrSize FrameGpuAllocator::endFrame()
 {
 	ANKI_ASSERT(isCreated());
 
-	PtrSize perFrameSize = m_size / MAX_FRAMES_IN_FLIGHT;
+	const U64 head = m_head.load();
+	m_frameHighWaterMark = max<PtrSize>(m_frameHighWaterMark, head - m_frameStart);
+	m_highWaterMark = max<PtrSize>(m_highWaterMark, head - m_tail);
+
+	m_frameEnds[m_frame % MAX_FRAMES_IN_FLIGHT] = head;
+	m_frameStart = head;
+	++m_frame;
+
+	// The GrManager has waited for the fence of the frame that was in flight MAX_FRAMES_IN_FLIGHT frames ago. Reclaim
+	// its memory
+	if(m_frame >= MAX_FRAMES_IN_FLIGHT)
+	{
+		m_tail = m_frameEnds[m_frame % MAX_FRAMES_IN_FLIGHT];
+	}
 
-	PtrSize crntFrameStartOffset = perFrameSize * (m_frame % MAX_FRAMES_IN_FLIGHT);
+	ANKI_ASSERT(head - m_tail <= m_size);
+	return m_size - (head - m_tail);
+}
 
-	PtrSize nextFrameStartOffset = perFrameSize * ((m_frame + 1) % MAX_FRAMES_IN_FLIGHT);
+FrameGpuAllocator::ThreadWindow& FrameGpuAllocator::getThreadWindow()
+{
+	static const U32 MAX_ALLOCATORS_PER_THREAD = 8;
+	static thread_local Array<ThreadWindow, MAX_ALLOCATORS_PER_THREAD> windows;
+	static thread_local U32 nextWindowToEvict;
 
-	PtrSize crntOffset = m_offset.exchange(nextFrameStartOffset);
-	ANKI_ASSERT(crntOffset >= crntFrameStartOffset);
+	for(ThreadWindow& window : windows)
+	{
+		if(window.m_allocatorUuid == m_uuid)
+		{
+			return window;
+		}
+	}
 
-	PtrSize bytesUsed = crntOffset - crntFrameStartOffset;
-	PtrSize bytesNotUsed = (bytesUsed > perFrameSize) ? 0 : perFrameSize - bytesUsed;
+	// First time this thread uses the allocator. Steal the window of another allocator, it will get a new one next time
+	ThreadWindow& window = windows[nextWindowToEvict++ % MAX_ALLOCATORS_PER_THREAD];
+	window = ThreadWindow();
+	window.m_allocatorUuid = m_uuid;
+	window.m_frame = MAX_U64;
+	return window;
+}
 
-	++m_frame;
-	return bytesNotUsed;
+Error FrameGpuAllocator::allocateFromRing(PtrSize size, PtrSize& outOffset)
+{
+	U64 start;
+	U64 end;
+	U64 head = m_head.load();
+	do
+	{
+		start = head;
+
+		// Allocations are contiguous. If it doesn't fit before the end of the buffer skip to the start
+		const PtrSize offset = start % m_size;
+		if(offset + size > m_size)
+		{
+			start += m_size - offset;
+		}
+
+		end = start + size;
+		if(end - m_tail > m_size)
+		{
+			return Error::OUT_OF_MEMORY;
+		}
+	} while(!m_head.compareExchange(head, end));
+
+	outOffset = start % m_size;
+	return Error::NONE;
 }
 
 Error FrameGpuAllocator::allocate(PtrSize originalSize, PtrSize& outOffset)
 {
 	ANKI_ASSERT(isCreated());
 	ANKI_ASSERT(originalSize > 0);
-	Error err = Error::NONE;
 
 	// Align size
 	PtrSize size = getAlignedRoundUp(m_alignment, originalSize);
 	ANKI_ASSERT(size <= m_maxAllocationSize && "Too high!");
 
-	PtrSize offset = m_offset.fetchAdd(size);
-	PtrSize perFrameSize = m_size / MAX_FRAMES_IN_FLIGHT;
-	PtrSize crntFrameStartOffset = perFrameSize * (m_frame % MAX_FRAMES_IN_FLIGHT);
-
-	if(offset - crntFrameStartOffset + size <= perFrameSize)
+	// Small allocations go to the window of the thread
+	if(size <= m_threadWindowSize / 4)
 	{
-		ANKI_ASSERT(isAligned(m_alignment, offset));
-		ANKI_ASSERT((offset + size) <= m_size);
-
-#if ANKI_ENABLE_TRACE
-		m_lastAllocatedSize.store(size);
-#endif
-
-		// Encode token
-		outOffset = offset;
+		ThreadWindow& window = getThreadWindow();
+
+		if(window.m_frame != m_frame || window.m_offset + size > window.m_end)
+		{
+			// The window is full or it belongs to a previous frame, get a new one. If there is no space for a window
+			// the allocation might still fit in the ring
+			PtrSize offset;
+			if(!allocateFromRing(m_threadWindowSize, offset))
+			{
+				window.m_frame = m_frame;
+				window.m_offset = offset;
+				window.m_end = offset + m_threadWindowSize;
+			}
+		}
+
+		if(window.m_frame == m_frame && window.m_offset + size <= window.m_end)
+		{
+			outOffset = window.m_offset;
+			window.m_offset += size;
+
+			ANKI_ASSERT(isAligned(m_alignment, outOffset));
+			ANKI_ASSERT(outOffset + originalSize <= m_size);
+			return Error::NONE;
+		}
+	}
 
-		ANKI_ASSERT(outOffset + originalSize <= m_size);
+	const Error err = allocateFromRing(size, outOffset);
+	if(err)
+	{
+		outOffset = MAX_PTR_SIZE;
 	}
 	else
 	{
-		outOffset = MAX_PTR_SIZE;
-		err = Error::OUT_OF_MEMORY;
+		ANKI_ASSERT(isAligned(m_alignment, outOffset));
+		ANKI_ASSERT(outOffset + originalSize <= m_size);
 	}
 
 	return err;
@@ -81,13 +164,8 @@ Error FrameGpuAllocator::allocate(PtrSize originalSize, PtrSize& outOffset)
 #if ANKI_ENABLE_TRACE
 PtrSize FrameGpuAllocator::getUnallocatedMemorySize() const
 {
-	PtrSize perFrameSize = m_size / MAX_FRAMES_IN_FLIGHT;
-	PtrSize crntFrameStartOffset = perFrameSize * (m_frame % MAX_FRAMES_IN_FLIGHT);
-	PtrSize usedSize = m_offset.get() - crntFrameStartOffset + m_lastAllocatedSize.get();
-
-	PtrSize remaining = (perFrameSize >= usedSize) ? (perFrameSize - usedSize) : 0;
-	return remaining;
+	return m_size - (m_head.load() - m_tail);
 }
 #endif
 
-} // end namespace anki
\ No newline at end of file
+} // end namespace anki
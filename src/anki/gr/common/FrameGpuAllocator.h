@@ -13,7 +13,10 @@ namespace anki
 /// @addtogroup graphics
 /// @{
 
-/// Manages pre-allocated GPU memory for per frame usage.
+/// Manages pre-allocated GPU memory for per frame usage. The memory is a ring buffer shared by all the frames in flight
+/// so a heavy frame can use the space that the light frames left. The memory of a frame is reclaimed when the GPU is
+/// done with it, MAX_FRAMES_IN_FLIGHT frames later. The small allocations are served by per-thread windows that are
+/// carved from the ring so most of them don't touch any atomic.
 class FrameGpuAllocator : public NonCopyable
 {
 	friend class DynamicMemorySerializeCommand;
@@ -31,35 +34,65 @@ public:
 	/// @param size The size of the GPU buffer.
 	/// @param alignment The working alignment.
 	/// @param maxAllocationSize The size in @a allocate cannot exceed maxAllocationSize.
-	void init(PtrSize size, U32 alignment, PtrSize maxAllocationSize = MAX_PTR_SIZE);
+	/// @param threadWindowSize The size of the per-thread windows. Allocations bigger than a quarter of that go
+	///                         directly to the ring. Zero disables the windows.
+	void init(PtrSize size, U32 alignment, PtrSize maxAllocationSize = MAX_PTR_SIZE, PtrSize threadWindowSize = 64_KB);
 
-	/// Allocate memory for a dynamic buffer.
+	/// Allocate memory for a dynamic buffer. It's thread safe but it shouldn't run in parallel with endFrame().
 	ANKI_USE_RESULT Error allocate(PtrSize size, PtrSize& outOffset);
 
 	/// Call this at the end of the frame.
 	/// @return The bytes that were not used. Used for statistics.
 	PtrSize endFrame();
 
+	/// The max memory that was used by the frames in flight. The memory wasted in the windows and at the end of the
+	/// buffer when the ring wraps is included.
+	PtrSize getHighWaterMark() const
+	{
+		return m_highWaterMark;
+	}
+
+	/// The max memory that was used by a single frame.
+	PtrSize getFrameHighWaterMark() const
+	{
+		return m_frameHighWaterMark;
+	}
+
 #if ANKI_ENABLE_TRACE
 	/// Call this before endFrame.
 	PtrSize getUnallocatedMemorySize() const;
 #endif
 
 private:
+	class ThreadWindow;
+
 	PtrSize m_size = 0; ///< The full size of the buffer.
 	U32 m_alignment = 0; ///< Always work in that alignment.
 	PtrSize m_maxAllocationSize = 0; ///< For debugging.
+	PtrSize m_threadWindowSize = 0;
+	U64 m_uuid = 0; ///< Identifies the allocator in the thread local storage.
+
+	/// The positions in the ring grow forever. The offset in the buffer is the position modulo m_size.
+	Atomic<U64> m_head = {0};
+	U64 m_tail = 0; ///< Where the oldest frame in flight starts.
+	U64 m_frameStart = 0; ///< Where the current frame starts.
+	Array<U64, MAX_FRAMES_IN_FLIGHT> m_frameEnds = {}; ///< Where the frames in flight end.
+
+	PtrSize m_highWaterMark = 0;
+	PtrSize m_frameHighWaterMark = 0;
 
-	Atomic<PtrSize> m_offset = {0};
-#if ANKI_ENABLE_TRACE
-	Atomic<PtrSize> m_lastAllocatedSize = {0}; ///< For tracing.
-#endif
 	U64 m_frame = 0;
 
 	Bool isCreated() const
 	{
 		return m_size > 0;
 	}
+
+	/// Allocate a contiguous range from the ring.
+	ANKI_USE_RESULT Error allocateFromRing(PtrSize size, PtrSize& outOffset);
+
+	/// Get the window of the calling thread.
+	ThreadWindow& getThreadWindow();
 };
 /// @}
 
@@ -0,0 +1,240 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/gr/common/ShardedClassGpuAllocator.h>
+
+namespace anki
+{
+
+/// Used to give a different shard to every thread.
+static Atomic<U32> g_shardedClassGpuAllocatorThreadCount = {0};
+
+ShardedClassGpuAllocator::~ShardedClassGpuAllocator()
+{
+	destroy();
+}
+
+void ShardedClassGpuAllocator::init(GenericMemoryPoolAllocator<U8> alloc, ClassGpuAllocatorInterface* iface)
+{
+	ANKI_ASSERT(iface);
+	m_alloc = alloc;
+	m_calloc.init(alloc, iface);
+
+	// Find the cached classes and how many slots every refill will get. Get a few slots of every chunk to leave some
+	// for the other threads
+	U cachedClassCount = 0;
+	while(cachedClassCount < iface->getClassCount())
+	{
+		PtrSize slotSize, chunkSize;
+		iface->getClassInfo(cachedClassCount, slotSize, chunkSize);
+
+		if(slotSize > MAX_CACHED_SLOT_SIZE || chunkSize / slotSize < 8)
+		{
+			break;
+		}
+
+		++cachedClassCount;
+	}
+
+	m_refillSlotCounts.create(m_alloc, cachedClassCount);
+	for(U i = 0; i < cachedClassCount; ++i)
+	{
+		PtrSize slotSize, chunkSize;
+		iface->getClassInfo(i, slotSize, chunkSize);
+		m_refillSlotCounts[i] = min<U32>(MAX_REFILL_SLOT_COUNT, chunkSize / slotSize / 4);
+	}
+
+	m_shards = m_alloc.newArray<Shard>(SHARD_COUNT);
+	for(U i = 0; i < SHARD_COUNT; ++i)
+	{
+		m_shards[i].m_caches.create(m_alloc, cachedClassCount);
+	}
+}
+
+void ShardedClassGpuAllocator::destroy()
+{
+	if(m_shards == nullptr)
+	{
+		return;
+	}
+
+	DynamicArrayAuto<ClassGpuAllocatorHandle> frees(m_alloc);
+	for(U i = 0; i < SHARD_COUNT; ++i)
+	{
+		Shard& shard = m_shards[i];
+
+		for(ClassCache& cache : shard.m_caches)
+		{
+			for(U j = 0; j < cache.m_slotCount; ++j)
+			{
+				frees.emplaceBack(cache.m_slots[j]);
+			}
+		}
+
+		for(const ClassGpuAllocatorHandle& handle : shard.m_deferredFrees)
+		{
+			frees.emplaceBack(handle);
+		}
+
+		shard.m_caches.destroy(m_alloc);
+		shard.m_deferredFrees.destroy(m_alloc);
+	}
+
+	if(frees.getSize())
+	{
+		m_calloc.freeBatch(WeakArray<ClassGpuAllocatorHandle>(frees));
+	}
+
+	m_alloc.deleteArray(m_shards, SHARD_COUNT);
+	m_shards = nullptr;
+	m_refillSlotCounts.destroy(m_alloc);
+}
+
+ShardedClassGpuAllocator::Shard& ShardedClassGpuAllocator::getShard()
+{
+	static thread_local U32 shardIdx = g_shardedClassGpuAllocatorThreadCount.fetchAdd(1) % SHARD_COUNT;
+	return m_shards[shardIdx];
+}
+
+Error ShardedClassGpuAllocator::allocate(PtrSize size, U alignment, ClassGpuAllocatorHandle& handle)
+{
+	ANKI_ASSERT(!handle);
+	ANKI_ASSERT(m_shards);
+
+	const U classIdx = m_calloc.getClassIndex(size, alignment);
+	if(classIdx >= m_refillSlotCounts.getSize())
+	{
+		// Too big to be cached
+		return m_calloc.allocate(size, alignment, handle);
+	}
+
+	Shard& shard = getShard();
+
+	// Fast path, get it from the cache
+	{
+		LockGuard<SpinLock> lock(shard.m_mtx);
+		ClassCache& cache = shard.m_caches[classIdx];
+		if(cache.m_slotCount > 0)
+		{
+			handle = cache.m_slots[--cache.m_slotCount];
+			return Error::NONE;
+		}
+	}
+
+	// Slow path, refill the cache. Do that outside the lock because the interface might allocate memory
+	Array<ClassGpuAllocatorHandle, MAX_REFILL_SLOT_COUNT> slots;
+	const U32 refillCount = m_refillSlotCounts[classIdx];
+	const Error err = m_calloc.allocateBatch(classIdx, WeakArray<ClassGpuAllocatorHandle>(&slots[0], refillCount));
+
+	// On failure keep what it managed to allocate
+	U32 slotCount = 0;
+	while(slotCount < refillCount && slots[slotCount])
+	{
+		++slotCount;
+	}
+
+	if(slotCount == 0)
+	{
+		ANKI_ASSERT(err);
+		return err;
+	}
+
+	handle = slots[0];
+
+	LockGuard<SpinLock> lock(shard.m_mtx);
+	ClassCache& cache = shard.m_caches[classIdx];
+	for(U32 i = 1; i < slotCount; ++i)
+	{
+		if(cache.m_slotCount < cache.m_slots.getSize())
+		{
+			cache.m_slots[cache.m_slotCount++] = slots[i];
+		}
+		else
+		{
+			// Another thread that shares the shard refilled it as well, return the extra slots with the next flush
+			shard.m_deferredFrees.emplaceBack(m_alloc, slots[i]);
+		}
+	}
+
+	return Error::NONE;
+}
+
+void ShardedClassGpuAllocator::free(ClassGpuAllocatorHandle& handle)
+{
+	ANKI_ASSERT(handle);
+	ANKI_ASSERT(m_shards);
+
+	Shard& shard = getShard();
+	{
+		LockGuard<SpinLock> lock(shard.m_mtx);
+		shard.m_deferredFrees.emplaceBack(m_alloc, handle);
+	}
+
+	handle = {};
+}
+
+void ShardedClassGpuAllocator::flushDeferredFrees()
+{
+	flushDeferredFreesInternal(true);
+}
+
+void ShardedClassGpuAllocator::compact(F32 maxChunkOccupancy,
+	Second timeBudget,
+	ClassGpuAllocatorMoveCallback moveCb,
+	void* moveCbUserData,
+	ClassGpuAllocatorCompactionStats& stats)
+{
+	// The cached slots and the deferred frees look used to the ClassGpuAllocator but nobody can move them
+	flushDeferredFreesInternal(false);
+	m_calloc.compact(maxChunkOccupancy, timeBudget, moveCb, moveCbUserData, stats);
+}
+
+void ShardedClassGpuAllocator::flushDeferredFreesInternal(Bool keepCachedSlots)
+{
+	ANKI_ASSERT(m_shards);
+
+	DynamicArrayAuto<ClassGpuAllocatorHandle> frees(m_alloc);
+	for(U i = 0; i < SHARD_COUNT; ++i)
+	{
+		Shard& shard = m_shards[i];
+		LockGuard<SpinLock> lock(shard.m_mtx);
+
+		// Trim the caches. They shouldn't keep more than a refill because the memory can't be used by the other threads
+		for(U classIdx = 0; classIdx < shard.m_caches.getSize(); ++classIdx)
+		{
+			ClassCache& cache = shard.m_caches[classIdx];
+			const U32 maxSlotCount = (keepCachedSlots) ? m_refillSlotCounts[classIdx] : 0;
+			while(cache.m_slotCount > maxSlotCount)
+			{
+				frees.emplaceBack(cache.m_slots[--cache.m_slotCount]);
+			}
+		}
+
+		// Recycle the frees of the cached classes and return the rest
+		for(const ClassGpuAllocatorHandle& handle : shard.m_deferredFrees)
+		{
+			const U classIdx = m_calloc.getClassIndex(handle);
+			if(keepCachedSlots && classIdx < shard.m_caches.getSize()
+				&& shard.m_caches[classIdx].m_slotCount < m_refillSlotCounts[classIdx])
+			{
+				ClassCache& cache = shard.m_caches[classIdx];
+				cache.m_slots[cache.m_slotCount++] = handle;
+			}
+			else
+			{
+				frees.emplaceBack(handle);
+			}
+		}
+
+		shard.m_deferredFrees.resize(m_alloc, 0);
+	}
+
+	if(frees.getSize())
+	{
+		m_calloc.freeBatch(WeakArray<ClassGpuAllocatorHandle>(frees));
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,105 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/gr/common/ClassGpuAllocator.h>
+
+namespace anki
+{
+
+/// @addtogroup graphics
+/// @{
+
+/// A ClassGpuAllocator with per-thread caches of slots in front of it. The small allocations are served by the cache of
+/// the calling thread and the caches are refilled in batches from the ClassGpuAllocator. The frees are deferred: they
+/// are queued per thread and they go back to the caches or to the ClassGpuAllocator in one batch when
+/// flushDeferredFrees() is called (at the end of the frame).
+class ShardedClassGpuAllocator : public NonCopyable
+{
+public:
+	/// The number of caches. Every thread gets its own cache. If there are more threads than caches some will share.
+	static const U32 SHARD_COUNT = 8;
+
+	/// The max number of slots that move from the ClassGpuAllocator to a cache at once.
+	static const U32 MAX_REFILL_SLOT_COUNT = 16;
+
+	/// Slots bigger than that are not cached. Caching them would keep too much memory away from the other threads.
+	static const PtrSize MAX_CACHED_SLOT_SIZE = 128_KB;
+
+	ShardedClassGpuAllocator()
+	{
+	}
+
+	~ShardedClassGpuAllocator();
+
+	void init(GenericMemoryPoolAllocator<U8> alloc, ClassGpuAllocatorInterface* iface);
+
+	/// Give all the cached slots and the pending frees back to the ClassGpuAllocator. Call it before the interface
+	/// releases its memory.
+	void destroy();
+
+	/// Allocate memory. It's thread safe.
+	ANKI_USE_RESULT Error allocate(PtrSize size, U alignment, ClassGpuAllocatorHandle& handle);
+
+	/// Free memory. The memory will be actually freed on the next flushDeferredFrees(). It's thread safe.
+	void free(ClassGpuAllocatorHandle& handle);
+
+	/// Free the memory passed to free(). It's thread safe but it's meant to be called once per frame.
+	void flushDeferredFrees();
+
+	/// Flush the deferred frees, empty the caches and compact. See ClassGpuAllocator::compact.
+	void compact(F32 maxChunkOccupancy,
+		Second timeBudget,
+		ClassGpuAllocatorMoveCallback moveCb,
+		void* moveCbUserData,
+		ClassGpuAllocatorCompactionStats& stats);
+
+	/// See ClassGpuAllocator::getClassStats. The cached slots count as used.
+	void getClassStats(U classIdx, F32 maxChunkOccupancy, ClassGpuAllocatorClassStats& stats)
+	{
+		m_calloc.getClassStats(classIdx, maxChunkOccupancy, stats);
+	}
+
+	/// Get the allocated memory. The cached slots are included.
+	PtrSize getAllocatedMemory() const
+	{
+		return m_calloc.getAllocatedMemory();
+	}
+
+private:
+	class ClassCache
+	{
+	public:
+		Array<ClassGpuAllocatorHandle, MAX_REFILL_SLOT_COUNT * 2> m_slots;
+		U32 m_slotCount = 0;
+	};
+
+	class alignas(ANKI_CACHE_LINE_SIZE) Shard
+	{
+	public:
+		SpinLock m_mtx;
+		DynamicArray<ClassCache> m_caches; ///< One per cached class.
+		DynamicArray<ClassGpuAllocatorHandle> m_deferredFrees;
+	};
+
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	ClassGpuAllocator m_calloc;
+	Shard* m_shards = nullptr;
+
+	/// How many slots to get from m_calloc when a cache is empty. The classes are sorted by size so the cached classes
+	/// are the first m_refillSlotCounts.getSize() ones.
+	DynamicArray<U32> m_refillSlotCounts;
+
+	/// Get the cache of the calling thread.
+	Shard& getShard();
+
+	/// Give the deferred frees back.
+	/// @param keepCachedSlots If false empty the caches as well.
+	void flushDeferredFreesInternal(Bool keepCachedSlots);
+};
+/// @}
+
+} // end namespace anki
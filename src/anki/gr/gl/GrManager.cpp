@@ -84,6 +84,11 @@ void GrManager::finish()
 	self.getRenderingThread().syncClientServer();
 }
 
+void GrManager::prewarmPipelines(ThreadHive& hive, PipelinePrewarmProgressCallback callback, void* userData)
+{
+	// Nothing to prewarm, the GL driver creates the pipelines internally
+}
+
 #define ANKI_SAFE_CONSTRUCT(class_) \
 	class_* out = class_::newInstance(this, init); \
 	class_##Ptr ptr(out); \
@@ -8,6 +8,7 @@
 #include <anki/gr/vulkan/BufferImpl.h>
 #include <anki/util/List.h>
 #include <anki/util/HashMap.h>
+#include <anki/util/ConcurrentHashMap.h>
 #include <anki/core/Trace.h>
 #include <algorithm>
 
@@ -85,8 +86,7 @@ public:
 	Array<VkDescriptorPoolSize, U(DescriptorType::COUNT)> m_poolSizesCreateInf = {};
 	VkDescriptorPoolCreateInfo m_poolCreateInf = {};
 
-	DynamicArray<DSThreadAllocator*> m_threadAllocs;
-	SpinLock m_threadAllocsMtx;
+	ConcurrentHashMap<ThreadId, DSThreadAllocator*> m_threadAllocs;
 
 	DSLayoutCacheEntry(DescriptorSetFactory* factory)
 		: m_factory(factory)
@@ -325,11 +325,7 @@ DSLayoutCacheEntry::~DSLayoutCacheEntry()
 {
 	auto alloc = m_factory->m_alloc;
 
-	for(DSThreadAllocator* a : m_threadAllocs)
-	{
-		alloc.deleteInstance(a);
-	}
-
+	m_threadAllocs.iterate([&](DSThreadAllocator* a) { alloc.deleteInstance(a); });
 	m_threadAllocs.destroy(alloc);
 
 	if(m_layoutHandle)
@@ -416,46 +412,24 @@ Error DSLayoutCacheEntry::getOrCreateThreadAllocator(ThreadId tid, DSThreadAlloc
 {
 	alloc = nullptr;
 
-	LockGuard<SpinLock> lock(m_threadAllocsMtx);
-
-	class Comp
-	{
-	public:
-		Bool operator()(const DSThreadAllocator* a, ThreadId tid) const
-		{
-			return a->m_tid < tid;
-		}
-
-		Bool operator()(ThreadId tid, const DSThreadAllocator* a) const
-		{
-			return tid < a->m_tid;
-		}
-	};
-
-	// Find using binary search
-	auto it = binarySearch(m_threadAllocs.getBegin(), m_threadAllocs.getEnd(), tid, Comp());
-
-	if(it != m_threadAllocs.getEnd())
-	{
-		ANKI_ASSERT((*it)->m_tid == tid);
-		alloc = *it;
-	}
-	else
-	{
-		// Need to create one
-
-		alloc = m_factory->m_alloc.newInstance<DSThreadAllocator>(this, tid);
-		ANKI_CHECK(alloc->init());
+	// Lock-free lookup. The map is locked only the first time a thread asks for an allocator
+	DSThreadAllocator** palloc;
+	ANKI_CHECK(m_threadAllocs.findOrCreate(m_factory->m_alloc,
+		tid,
+		[&](DSThreadAllocator*& newAlloc) -> Error {
+			newAlloc = m_factory->m_alloc.newInstance<DSThreadAllocator>(this, tid);
+			const Error err = newAlloc->init();
+			if(err)
+			{
+				m_factory->m_alloc.deleteInstance(newAlloc);
+				newAlloc = nullptr;
+			}
 
-		m_threadAllocs.resize(m_factory->m_alloc, m_threadAllocs.getSize() + 1);
-		m_threadAllocs[m_threadAllocs.getSize() - 1] = alloc;
-
-		// Sort for fast find
-		std::sort(m_threadAllocs.getBegin(),
-			m_threadAllocs.getEnd(),
-			[](const DSThreadAllocator* a, const DSThreadAllocator* b) { return a->m_tid < b->m_tid; });
-	}
+			return err;
+		},
+		palloc));
 
+	alloc = *palloc;
 	ANKI_ASSERT(alloc);
 	return Error::NONE;
 }
@@ -543,11 +517,7 @@ void DescriptorSetFactory::init(const GrAllocator<U8>& alloc, VkDevice dev)
 
 void DescriptorSetFactory::destroy()
 {
-	for(DSLayoutCacheEntry* l : m_caches)
-	{
-		m_alloc.deleteInstance(l);
-	}
-
+	m_caches.iterate([&](DSLayoutCacheEntry* l) { m_alloc.deleteInstance(l); });
 	m_caches.destroy(m_alloc);
 }
 
@@ -573,29 +543,24 @@ Error DescriptorSetFactory::newDescriptorSetLayout(const DescriptorSetLayoutInit
 		hash = 1;
 	}
 
-	// Find or create the cache entry
-	LockGuard<SpinLock> lock(m_cachesMtx);
-
-	DSLayoutCacheEntry* cache = nullptr;
-	U count = 0;
-	for(DSLayoutCacheEntry* it : m_caches)
-	{
-		if(it->m_hash == hash)
-		{
-			cache = it;
-			break;
-		}
-		++count;
-	}
+	// Find or create the cache entry. Lock-free lookup, the map is locked only when a new entry is created
+	DSLayoutCacheEntry** pcache;
+	ANKI_CHECK(m_caches.findOrCreate(m_alloc,
+		hash,
+		[&](DSLayoutCacheEntry*& newCache) -> Error {
+			newCache = m_alloc.newInstance<DSLayoutCacheEntry>(this);
+			const Error err = newCache->init(&bindings[0], bindingCount, hash);
+			if(err)
+			{
+				m_alloc.deleteInstance(newCache);
+				newCache = nullptr;
+			}
 
-	if(cache == nullptr)
-	{
-		cache = m_alloc.newInstance<DSLayoutCacheEntry>(this);
-		ANKI_CHECK(cache->init(&bindings[0], bindingCount, hash));
+			return err;
+		},
+		pcache));
 
-		m_caches.resize(m_alloc, m_caches.getSize() + 1);
-		m_caches[m_caches.getSize() - 1] = cache;
-	}
+	DSLayoutCacheEntry* cache = *pcache;
 
 	// Set the layout
 	layout.m_handle = cache->m_layoutHandle;
@@ -12,6 +12,7 @@
 #include <anki/gr/vulkan/SamplerImpl.h>
 #include <anki/util/WeakArray.h>
 #include <anki/util/BitSet.h>
+#include <anki/util/ConcurrentHashMap.h>
 
 namespace anki
 {
@@ -239,8 +240,7 @@ private:
 	VkDevice m_dev = VK_NULL_HANDLE;
 	U64 m_frameCount = 0;
 
-	DynamicArray<DSLayoutCacheEntry*> m_caches;
-	SpinLock m_cachesMtx; ///< Not a mutex because after a while there will be no reason to lock
+	ConcurrentHashMap<U64, DSLayoutCacheEntry*> m_caches;
 };
 /// @}
 
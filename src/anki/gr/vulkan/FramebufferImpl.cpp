@@ -18,12 +18,10 @@ FramebufferImpl::~FramebufferImpl()
 		vkDestroyFramebuffer(getDevice(), m_fb, nullptr);
 	}
 
-	for(auto it : m_rpasses)
-	{
-		VkRenderPass rpass = it;
+	m_rpasses.iterate([&](VkRenderPass rpass) {
 		ANKI_ASSERT(rpass);
 		vkDestroyRenderPass(getDevice(), rpass, nullptr);
-	}
+	});
 
 	m_rpasses.destroy(getAllocator());
 
@@ -218,8 +216,6 @@ void FramebufferImpl::initRpassCreateInfo(const FramebufferInitInfo& init)
 VkRenderPass FramebufferImpl::getRenderPassHandle(
 	const Array<VkImageLayout, MAX_COLOR_ATTACHMENTS>& colorLayouts, VkImageLayout dsLayout)
 {
-	VkRenderPass out = {};
-
 	// Create hash
 	Array<VkImageLayout, MAX_COLOR_ATTACHMENTS + 1> allLayouts;
 	U allLayoutCount = 0;
@@ -237,59 +233,56 @@ VkRenderPass FramebufferImpl::getRenderPassHandle(
 
 	U64 hash = computeHash(&allLayouts[0], allLayoutCount * sizeof(allLayouts[0]));
 
-	// Get or create
-	LockGuard<Mutex> lock(m_rpassesMtx);
-	auto it = m_rpasses.find(hash);
-	if(it != m_rpasses.getEnd())
-	{
-		out = *it;
-	}
-	else
-	{
-		// Create
-
-		VkRenderPassCreateInfo ci = m_rpassCi;
-		Array<VkAttachmentDescription, MAX_COLOR_ATTACHMENTS + 1> attachmentDescriptions = m_attachmentDescriptions;
-		Array<VkAttachmentReference, MAX_COLOR_ATTACHMENTS + 1> references = m_references;
-		VkSubpassDescription subpassDescr = m_subpassDescr;
-
-		// Fix pointers
-		subpassDescr.pColorAttachments = &references[0];
-		ci.pAttachments = &attachmentDescriptions[0];
-		ci.pSubpasses = &subpassDescr;
-
-		for(U i = 0; i < subpassDescr.colorAttachmentCount; ++i)
-		{
-			const VkImageLayout lay = colorLayouts[i];
-			ANKI_ASSERT(lay != VK_IMAGE_LAYOUT_UNDEFINED);
-
-			attachmentDescriptions[i].initialLayout = lay;
-			attachmentDescriptions[i].finalLayout = lay;
-
-			references[i].layout = lay;
-		}
-
-		if(hasDepthStencil())
-		{
-			const U i = subpassDescr.colorAttachmentCount;
-			const VkImageLayout lay = dsLayout;
-			ANKI_ASSERT(lay != VK_IMAGE_LAYOUT_UNDEFINED);
-
-			attachmentDescriptions[i].initialLayout = lay;
-			attachmentDescriptions[i].finalLayout = lay;
-
-			references[subpassDescr.colorAttachmentCount].layout = lay;
-			subpassDescr.pDepthStencilAttachment = &references[subpassDescr.colorAttachmentCount];
-		}
-
-		ANKI_VK_CHECKF(vkCreateRenderPass(getDevice(), &ci, nullptr, &out));
-		getGrManagerImpl().trySetVulkanHandleName(getName(), VK_DEBUG_REPORT_OBJECT_TYPE_RENDER_PASS_EXT, out);
-
-		m_rpasses.emplace(getAllocator(), hash, out);
-	}
-
-	ANKI_ASSERT(out);
-	return out;
+	// Get or create. Lock-free lookup, the map is locked only when a new render pass is created
+	VkRenderPass* out;
+	const Error err = m_rpasses.findOrCreate(getAllocator(),
+		hash,
+		[&](VkRenderPass& newRpass) -> Error {
+			VkRenderPassCreateInfo ci = m_rpassCi;
+			Array<VkAttachmentDescription, MAX_COLOR_ATTACHMENTS + 1> attachmentDescriptions = m_attachmentDescriptions;
+			Array<VkAttachmentReference, MAX_COLOR_ATTACHMENTS + 1> references = m_references;
+			VkSubpassDescription subpassDescr = m_subpassDescr;
+
+			// Fix pointers
+			subpassDescr.pColorAttachments = &references[0];
+			ci.pAttachments = &attachmentDescriptions[0];
+			ci.pSubpasses = &subpassDescr;
+
+			for(U i = 0; i < subpassDescr.colorAttachmentCount; ++i)
+			{
+				const VkImageLayout lay = colorLayouts[i];
+				ANKI_ASSERT(lay != VK_IMAGE_LAYOUT_UNDEFINED);
+
+				attachmentDescriptions[i].initialLayout = lay;
+				attachmentDescriptions[i].finalLayout = lay;
+
+				references[i].layout = lay;
+			}
+
+			if(hasDepthStencil())
+			{
+				const U i = subpassDescr.colorAttachmentCount;
+				const VkImageLayout lay = dsLayout;
+				ANKI_ASSERT(lay != VK_IMAGE_LAYOUT_UNDEFINED);
+
+				attachmentDescriptions[i].initialLayout = lay;
+				attachmentDescriptions[i].finalLayout = lay;
+
+				references[subpassDescr.colorAttachmentCount].layout = lay;
+				subpassDescr.pDepthStencilAttachment = &references[subpassDescr.colorAttachmentCount];
+			}
+
+			ANKI_VK_CHECKF(vkCreateRenderPass(getDevice(), &ci, nullptr, &newRpass));
+			getGrManagerImpl().trySetVulkanHandleName(getName(), VK_DEBUG_REPORT_OBJECT_TYPE_RENDER_PASS_EXT, newRpass);
+
+			return Error::NONE;
+		},
+		out);
+	(void)err;
+	ANKI_ASSERT(!err);
+
+	ANKI_ASSERT(*out);
+	return *out;
 }
 
 } // end namespace anki
@@ -8,7 +8,7 @@
 #include <anki/gr/Framebuffer.h>
 #include <anki/gr/vulkan/VulkanObject.h>
 #include <anki/gr/vulkan/SwapchainFactory.h>
-#include <anki/util/HashMap.h>
+#include <anki/util/ConcurrentHashMap.h>
 #include <anki/util/BitSet.h>
 
 namespace anki
@@ -62,6 +62,12 @@ public:
 		return m_colorAttCount;
 	}
 
+	/// The attachments of the compatible render pass.
+	ConstWeakArray<VkAttachmentDescription> getAttachmentDescriptions() const
+	{
+		return ConstWeakArray<VkAttachmentDescription>(&m_attachmentDescriptions[0], getAttachmentCount());
+	}
+
 	Bool hasDepthStencil() const
 	{
 		return !!m_aspect;
@@ -122,8 +128,7 @@ private:
 
 	// VK objects
 	VkRenderPass m_compatibleRpass = {}; ///< Compatible renderpass.
-	HashMap<U64, VkRenderPass> m_rpasses;
-	Mutex m_rpassesMtx;
+	ConcurrentHashMap<U64, VkRenderPass> m_rpasses;
 	VkFramebuffer m_fb = VK_NULL_HANDLE;
 
 	// Methods
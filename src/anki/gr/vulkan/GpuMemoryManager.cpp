@@ -157,7 +157,7 @@ public:
 	}
 };
 
-class GpuMemoryManager::ClassAllocator : public ClassGpuAllocator
+class GpuMemoryManager::ClassAllocator : public ShardedClassGpuAllocator
 {
 public:
 	Bool8 m_isDeviceMemory;
@@ -169,6 +169,11 @@ GpuMemoryManager::~GpuMemoryManager()
 
 void GpuMemoryManager::destroy()
 {
+	for(ClassAllocator& calloc : m_callocs)
+	{
+		calloc.destroy();
+	}
+
 	for(Interface& iface : m_ifaces)
 	{
 		iface.collectGarbage();
@@ -223,7 +228,7 @@ void GpuMemoryManager::init(VkPhysicalDevice pdev, VkDevice dev, GrAllocator<U8>
 void GpuMemoryManager::allocateMemory(
 	U memTypeIdx, PtrSize size, U alignment, Bool linearResource, GpuMemoryHandle& handle)
 {
-	ClassGpuAllocator& calloc = m_callocs[memTypeIdx * 2 + ((linearResource) ? 0 : 1)];
+	ShardedClassGpuAllocator& calloc = m_callocs[memTypeIdx * 2 + ((linearResource) ? 0 : 1)];
 	Error err = calloc.allocate(size, alignment, handle.m_classHandle);
 	(void)err;
 
@@ -237,12 +242,20 @@ void GpuMemoryManager::freeMemory(GpuMemoryHandle& handle)
 {
 	ANKI_ASSERT(handle);
 
-	ClassGpuAllocator& calloc = m_callocs[handle.m_memTypeIdx * 2 + ((handle.m_linear) ? 0 : 1)];
+	ShardedClassGpuAllocator& calloc = m_callocs[handle.m_memTypeIdx * 2 + ((handle.m_linear) ? 0 : 1)];
 	calloc.free(handle.m_classHandle);
 
 	handle = {};
 }
 
+void GpuMemoryManager::endFrame()
+{
+	for(ClassAllocator& calloc : m_callocs)
+	{
+		calloc.flushDeferredFrees();
+	}
+}
+
 void* GpuMemoryManager::getMappedAddress(GpuMemoryHandle& handle)
 {
 	ANKI_ASSERT(handle);
@@ -5,7 +5,7 @@
 
 #pragma once
 
-#include <anki/gr/common/ClassGpuAllocator.h>
+#include <anki/gr/common/ShardedClassGpuAllocator.h>
 #include <anki/gr/vulkan/Common.h>
 
 namespace anki
@@ -49,9 +49,12 @@ public:
 	/// Allocate memory.
 	void allocateMemory(U memTypeIdx, PtrSize size, U alignment, Bool linearResource, GpuMemoryHandle& handle);
 
-	/// Free memory.
+	/// Free memory. The memory will be reused after the next endFrame().
 	void freeMemory(GpuMemoryHandle& handle);
 
+	/// Free the memory of the freeMemory() calls of this frame in a batch.
+	void endFrame();
+
 	/// Map memory.
 	ANKI_USE_RESULT void* getMappedAddress(GpuMemoryHandle& handle);
 
@@ -84,6 +84,12 @@ void GrManager::finish()
 	self.finish();
 }
 
+void GrManager::prewarmPipelines(ThreadHive& hive, PipelinePrewarmProgressCallback callback, void* userData)
+{
+	ANKI_VK_SELF(GrManagerImpl);
+	self.getPipelineStateLog().prewarm(hive, callback, userData);
+}
+
 GrManagerStats GrManager::getStats() const
 {
 	ANKI_VK_SELF_CONST(GrManagerImpl);
@@ -37,6 +37,7 @@ GrManagerImpl::~GrManagerImpl()
 	}
 
 	m_crntSwapchain.reset(nullptr);
+	m_pplineStateLog.cancelPrewarm();
 
 	// THIRD THING: Continue with the rest
 	m_gpuMemManager.destroy();
@@ -49,6 +50,7 @@ GrManagerImpl::~GrManagerImpl()
 	m_descrFactory.destroy();
 
 	m_pplineCache.destroy(m_device, m_physicalDevice, getAllocator());
+	m_pplineStateLog.destroy();
 
 	m_fences.destroy();
 
@@ -112,6 +114,7 @@ Error GrManagerImpl::initInternal(const GrManagerInitInfo& init)
 	m_crntSwapchain = m_swapchainFactory.newInstance();
 
 	ANKI_CHECK(m_pplineCache.init(m_device, m_physicalDevice, init.m_cacheDirectory, *init.m_config, getAllocator()));
+	ANKI_CHECK(m_pplineStateLog.init(m_device, init.m_cacheDirectory, *init.m_config, getAllocator()));
 
 	ANKI_CHECK(initMemory(*init.m_config));
 
@@ -774,6 +777,7 @@ void GrManagerImpl::endFrame()
 	}
 
 	m_descrFactory.endFrame();
+	m_gpuMemManager.endFrame();
 
 	// Finalize
 	++m_frame;
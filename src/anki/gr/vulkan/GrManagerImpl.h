@@ -18,6 +18,7 @@
 #include <anki/gr/vulkan/SwapchainFactory.h>
 #include <anki/gr/vulkan/PipelineLayout.h>
 #include <anki/gr/vulkan/PipelineCache.h>
+#include <anki/gr/vulkan/PipelineStateLog.h>
 #include <anki/util/HashMap.h>
 
 namespace anki
@@ -153,6 +154,16 @@ public:
 		return m_pplineLayoutFactory;
 	}
 
+	PipelineStateLog& getPipelineStateLog()
+	{
+		return m_pplineStateLog;
+	}
+
+	const PipelineStateLog& getPipelineStateLog() const
+	{
+		return m_pplineStateLog;
+	}
+
 	VulkanExtensions getExtensions() const
 	{
 		return m_extensions;
@@ -293,6 +304,7 @@ private:
 	QueryAllocator m_queryAlloc;
 
 	PipelineCache m_pplineCache;
+	PipelineStateLog m_pplineStateLog;
 
 	Bool8 m_r8g8b8ImagesSupported = false;
 	Bool8 m_s8ImagesSupported = false;
@@ -397,29 +397,57 @@ public:
 	/// The pipeline needs a render pass and the framebuffers are the owners of that. So the internal pipeline will
 	/// hold a ref to the FB in order to hold a ref to the render pass.
 	FramebufferPtr m_fb;
+
+	Atomic<U32> m_created = {0}; ///< It's set when m_handle is valid.
 };
 
-class PipelineFactory::Hasher
+void PipelineFactory::init(GrAllocator<U8> alloc, VkDevice dev, VkPipelineCache pplineCache)
 {
-public:
-	U64 operator()(U64 h)
-	{
-		return h;
-	}
-};
+	m_alloc = alloc;
+	m_dev = dev;
+	m_pplineCache = pplineCache;
+}
 
 void PipelineFactory::destroy()
 {
-	for(auto it : m_pplines)
+	m_pplines.iterate([&](PipelineInternal* pp) {
+		ANKI_ASSERT(pp->m_created.load());
+		vkDestroyPipeline(m_dev, pp->m_handle, nullptr);
+		m_alloc.deleteInstance(pp);
+	});
+
+	m_pplines.destroy(m_alloc);
+}
+
+void PipelineFactory::createPipeline(PipelineStateTracker& state, U64 hash, PipelineInternal& pp)
+{
+	const VkGraphicsPipelineCreateInfo& ci = state.updatePipelineCreateInfo();
+	pp.m_fb = state.m_fb; // It's empty when prewarming. The PipelineStateLog owns the render pass then
+
 	{
-		if(it.m_handle)
-		{
-			vkDestroyPipeline(m_dev, it.m_handle, nullptr);
-			it.m_fb.reset(nullptr);
-		}
+		ANKI_TRACE_SCOPED_EVENT(VK_PIPELINE_CREATE);
+		ANKI_VK_CHECKF(vkCreateGraphicsPipelines(m_dev, m_pplineCache, 1, &ci, nullptr, &pp.m_handle));
 	}
 
-	m_pplines.destroy(m_alloc);
+	ANKI_TRACE_INC_COUNTER(VK_PIPELINE_CREATE, 1);
+
+	// Publish it and wake up the threads that wait for it
+	pp.m_created.store(1, AtomicMemoryOrder::RELEASE);
+	{
+		LockGuard<Mutex> lock(m_waitMtx);
+		m_waitCond.notifyAll();
+	}
+
+	// Print shader info
+	const ShaderProgramImpl& shaderImpl = static_cast<const ShaderProgramImpl&>(*state.m_state.m_prog);
+	shaderImpl.getGrManagerImpl().printPipelineShaderInfo(
+		pp.m_handle, shaderImpl.getName(), shaderImpl.getStages(), hash);
+
+	// Log the state of the pipelines that weren't prewarmed
+	if(state.m_fb.isCreated())
+	{
+		shaderImpl.getGrManagerImpl().getPipelineStateLog().recordPipeline(shaderImpl, state);
+	}
 }
 
 void PipelineFactory::newPipeline(PipelineStateTracker& state, Pipeline& ppline, Bool& stateDirty)
@@ -433,34 +461,39 @@ void PipelineFactory::newPipeline(PipelineStateTracker& state, Pipeline& ppline,
 		return;
 	}
 
-	LockGuard<SpinLock> lock(m_pplinesMtx);
+	// Fast path, the pipeline is already there
+	PipelineInternal* const* ppp = m_pplines.find(hash);
+	PipelineInternal* pp = (ppp) ? *ppp : nullptr;
 
-	auto it = m_pplines.find(hash);
-	if(it != m_pplines.getEnd())
-	{
-		ppline.m_handle = (*it).m_handle;
-	}
-	else
+	if(ANKI_UNLIKELY(pp == nullptr))
 	{
-		PipelineInternal pp;
-		const VkGraphicsPipelineCreateInfo& ci = state.updatePipelineCreateInfo();
-		pp.m_fb = state.getFb();
+		// Race with the other threads that want the same pipeline. Only one inserts it and that one creates it
+		// outside of the lock of the map
+		PipelineInternal* candidate = m_alloc.newInstance<PipelineInternal>();
+		pp = m_pplines.emplace(m_alloc, hash, candidate);
 
+		if(pp == candidate)
 		{
-			ANKI_TRACE_SCOPED_EVENT(VK_PIPELINE_CREATE);
-			ANKI_VK_CHECKF(vkCreateGraphicsPipelines(m_dev, m_pplineCache, 1, &ci, nullptr, &pp.m_handle));
+			createPipeline(state, hash, *pp);
 		}
+		else
+		{
+			m_alloc.deleteInstance(candidate);
+		}
+	}
 
-		ANKI_TRACE_INC_COUNTER(VK_PIPELINE_CREATE, 1);
-
-		m_pplines.emplace(m_alloc, hash, pp);
-		ppline.m_handle = pp.m_handle;
-
-		// Print shader info
-		const ShaderProgramImpl& shaderImpl = static_cast<const ShaderProgramImpl&>(*state.m_state.m_prog);
-		shaderImpl.getGrManagerImpl().printPipelineShaderInfo(
-			pp.m_handle, shaderImpl.getName(), shaderImpl.getStages(), hash);
+	if(ANKI_UNLIKELY(!pp->m_created.load(AtomicMemoryOrder::ACQUIRE)))
+	{
+		// Some other thread is creating it, wait
+		ANKI_TRACE_SCOPED_EVENT(VK_PIPELINE_WAIT);
+		LockGuard<Mutex> lock(m_waitMtx);
+		while(!pp->m_created.load(AtomicMemoryOrder::ACQUIRE))
+		{
+			m_waitCond.wait(m_waitMtx);
+		}
 	}
+
+	ppline.m_handle = pp->m_handle;
 }
 
 } // end namespace anki
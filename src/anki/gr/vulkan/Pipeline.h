@@ -11,6 +11,7 @@
 #include <anki/gr/Framebuffer.h>
 #include <anki/gr/vulkan/FramebufferImpl.h>
 #include <anki/util/HashMap.h>
+#include <anki/util/ConcurrentHashMap.h>
 
 namespace anki
 {
@@ -177,6 +178,7 @@ public:
 class PipelineStateTracker : public NonCopyable
 {
 	friend class PipelineFactory;
+	friend class PipelineStateLog;
 
 public:
 	PipelineStateTracker()
@@ -547,7 +549,8 @@ private:
 	VkPipeline m_handle ANKI_DBG_NULLIFY;
 };
 
-/// Given some state it creates/hashes pipelines.
+/// Given some state it creates/hashes pipelines. The lookups of the existing pipelines don't lock. The creation of a
+/// new pipeline blocks only the threads that ask for that same pipeline.
 class PipelineFactory
 {
 public:
@@ -559,12 +562,7 @@ public:
 	{
 	}
 
-	void init(GrAllocator<U8> alloc, VkDevice dev, VkPipelineCache pplineCache)
-	{
-		m_alloc = alloc;
-		m_dev = dev;
-		m_pplineCache = pplineCache;
-	}
+	void init(GrAllocator<U8> alloc, VkDevice dev, VkPipelineCache pplineCache);
 
 	void destroy();
 
@@ -573,14 +571,19 @@ public:
 
 private:
 	class PipelineInternal;
-	class Hasher;
 
 	GrAllocator<U8> m_alloc;
 	VkDevice m_dev = VK_NULL_HANDLE;
 	VkPipelineCache m_pplineCache = VK_NULL_HANDLE;
 
-	HashMap<U64, PipelineInternal, Hasher> m_pplines;
-	SpinLock m_pplinesMtx;
+	/// The key is the hash of the state. A pipeline is inserted before it's created, see PipelineInternal::m_created.
+	ConcurrentHashMap<U64, PipelineInternal*> m_pplines;
+
+	/// Used only by the threads that wait for a pipeline that another thread is creating.
+	Mutex m_waitMtx;
+	ConditionVariable m_waitCond;
+
+	void createPipeline(PipelineStateTracker& state, U64 hash, PipelineInternal& pp);
 };
 /// @}
 
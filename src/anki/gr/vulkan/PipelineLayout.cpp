@@ -10,14 +10,8 @@ namespace anki
 
 void PipelineLayoutFactory::destroy()
 {
-	while(!m_layouts.isEmpty())
-	{
-		auto it = m_layouts.getBegin();
-		VkPipelineLayout handle = *it;
-		m_layouts.erase(m_alloc, it);
-
-		vkDestroyPipelineLayout(m_dev, handle, nullptr);
-	}
+	m_layouts.iterate([&](VkPipelineLayout handle) { vkDestroyPipelineLayout(m_dev, handle, nullptr); });
+	m_layouts.destroy(m_alloc);
 }
 
 Error PipelineLayoutFactory::newPipelineLayout(
@@ -36,41 +30,32 @@ Error PipelineLayoutFactory::newPipelineLayout(
 		hash = appendHash(&vkDsetLayouts[0], sizeof(vkDsetLayouts[0]) * dsetLayoutCount, hash);
 	}
 
-	LockGuard<Mutex> lock(m_layoutsMtx);
-
-	auto it = m_layouts.find(hash);
-	if(it != m_layouts.getEnd())
-	{
-		// Found it
-
-		layout.m_handle = *it;
-	}
-	else
-	{
-		// Not found, create new
-
-		VkPipelineLayoutCreateInfo ci = {};
-		ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		ci.pSetLayouts = &vkDsetLayouts[0];
-		ci.setLayoutCount = dsetLayoutCount;
-
-		VkPushConstantRange pushConstantRange;
-		if(pushConstantsSize > 0)
-		{
-			pushConstantRange.offset = 0;
-			pushConstantRange.size = pushConstantsSize;
-			pushConstantRange.stageFlags = VK_SHADER_STAGE_ALL;
-			ci.pushConstantRangeCount = 1;
-			ci.pPushConstantRanges = &pushConstantRange;
-		}
-
-		VkPipelineLayout pplineLayHandle;
-		ANKI_VK_CHECK(vkCreatePipelineLayout(m_dev, &ci, nullptr, &pplineLayHandle));
-
-		m_layouts.emplace(m_alloc, hash, pplineLayHandle);
-
-		layout.m_handle = pplineLayHandle;
-	}
+	// Lock-free lookup. The map is locked only when a new layout is created
+	VkPipelineLayout* handle;
+	ANKI_CHECK(m_layouts.findOrCreate(m_alloc,
+		hash,
+		[&](VkPipelineLayout& newHandle) -> Error {
+			VkPipelineLayoutCreateInfo ci = {};
+			ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+			ci.pSetLayouts = &vkDsetLayouts[0];
+			ci.setLayoutCount = dsetLayoutCount;
+
+			VkPushConstantRange pushConstantRange;
+			if(pushConstantsSize > 0)
+			{
+				pushConstantRange.offset = 0;
+				pushConstantRange.size = pushConstantsSize;
+				pushConstantRange.stageFlags = VK_SHADER_STAGE_ALL;
+				ci.pushConstantRangeCount = 1;
+				ci.pPushConstantRanges = &pushConstantRange;
+			}
+
+			ANKI_VK_CHECK(vkCreatePipelineLayout(m_dev, &ci, nullptr, &newHandle));
+			return Error::NONE;
+		},
+		handle));
+
+	layout.m_handle = *handle;
 
 	return Error::NONE;
 }
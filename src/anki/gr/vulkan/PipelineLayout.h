@@ -6,7 +6,7 @@
 #pragma once
 
 #include <anki/gr/vulkan/DescriptorSet.h>
-#include <anki/util/HashMap.h>
+#include <anki/util/ConcurrentHashMap.h>
 
 namespace anki
 {
@@ -52,8 +52,7 @@ private:
 	GrAllocator<U8> m_alloc;
 	VkDevice m_dev = VK_NULL_HANDLE;
 
-	HashMap<U64, VkPipelineLayout> m_layouts;
-	Mutex m_layoutsMtx;
+	ConcurrentHashMap<U64, VkPipelineLayout> m_layouts;
 };
 /// @}
 
@@ -0,0 +1,458 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/gr/vulkan/PipelineStateLog.h>
+#include <anki/gr/vulkan/Pipeline.h>
+#include <anki/gr/vulkan/ShaderProgramImpl.h>
+#include <anki/gr/vulkan/FramebufferImpl.h>
+#include <anki/core/Config.h>
+#include <anki/core/Trace.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/Filesystem.h>
+#include <anki/util/File.h>
+#include <algorithm>
+
+namespace anki
+{
+
+/// The part of PipelineInfoState that comes after the program. It's plain data.
+static const PtrSize STATE_SIZE = sizeof(PipelineInfoState) - sizeof(ShaderProgramPtr);
+
+static const U8* getStateData(const PipelineInfoState& state)
+{
+	ANKI_ASSERT(PtrSize(reinterpret_cast<const U8*>(&state.m_vertex) - reinterpret_cast<const U8*>(&state))
+				== sizeof(ShaderProgramPtr));
+	return reinterpret_cast<const U8*>(&state.m_vertex);
+}
+
+static U8* getStateData(PipelineInfoState& state)
+{
+	return const_cast<U8*>(getStateData(static_cast<const PipelineInfoState&>(state)));
+}
+
+/// Copy a part of PipelineInfoState. The parts are plain data but they are NonCopyable.
+template<typename T>
+static void copyStatePart(const T& src, T& dst)
+{
+	memcpy(static_cast<void*>(&dst), static_cast<const void*>(&src), sizeof(T));
+}
+
+/// The state of a single pipeline. It's stored as is in the file.
+class PipelineStateLog::Record
+{
+public:
+	U64 m_programHash; ///< The hash of the binaries of the program. Unlike the UUID it's the same in every run.
+	U64 m_hash; ///< The hash of the rest of the record.
+	Array<U8, STATE_SIZE> m_state;
+
+	/// The attachments of the compatible render pass.
+	Array<VkAttachmentDescription, MAX_COLOR_ATTACHMENTS + 1> m_attachments;
+	BitSet<MAX_VERTEX_ATTRIBUTES, U8> m_attributeMask; ///< The attributes of the program. Only those are in m_state.
+	BitSet<MAX_VERTEX_ATTRIBUTES, U8> m_vertBindingMask; ///< The vertex bindings that are in m_state.
+	BitSet<MAX_COLOR_ATTACHMENTS, U8> m_colorAttachmentMask;
+	U8 m_colorAttachmentCount;
+	Bool8 m_depth;
+	Bool8 m_stencil;
+	Bool8 m_defaultFb;
+};
+
+class PipelineStateLog::Header
+{
+public:
+	Array<U8, 8> m_magic;
+	U32 m_recordSize; ///< Detect changes to the state structures.
+	U32 m_recordCount;
+};
+
+class PipelineStateLog::Job
+{
+public:
+	PipelineStateLog* m_log;
+	ShaderProgramPtr m_prog;
+	U32 m_recordIdx;
+};
+
+static const Array<U8, 8> FILE_MAGIC = {{'A', 'N', 'K', 'I', 'P', 'S', 'L', '2'}};
+
+Error PipelineStateLog::init(VkDevice dev, CString cacheDir, const ConfigSet& cfg, GrAllocator<U8> alloc)
+{
+	ANKI_ASSERT(dev && cacheDir);
+	m_alloc = alloc;
+	m_dev = dev;
+	m_recordEnabled = cfg.getNumber("gr.pipelineStateLogRecord") != 0.0;
+	m_prewarmEnabled = cfg.getNumber("gr.pipelineStatePrewarm") != 0.0;
+	m_filename.sprintf(alloc, "%s/vk_pipeline_state_log", &cacheDir[0]);
+
+	if(m_recordEnabled || m_prewarmEnabled)
+	{
+		ANKI_CHECK(load());
+	}
+
+	return Error::NONE;
+}
+
+Error PipelineStateLog::load()
+{
+	if(!fileExists(m_filename.toCString()))
+	{
+		ANKI_VK_LOGI("Pipeline state log not found: %s", &m_filename[0]);
+		return Error::NONE;
+	}
+
+	File file;
+	ANKI_CHECK(file.open(m_filename.toCString(), FileOpenFlag::BINARY | FileOpenFlag::READ));
+
+	Header header;
+	if(file.getSize() < sizeof(header))
+	{
+		ANKI_VK_LOGI("Pipeline state log appears to be empty: %s", &m_filename[0]);
+		return Error::NONE;
+	}
+
+	ANKI_CHECK(file.read(&header, sizeof(header)));
+	if(memcmp(&header.m_magic[0], &FILE_MAGIC[0], sizeof(FILE_MAGIC)) != 0 || header.m_recordSize != sizeof(Record)
+		|| file.getSize() != sizeof(header) + PtrSize(header.m_recordCount) * sizeof(Record))
+	{
+		ANKI_VK_LOGI("Pipeline state log is not compatible with the current build: %s", &m_filename[0]);
+		return Error::NONE;
+	}
+
+	if(header.m_recordCount == 0)
+	{
+		return Error::NONE;
+	}
+
+	m_loadedRecords.create(m_alloc, header.m_recordCount);
+	ANKI_CHECK(file.read(&m_loadedRecords[0], m_loadedRecords.getSizeInBytes()));
+
+	std::sort(m_loadedRecords.getBegin(), m_loadedRecords.getEnd(), [](const Record& a, const Record& b) {
+		return a.m_programHash < b.m_programHash;
+	});
+
+	for(const Record& record : m_loadedRecords)
+	{
+		if(m_recordHashes.find(record.m_hash) == m_recordHashes.getEnd())
+		{
+			m_recordHashes.emplace(m_alloc, record.m_hash, true);
+		}
+	}
+
+	ANKI_VK_LOGI("Loaded %u pipeline states from the log", header.m_recordCount);
+	return Error::NONE;
+}
+
+Error PipelineStateLog::store()
+{
+	const U32 recordCount = m_loadedRecords.getSize() + m_newRecords.getSize();
+
+	File file;
+	ANKI_CHECK(file.open(&m_filename[0], FileOpenFlag::BINARY | FileOpenFlag::WRITE));
+
+	Header header;
+	header.m_magic = FILE_MAGIC;
+	header.m_recordSize = sizeof(Record);
+	header.m_recordCount = recordCount;
+	ANKI_CHECK(file.write(&header, sizeof(header)));
+
+	if(m_loadedRecords.getSize())
+	{
+		ANKI_CHECK(file.write(&m_loadedRecords[0], m_loadedRecords.getSizeInBytes()));
+	}
+
+	if(m_newRecords.getSize())
+	{
+		ANKI_CHECK(file.write(&m_newRecords[0], m_newRecords.getSizeInBytes()));
+	}
+
+	ANKI_VK_LOGI("Stored %u pipeline states to the log (%u new)", recordCount, m_newRecords.getSize());
+	return Error::NONE;
+}
+
+void PipelineStateLog::destroy()
+{
+	cancelPrewarm();
+
+	if(m_recordEnabled && m_newRecords.getSize())
+	{
+		if(store())
+		{
+			ANKI_VK_LOGE("An error occurred while storing the pipeline state log to disk. Will ignore");
+		}
+	}
+
+	for(VkRenderPass rpass : m_rpasses)
+	{
+		vkDestroyRenderPass(m_dev, rpass, nullptr);
+	}
+
+	m_rpasses.destroy(m_alloc);
+	m_jobs.destroy(m_alloc);
+	m_recordHashes.destroy(m_alloc);
+	m_newRecords.destroy(m_alloc);
+	m_loadedRecords.destroy(m_alloc);
+	m_filename.destroy(m_alloc);
+}
+
+void PipelineStateLog::recordPipeline(const ShaderProgramImpl& prog, const PipelineStateTracker& state)
+{
+	if(!m_recordEnabled)
+	{
+		return;
+	}
+
+	Record record;
+	zeroMemory(record); // Zero the padding since it will be hashed
+	record.m_programHash = prog.getBinaryHash();
+
+	// Copy only the state that the pipeline hash covers. The rest keeps the defaults because it might be stale and it
+	// would create different records for the same pipeline
+	const PipelineInfoState& in = state.m_state;
+	PipelineInfoState out; // It zeroes the padding
+	for(U i = 0; i < MAX_VERTEX_ATTRIBUTES; ++i)
+	{
+		if(!state.m_shaderAttributeMask.get(i))
+		{
+			continue;
+		}
+
+		// The hash of the attribute covers the binding with the same index and the pipeline uses the binding of
+		// the attribute
+		const U binding = in.m_vertex.m_attributes[i].m_binding;
+		copyStatePart(in.m_vertex.m_attributes[i], out.m_vertex.m_attributes[i]);
+		copyStatePart(in.m_vertex.m_bindings[i], out.m_vertex.m_bindings[i]);
+		copyStatePart(in.m_vertex.m_bindings[binding], out.m_vertex.m_bindings[binding]);
+		record.m_attributeMask.set(i);
+		record.m_vertBindingMask.set(i);
+		record.m_vertBindingMask.set(binding);
+	}
+
+	copyStatePart(in.m_inputAssembler, out.m_inputAssembler);
+	copyStatePart(in.m_tessellation, out.m_tessellation);
+	copyStatePart(in.m_viewport, out.m_viewport);
+	copyStatePart(in.m_rasterizer, out.m_rasterizer);
+
+	if(state.m_fbDepth)
+	{
+		copyStatePart(in.m_depth, out.m_depth);
+	}
+
+	if(state.m_fbStencil)
+	{
+		copyStatePart(in.m_stencil, out.m_stencil);
+	}
+
+	if(!!state.m_shaderColorAttachmentWritemask)
+	{
+		// The program writes all the color attachments of the render pass
+		out.m_color.m_alphaToCoverageEnabled = in.m_color.m_alphaToCoverageEnabled;
+		for(U i = 0; i < MAX_COLOR_ATTACHMENTS; ++i)
+		{
+			if(state.m_shaderColorAttachmentWritemask.get(i))
+			{
+				copyStatePart(in.m_color.m_attachments[i], out.m_color.m_attachments[i]);
+			}
+		}
+	}
+
+	memcpy(&record.m_state[0], getStateData(out), STATE_SIZE);
+
+	const FramebufferImpl& fb = static_cast<const FramebufferImpl&>(*state.m_fb);
+	ConstWeakArray<VkAttachmentDescription> attachments = fb.getAttachmentDescriptions();
+	for(U i = 0; i < attachments.getSize(); ++i)
+	{
+		record.m_attachments[i] = attachments[i];
+	}
+
+	record.m_colorAttachmentMask = state.m_fbColorAttachmentMask;
+	record.m_colorAttachmentCount = fb.getColorAttachmentCount();
+	record.m_depth = state.m_fbDepth;
+	record.m_stencil = state.m_fbStencil;
+	record.m_defaultFb = state.m_defaultFb;
+
+	const PtrSize hashOffset = sizeof(record.m_programHash) + sizeof(record.m_hash);
+	record.m_hash = computeHash(
+		reinterpret_cast<const U8*>(&record) + hashOffset, sizeof(record) - hashOffset, record.m_programHash);
+
+	LockGuard<Mutex> lock(m_mtx);
+	if(m_recordHashes.find(record.m_hash) == m_recordHashes.getEnd())
+	{
+		m_recordHashes.emplace(m_alloc, record.m_hash, true);
+		m_newRecords.emplaceBack(m_alloc, record);
+	}
+}
+
+void PipelineStateLog::schedulePrewarm(ShaderProgramImpl& prog)
+{
+	if(!m_prewarmEnabled || m_loadedRecords.getSize() == 0)
+	{
+		return;
+	}
+
+	// Find the records of the program
+	Record key;
+	key.m_programHash = prog.getBinaryHash();
+	auto range = std::equal_range(m_loadedRecords.getBegin(),
+		m_loadedRecords.getEnd(),
+		key,
+		[](const Record& a, const Record& b) { return a.m_programHash < b.m_programHash; });
+
+	if(range.first == range.second)
+	{
+		return;
+	}
+
+	LockGuard<Mutex> lock(m_mtx);
+	if(m_prewarmDone)
+	{
+		return;
+	}
+
+	for(const Record* it = range.first; it != range.second; ++it)
+	{
+		Job& job = *m_jobs.emplaceBack(m_alloc);
+		job.m_log = this;
+		job.m_prog.reset(&prog);
+		job.m_recordIdx = it - m_loadedRecords.getBegin();
+	}
+}
+
+void PipelineStateLog::cancelPrewarm()
+{
+	LockGuard<Mutex> lock(m_mtx);
+	m_jobs.destroy(m_alloc);
+}
+
+void PipelineStateLog::prewarm(ThreadHive& hive, PipelinePrewarmProgressCallback callback, void* callbackUserData)
+{
+	ANKI_TRACE_SCOPED_EVENT(VK_PIPELINE_PREWARM);
+
+	// Take the jobs. The programs that are created from now on won't queue more
+	DynamicArray<Job> jobs;
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		jobs = std::move(m_jobs);
+		m_prewarmDone = true;
+	}
+
+	const U32 jobCount = jobs.getSize();
+	if(jobCount == 0)
+	{
+		return;
+	}
+
+	// Submit them in batches to be able to report the progress
+	const U32 batchSize = hive.getThreadCount() * 4;
+	DynamicArrayAuto<ThreadHiveTask> tasks(m_alloc);
+	tasks.create(batchSize);
+
+	U32 jobsDone = 0;
+	while(jobsDone < jobCount)
+	{
+		const U32 count = min(batchSize, jobCount - jobsDone);
+		for(U32 i = 0; i < count; ++i)
+		{
+			Job* job = &jobs[jobsDone + i];
+			tasks[i] = ANKI_THREAD_HIVE_TASK({ self->m_log->prewarmPipeline(*self); }, job, nullptr, nullptr);
+		}
+
+		hive.submitTasks(&tasks[0], count);
+		hive.waitAllTasks();
+
+		jobsDone += count;
+		if(callback)
+		{
+			callback(callbackUserData, jobsDone, jobCount);
+		}
+	}
+
+	ANKI_VK_LOGI("Prewarmed %u pipelines", jobCount);
+	ANKI_TRACE_INC_COUNTER(VK_PIPELINE_PREWARM, jobCount);
+
+	jobs.destroy(m_alloc);
+}
+
+void PipelineStateLog::prewarmPipeline(const Job& job)
+{
+	const Record& record = m_loadedRecords[job.m_recordIdx];
+	ShaderProgramImpl& progImpl = static_cast<ShaderProgramImpl&>(*job.m_prog);
+
+	// Same binaries should give the same reflection but be defensive since the file may be stale
+	if(!!progImpl.getReflectionInfo().m_colorAttachmentWritemask
+		&& !(progImpl.getReflectionInfo().m_colorAttachmentWritemask == record.m_colorAttachmentMask))
+	{
+		return;
+	}
+
+	if(!(progImpl.getReflectionInfo().m_attributeMask == record.m_attributeMask))
+	{
+		return;
+	}
+
+	// Build the state. The hash will be the same as if the state was set by a command buffer
+	PipelineStateTracker state;
+	memcpy(getStateData(state.m_state), &record.m_state[0], STATE_SIZE);
+	state.m_set.m_attribs = record.m_attributeMask;
+	state.m_set.m_vertBindings = record.m_vertBindingMask;
+	state.bindShaderProgram(job.m_prog);
+	state.m_fbColorAttachmentMask = record.m_colorAttachmentMask;
+	state.m_fbDepth = record.m_depth;
+	state.m_fbStencil = record.m_stencil;
+	state.m_defaultFb = record.m_defaultFb;
+	state.m_rpass = getOrCreateRenderPass(record);
+
+	Pipeline ppline;
+	Bool stateDirty;
+	progImpl.getPipelineFactory().newPipeline(state, ppline, stateDirty);
+}
+
+VkRenderPass PipelineStateLog::getOrCreateRenderPass(const Record& record)
+{
+	const U attachmentCount = record.m_colorAttachmentCount + ((record.m_depth || record.m_stencil) ? 1 : 0);
+	const U64 hash = computeHash(&record.m_attachments[0], sizeof(record.m_attachments[0]) * attachmentCount);
+
+	LockGuard<Mutex> lock(m_mtx);
+
+	auto it = m_rpasses.find(hash);
+	if(it != m_rpasses.getEnd())
+	{
+		return *it;
+	}
+
+	// Create it the same way FramebufferImpl does
+	Array<VkAttachmentReference, MAX_COLOR_ATTACHMENTS + 1> references;
+	for(U i = 0; i < record.m_colorAttachmentCount; ++i)
+	{
+		references[i].attachment = i;
+		references[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	const Bool hasDepthStencil = attachmentCount > record.m_colorAttachmentCount;
+	if(hasDepthStencil)
+	{
+		references[record.m_colorAttachmentCount].attachment = record.m_colorAttachmentCount;
+		references[record.m_colorAttachmentCount].layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	}
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = record.m_colorAttachmentCount;
+	subpass.pColorAttachments = (record.m_colorAttachmentCount) ? &references[0] : nullptr;
+	subpass.pDepthStencilAttachment = (hasDepthStencil) ? &references[record.m_colorAttachmentCount] : nullptr;
+
+	VkRenderPassCreateInfo ci = {};
+	ci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	ci.attachmentCount = attachmentCount;
+	ci.pAttachments = &record.m_attachments[0];
+	ci.subpassCount = 1;
+	ci.pSubpasses = &subpass;
+
+	VkRenderPass rpass;
+	ANKI_VK_CHECKF(vkCreateRenderPass(m_dev, &ci, nullptr, &rpass));
+	m_rpasses.emplace(m_alloc, hash, rpass);
+
+	return rpass;
+}
+
+} // end namespace anki
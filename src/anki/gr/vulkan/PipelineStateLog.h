@@ -0,0 +1,80 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/gr/vulkan/Common.h>
+#include <anki/util/HashMap.h>
+#include <anki/util/Thread.h>
+
+namespace anki
+{
+
+// Forward
+class ConfigSet;
+class ShaderProgramImpl;
+class PipelineStateTracker;
+class ThreadHive;
+
+/// @addtogroup vulkan
+/// @{
+
+/// On disk log of the graphics pipeline state. When recording is enabled the state of every new pipeline is written
+/// to the log. In the next runs the log is used to create the pipelines of the shader programs before they are used
+/// for the first time (prewarming). It complements the PipelineCache that stores only the driver's blob.
+class PipelineStateLog
+{
+public:
+	ANKI_USE_RESULT Error init(VkDevice dev, CString cacheDir, const ConfigSet& cfg, GrAllocator<U8> alloc);
+
+	void destroy();
+
+	/// Store the state of a pipeline that was just created.
+	/// @note It's thread-safe.
+	void recordPipeline(const ShaderProgramImpl& prog, const PipelineStateTracker& state);
+
+	/// Queue the logged pipelines of a new program for prewarming. It does nothing after prewarm() so the queue
+	/// doesn't hold references to the programs that nothing would prewarm.
+	/// @note It's thread-safe.
+	void schedulePrewarm(ShaderProgramImpl& prog);
+
+	/// Create all the pipelines that were queued. It runs once.
+	void prewarm(ThreadHive& hive, PipelinePrewarmProgressCallback callback, void* callbackUserData);
+
+	/// Drop the queued pipelines and the references to their programs.
+	void cancelPrewarm();
+
+private:
+	class Record;
+	class Header;
+	class Job;
+
+	GrAllocator<U8> m_alloc;
+	VkDevice m_dev = VK_NULL_HANDLE;
+	String m_filename;
+
+	DynamicArray<Record> m_loadedRecords; ///< The records of the file sorted by program. Immutable after init.
+	DynamicArray<Record> m_newRecords; ///< The records of this run.
+	HashMap<U64, Bool> m_recordHashes; ///< The hashes of all the records to skip the duplicates.
+
+	DynamicArray<Job> m_jobs;
+	HashMap<U64, VkRenderPass> m_rpasses; ///< Render passes compatible with the ones of the logged pipelines.
+
+	Mutex m_mtx;
+
+	Bool8 m_recordEnabled = false;
+	Bool8 m_prewarmEnabled = false;
+	Bool8 m_prewarmDone = false; ///< Protected by m_mtx.
+
+	VkRenderPass getOrCreateRenderPass(const Record& record);
+
+	void prewarmPipeline(const Job& job);
+
+	ANKI_USE_RESULT Error load();
+	ANKI_USE_RESULT Error store();
+};
+/// @}
+
+} // end namespace anki
@@ -103,12 +103,10 @@ void SamplerFactory::destroy()
 	}
 
 	GrAllocator<U8> alloc = m_gr->getAllocator();
-	for(auto it : m_map)
-	{
-		MicroSampler* const sampler = it;
+	m_map.iterate([&](MicroSampler*& sampler) {
 		ANKI_ASSERT(sampler->getRefcount().load() == 0 && "Someone still holds a reference to a sampler");
 		alloc.deleteInstance(sampler);
-	}
+	});
 
 	m_map.destroy(alloc);
 
@@ -119,41 +117,28 @@ Error SamplerFactory::newInstance(const SamplerInitInfo& inf, MicroSamplerPtr& p
 {
 	ANKI_ASSERT(m_gr);
 
-	Error err = Error::NONE;
-	MicroSampler* out = nullptr;
-	const U64 hash = inf.computeHash();
-
-	LockGuard<Mutex> lock(m_mtx);
-
-	auto it = m_map.find(hash);
-
-	if(it != m_map.getEnd())
-	{
-		out = *it;
-	}
-	else
-	{
-		// Create a new one
-
-		GrAllocator<U8> alloc = m_gr->getAllocator();
-
-		out = alloc.newInstance<MicroSampler>(this);
-		err = out->init(inf);
-
-		if(err)
-		{
-			alloc.deleteInstance(out);
-			out = nullptr;
-		}
-		else
-		{
-			m_map.emplace(alloc, hash, out);
-		}
-	}
+	GrAllocator<U8> alloc = m_gr->getAllocator();
+	MicroSampler** out;
+
+	// Lock-free lookup. The map is locked only when a new sampler is created
+	Error err = m_map.findOrCreate(alloc,
+		inf.computeHash(),
+		[&](MicroSampler*& sampler) -> Error {
+			sampler = alloc.newInstance<MicroSampler>(this);
+			const Error initErr = sampler->init(inf);
+			if(initErr)
+			{
+				alloc.deleteInstance(sampler);
+				sampler = nullptr;
+			}
+
+			return initErr;
+		},
+		out);
 
 	if(!err)
 	{
-		psampler.reset(out);
+		psampler.reset(*out);
 	}
 
 	return err;
@@ -6,7 +6,7 @@
 #pragma once
 
 #include <anki/gr/vulkan/FenceFactory.h>
-#include <anki/util/HashMap.h>
+#include <anki/util/ConcurrentHashMap.h>
 
 namespace anki
 {
@@ -91,8 +91,7 @@ public:
 
 private:
 	GrManagerImpl* m_gr = nullptr;
-	HashMap<U64, MicroSampler*> m_map;
-	Mutex m_mtx;
+	ConcurrentHashMap<U64, MicroSampler*> m_map;
 };
 /// @}
 
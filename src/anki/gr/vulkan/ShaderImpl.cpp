@@ -106,6 +106,12 @@ Error ShaderImpl::init(const ShaderInitInfo& inf)
 		}
 	}
 
+	m_binaryHash = computeHash(&inf.m_binary[0], inf.m_binary.getSize());
+	if(m_specConstInfo.dataSize)
+	{
+		m_binaryHash = appendHash(m_specConstInfo.pData, m_specConstInfo.dataSize, m_binaryHash);
+	}
+
 	return Error::NONE;
 }
 
@@ -5,6 +5,7 @@
 
 #include <anki/gr/ShaderProgram.h>
 #include <anki/gr/vulkan/ShaderProgramImpl.h>
+#include <anki/gr/vulkan/GrManagerImpl.h>
 #include <anki/gr/Shader.h>
 #include <anki/gr/GrManager.h>
 
@@ -18,6 +19,11 @@ ShaderProgram* ShaderProgram::newInstance(GrManager* manager, const ShaderProgra
 	if(err)
 	{
 		manager->getAllocator().deleteInstance(impl);
+		impl = nullptr;
+	}
+	else if(impl->isGraphics())
+	{
+		impl->getGrManagerImpl().getPipelineStateLog().schedulePrewarm(*impl);
 	}
 	return impl;
 }
@@ -31,6 +31,15 @@ Error ShaderProgramImpl::init(const ShaderProgramInitInfo& inf)
 	ANKI_ASSERT(inf.isValid());
 	m_shaders = inf.m_shaders;
 
+	for(ShaderType stype = ShaderType::FIRST; stype < ShaderType::COUNT; ++stype)
+	{
+		if(m_shaders[stype].isCreated())
+		{
+			const U64 hash = scast<const ShaderImpl*>(m_shaders[stype].get())->m_binaryHash;
+			m_binaryHash = (m_binaryHash) ? appendHash(&hash, sizeof(hash), m_binaryHash) : hash;
+		}
+	}
+
 	// Merge bindings
 	//
 	Array2d<DescriptorBinding, MAX_DESCRIPTOR_SETS, MAX_BINDINGS_PER_DESCRIPTOR_SET> bindings;
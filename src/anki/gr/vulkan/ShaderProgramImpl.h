@@ -88,9 +88,17 @@ public:
 		return m_stages;
 	}
 
+	/// The hash of the binaries of the shaders. Unlike the UUID it's the same between runs.
+	U64 getBinaryHash() const
+	{
+		ANKI_ASSERT(m_binaryHash);
+		return m_binaryHash;
+	}
+
 private:
 	Array<ShaderPtr, U(ShaderType::COUNT)> m_shaders;
 	ShaderTypeBit m_stages = ShaderTypeBit::NONE;
+	U64 m_binaryHash = 0;
 
 	Array<VkPipelineShaderStageCreateInfo, U(ShaderType::COUNT) - 1> m_shaderCreateInfos;
 	U32 m_shaderCreateInfoCount = 0;
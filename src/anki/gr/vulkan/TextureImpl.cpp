@@ -23,13 +23,12 @@ TextureImpl::~TextureImpl()
 	}
 #endif
 
-	for(auto it : m_viewsMap)
-	{
-		if(it != VK_NULL_HANDLE)
+	m_viewsMap.iterate([&](VkImageView view) {
+		if(view != VK_NULL_HANDLE)
 		{
-			vkDestroyImageView(getDevice(), it, nullptr);
+			vkDestroyImageView(getDevice(), view, nullptr);
 		}
-	}
+	});
 
 	m_viewsMap.destroy(getAllocator());
 
@@ -672,38 +671,38 @@ VkImageLayout TextureImpl::computeLayout(TextureUsageBit usage, U level) const
 
 VkImageView TextureImpl::getOrCreateView(const TextureSubresourceInfo& subresource, TextureType& newTexType) const
 {
-	LockGuard<Mutex> lock(m_viewsMapMtx);
-	auto it = m_viewsMap.find(subresource);
-
-	if(it != m_viewsMap.getEnd())
-	{
-		// Fixup the image view type
-		newTexType = computeNewTexTypeOfSubresource(subresource);
-
-		return *it;
-	}
-	else
-	{
-		// Compute the VkImageViewCreateInfo
-		VkImageViewCreateInfo viewCi;
-		computeVkImageViewCreateInfo(subresource, viewCi, newTexType);
-
-		VkImageView view = VK_NULL_HANDLE;
-		ANKI_VK_CHECKF(vkCreateImageView(getDevice(), &viewCi, nullptr, &view));
-		getGrManagerImpl().trySetVulkanHandleName(
-			getName(), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT, ptrToNumber(view));
-
-		m_viewsMap.emplace(getAllocator(), subresource, view);
+	// Fixup the image view type
+	newTexType = computeNewTexTypeOfSubresource(subresource);
+
+	// Lock-free lookup. The map is locked only when a new view is created
+	VkImageView* view;
+	const Error err = m_viewsMap.findOrCreate(getAllocator(),
+		subresource,
+		[&](VkImageView& newView) -> Error {
+			// Compute the VkImageViewCreateInfo
+			VkImageViewCreateInfo viewCi;
+			TextureType texType;
+			computeVkImageViewCreateInfo(subresource, viewCi, texType);
+			ANKI_ASSERT(texType == newTexType);
+
+			ANKI_VK_CHECKF(vkCreateImageView(getDevice(), &viewCi, nullptr, &newView));
+			getGrManagerImpl().trySetVulkanHandleName(
+				getName(), VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_VIEW_EXT, ptrToNumber(newView));
 
 #if 0
-		printf("Creating image view %p. Texture %p %s\n",
-		static_cast<void*>(view),
-		static_cast<void*>(m_imageHandle),
-		getName() ? getName().cstr() : "Unnamed");
+			printf("Creating image view %p. Texture %p %s\n",
+			static_cast<void*>(newView),
+			static_cast<void*>(m_imageHandle),
+			getName() ? getName().cstr() : "Unnamed");
 #endif
 
-		return view;
-	}
+			return Error::NONE;
+		},
+		view);
+	(void)err;
+	ANKI_ASSERT(!err);
+
+	return *view;
 }
 
 } // end namespace anki
@@ -10,7 +10,7 @@
 #include <anki/gr/vulkan/GpuMemoryManager.h>
 #include <anki/gr/common/Misc.h>
 #include <anki/gr/vulkan/SamplerFactory.h>
-#include <anki/util/HashMap.h>
+#include <anki/util/ConcurrentHashMap.h>
 
 namespace anki
 {
@@ -151,8 +151,7 @@ public:
 	VkImageView getOrCreateView(const TextureSubresourceInfo& subresource, TextureType& newTexType) const;
 
 private:
-	mutable HashMap<TextureSubresourceInfo, VkImageView> m_viewsMap;
-	mutable Mutex m_viewsMapMtx;
+	mutable ConcurrentHashMap<TextureSubresourceInfo, VkImageView> m_viewsMap;
 
 	VkDeviceMemory m_dedicatedMem = VK_NULL_HANDLE;
 
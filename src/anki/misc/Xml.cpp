@@ -6,10 +6,168 @@
 #include <anki/misc/Xml.h>
 #include <anki/util/File.h>
 #include <anki/util/Logger.h>
+#include <anki/util/Hash.h>
+#include <anki/util/HashMap.h>
+#include <tinyxml2.h>
+#if !ANKI_TINYXML2
+#	error "Wrong tinyxml2 included"
+#endif
+#include <cerrno>
 
 namespace anki
 {
 
+/// Compiles the tree of tinyxml2 to the form of XmlBinaryFile.
+class XmlBinaryBuilder
+{
+public:
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	DynamicArrayAuto<XmlBinaryFile::Element> m_elements;
+	DynamicArrayAuto<XmlBinaryFile::Attribute> m_attributes;
+	DynamicArrayAuto<XmlBinaryFile::Number> m_numbers;
+	DynamicArrayAuto<char> m_strings;
+	HashMap<U64, U32> m_stringOffsets; ///< String hash to offset to m_strings.
+
+	XmlBinaryBuilder(GenericMemoryPoolAllocator<U8> alloc)
+		: m_alloc(alloc)
+		, m_elements(alloc)
+		, m_attributes(alloc)
+		, m_numbers(alloc)
+		, m_strings(alloc)
+	{
+	}
+
+	~XmlBinaryBuilder()
+	{
+		m_stringOffsets.destroy(m_alloc);
+	}
+
+	/// Add an element and its children. The elements are stored depth first so the children and the next siblings of
+	/// an element are always after it.
+	U32 addElement(const tinyxml2::XMLNode& node, CString name, const char* text)
+	{
+		const U32 idx = m_elements.getSize();
+		XmlBinaryFile::Element& el = *m_elements.emplaceBack();
+		el.m_nameHash = computeHash(&name[0], name.getLength());
+		el.m_name = addString(name);
+		el.m_text = (text) ? addString(text) : MAX_U32;
+		el.m_firstNumber = m_numbers.getSize();
+		el.m_numberCount = (text) ? addNumbers(text) : 0;
+		el.m_firstChild = MAX_U32;
+		el.m_nextSibling = MAX_U32;
+		el.m_firstAttribute = m_attributes.getSize();
+		el.m_attributeCount = 0;
+
+		const tinyxml2::XMLElement* xmlEl = node.ToElement();
+		for(const tinyxml2::XMLAttribute* attrib = (xmlEl) ? xmlEl->FirstAttribute() : nullptr; attrib;
+			attrib = attrib->Next())
+		{
+			const CString attribName = attrib->Name();
+			const char* value = (attrib->Value()) ? attrib->Value() : "";
+
+			XmlBinaryFile::Attribute& outAttrib = *m_attributes.emplaceBack();
+			outAttrib.m_nameHash = computeHash(&attribName[0], attribName.getLength());
+			outAttrib.m_name = addString(attribName);
+			outAttrib.m_value = addString(value);
+			outAttrib.m_firstNumber = m_numbers.getSize();
+			outAttrib.m_numberCount = addNumbers(value);
+
+			++m_elements[idx].m_attributeCount;
+		}
+
+		// Don't keep references to the elements, the array grows
+		U32 prevChild = MAX_U32;
+		for(const tinyxml2::XMLElement* child = node.FirstChildElement(); child; child = child->NextSiblingElement())
+		{
+			const U32 childIdx = addElement(*child, child->Name(), child->GetText());
+
+			if(prevChild == MAX_U32)
+			{
+				m_elements[idx].m_firstChild = childIdx;
+			}
+			else
+			{
+				m_elements[prevChild].m_nextSibling = childIdx;
+			}
+
+			prevChild = childIdx;
+		}
+
+		return idx;
+	}
+
+private:
+	/// Add a string once.
+	U32 addString(CString str)
+	{
+		const U32 len = str.getLength();
+		const U64 hash = computeHash(&str[0], len);
+		auto it = m_stringOffsets.find(hash);
+		if(it != m_stringOffsets.getEnd() && strcmp(&m_strings[*it], &str[0]) == 0)
+		{
+			return *it;
+		}
+
+		const U32 offset = m_strings.getSize();
+		m_strings.resize(offset + len + 1);
+		memcpy(&m_strings[offset], &str[0], len + 1);
+
+		if(it == m_stringOffsets.getEnd())
+		{
+			m_stringOffsets.emplace(m_alloc, hash, offset);
+		}
+
+		return offset;
+	}
+
+	/// Convert the parts of a text to numbers.
+	/// @return The number of parts or MAX_U32 if a part is out of range.
+	U32 addNumbers(CString text)
+	{
+		StringListAuto list(m_alloc);
+		list.splitString(text, ' ');
+
+		const U32 first = m_numbers.getSize();
+		Bool outOfRange = false;
+		for(const String& str : list)
+		{
+			XmlBinaryFile::Number& number = *m_numbers.emplaceBack();
+
+			errno = 0;
+			number.m_float = std::strtod(&str[0], nullptr);
+			outOfRange = outOfRange || errno;
+
+			// Out of range integers are clamped, the conversions check the range later. Parse the positive ones again
+			// as unsigned, strtoll stops at MAX_I64
+			number.m_int = std::strtoll(&str[0], nullptr, 10);
+			number.m_uint = (number.m_int >= 0) ? std::strtoull(&str[0], nullptr, 10) : 0;
+			errno = 0;
+		}
+
+		return (outOfRange) ? MAX_U32 : m_numbers.getSize() - first;
+	}
+};
+
+XmlDocument::~XmlDocument()
+{
+	destroy();
+}
+
+void XmlDocument::destroy()
+{
+	if(m_data)
+	{
+		m_alloc.getMemoryPool().free(m_data);
+		m_data = nullptr;
+	}
+
+	m_dataSize = 0;
+	m_elements = nullptr;
+	m_attributes = nullptr;
+	m_numbers = nullptr;
+	m_strings = nullptr;
+}
+
 ANKI_USE_RESULT Error XmlElement::check() const
 {
 	Error err = Error::NONE;
@@ -21,12 +179,59 @@ ANKI_USE_RESULT Error XmlElement::check() const
 	return err;
 }
 
+CString XmlElement::getName() const
+{
+	ANKI_ASSERT(m_el);
+	return &m_doc->m_strings[m_el->m_name];
+}
+
+const XmlBinaryFile::Attribute* XmlElement::findAttribute(const CString& name) const
+{
+	ANKI_ASSERT(m_el);
+	const U64 hash = computeHash(&name[0], name.getLength());
+	for(U32 i = 0; i < m_el->m_attributeCount; ++i)
+	{
+		const XmlBinaryFile::Attribute& attrib = m_doc->m_attributes[m_el->m_firstAttribute + i];
+		if(attrib.m_nameHash == hash && name == &m_doc->m_strings[attrib.m_name])
+		{
+			return &attrib;
+		}
+	}
+
+	return nullptr;
+}
+
+ConstWeakArray<XmlBinaryFile::Number> XmlElement::getNumberRange(U32 first, U32 count) const
+{
+	ANKI_ASSERT(count > 0 && count != MAX_U32);
+	return ConstWeakArray<XmlBinaryFile::Number>(m_doc->m_numbers + first, count);
+}
+
+/// Find the first element of a list of siblings with a name.
+static const XmlBinaryFile::Element* findElement(
+	const XmlBinaryFile::Element* elements, const char* strings, U32 idx, const CString& name)
+{
+	const U64 hash = computeHash(&name[0], name.getLength());
+	while(idx != MAX_U32)
+	{
+		const XmlBinaryFile::Element& el = elements[idx];
+		if(el.m_nameHash == hash && name == &strings[el.m_name])
+		{
+			return &el;
+		}
+
+		idx = el.m_nextSibling;
+	}
+
+	return nullptr;
+}
+
 Error XmlElement::getText(CString& out) const
 {
 	Error err = check();
-	if(!err && m_el->GetText())
+	if(!err && m_el->m_text != MAX_U32)
 	{
-		out = CString(m_el->GetText());
+		out = CString(&m_doc->m_strings[m_el->m_text]);
 	}
 	else
 	{
@@ -57,7 +262,7 @@ Error XmlElement::getMat3(Mat3& out) const
 
 	if(err)
 	{
-		ANKI_MISC_LOGE("Failed to return Mat3. Element: %s", m_el->Value());
+		ANKI_MISC_LOGE("Failed to return Mat3. Element: %s", (m_el) ? &getName()[0] : "");
 	}
 
 	return err;
@@ -84,7 +289,7 @@ Error XmlElement::getMat4(Mat4& out) const
 
 	if(err)
 	{
-		ANKI_MISC_LOGE("Failed to return Mat4. Element: %s", m_el->Value());
+		ANKI_MISC_LOGE("Failed to return Mat4. Element: %s", (m_el) ? &getName()[0] : "");
 	}
 
 	return err;
@@ -111,7 +316,7 @@ Error XmlElement::getVec2(Vec2& out) const
 
 	if(err)
 	{
-		ANKI_MISC_LOGE("Failed to return Vec2. Element: %s", m_el->Value());
+		ANKI_MISC_LOGE("Failed to return Vec2. Element: %s", (m_el) ? &getName()[0] : "");
 	}
 
 	return err;
@@ -138,7 +343,7 @@ Error XmlElement::getVec3(Vec3& out) const
 
 	if(err)
 	{
-		ANKI_MISC_LOGE("Failed to return Vec3. Element: %s", m_el->Value());
+		ANKI_MISC_LOGE("Failed to return Vec3. Element: %s", (m_el) ? &getName()[0] : "");
 	}
 
 	return err;
@@ -165,7 +370,7 @@ Error XmlElement::getVec4(Vec4& out) const
 
 	if(err)
 	{
-		ANKI_MISC_LOGE("Failed to return Vec4. Element: %s", m_el->Value());
+		ANKI_MISC_LOGE("Failed to return Vec4. Element: %s", (m_el) ? &getName()[0] : "");
 	}
 
 	return err;
@@ -176,7 +381,8 @@ Error XmlElement::getChildElementOptional(const CString& name, XmlElement& out)
 	Error err = check();
 	if(!err)
 	{
-		out = XmlElement(m_el->FirstChildElement(&name[0]), m_alloc);
+		out = XmlElement(
+			m_doc, findElement(m_doc->m_elements, m_doc->m_strings, m_el->m_firstChild, name), m_alloc);
 	}
 	else
 	{
@@ -215,7 +421,8 @@ Error XmlElement::getNextSiblingElement(const CString& name, XmlElement& out) co
 	Error err = check();
 	if(!err)
 	{
-		out = XmlElement(m_el->NextSiblingElement(&name[0]), m_alloc);
+		out = XmlElement(
+			m_doc, findElement(m_doc->m_elements, m_doc->m_strings, m_el->m_nextSibling, name), m_alloc);
 	}
 	else
 	{
@@ -228,12 +435,13 @@ Error XmlElement::getNextSiblingElement(const CString& name, XmlElement& out) co
 Error XmlElement::getSiblingElementsCount(U32& out) const
 {
 	ANKI_CHECK(check());
-	const tinyxml2::XMLElement* el = m_el;
+	const CString name = getName();
+	const XmlBinaryFile::Element* el = m_el;
 
 	I count = -1;
 	do
 	{
-		el = el->NextSiblingElement(m_el->Name());
+		el = findElement(m_doc->m_elements, m_doc->m_strings, el->m_nextSibling, name);
 		++count;
 	} while(el);
 
@@ -246,7 +454,7 @@ Error XmlElement::getAttributeTextOptional(const CString& name, CString& out, Bo
 {
 	ANKI_CHECK(check());
 
-	const tinyxml2::XMLAttribute* attrib = m_el->FindAttribute(&name[0]);
+	const XmlBinaryFile::Attribute* attrib = findAttribute(name);
 	if(!attrib)
 	{
 		attribPresent = false;
@@ -254,16 +462,7 @@ Error XmlElement::getAttributeTextOptional(const CString& name, CString& out, Bo
 	}
 
 	attribPresent = true;
-
-	const char* value = attrib->Value();
-	if(value)
-	{
-		out = value;
-	}
-	else
-	{
-		out = CString();
-	}
+	out = CString(&m_doc->m_strings[attrib->m_value]);
 
 	return Error::NONE;
 }
@@ -285,23 +484,183 @@ Error XmlDocument::loadFile(const CString& filename, GenericMemoryPoolAllocator<
 
 Error XmlDocument::parse(const CString& xmlText, GenericMemoryPoolAllocator<U8> alloc)
 {
+	destroy();
 	m_alloc = alloc;
 
-	if(m_doc.Parse(&xmlText[0]))
+	tinyxml2::XMLDocument doc;
+	if(doc.Parse(&xmlText[0]))
 	{
 		ANKI_MISC_LOGE(
-			"Cannot parse file. Reason: %s", ((m_doc.GetErrorStr1() == nullptr) ? "unknown" : m_doc.GetErrorStr1()));
+			"Cannot parse file. Reason: %s", ((doc.GetErrorStr1() == nullptr) ? "unknown" : doc.GetErrorStr1()));
 
 		return Error::USER_DATA;
 	}
 
+	// Compile it
+	XmlBinaryBuilder builder(alloc);
+	builder.addElement(doc, "", nullptr);
+
+	XmlBinaryFile::Header header;
+	zeroMemory(header);
+	memcpy(&header.m_magic[0], XmlBinaryFile::MAGIC, 8);
+	header.m_elementCount = builder.m_elements.getSize();
+	header.m_attributeCount = builder.m_attributes.getSize();
+	header.m_numberCount = builder.m_numbers.getSize();
+	header.m_stringDataSize = builder.m_strings.getSize();
+
+	m_dataSize = sizeof(header) + builder.m_elements.getSizeInBytes() + builder.m_attributes.getSizeInBytes()
+				 + builder.m_numbers.getSizeInBytes() + builder.m_strings.getSizeInBytes();
+	m_data = m_alloc.getMemoryPool().allocate(m_dataSize, ANKI_SAFE_ALIGNMENT);
+
+	U8* ptr = static_cast<U8*>(m_data);
+	memcpy(ptr, &header, sizeof(header));
+	ptr += sizeof(header);
+	memcpy(ptr, &builder.m_elements[0], builder.m_elements.getSizeInBytes());
+	ptr += builder.m_elements.getSizeInBytes();
+	if(builder.m_attributes.getSize())
+	{
+		memcpy(ptr, &builder.m_attributes[0], builder.m_attributes.getSizeInBytes());
+		ptr += builder.m_attributes.getSizeInBytes();
+	}
+	if(builder.m_numbers.getSize())
+	{
+		memcpy(ptr, &builder.m_numbers[0], builder.m_numbers.getSizeInBytes());
+		ptr += builder.m_numbers.getSizeInBytes();
+	}
+	memcpy(ptr, &builder.m_strings[0], builder.m_strings.getSizeInBytes());
+
+	const Error err = initBinary();
+	ANKI_ASSERT(!err);
+	(void)err;
+
+	return Error::NONE;
+}
+
+Error XmlDocument::loadBinaryFile(const CString& filename, GenericMemoryPoolAllocator<U8> alloc)
+{
+	destroy();
+	m_alloc = alloc;
+
+	// Read the whole file at once. The structures are used in place
+	File file;
+	ANKI_CHECK(file.open(filename, FileOpenFlag::READ | FileOpenFlag::BINARY));
+	m_dataSize = file.getSize();
+	if(m_dataSize < sizeof(XmlBinaryFile::Header))
+	{
+		ANKI_MISC_LOGE("Compiled XML is too small: %s", &filename[0]);
+		destroy();
+		return Error::USER_DATA;
+	}
+
+	m_data = m_alloc.getMemoryPool().allocate(m_dataSize, ANKI_SAFE_ALIGNMENT);
+	Error err = file.read(m_data, m_dataSize);
+	if(!err)
+	{
+		err = initBinary();
+		if(err)
+		{
+			ANKI_MISC_LOGE("Compiled XML is corrupted: %s", &filename[0]);
+		}
+	}
+
+	if(err)
+	{
+		destroy();
+	}
+
+	return err;
+}
+
+Error XmlDocument::writeBinaryFile(const CString& filename) const
+{
+	ANKI_ASSERT(m_data);
+
+	File file;
+	ANKI_CHECK(file.open(filename, FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+	ANKI_CHECK(file.write(m_data, m_dataSize));
+
+	return Error::NONE;
+}
+
+Error XmlDocument::initBinary()
+{
+	ANKI_ASSERT(m_data);
+	const U8* ptr = static_cast<const U8*>(m_data);
+	const XmlBinaryFile::Header& header = *reinterpret_cast<const XmlBinaryFile::Header*>(ptr);
+
+	if(memcmp(&header.m_magic[0], XmlBinaryFile::MAGIC, 8) != 0)
+	{
+		return Error::USER_DATA;
+	}
+
+	const PtrSize expectedSize = sizeof(XmlBinaryFile::Header)
+								 + sizeof(XmlBinaryFile::Element) * PtrSize(header.m_elementCount)
+								 + sizeof(XmlBinaryFile::Attribute) * PtrSize(header.m_attributeCount)
+								 + sizeof(XmlBinaryFile::Number) * PtrSize(header.m_numberCount)
+								 + header.m_stringDataSize;
+	if(expectedSize != m_dataSize || header.m_elementCount == 0 || header.m_stringDataSize == 0)
+	{
+		return Error::USER_DATA;
+	}
+
+	ptr += sizeof(XmlBinaryFile::Header);
+	const XmlBinaryFile::Element* elements = reinterpret_cast<const XmlBinaryFile::Element*>(ptr);
+	ptr += sizeof(XmlBinaryFile::Element) * header.m_elementCount;
+	const XmlBinaryFile::Attribute* attributes = reinterpret_cast<const XmlBinaryFile::Attribute*>(ptr);
+	ptr += sizeof(XmlBinaryFile::Attribute) * header.m_attributeCount;
+	const XmlBinaryFile::Number* numbers = reinterpret_cast<const XmlBinaryFile::Number*>(ptr);
+	ptr += sizeof(XmlBinaryFile::Number) * header.m_numberCount;
+	const char* strings = reinterpret_cast<const char*>(ptr);
+
+	// All the strings have to end
+	if(strings[header.m_stringDataSize - 1] != '\0')
+	{
+		return Error::USER_DATA;
+	}
+
+	auto numbersValid = [&](U32 first, U32 count) {
+		return count == MAX_U32 || U64(first) + count <= header.m_numberCount;
+	};
+
+	for(U32 i = 0; i < header.m_elementCount; ++i)
+	{
+		const XmlBinaryFile::Element& el = elements[i];
+
+		// The children and the siblings are after the element so walking them always ends
+		if(el.m_name >= header.m_stringDataSize
+			|| (el.m_text != MAX_U32 && el.m_text >= header.m_stringDataSize)
+			|| !numbersValid(el.m_firstNumber, el.m_numberCount)
+			|| (el.m_firstChild != MAX_U32 && (el.m_firstChild <= i || el.m_firstChild >= header.m_elementCount))
+			|| (el.m_nextSibling != MAX_U32 && (el.m_nextSibling <= i || el.m_nextSibling >= header.m_elementCount))
+			|| U64(el.m_firstAttribute) + el.m_attributeCount > header.m_attributeCount)
+		{
+			return Error::USER_DATA;
+		}
+	}
+
+	for(U32 i = 0; i < header.m_attributeCount; ++i)
+	{
+		const XmlBinaryFile::Attribute& attrib = attributes[i];
+		if(attrib.m_name >= header.m_stringDataSize || attrib.m_value >= header.m_stringDataSize
+			|| !numbersValid(attrib.m_firstNumber, attrib.m_numberCount))
+		{
+			return Error::USER_DATA;
+		}
+	}
+
+	m_elements = elements;
+	m_attributes = attributes;
+	m_numbers = numbers;
+	m_strings = strings;
+
 	return Error::NONE;
 }
 
 ANKI_USE_RESULT Error XmlDocument::getChildElement(const CString& name, XmlElement& out) const
 {
+	ANKI_ASSERT(m_elements);
 	Error err = Error::NONE;
-	out = XmlElement(m_doc.FirstChildElement(&name[0]), m_alloc);
+	out = XmlElement(this, findElement(m_elements, m_strings, m_elements[0].m_firstChild, name), m_alloc);
 
 	if(!out)
 	{
@@ -9,18 +9,72 @@
 #include <anki/util/String.h>
 #include <anki/util/DynamicArray.h>
 #include <anki/util/StringList.h>
+#include <anki/util/WeakArray.h>
 #include <anki/Math.h>
-#include <tinyxml2.h>
-#if !ANKI_TINYXML2
-#	error "Wrong tinyxml2 included"
-#endif
+#include <type_traits>
+#include <limits>
 
 namespace anki
 {
 
+// Forward
+class XmlDocument;
+
 /// @addtogroup misc
 /// @{
 
+/// Information to decode compiled XML documents. The compiled document has the tree of the elements and the
+/// attributes and their text is already converted to numbers so the documents can be used without parsing any text.
+///
+/// The file has the Header, then Header::m_elementCount Element, then Header::m_attributeCount Attribute, then
+/// Header::m_numberCount Number and then Header::m_stringDataSize bytes of zero terminated strings. Everything is
+/// referenced by indices or offsets so the file can be used as is after it's read. The first element is the document
+/// itself and its children are the top level elements.
+class XmlBinaryFile
+{
+public:
+	static constexpr const char* MAGIC = "ANKIXML2";
+
+	struct Header
+	{
+		char m_magic[8];
+		U32 m_elementCount;
+		U32 m_attributeCount;
+		U32 m_numberCount;
+		U32 m_stringDataSize;
+	};
+
+	/// A number of a text. The text is split at spaces and every part is converted to a float and to an integer.
+	struct Number
+	{
+		F64 m_float;
+		I64 m_int;
+		U64 m_uint; ///< The value if m_int is not negative. It holds the values that don't fit in m_int.
+	};
+
+	struct Element
+	{
+		U64 m_nameHash;
+		U32 m_name; ///< Offset to the strings.
+		U32 m_text; ///< Offset to the strings or MAX_U32 if there is no text.
+		U32 m_firstNumber; ///< The numbers of the text.
+		U32 m_numberCount; ///< It's MAX_U32 if a part of the text is out of range.
+		U32 m_firstChild; ///< It's MAX_U32 if there are no children.
+		U32 m_nextSibling; ///< It's MAX_U32 for the last child.
+		U32 m_firstAttribute;
+		U32 m_attributeCount;
+	};
+
+	struct Attribute
+	{
+		U64 m_nameHash;
+		U32 m_name; ///< Offset to the strings.
+		U32 m_value; ///< Offset to the strings.
+		U32 m_firstNumber; ///< The numbers of the value.
+		U32 m_numberCount; ///< It's MAX_U32 if a part of the value is out of range.
+	};
+};
+
 /// XML element.
 class XmlElement
 {
@@ -28,22 +82,18 @@ class XmlElement
 
 public:
 	XmlElement()
-		: m_el(nullptr)
+		: m_doc(nullptr)
+		, m_el(nullptr)
 	{
 	}
 
 	XmlElement(const XmlElement& b)
-		: m_el(b.m_el)
+		: m_doc(b.m_doc)
+		, m_el(b.m_el)
 		, m_alloc(b.m_alloc)
 	{
 	}
 
-	XmlElement(const tinyxml2::XMLElement* el, GenericMemoryPoolAllocator<U8> alloc)
-		: m_el(el)
-		, m_alloc(alloc)
-	{
-	}
-
 	/// If element has something return true
 	operator Bool() const
 	{
@@ -53,6 +103,7 @@ public:
 	/// Copy
 	XmlElement& operator=(const XmlElement& b)
 	{
+		m_doc = b.m_doc;
 		m_el = b.m_el;
 		m_alloc = b.m_alloc;
 		return *this;
@@ -67,30 +118,24 @@ public:
 	{
 		ANKI_CHECK(check());
 
-		const char* txt = m_el->GetText();
-		if(txt != nullptr)
-		{
-			ANKI_CHECK(CString(txt).toNumber(out));
-		}
-		else
+		if(m_el->m_numberCount == MAX_U32 || m_el->m_numberCount == 0)
 		{
-			ANKI_MISC_LOGE("Failed to return number. Element: %s", m_el->Value());
+			ANKI_MISC_LOGE("Failed to return number. Element: %s", &getName()[0]);
 			return Error::USER_DATA;
 		}
 
-		return Error::NONE;
+		return convertNumber(getNumberRange(m_el->m_firstNumber, 1)[0], out);
 	}
 
 	/// Get a number of numbers.
 	template<typename T>
 	ANKI_USE_RESULT Error getNumbers(DynamicArrayAuto<T>& out) const
 	{
-		CString txt;
-		ANKI_CHECK(getText(txt));
+		ANKI_CHECK(check());
 
-		if(txt)
+		if(m_el->m_numberCount != 0)
 		{
-			return parseNumbers(txt, out);
+			return getNumbers(m_el->m_firstNumber, m_el->m_numberCount, out);
 		}
 		else
 		{
@@ -144,12 +189,13 @@ public:
 	ANKI_USE_RESULT Error getAttributeNumbersOptional(
 		const CString& name, DynamicArrayAuto<T>& out, Bool& attribPresent) const
 	{
-		CString txtVal;
-		ANKI_CHECK(getAttributeTextOptional(name, txtVal, attribPresent));
+		ANKI_CHECK(check());
 
-		if(txtVal && attribPresent)
+		const XmlBinaryFile::Attribute* attrib = findAttribute(name);
+		attribPresent = attrib != nullptr;
+		if(attrib)
 		{
-			return parseNumbers(txtVal, out);
+			return getNumbers(attrib->m_firstNumber, attrib->m_numberCount, out);
 		}
 		else
 		{
@@ -277,39 +323,83 @@ public:
 	/// @}
 
 private:
-	const tinyxml2::XMLElement* m_el;
+	const XmlDocument* m_doc;
+	const XmlBinaryFile::Element* m_el;
 	GenericMemoryPoolAllocator<U8> m_alloc;
 
+	XmlElement(const XmlDocument* doc, const XmlBinaryFile::Element* el, GenericMemoryPoolAllocator<U8> alloc)
+		: m_doc(doc)
+		, m_el(el)
+		, m_alloc(alloc)
+	{
+	}
+
 	ANKI_USE_RESULT Error check() const;
 
-	template<typename T>
-	ANKI_USE_RESULT Error parseNumbers(CString txt, DynamicArrayAuto<T>& out) const
-	{
-		ANKI_ASSERT(txt);
-		ANKI_ASSERT(m_el);
+	CString getName() const;
+
+	const XmlBinaryFile::Attribute* findAttribute(const CString& name) const;
 
-		StringListAuto list(m_alloc);
-		list.splitString(txt, ' ');
+	ConstWeakArray<XmlBinaryFile::Number> getNumberRange(U32 first, U32 count) const;
 
+	template<typename T>
+	ANKI_USE_RESULT Error getNumbers(U32 first, U32 count, DynamicArrayAuto<T>& out) const
+	{
 		out = DynamicArrayAuto<T>(m_alloc);
-		out.create(list.getSize());
 
-		Error err = Error::NONE;
-		auto it = list.getBegin();
-		auto end = list.getEnd();
-		U i = 0;
-		while(it != end && !err)
+		if(count == MAX_U32)
+		{
+			ANKI_MISC_LOGE("Failed to parse numbers. Element: %s", &getName()[0]);
+			return Error::USER_DATA;
+		}
+
+		if(count)
 		{
-			err = it->toNumber(out[i++]);
-			++it;
+			out.create(count);
+			ConstWeakArray<XmlBinaryFile::Number> numbers = getNumberRange(first, count);
+			for(U32 i = 0; i < count; ++i)
+			{
+				ANKI_CHECK(convertNumber(numbers[i], out[i]));
+			}
 		}
 
-		if(err)
+		return Error::NONE;
+	}
+
+	template<typename T>
+	static typename std::enable_if<std::is_floating_point<T>::value, Error>::type convertNumber(
+		const XmlBinaryFile::Number& in, T& out)
+	{
+		out = T(in.m_float);
+		return Error::NONE;
+	}
+
+	template<typename T>
+	static typename std::enable_if<std::is_integral<T>::value, Error>::type convertNumber(
+		const XmlBinaryFile::Number& in, T& out)
+	{
+		if(in.m_int < 0)
+		{
+			if(in.m_int < I64(std::numeric_limits<T>::min()))
+			{
+				ANKI_MISC_LOGE("Conversion failed. Out of range");
+				return Error::USER_DATA;
+			}
+
+			out = T(in.m_int);
+		}
+		else
 		{
-			ANKI_MISC_LOGE("Failed to parse floats. Element: %s", m_el->Value());
+			if(in.m_uint > U64(std::numeric_limits<T>::max()))
+			{
+				ANKI_MISC_LOGE("Conversion failed. Out of range");
+				return Error::USER_DATA;
+			}
+
+			out = T(in.m_uint);
 		}
 
-		return err;
+		return Error::NONE;
 	}
 
 	ANKI_USE_RESULT Error throwAttribNotFoundError(CString attrib, Bool found) const
@@ -326,21 +416,47 @@ private:
 	}
 };
 
-/// XML document
-class XmlDocument
+/// XML document. The text is compiled to the form of XmlBinaryFile and the elements work on that. The compiled form
+/// can be stored and used later to skip parsing the text.
+class XmlDocument : public NonCopyable
 {
+	friend class XmlElement;
+
 public:
 	static CString XML_HEADER;
 
+	XmlDocument()
+	{
+	}
+
+	~XmlDocument();
+
 	ANKI_USE_RESULT Error loadFile(const CString& filename, GenericMemoryPoolAllocator<U8> alloc);
 
 	ANKI_USE_RESULT Error parse(const CString& xmlText, GenericMemoryPoolAllocator<U8> alloc);
 
+	/// Load a document that was written with writeBinaryFile(). It's a single read and no text is parsed.
+	ANKI_USE_RESULT Error loadBinaryFile(const CString& filename, GenericMemoryPoolAllocator<U8> alloc);
+
+	/// Write the compiled document.
+	ANKI_USE_RESULT Error writeBinaryFile(const CString& filename) const;
+
 	ANKI_USE_RESULT Error getChildElement(const CString& name, XmlElement& out) const;
 
 private:
-	tinyxml2::XMLDocument m_doc;
 	GenericMemoryPoolAllocator<U8> m_alloc;
+	void* m_data = nullptr; ///< The compiled document.
+	PtrSize m_dataSize = 0;
+
+	const XmlBinaryFile::Element* m_elements = nullptr;
+	const XmlBinaryFile::Attribute* m_attributes = nullptr;
+	const XmlBinaryFile::Number* m_numbers = nullptr;
+	const char* m_strings = nullptr;
+
+	/// Check the compiled document and set the pointers to it.
+	ANKI_USE_RESULT Error initBinary();
+
+	void destroy();
 };
 /// @}
 
@@ -12,13 +12,19 @@
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wall"
-#define BT_THREADSAFE 0
+#define BT_THREADSAFE ANKI_PHYSICS_MULTITHREADED
 #define BT_NO_PROFILE 1
 #include <btBulletCollisionCommon.h>
 #include <btBulletDynamicsCommon.h>
 #include <BulletCollision/CollisionDispatch/btGhostObject.h>
 #include <BulletDynamics/Character/btKinematicCharacterController.h>
 #include <BulletCollision/Gimpact/btGImpactShape.h>
+#include <LinearMath/btThreads.h>
+#if ANKI_PHYSICS_MULTITHREADED
+#	include <BulletCollision/CollisionDispatch/btCollisionDispatcherMt.h>
+#	include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#	include <BulletDynamics/ConstraintSolver/btSequentialImpulseConstraintSolverMt.h>
+#endif
 #pragma GCC diagnostic pop
 
 namespace anki
@@ -69,4 +69,18 @@ void PhysicsBody::setMass(F32 mass)
 	m_mass = mass;
 }
 
+void PhysicsBody::interpolateTransform(F32 factor)
+{
+	if(factor >= 1.0f || m_prevTrf == m_trf)
+	{
+		m_interpolatedTrf = m_trf;
+		return;
+	}
+
+	const Vec4 origin = mix(m_prevTrf.getOrigin(), m_trf.getOrigin(), factor);
+	const Quat rot = Quat(m_prevTrf.getRotation()).slerp(Quat(m_trf.getRotation()), factor);
+	const F32 scale = mix(m_prevTrf.getScale(), m_trf.getScale(), factor);
+	m_interpolatedTrf = Transform(origin, Mat3x4(rot), scale);
+}
+
 } // end namespace anki
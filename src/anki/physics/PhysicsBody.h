@@ -31,14 +31,25 @@ class PhysicsBody : public PhysicsFilteredObject
 public:
 	static const PhysicsObjectType CLASS_TYPE = PhysicsObjectType::BODY;
 
+	/// Get the transform of the last physics step. Don't use it while PhysicsWorld::updateAsync() runs.
 	const Transform& getTransform() const
 	{
 		return m_trf;
 	}
 
+	/// Get the transform between the last two physics steps that matches the current time. Use it for rendering. See
+	/// PhysicsWorld::setFixedTimeStep. It only changes in PhysicsWorld::update() and PhysicsWorld::waitUpdate() so it
+	/// can be read while PhysicsWorld::updateAsync() runs.
+	const Transform& getInterpolatedTransform() const
+	{
+		return m_interpolatedTrf;
+	}
+
 	void setTransform(const Transform& trf)
 	{
 		m_trf = trf;
+		m_prevTrf = trf;
+		m_interpolatedTrf = trf;
 		m_body->setWorldTransform(toBt(trf));
 	}
 
@@ -99,6 +110,16 @@ anki_internal:
 		return m_body.get();
 	}
 
+	/// Remember the transform before a physics step.
+	void savePreviousTransform()
+	{
+		m_prevTrf = m_trf;
+	}
+
+	/// Compute the interpolated transform.
+	/// @param factor Zero gives the transform of the previous step and one the transform of the last step.
+	void interpolateTransform(F32 factor);
+
 private:
 	class MotionState : public btMotionState
 	{
@@ -120,6 +141,8 @@ private:
 	BtClassWrapper<btRigidBody> m_body;
 
 	Transform m_trf = Transform::getIdentity();
+	Transform m_prevTrf = Transform::getIdentity();
+	Transform m_interpolatedTrf = Transform::getIdentity();
 	MotionState m_motionState;
 
 	PhysicsCollisionShapePtr m_shape;
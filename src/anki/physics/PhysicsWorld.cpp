@@ -8,6 +8,7 @@
 #include <anki/physics/PhysicsBody.h>
 #include <anki/physics/PhysicsTrigger.h>
 #include <anki/util/Rtti.h>
+#include <anki/util/ThreadHive.h>
 #include <BulletCollision/Gimpact/btGImpactCollisionAlgorithm.h>
 
 namespace anki
@@ -139,12 +140,322 @@ public:
 	}
 };
 
+/// Get the object of a proxy if it's one of the materials.
+static PhysicsFilteredObject* getFilteredObject(const btBroadphaseProxy* proxy, PhysicsMaterialBit materialMask)
+{
+	ANKI_ASSERT(proxy);
+	const btCollisionObject* cobj = static_cast<const btCollisionObject*>(proxy->m_clientObject);
+	ANKI_ASSERT(cobj);
+
+	PhysicsObject* pobj = static_cast<PhysicsObject*>(cobj->getUserPointer());
+	if(pobj == nullptr)
+	{
+		return nullptr;
+	}
+
+	PhysicsFilteredObject* fobj = dcast<PhysicsFilteredObject*>(pobj);
+	return (!!(fobj->getMaterialGroup() & materialMask)) ? fobj : nullptr;
+}
+
+/// Runs the queries of a PhysicsQueryBatch. The rays come first, then the sweeps and then the overlaps. Bullet's
+/// queries only read the world and the broadphase has a ray stack per thread so they can run in parallel.
+class PhysicsWorld::MyQueryLoop : public btIParallelForBody
+{
+public:
+	PhysicsWorld* m_world;
+	PhysicsQueryBatch* m_batch;
+
+	U32 getQueryCount() const
+	{
+		return m_batch->m_rays.getSize() + m_batch->m_sweeps.getSize() + m_batch->m_overlaps.getSize();
+	}
+
+	void forLoop(int iBegin, int iEnd) const override
+	{
+		for(U32 i = iBegin; i < U32(iEnd); ++i)
+		{
+			U32 idx = i;
+			if(idx < m_batch->m_rays.getSize())
+			{
+				rayQuery(m_batch->m_rays[idx], m_batch->m_rayHits[idx]);
+				continue;
+			}
+
+			idx -= m_batch->m_rays.getSize();
+			if(idx < m_batch->m_sweeps.getSize())
+			{
+				sweepQuery(m_batch->m_sweeps[idx], m_batch->m_sweepHits[idx]);
+				continue;
+			}
+
+			idx -= m_batch->m_sweeps.getSize();
+			m_batch->m_overlapCounts[idx] = overlapQuery(m_batch->m_overlaps[idx]);
+		}
+	}
+
+private:
+	class RayCallback : public btCollisionWorld::ClosestRayResultCallback
+	{
+	public:
+		PhysicsMaterialBit m_materialMask;
+
+		RayCallback(const btVector3& from, const btVector3& to, PhysicsMaterialBit materialMask)
+			: btCollisionWorld::ClosestRayResultCallback(from, to)
+			, m_materialMask(materialMask)
+		{
+		}
+
+		bool needsCollision(btBroadphaseProxy* proxy) const override
+		{
+			return getFilteredObject(proxy, m_materialMask) != nullptr;
+		}
+	};
+
+	class SweepCallback : public btCollisionWorld::ClosestConvexResultCallback
+	{
+	public:
+		PhysicsMaterialBit m_materialMask;
+
+		SweepCallback(const btVector3& from, const btVector3& to, PhysicsMaterialBit materialMask)
+			: btCollisionWorld::ClosestConvexResultCallback(from, to)
+			, m_materialMask(materialMask)
+		{
+		}
+
+		bool needsCollision(btBroadphaseProxy* proxy) const override
+		{
+			return getFilteredObject(proxy, m_materialMask) != nullptr;
+		}
+	};
+
+	class OverlapCallback : public btBroadphaseAabbCallback
+	{
+	public:
+		const PhysicsOverlapQuery* m_query;
+		btVector3 m_aabbMin;
+		btVector3 m_aabbMax;
+		U32 m_count = 0;
+
+		bool process(const btBroadphaseProxy* proxy) override
+		{
+			// The broadphase uses enlarged boxes, test the real ones
+			if(TestAabbAgainstAabb2(proxy->m_aabbMin, proxy->m_aabbMax, m_aabbMin, m_aabbMax))
+			{
+				PhysicsFilteredObject* obj = getFilteredObject(proxy, m_query->m_materialMask);
+				if(obj)
+				{
+					if(m_count < m_query->m_objects.getSize())
+					{
+						m_query->m_objects[m_count] = obj;
+					}
+					++m_count;
+				}
+			}
+
+			return true;
+		}
+	};
+
+	static void writeHit(const btCollisionObject* cobj,
+		const btVector3& pos,
+		const btVector3& normal,
+		F32 fraction,
+		PhysicsQueryHit& hit)
+	{
+		hit = PhysicsQueryHit();
+		if(cobj)
+		{
+			hit.m_object = dcast<PhysicsFilteredObject*>(static_cast<PhysicsObject*>(cobj->getUserPointer()));
+			hit.m_position = toAnki(pos);
+			hit.m_normal = toAnki(normal);
+			hit.m_fraction = fraction;
+		}
+	}
+
+	void rayQuery(const PhysicsRayQuery& query, PhysicsQueryHit& hit) const
+	{
+		RayCallback callback(toBt(query.m_from), toBt(query.m_to), query.m_materialMask);
+		m_world->m_btWorld->rayTest(toBt(query.m_from), toBt(query.m_to), callback);
+
+		writeHit((callback.hasHit()) ? callback.m_collisionObject : nullptr,
+			callback.m_hitPointWorld,
+			callback.m_hitNormalWorld,
+			callback.m_closestHitFraction,
+			hit);
+	}
+
+	void sweepQuery(const PhysicsSweepQuery& query, PhysicsQueryHit& hit) const
+	{
+		ANKI_ASSERT(query.m_radius > 0.0f);
+		btSphereShape sphere(query.m_radius);
+
+		btTransform from;
+		from.setIdentity();
+		from.setOrigin(toBt(query.m_from));
+		btTransform to;
+		to.setIdentity();
+		to.setOrigin(toBt(query.m_to));
+
+		SweepCallback callback(toBt(query.m_from), toBt(query.m_to), query.m_materialMask);
+		m_world->m_btWorld->convexSweepTest(&sphere, from, to, callback);
+
+		writeHit((callback.hasHit()) ? callback.m_hitCollisionObject : nullptr,
+			callback.m_hitPointWorld,
+			callback.m_hitNormalWorld,
+			callback.m_closestHitFraction,
+			hit);
+	}
+
+	U32 overlapQuery(const PhysicsOverlapQuery& query) const
+	{
+		OverlapCallback callback;
+		callback.m_query = &query;
+		callback.m_aabbMin = toBt(query.m_aabbMin);
+		callback.m_aabbMax = toBt(query.m_aabbMax);
+		m_world->m_broadphase->aabbTest(callback.m_aabbMin, callback.m_aabbMax, callback);
+		return callback.m_count;
+	}
+};
+
+#if ANKI_PHYSICS_MULTITHREADED
+/// Runs the parallel loops of Bullet in the ThreadHive. The loop is split in chunks of the grain size and the tasks of
+/// the hive and the calling thread take chunks until there are no more left.
+class PhysicsWorld::MyTaskScheduler : public btITaskScheduler
+{
+public:
+	ThreadHive* m_hive;
+
+	MyTaskScheduler(ThreadHive* hive)
+		: btITaskScheduler("AnKi ThreadHive")
+		, m_hive(hive)
+	{
+		ANKI_ASSERT(hive);
+	}
+
+	int getMaxNumThreads() const override
+	{
+		return min<int>(m_hive->getThreadCount() + 1, BT_MAX_THREAD_COUNT);
+	}
+
+	int getNumThreads() const override
+	{
+		return getMaxNumThreads();
+	}
+
+	void setNumThreads(int numThreads) override
+	{
+		// The ThreadHive has a fixed number of threads
+	}
+
+	void activate() override
+	{
+		// Bullet hands out a thread index to every new thread that touches it and never reuses them. The threads of
+		// the previous world's hive are gone so start counting again, otherwise the indices of a new hive's threads
+		// will overflow the per thread arrays of btCollisionDispatcherMt
+		btResetThreadIndexCounter();
+		btITaskScheduler::activate();
+	}
+
+	void parallelFor(int iBegin, int iEnd, int grainSize, const btIParallelForBody& body) override
+	{
+		Loop loop(iBegin, iEnd, grainSize);
+		loop.m_forBody = &body;
+		run(loop);
+	}
+
+	btScalar parallelSum(int iBegin, int iEnd, int grainSize, const btIParallelSumBody& body) override
+	{
+		Loop loop(iBegin, iEnd, grainSize);
+		loop.m_sumBody = &body;
+		run(loop);
+		return loop.m_sum;
+	}
+
+private:
+	class Loop
+	{
+	public:
+		const btIParallelForBody* m_forBody = nullptr;
+		const btIParallelSumBody* m_sumBody = nullptr;
+		I32 m_end;
+		I32 m_grainSize;
+		Atomic<I32> m_nextBegin;
+
+		SpinLock m_sumMtx;
+		btScalar m_sum = 0.0f;
+
+		Loop(I32 begin, I32 end, I32 grainSize)
+			: m_end(end)
+			, m_grainSize(max(grainSize, 1))
+			, m_nextBegin(begin)
+		{
+		}
+	};
+
+	static void work(Loop& loop)
+	{
+		btScalar sum = 0.0f;
+
+		I32 begin;
+		while((begin = loop.m_nextBegin.fetchAdd(loop.m_grainSize)) < loop.m_end)
+		{
+			const I32 end = min(begin + loop.m_grainSize, loop.m_end);
+			if(loop.m_forBody)
+			{
+				loop.m_forBody->forLoop(begin, end);
+			}
+			else
+			{
+				sum += loop.m_sumBody->sumLoop(begin, end);
+			}
+		}
+
+		if(loop.m_sumBody)
+		{
+			LockGuard<SpinLock> lock(loop.m_sumMtx);
+			loop.m_sum += sum;
+		}
+	}
+
+	void run(Loop& loop)
+	{
+		const I32 chunkCount = (loop.m_end - loop.m_nextBegin.load() + loop.m_grainSize - 1) / loop.m_grainSize;
+		const U32 taskCount = (chunkCount > 1) ? min<U32>(chunkCount - 1, m_hive->getThreadCount()) : 0;
+
+		if(taskCount > 0)
+		{
+			Array<ThreadHiveTask, ThreadHive::MAX_THREADS> tasks;
+			for(U32 i = 0; i < taskCount; ++i)
+			{
+				tasks[i].m_callback = [](void* ud, U32 threadId, ThreadHive& hive, ThreadHiveSemaphore* sem) {
+					work(*static_cast<Loop*>(ud));
+				};
+				tasks[i].m_argument = &loop;
+			}
+
+			m_hive->submitTasks(&tasks[0], taskCount);
+		}
+
+		// Help
+		work(loop);
+
+		if(taskCount > 0)
+		{
+			m_hive->waitAllTasks();
+		}
+	}
+};
+#endif
+
 PhysicsWorld::PhysicsWorld()
+	: m_updateThread("anki_physics")
 {
 }
 
 PhysicsWorld::~PhysicsWorld()
 {
+	stopUpdateThread();
+
 #if ANKI_ASSERTS_ENABLED
 	for(PhysicsObjectType type = PhysicsObjectType::FIRST; type < PhysicsObjectType::COUNT; ++type)
 	{
@@ -152,9 +463,26 @@ PhysicsWorld::~PhysicsWorld()
 	}
 #endif
 
-	m_world.destroy();
-	m_solver.destroy();
-	m_dispatcher.destroy();
+#if ANKI_PHYSICS_MULTITHREADED
+	if(m_taskScheduler)
+	{
+		m_worldMt.destroy();
+		m_solverMt.destroy();
+		m_solverPool.destroy();
+		m_dispatcherMt.destroy();
+
+		btSetTaskScheduler(nullptr);
+		m_alloc.deleteInstance(m_taskScheduler);
+		m_taskScheduler = nullptr;
+	}
+	else
+#endif
+	{
+		m_world.destroy();
+		m_solver.destroy();
+		m_dispatcher.destroy();
+	}
+
 	m_collisionConfig.destroy();
 	m_broadphase.destroy();
 	m_gpc.destroy();
@@ -163,7 +491,7 @@ PhysicsWorld::~PhysicsWorld()
 	gAlloc = nullptr;
 }
 
-Error PhysicsWorld::create(AllocAlignedCallback allocCb, void* allocCbData)
+Error PhysicsWorld::create(AllocAlignedCallback allocCb, void* allocCbData, ThreadHive* threadHive)
 {
 	m_alloc = HeapAllocator<U8>(allocCb, allocCbData);
 	m_tmpAlloc = StackAllocator<U8>(allocCb, allocCbData, 1_KB, 2.0f);
@@ -181,41 +509,200 @@ Error PhysicsWorld::create(AllocAlignedCallback allocCb, void* allocCbData)
 
 	m_collisionConfig.init();
 
-	m_dispatcher.init(m_collisionConfig.get());
-	btGImpactCollisionAlgorithm::registerAlgorithm(m_dispatcher.get());
+#if ANKI_PHYSICS_MULTITHREADED
+	if(threadHive && threadHive->getThreadCount() > 1)
+	{
+		// Bullet has a single task scheduler for all the worlds
+		ANKI_ASSERT(btGetTaskScheduler() == nullptr || btGetTaskScheduler() == btGetSequentialTaskScheduler());
+		m_taskScheduler = m_alloc.newInstance<MyTaskScheduler>(threadHive);
+		btSetTaskScheduler(m_taskScheduler);
+
+		m_dispatcherMt.init(m_collisionConfig.get());
+		btGImpactCollisionAlgorithm::registerAlgorithm(m_dispatcherMt.get());
+
+		// One solver per thread for the islands
+		m_solverPool.init(m_taskScheduler->getMaxNumThreads());
+		m_solverMt.init();
+
+		m_worldMt.init(
+			m_dispatcherMt.get(), m_broadphase.get(), m_solverPool.get(), m_solverMt.get(), m_collisionConfig.get());
+		m_btWorld = m_worldMt.get();
+
+		ANKI_PHYS_LOGI("Using the multithreaded world with %d threads", m_taskScheduler->getMaxNumThreads());
+	}
+	else
+#endif
+	{
+		m_dispatcher.init(m_collisionConfig.get());
+		btGImpactCollisionAlgorithm::registerAlgorithm(m_dispatcher.get());
+
+		m_solver.init();
 
-	m_solver.init();
+		m_world.init(m_dispatcher.get(), m_broadphase.get(), m_solver.get(), m_collisionConfig.get());
+		m_btWorld = m_world.get();
+	}
 
-	m_world.init(m_dispatcher.get(), m_broadphase.get(), m_solver.get(), m_collisionConfig.get());
-	m_world->setGravity(btVector3(0.0f, -9.8f, 0.0f));
+	m_btWorld->setGravity(btVector3(0.0f, -9.8f, 0.0f));
 
 	return Error::NONE;
 }
 
 Error PhysicsWorld::update(Second dt)
 {
-	// Update world
+	ANKI_ASSERT(m_asyncState == AsyncUpdateState::IDLE && "Call waitUpdate() first");
+
+	step(dt);
+	finalizeUpdate();
+
+	return Error::NONE;
+}
+
+void PhysicsWorld::updateAsync(Second dt)
+{
+#if ANKI_PHYSICS_MULTITHREADED
+	ANKI_ASSERT(!m_taskScheduler && "Only the thread that waits the ThreadHive can step the multithreaded world");
+#endif
+
+	if(!m_updateThreadStarted)
 	{
-		auto lock = lockBtWorld();
-		m_world->stepSimulation(dt, 1, 1.0 / 60.0);
+		m_updateThread.start(this, updateThreadCallback);
+		m_updateThreadStarted = true;
 	}
 
-	// Process trigger contacts
+	LockGuard<Mutex> lock(m_updateMtx);
+	ANKI_ASSERT(m_asyncState == AsyncUpdateState::IDLE && "Call waitUpdate() first");
+	m_asyncDt = dt;
+	m_asyncState = AsyncUpdateState::PENDING;
+	m_updateStartCondVar.notifyOne();
+}
+
+void PhysicsWorld::waitUpdate()
+{
 	{
-		LockGuard<Mutex> lock(m_objectListsMtx);
+		LockGuard<Mutex> lock(m_updateMtx);
+		while(m_asyncState == AsyncUpdateState::PENDING)
+		{
+			m_updateDoneCondVar.wait(m_updateMtx);
+		}
 
-		for(PhysicsObject& trigger : m_objectLists[PhysicsObjectType::TRIGGER])
+		if(m_asyncState == AsyncUpdateState::IDLE)
 		{
-			static_cast<PhysicsTrigger&>(trigger).processContacts();
+			return;
 		}
+
+		m_asyncState = AsyncUpdateState::IDLE;
 	}
 
-	// Reset the pool
-	m_tmpAlloc.getMemoryPool().reset();
+	finalizeUpdate();
+}
+
+Error PhysicsWorld::updateThreadCallback(ThreadCallbackInfo& info)
+{
+	PhysicsWorld& self = *static_cast<PhysicsWorld*>(info.m_userData);
+
+	while(true)
+	{
+		Second dt;
+		{
+			LockGuard<Mutex> lock(self.m_updateMtx);
+			while(self.m_asyncState != AsyncUpdateState::PENDING && !self.m_quitUpdateThread)
+			{
+				self.m_updateStartCondVar.wait(self.m_updateMtx);
+			}
+
+			if(self.m_quitUpdateThread)
+			{
+				break;
+			}
+
+			dt = self.m_asyncDt;
+		}
+
+		self.step(dt);
+
+		LockGuard<Mutex> lock(self.m_updateMtx);
+		self.m_asyncState = AsyncUpdateState::DONE;
+		self.m_updateDoneCondVar.notifyOne();
+	}
 
 	return Error::NONE;
 }
 
+void PhysicsWorld::stopUpdateThread()
+{
+	if(!m_updateThreadStarted)
+	{
+		return;
+	}
+
+	{
+		// The quit is checked before the next step so a pending step finishes first
+		LockGuard<Mutex> lock(m_updateMtx);
+		while(m_asyncState == AsyncUpdateState::PENDING)
+		{
+			m_updateDoneCondVar.wait(m_updateMtx);
+		}
+
+		m_quitUpdateThread = true;
+		m_updateStartCondVar.notifyOne();
+	}
+
+	Error err = m_updateThread.join();
+	(void)err;
+	m_updateThreadStarted = false;
+}
+
+void PhysicsWorld::step(Second dt)
+{
+	// Accumulate the time and find how many fixed steps fit. Tolerate the rounding errors of dt
+	m_timeAccumulator += dt;
+	U32 stepCount = U32(m_timeAccumulator / m_fixedTimeStep + 0.001);
+	if(stepCount > m_maxSubSteps)
+	{
+		// Drop the time that doesn't fit, the next updates shouldn't pay for a long frame
+		stepCount = m_maxSubSteps;
+		m_timeAccumulator = m_fixedTimeStep * stepCount;
+	}
+	m_timeAccumulator = max(0.0, m_timeAccumulator - m_fixedTimeStep * stepCount);
+	m_lastSubStepCount = stepCount;
+	m_interpolationFactor = (m_interpolateTransforms) ? F32(m_timeAccumulator / m_fixedTimeStep) : 1.0f;
+
+	auto lock = lockBtWorld();
+	LockGuard<Mutex> lock2(m_objectListsMtx);
+
+	for(U32 i = 0; i < stepCount; ++i)
+	{
+		for(PhysicsObject& body : m_objectLists[PhysicsObjectType::BODY])
+		{
+			static_cast<PhysicsBody&>(body).savePreviousTransform();
+		}
+
+		// Zero substeps means that Bullet won't accumulate or interpolate, it will do a single step
+		m_btWorld->stepSimulation(m_fixedTimeStep, 0, m_fixedTimeStep);
+	}
+}
+
+void PhysicsWorld::finalizeUpdate()
+{
+	LockGuard<Mutex> lock(m_objectListsMtx);
+
+	// Publish the transforms. The interpolated transforms are the only ones that are safe to read while an async
+	// update steps the world
+	for(PhysicsObject& body : m_objectLists[PhysicsObjectType::BODY])
+	{
+		static_cast<PhysicsBody&>(body).interpolateTransform(m_interpolationFactor);
+	}
+
+	// Process trigger contacts
+	for(PhysicsObject& trigger : m_objectLists[PhysicsObjectType::TRIGGER])
+	{
+		static_cast<PhysicsTrigger&>(trigger).processContacts();
+	}
+
+	// Reset the pool
+	m_tmpAlloc.getMemoryPool().reset();
+}
+
 void PhysicsWorld::destroyObject(PhysicsObject* obj)
 {
 	ANKI_ASSERT(obj);
@@ -237,8 +724,41 @@ void PhysicsWorld::rayCast(WeakArray<PhysicsWorldRayCastCallback*> rayCasts)
 	for(PhysicsWorldRayCastCallback* cb : rayCasts)
 	{
 		callback.m_raycast = cb;
-		m_world->rayTest(toBt(cb->m_from), toBt(cb->m_to), callback);
+		m_btWorld->rayTest(toBt(cb->m_from), toBt(cb->m_to), callback);
 	}
 }
 
+void PhysicsWorld::query(PhysicsQueryBatch& batch)
+{
+	ANKI_ASSERT(batch.m_rays.getSize() == batch.m_rayHits.getSize());
+	ANKI_ASSERT(batch.m_sweeps.getSize() == batch.m_sweepHits.getSize());
+	ANKI_ASSERT(batch.m_overlaps.getSize() == batch.m_overlapCounts.getSize());
+
+	MyQueryLoop loop;
+	loop.m_world = this;
+	loop.m_batch = &batch;
+
+	const U32 queryCount = loop.getQueryCount();
+	if(queryCount == 0)
+	{
+		return;
+	}
+
+	// Writers wait for the whole batch. The threads of the hive don't need to lock
+	auto lock = lockBtWorld();
+
+#if ANKI_PHYSICS_MULTITHREADED
+	if(m_taskScheduler)
+	{
+		const U32 QUERIES_PER_TASK = 32;
+		btParallelFor(0, queryCount, QUERIES_PER_TASK, loop);
+		return;
+	}
+#endif
+
+	// No scheduler of ours is set. Don't go through btParallelFor since it will use whatever global scheduler some
+	// other world has set
+	loop.forLoop(0, queryCount);
+}
+
 } // end namespace anki
@@ -9,10 +9,14 @@
 #include <anki/physics/PhysicsObject.h>
 #include <anki/util/List.h>
 #include <anki/util/WeakArray.h>
+#include <anki/util/Thread.h>
 
 namespace anki
 {
 
+// Forward
+class ThreadHive;
+
 /// @addtogroup physics
 /// @{
 
@@ -36,6 +40,61 @@ public:
 	virtual void processResult(PhysicsFilteredObject& obj, const Vec3& worldNormal, const Vec3& worldPosition) = 0;
 };
 
+/// A ray query of a PhysicsQueryBatch.
+class PhysicsRayQuery
+{
+public:
+	Vec3 m_from = Vec3(0.0f);
+	Vec3 m_to = Vec3(0.0f);
+	PhysicsMaterialBit m_materialMask = PhysicsMaterialBit::ALL; ///< Materials to check.
+};
+
+/// A query of a PhysicsQueryBatch that sweeps a sphere from one point to another.
+class PhysicsSweepQuery
+{
+public:
+	Vec3 m_from = Vec3(0.0f);
+	Vec3 m_to = Vec3(0.0f);
+	F32 m_radius = 0.0f;
+	PhysicsMaterialBit m_materialMask = PhysicsMaterialBit::ALL; ///< Materials to check.
+};
+
+/// A query of a PhysicsQueryBatch that finds the objects whose bounding boxes overlap a box.
+class PhysicsOverlapQuery
+{
+public:
+	Vec3 m_aabbMin = Vec3(0.0f);
+	Vec3 m_aabbMax = Vec3(0.0f);
+	PhysicsMaterialBit m_materialMask = PhysicsMaterialBit::ALL; ///< Materials to check.
+
+	/// Where to write the objects. If there are more objects than that they are counted but not written.
+	WeakArray<PhysicsFilteredObject*> m_objects;
+};
+
+/// The closest hit of a ray or a sweep.
+class PhysicsQueryHit
+{
+public:
+	PhysicsFilteredObject* m_object = nullptr; ///< It's nullptr if nothing was hit.
+	Vec3 m_position = Vec3(0.0f); ///< The hit point in world space.
+	Vec3 m_normal = Vec3(0.0f); ///< The normal of the hit in world space.
+	F32 m_fraction = 1.0f; ///< Where the hit is between the start and the end of the query.
+};
+
+/// Many queries that run together. The results are written to arrays that the caller allocated.
+class PhysicsQueryBatch
+{
+public:
+	ConstWeakArray<PhysicsRayQuery> m_rays;
+	WeakArray<PhysicsQueryHit> m_rayHits; ///< One per ray.
+
+	ConstWeakArray<PhysicsSweepQuery> m_sweeps;
+	WeakArray<PhysicsQueryHit> m_sweepHits; ///< One per sweep.
+
+	ConstWeakArray<PhysicsOverlapQuery> m_overlaps;
+	WeakArray<U32> m_overlapCounts; ///< The number of overlapping objects of every overlap query.
+};
+
 /// The master container for all physics related stuff.
 class PhysicsWorld
 {
@@ -43,7 +102,12 @@ public:
 	PhysicsWorld();
 	~PhysicsWorld();
 
-	ANKI_USE_RESULT Error create(AllocAlignedCallback allocCb, void* allocCbData);
+	/// Create the world.
+	/// @param threadHive If it's not nullptr and the engine is built with ANKI_PHYSICS_MULTITHREADED the world will be
+	///                   Bullet's multithreaded world and the collision detection and the island solving will run in
+	///                   the ThreadHive. update() should then be called from the thread that waits the ThreadHive and
+	///                   while no other tasks are running.
+	ANKI_USE_RESULT Error create(AllocAlignedCallback allocCb, void* allocCbData, ThreadHive* threadHive = nullptr);
 
 	template<typename T, typename... TArgs>
 	PhysicsPtr<T> newInstance(TArgs&&... args)
@@ -58,9 +122,41 @@ public:
 		return PhysicsPtr<T>(obj);
 	}
 
+	/// Set how the world is stepped. The time passed to update() is accumulated and the world is stepped in fixed
+	/// steps as many times as the accumulated time allows. The bodies get a transform interpolated between the last two
+	/// steps so the motion is smooth even if the rate of the physics is lower than the frame rate.
+	/// @param fixedTimeStep The time of a single step.
+	/// @param maxSubSteps The max steps in a single update. The time that doesn't fit is dropped and the simulation
+	///                    slows down instead of falling further behind.
+	/// @param interpolateTransforms If false PhysicsBody::getInterpolatedTransform() returns the last step.
+	void setFixedTimeStep(Second fixedTimeStep, U32 maxSubSteps, Bool interpolateTransforms = true)
+	{
+		ANKI_ASSERT(fixedTimeStep > 0.0 && maxSubSteps > 0);
+		m_fixedTimeStep = fixedTimeStep;
+		m_maxSubSteps = maxSubSteps;
+		m_interpolateTransforms = interpolateTransforms;
+	}
+
 	/// Do the update.
 	Error update(Second dt);
 
+	/// Start an update in a dedicated thread and return immediately. The update is finished by waitUpdate() which is
+	/// the only sync point. Until then only the interpolated transforms of the bodies can be read (see
+	/// PhysicsBody::getInterpolatedTransform()) and anything that touches the world will block until the step is done.
+	/// It can't be used with a world that steps in the ThreadHive (see create()).
+	void updateAsync(Second dt);
+
+	/// Wait for the updateAsync() to finish and publish its results. It's the counterpart of update() for the async
+	/// mode: the interpolated transforms are updated and the triggers are processed in the calling thread. It does
+	/// nothing if there is no pending updateAsync().
+	void waitUpdate();
+
+	/// Get the steps of the last update().
+	U32 getLastSubStepCount() const
+	{
+		return m_lastSubStepCount;
+	}
+
 	HeapAllocator<U8> getAllocator() const
 	{
 		return m_alloc;
@@ -80,15 +176,20 @@ public:
 		rayCast(arr);
 	}
 
+	/// Run a batch of read-only queries. The world lock is held once for the whole batch. If the world is
+	/// multithreaded (see create()) the queries run in parallel in the ThreadHive without any more locking, so call it
+	/// from the thread that waits the ThreadHive.
+	void query(PhysicsQueryBatch& batch);
+
 anki_internal:
 	btDynamicsWorld* getBtWorld()
 	{
-		return m_world.get();
+		return m_btWorld;
 	}
 
 	const btDynamicsWorld* getBtWorld() const
 	{
-		return m_world.get();
+		return m_btWorld;
 	}
 
 	F32 getCollisionMargin() const
@@ -106,6 +207,16 @@ anki_internal:
 private:
 	class MyOverlapFilterCallback;
 	class MyRaycastCallback;
+	class MyTaskScheduler;
+	class MyQueryLoop;
+
+	/// The state of the async update.
+	enum class AsyncUpdateState : U8
+	{
+		IDLE,
+		PENDING, ///< The update thread steps the world.
+		DONE ///< The update thread is done and waitUpdate() should publish the results.
+	};
 
 	HeapAllocator<U8> m_alloc;
 	StackAllocator<U8> m_tmpAlloc;
@@ -118,10 +229,50 @@ private:
 	BtClassWrapper<btCollisionDispatcher> m_dispatcher;
 	BtClassWrapper<btSequentialImpulseConstraintSolver> m_solver;
 	BtClassWrapper<btDiscreteDynamicsWorld> m_world;
+
+#if ANKI_PHYSICS_MULTITHREADED
+	MyTaskScheduler* m_taskScheduler = nullptr; ///< If it's not nullptr the multithreaded world is used.
+	BtClassWrapper<btCollisionDispatcherMt> m_dispatcherMt;
+	BtClassWrapper<btConstraintSolverPoolMt> m_solverPool;
+	BtClassWrapper<btSequentialImpulseConstraintSolverMt> m_solverMt;
+	BtClassWrapper<btDiscreteDynamicsWorldMt> m_worldMt;
+#endif
+
+	btDiscreteDynamicsWorld* m_btWorld = nullptr; ///< Points to m_world or m_worldMt.
 	mutable Mutex m_btWorldMtx;
 
+	Second m_fixedTimeStep = 1.0 / 60.0;
+	U32 m_maxSubSteps = 1;
+	Bool8 m_interpolateTransforms = true;
+	Second m_timeAccumulator = 0.0;
+	U32 m_lastSubStepCount = 0;
+	F32 m_interpolationFactor = 1.0f;
+
+	/// @name Async update
+	/// @{
+	Thread m_updateThread;
+	Mutex m_updateMtx;
+	ConditionVariable m_updateStartCondVar;
+	ConditionVariable m_updateDoneCondVar;
+	Second m_asyncDt = 0.0;
+	AsyncUpdateState m_asyncState = AsyncUpdateState::IDLE;
+	Bool8 m_updateThreadStarted = false;
+	Bool8 m_quitUpdateThread = false;
+	/// @}
+
 	Array<IntrusiveList<PhysicsObject>, U(PhysicsObjectType::COUNT)> m_objectLists;
 	mutable Mutex m_objectListsMtx;
+
+	/// Step the world. It can run in the update thread.
+	void step(Second dt);
+
+	/// Interpolate the transforms and process the triggers. It runs in the thread that called update() or
+	/// waitUpdate().
+	void finalizeUpdate();
+
+	static ANKI_USE_RESULT Error updateThreadCallback(ThreadCallbackInfo& info);
+
+	void stopUpdateThread();
 };
 /// @}
 
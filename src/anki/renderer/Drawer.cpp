@@ -22,10 +22,11 @@ public:
 
 	const RenderableQueueElement* m_renderableElement = nullptr;
 
-	Array<RenderableQueueElement, MAX_INSTANCES> m_cachedRenderElements;
-	Array<U8, MAX_INSTANCES> m_cachedRenderElementLods;
-	Array<const void*, MAX_INSTANCES> m_userData;
-	U m_cachedRenderElementCount = 0;
+	/// The elements that will be merged. They are contiguous in the queue so there is no need to copy them. There is
+	/// no limit to their number.
+	const RenderableQueueElement* m_cachedRenderElements = nullptr;
+	U32 m_cachedRenderElementCount = 0;
+	U8 m_cachedRenderElementLod = 0;
 };
 
 /// Check if the drawcalls can be merged.
@@ -72,27 +73,38 @@ void RenderableDrawer::drawRange(Pass pass,
 
 void RenderableDrawer::flushDrawcall(DrawContext& ctx)
 {
-	ctx.m_queueCtx.m_key.m_lod = ctx.m_cachedRenderElementLods[0];
-	ctx.m_queueCtx.m_key.m_instanceCount = ctx.m_cachedRenderElementCount;
+	const U32 count = ctx.m_cachedRenderElementCount;
+	ANKI_ASSERT(count > 0);
 
-	ctx.m_cachedRenderElements[0].m_callback(
-		ctx.m_queueCtx, ConstWeakArray<void*>(const_cast<void**>(&ctx.m_userData[0]), ctx.m_cachedRenderElementCount));
+	ctx.m_queueCtx.m_key.m_lod = ctx.m_cachedRenderElementLod;
+	ctx.m_queueCtx.m_key.m_instanceCount = count;
+
+	// Gather the user data. Use the stack for the common case and the frame memory for the big merged drawcalls
+	Array<void*, MAX_INSTANCES> userDataStorage;
+	void** userData =
+		(count <= MAX_INSTANCES) ? &userDataStorage[0] : m_r->getFrameAllocator().newArray<void*>(count);
+	for(U32 i = 0; i < count; ++i)
+	{
+		userData[i] = const_cast<void*>(ctx.m_cachedRenderElements[i].m_userData);
+	}
+
+	ctx.m_cachedRenderElements[0].m_callback(ctx.m_queueCtx, ConstWeakArray<void*>(userData, count));
+
+	if(count > MAX_INSTANCES)
+	{
+		m_r->getFrameAllocator().deleteArray(userData, count);
+	}
 
 	// Rendered something, reset the cached transforms
-	if(ctx.m_cachedRenderElementCount > 1)
+	if(count > 1)
 	{
-		ANKI_TRACE_INC_COUNTER(R_MERGED_DRAWCALLS, ctx.m_cachedRenderElementCount - 1);
+		ANKI_TRACE_INC_COUNTER(R_MERGED_DRAWCALLS, count - 1);
 	}
 	ctx.m_cachedRenderElementCount = 0;
 }
 
 void RenderableDrawer::drawSingle(DrawContext& ctx)
 {
-	if(ctx.m_cachedRenderElementCount == MAX_INSTANCES)
-	{
-		flushDrawcall(ctx);
-	}
-
 	const RenderableQueueElement& rqel = *ctx.m_renderableElement;
 
 	U8 lod;
@@ -102,13 +114,13 @@ void RenderableDrawer::drawSingle(DrawContext& ctx)
 	}
 	else
 	{
-		lod = min<U8>(m_r->calculateLod(rqel.m_distanceFromCamera), MAX_LOD_COUNT - 1);
+		lod = min<U8>(rqel.m_lod, MAX_LOD_COUNT - 1);
 	}
 
 	const Bool shouldFlush =
 		ctx.m_cachedRenderElementCount > 0
 		&& (!canMergeRenderableQueueElements(ctx.m_cachedRenderElements[ctx.m_cachedRenderElementCount - 1], rqel)
-			   || ctx.m_cachedRenderElementLods[ctx.m_cachedRenderElementCount - 1] != lod);
+			   || ctx.m_cachedRenderElementLod != lod);
 
 	if(shouldFlush)
 	{
@@ -116,9 +128,12 @@ void RenderableDrawer::drawSingle(DrawContext& ctx)
 	}
 
 	// Cache the new one
-	ctx.m_cachedRenderElements[ctx.m_cachedRenderElementCount] = rqel;
-	ctx.m_cachedRenderElementLods[ctx.m_cachedRenderElementCount] = lod;
-	ctx.m_userData[ctx.m_cachedRenderElementCount] = rqel.m_userData;
+	if(ctx.m_cachedRenderElementCount == 0)
+	{
+		ctx.m_cachedRenderElements = &rqel;
+		ctx.m_cachedRenderElementLod = lod;
+	}
+	ANKI_ASSERT(&ctx.m_cachedRenderElements[ctx.m_cachedRenderElementCount] == &rqel && "Should be contiguous");
 	++ctx.m_cachedRenderElementCount;
 }
 
@@ -13,6 +13,7 @@ U RenderQueue::countAllRenderables() const
 	U drawableCount = 0;
 	drawableCount += m_earlyZRenderables.getSize();
 	drawableCount += m_renderables.getSize();
+	drawableCount += m_dynamicShadowRenderables.getSize();
 	drawableCount += m_forwardShadingRenderables.getSize();
 
 	for(const SpotLightQueueElement* slight : m_shadowSpotLights)
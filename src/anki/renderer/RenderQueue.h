@@ -54,7 +54,9 @@ public:
 	RenderQueueDrawCallback m_callback;
 	const void* m_userData;
 	U64 m_mergeKey;
+	U64 m_sortKey; ///< Don't set this. It's computed by the visibility tests.
 	F32 m_distanceFromCamera; ///< Don't set this
+	U8 m_lod; ///< Don't set this. It's selected by the visibility tests.
 
 	RenderableQueueElement()
 	{
@@ -242,7 +244,8 @@ using FillCoverageBufferCallback = void (*)(void* userData, F32* depthValues, U3
 class RenderQueue : public RenderingMatrices
 {
 public:
-	WeakArray<RenderableQueueElement> m_renderables; ///< Deferred shading or shadow renderables.
+	WeakArray<RenderableQueueElement> m_renderables; ///< Deferred shading or static shadow renderables.
+	WeakArray<RenderableQueueElement> m_dynamicShadowRenderables; ///< Shadow renderables that changed recently.
 	WeakArray<RenderableQueueElement> m_earlyZRenderables; ///< Some renderables that will be used for Early Z pass.
 	WeakArray<RenderableQueueElement> m_forwardShadingRenderables;
 	WeakArray<PointLightQueueElement> m_pointLights;
@@ -258,6 +261,13 @@ public:
 	/// Applies only if the RenderQueue holds shadow casters. It's the max timesamp of all shadow casters
 	Timestamp m_shadowRenderablesLastUpdateTimestamp = 0;
 
+	/// Applies only if the RenderQueue holds shadow casters. It's the max timesamp of the static shadow casters
+	Timestamp m_staticShadowRenderablesLastUpdateTimestamp = 0;
+
+	/// Applies only if the RenderQueue holds shadow casters. A hash of the identities and the timestamps of the static
+	/// shadow casters. It changes when the set of the static shadow casters changes.
+	U64 m_staticShadowRenderablesHash = 0;
+
 	F32 m_cameraNear;
 	F32 m_cameraFar;
 
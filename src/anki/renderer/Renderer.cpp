@@ -77,9 +77,6 @@ Error Renderer::initInternal(const ConfigSet& config)
 	m_height = config.getNumber("height");
 	ANKI_R_LOGI("Initializing offscreen renderer. Size %ux%u", m_width, m_height);
 
-	ANKI_ASSERT(m_lodDistances.getSize() == 2);
-	m_lodDistances[0] = config.getNumber("r.lodDistance0");
-	m_lodDistances[1] = config.getNumber("r.lodDistance1");
 	m_frameCount = 0;
 
 	m_clusterCount[0] = config.getNumber("r.clusterSizeX");
@@ -252,6 +249,8 @@ void Renderer::initJitteredMats()
 
 Error Renderer::populateRenderGraph(RenderingContext& ctx)
 {
+	m_frameAlloc = ctx.m_tempAllocator;
+
 	ctx.m_matrices.m_cameraTransform = ctx.m_renderQueue->m_cameraTransform;
 	ctx.m_matrices.m_view = ctx.m_renderQueue->m_viewMatrix;
 	ctx.m_matrices.m_projection = ctx.m_renderQueue->m_projectionMatrix;
@@ -248,24 +248,6 @@ anki_internal:
 	static Vec3 unproject(
 		const Vec3& windowCoords, const Mat4& modelViewMat, const Mat4& projectionMat, const int view[4]);
 
-	/// Get the LOD given the distance of an object from the camera
-	U calculateLod(F32 distance) const
-	{
-		ANKI_ASSERT(m_lodDistances.getSize() == 2);
-		if(distance < m_lodDistances[0])
-		{
-			return 0;
-		}
-		else if(distance < m_lodDistances[1])
-		{
-			return 1;
-		}
-		else
-		{
-			return 2;
-		}
-	}
-
 	/// Create the init info for a 2D texture that will be used as a render target.
 	ANKI_USE_RESULT TextureInitInfo create2DRenderTargetInitInfo(
 		U32 w, U32 h, Format format, TextureUsageBit usage, CString name = {});
@@ -287,6 +269,12 @@ anki_internal:
 		return m_alloc;
 	}
 
+	/// The allocator of the current frame. Its memory is released when the next frame starts.
+	StackAllocator<U8> getFrameAllocator() const
+	{
+		return m_frameAlloc;
+	}
+
 	ResourceManager& getResourceManager()
 	{
 		return *m_resources;
@@ -369,6 +357,7 @@ private:
 	UiManager* m_ui = nullptr;
 	Timestamp* m_globTimestamp;
 	HeapAllocator<U8> m_alloc;
+	StackAllocator<U8> m_frameAlloc; ///< The RenderingContext::m_tempAllocator of the current frame.
 
 	/// @name Rendering stages
 	/// @{
@@ -399,8 +388,6 @@ private:
 	U32 m_width;
 	U32 m_height;
 
-	Array<F32, MAX_LOD_COUNT - 1> m_lodDistances; ///< Distance that used to calculate the LOD
-
 	RenderableDrawer m_sceneDrawer;
 
 	U64 m_frameCount; ///< Frame number
@@ -10,21 +10,55 @@
 #include <anki/core/Trace.h>
 #include <anki/misc/ConfigSet.h>
 #include <anki/util/ThreadHive.h>
+#include <algorithm>
 
 namespace anki
 {
 
-struct ShadowMapping::LightToRenderToScratchInfo
+struct ShadowMapping::LightToRenderInfo
 {
 	Array<U32, 4> m_viewport;
 	RenderQueue* m_renderQueue;
+	const RenderableQueueElement* m_renderables;
 	U32 m_drawcallCount;
 };
 
+/// The temporary work items of ShadowMapping::processLights.
+class ShadowMapping::ProcessLightsContext
+{
+public:
+	DynamicArrayAuto<LightToRenderInfo> m_staticLightsToRender;
+	DynamicArrayAuto<LightToRenderInfo> m_dynamicLightsToRender;
+	DynamicArrayAuto<Array<U32, 4>> m_staticClearViewports;
+	DynamicArrayAuto<CopyStaticLayerWorkItem> m_copyStaticLayerWorkItems;
+	DynamicArrayAuto<EsmResolveWorkItem> m_esmWorkItems;
+	U32 m_staticDrawcallCount = 0;
+	U32 m_dynamicDrawcallCount = 0;
+	U32 m_cachedStaticDrawcallCount = 0; ///< Static drawcalls that were skipped because the static layer is cached.
+
+	ProcessLightsContext(StackAllocator<U8> alloc)
+		: m_staticLightsToRender(alloc)
+		, m_dynamicLightsToRender(alloc)
+		, m_staticClearViewports(alloc)
+		, m_copyStaticLayerWorkItems(alloc)
+		, m_esmWorkItems(alloc)
+	{
+	}
+};
+
+template<typename T>
+static WeakArray<T> moveToWeakArray(DynamicArrayAuto<T>& arr)
+{
+	T* mem;
+	PtrSize size;
+	PtrSize storageSize;
+	arr.moveAndReset(mem, size, storageSize);
+	return WeakArray<T>(mem, size);
+}
+
 ShadowMapping::~ShadowMapping()
 {
-	m_tiles.destroy(getAllocator());
-	m_lightUuidToTileIdx.destroy(getAllocator());
+	m_dynamicLayerInfos.destroy(getAllocator());
 }
 
 Error ShadowMapping::init(const ConfigSet& config)
@@ -92,29 +126,23 @@ Error ShadowMapping::initEsm(const ConfigSet& cfg)
 
 	// Tiles
 	{
-		m_tiles.create(getAllocator(), m_tileCountPerRowOrColumn * m_tileCountPerRowOrColumn);
-
-		for(U y = 0; y < m_tileCountPerRowOrColumn; ++y)
+		// The point lights encode the tile indices with 5 bits
+		const U32 hierarchyCount = cfg.getNumber("r.shadowMapping.tileHierarchyCount");
+		if(hierarchyCount == 0 || (m_tileCountPerRowOrColumn << (hierarchyCount - 1)) > 32
+			|| (m_tileResolution >> (hierarchyCount - 1)) == 0)
 		{
-			for(U x = 0; x < m_tileCountPerRowOrColumn; ++x)
-			{
-				const U tileIdx = y * m_tileCountPerRowOrColumn + x;
-				Tile& tile = m_tiles[tileIdx];
-
-				tile.m_uv[0] = F32(x) / m_tileCountPerRowOrColumn;
-				tile.m_uv[1] = F32(y) / m_tileCountPerRowOrColumn;
-				tile.m_uv[2] = 1.0f / m_tileCountPerRowOrColumn;
-				tile.m_uv[3] = tile.m_uv[2];
-
-				tile.m_viewport[0] = x * m_tileResolution;
-				tile.m_viewport[1] = y * m_tileResolution;
-				tile.m_viewport[2] = m_tileResolution;
-				tile.m_viewport[3] = m_tileResolution;
-			}
+			ANKI_R_LOGE("Wrong r.shadowMapping.tileCountPerRowOrColumn or r.shadowMapping.tileHierarchyCount");
+			return Error::USER_DATA;
 		}
 
-		// The first tile is always pinned
-		m_tiles[0].m_pinned = true;
+		m_tileAlloc.init(getAllocator(),
+			m_tileCountPerRowOrColumn,
+			m_tileCountPerRowOrColumn,
+			hierarchyCount,
+			m_tileResolution);
+
+		// The first tile is always reserved. The point light faces that don't have renderables point to it
+		m_tileAlloc.reserveTile(0, 0);
 	}
 
 	// Programs and shaders
@@ -133,10 +161,50 @@ Error ShadowMapping::initEsm(const ConfigSet& cfg)
 	return Error::NONE;
 }
 
+Error ShadowMapping::initStatic(const ConfigSet& cfg)
+{
+	// RT and FB
+	{
+		TextureInitInfo texinit = m_r->create2DRenderTargetInitInfo(m_atlasResolution,
+			m_atlasResolution,
+			SHADOW_DEPTH_PIXEL_FORMAT,
+			TextureUsageBit::SAMPLED_FRAGMENT | TextureUsageBit::FRAMEBUFFER_ATTACHMENT_READ_WRITE,
+			"SM static");
+		texinit.m_initialUsage = TextureUsageBit::SAMPLED_FRAGMENT;
+		ClearValue clearVal;
+		clearVal.m_depthStencil.m_depth = 1.0f;
+		m_staticAtlas = m_r->createAndClearRenderTarget(texinit, clearVal);
+
+		m_staticFbDescr.m_depthStencilAttachment.m_loadOperation = AttachmentLoadOperation::LOAD;
+		m_staticFbDescr.m_depthStencilAttachment.m_aspect = DepthStencilAspectBit::DEPTH;
+		m_staticFbDescr.bake();
+	}
+
+	// Programs
+	{
+		ANKI_CHECK(getResourceManager().loadResource("shaders/ShadowmappingCopyDepth.glslp", m_copyDepthProg));
+
+		ShaderProgramResourceMutationInitList<1> mutations(m_copyDepthProg);
+		mutations.add("CLEAR", 0);
+
+		const ShaderProgramResourceVariant* variant;
+		m_copyDepthProg->getOrCreateVariant(mutations.get(), variant);
+		m_copyDepthGrProg = variant->getProgram();
+
+		ShaderProgramResourceMutationInitList<1> clearMutations(m_copyDepthProg);
+		clearMutations.add("CLEAR", 1);
+		m_copyDepthProg->getOrCreateVariant(clearMutations.get(), variant);
+		m_clearDepthGrProg = variant->getProgram();
+	}
+
+	return Error::NONE;
+}
+
 Error ShadowMapping::initInternal(const ConfigSet& cfg)
 {
 	ANKI_CHECK(initScratch(cfg));
 	ANKI_CHECK(initEsm(cfg));
+	ANKI_CHECK(initStatic(cfg));
 
 	return Error::NONE;
 }
@@ -174,13 +242,73 @@ void ShadowMapping::runEsm(RenderPassWorkContext& rgraphCtx)
 
 void ShadowMapping::runShadowMapping(RenderPassWorkContext& rgraphCtx)
 {
-	ANKI_ASSERT(m_scratchWorkItems.getSize());
 	ANKI_TRACE_SCOPED_EVENT(R_SM);
 
+	CommandBufferPtr& cmdb = rgraphCtx.m_commandBuffer;
+
+	// Copy the static layer before drawing the dynamic shadow casters on top of it. The 1st command buffer runs first
+	if(rgraphCtx.m_currentSecondLevelCommandBufferIndex == 0)
+	{
+		cmdb->bindShaderProgram(m_copyDepthGrProg);
+		rgraphCtx.bindTextureAndSampler(
+			0, 0, m_staticRt, TextureSubresourceInfo(DepthStencilAspectBit::DEPTH), m_r->getNearestSampler());
+		cmdb->setDepthCompareOperation(CompareOperation::ALWAYS);
+
+		for(const CopyStaticLayerWorkItem& workItem : m_copyStaticLayerWorkItems)
+		{
+			cmdb->setViewport(workItem.m_viewportOut[0],
+				workItem.m_viewportOut[1],
+				workItem.m_viewportOut[2],
+				workItem.m_viewportOut[3]);
+			cmdb->setScissor(workItem.m_viewportOut[0],
+				workItem.m_viewportOut[1],
+				workItem.m_viewportOut[2],
+				workItem.m_viewportOut[3]);
+
+			Vec4* unis = allocateAndBindUniforms<Vec4*>(sizeof(Vec4), cmdb, 0, 0);
+			unis[0] = workItem.m_uvIn;
+
+			drawQuad(cmdb);
+		}
+
+		cmdb->setDepthCompareOperation(CompareOperation::LESS);
+	}
+
+	renderWorkItems(m_scratchWorkItems, rgraphCtx);
+}
+
+void ShadowMapping::runStaticShadowMapping(RenderPassWorkContext& rgraphCtx)
+{
+	ANKI_TRACE_SCOPED_EVENT(R_SM);
+
+	CommandBufferPtr& cmdb = rgraphCtx.m_commandBuffer;
+
+	// Clear the tiles that will be rendered. The 1st command buffer runs first
+	if(rgraphCtx.m_currentSecondLevelCommandBufferIndex == 0)
+	{
+		cmdb->bindShaderProgram(m_clearDepthGrProg);
+		cmdb->setDepthCompareOperation(CompareOperation::ALWAYS);
+
+		for(const Array<U32, 4>& viewport : m_staticClearViewports)
+		{
+			cmdb->setViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+			cmdb->setScissor(viewport[0], viewport[1], viewport[2], viewport[3]);
+			drawQuad(cmdb);
+		}
+
+		cmdb->setDepthCompareOperation(CompareOperation::LESS);
+	}
+
+	renderWorkItems(m_staticWorkItems, rgraphCtx);
+}
+
+void ShadowMapping::renderWorkItems(
+	const WeakArray<RenderShadowsWorkItem>& workItems, RenderPassWorkContext& rgraphCtx) const
+{
 	CommandBufferPtr& cmdb = rgraphCtx.m_commandBuffer;
 	const U threadIdx = rgraphCtx.m_currentSecondLevelCommandBufferIndex;
 
-	for(ScratchBufferWorkItem& work : m_scratchWorkItems)
+	for(const RenderShadowsWorkItem& work : workItems)
 	{
 		if(work.m_threadPoolTaskIdx != threadIdx)
 		{
@@ -196,9 +324,8 @@ void ShadowMapping::runShadowMapping(RenderPassWorkContext& rgraphCtx)
 			work.m_renderQueue->m_viewProjectionMatrix,
 			Mat4::getIdentity(), // Don't care about prev matrices here
 			cmdb,
-			work.m_renderQueue->m_renderables.getBegin() + work.m_firstRenderableElement,
-			work.m_renderQueue->m_renderables.getBegin() + work.m_firstRenderableElement
-				+ work.m_renderableElementCount);
+			work.m_renderables + work.m_firstRenderableElement,
+			work.m_renderables + work.m_firstRenderableElement + work.m_renderableElementCount);
 	}
 }
 
@@ -207,31 +334,44 @@ void ShadowMapping::populateRenderGraph(RenderingContext& ctx)
 	ANKI_TRACE_SCOPED_EVENT(R_SM);
 
 	// First process the lights
-	U32 threadCountForScratchPass = 0;
-	processLights(ctx, threadCountForScratchPass);
+	processLights(ctx);
 
 	// Build the render graph
 	RenderGraphDescription& rgraph = ctx.m_renderGraphDescr;
-	if(m_scratchWorkItems.getSize())
+	if(m_esmResolveWorkItems.getSize())
 	{
 		// Will have to create render passes
 
+		m_staticRt = rgraph.importRenderTarget(m_staticAtlas, TextureUsageBit::SAMPLED_FRAGMENT);
+		const TextureSubresourceInfo depthSubresource = TextureSubresourceInfo(DepthStencilAspectBit::DEPTH);
+
+		// Static pass
+		if(m_staticClearViewports.getSize())
+		{
+			GraphicsRenderPassDescription& pass = rgraph.newGraphicsRenderPass("SM static");
+
+			pass.setFramebufferInfo(m_staticFbDescr, {}, m_staticRt);
+			ANKI_ASSERT(m_staticThreadCount && m_staticThreadCount <= m_r->getThreadHive().getThreadCount());
+			pass.setWork(runStaticShadowMappingCallback, this, m_staticThreadCount);
+
+			pass.newDependency({m_staticRt, TextureUsageBit::FRAMEBUFFER_ATTACHMENT_READ_WRITE, depthSubresource});
+		}
+
 		// Scratch pass
 		{
 			// Compute render area
 			const U32 minx = 0, miny = 0, height = m_scratchTileResolution;
-			const U32 width = m_scratchTileResolution * m_scratchWorkItems.getSize();
+			const U32 width = m_scratchTileResolution * (m_scratchTileCount - m_freeScratchTiles);
 
 			GraphicsRenderPassDescription& pass = rgraph.newGraphicsRenderPass("SM scratch");
 
 			m_scratchRt = rgraph.newRenderTarget(m_scratchRtDescr);
 			pass.setFramebufferInfo(m_scratchFbDescr, {}, m_scratchRt, minx, miny, width, height);
-			ANKI_ASSERT(
-				threadCountForScratchPass && threadCountForScratchPass <= m_r->getThreadHive().getThreadCount());
-			pass.setWork(runShadowmappingCallback, this, threadCountForScratchPass);
+			ANKI_ASSERT(m_scratchThreadCount && m_scratchThreadCount <= m_r->getThreadHive().getThreadCount());
+			pass.setWork(runShadowmappingCallback, this, m_scratchThreadCount);
 
-			TextureSubresourceInfo subresource = TextureSubresourceInfo(DepthStencilAspectBit::DEPTH);
-			pass.newDependency({m_scratchRt, TextureUsageBit::FRAMEBUFFER_ATTACHMENT_READ_WRITE, subresource});
+			pass.newDependency({m_scratchRt, TextureUsageBit::FRAMEBUFFER_ATTACHMENT_READ_WRITE, depthSubresource});
+			pass.newDependency({m_staticRt, TextureUsageBit::SAMPLED_FRAGMENT, depthSubresource});
 		}
 
 		// ESM pass
@@ -242,8 +382,7 @@ void ShadowMapping::populateRenderGraph(RenderingContext& ctx)
 			pass.setFramebufferInfo(m_esmFbDescr, {{m_esmRt}}, {});
 			pass.setWork(runEsmCallback, this, 0);
 
-			pass.newDependency(
-				{m_scratchRt, TextureUsageBit::SAMPLED_FRAGMENT, TextureSubresourceInfo(DepthStencilAspectBit::DEPTH)});
+			pass.newDependency({m_scratchRt, TextureUsageBit::SAMPLED_FRAGMENT, depthSubresource});
 			pass.newDependency({m_esmRt, TextureUsageBit::FRAMEBUFFER_ATTACHMENT_WRITE});
 		}
 	}
@@ -254,16 +393,19 @@ void ShadowMapping::populateRenderGraph(RenderingContext& ctx)
 	}
 }
 
-Mat4 ShadowMapping::createSpotLightTextureMatrix(const Tile& tile)
+Mat4 ShadowMapping::createSpotLightTextureMatrix(const Array<U32, 4>& atlasViewport) const
 {
-	return Mat4(tile.m_uv[2],
+	const Vec4 uv = Vec4(F32(atlasViewport[0]), F32(atlasViewport[1]), F32(atlasViewport[2]), F32(atlasViewport[3]))
+					/ F32(m_atlasResolution);
+
+	return Mat4(uv[2],
 		0.0,
 		0.0,
-		tile.m_uv[0],
+		uv[0],
 		0.0,
-		tile.m_uv[3],
+		uv[3],
 		0.0,
-		tile.m_uv[1],
+		uv[1],
 		0.0,
 		0.0,
 		1.0,
@@ -274,291 +416,407 @@ Mat4 ShadowMapping::createSpotLightTextureMatrix(const Tile& tile)
 		1.0);
 }
 
-void ShadowMapping::processLights(RenderingContext& ctx, U32& threadCountForScratchPass)
+void ShadowMapping::processLights(RenderingContext& ctx)
 {
 	// Reset stuff
 	m_freeScratchTiles = m_scratchTileCount;
 
 	// Vars
-	DynamicArrayAuto<LightToRenderToScratchInfo> lightsToRender(ctx.m_tempAllocator);
-	U32 drawcallCount = 0;
-	DynamicArrayAuto<EsmResolveWorkItem> esmWorkItems(ctx.m_tempAllocator);
+	ProcessLightsContext plCtx(ctx.m_tempAllocator);
 
-	// Process the point lights first.
-	for(PointLightQueueElement* light : ctx.m_renderQueue->m_shadowPointLights)
+	// Gather the lights and sort them by importance. The important lights allocate tiles first and they get the
+	// higher resolutions
+	class LightToProcess
 	{
-		// Prepare data to allocate tiles and allocate
-		Array<U32, 6> tiles;
-		Array<U32, 6> scratchTiles;
-		Array<U64, 6> timestamps;
-		Array<U32, 6> faceIndices;
-		Array<U32, 6> drawcallCounts;
-		U numOfFacesThatHaveDrawcalls = 0;
-		for(U face = 0; face < 6; ++face)
-		{
-			ANKI_ASSERT(light->m_shadowRenderQueues[face]);
-			if(light->m_shadowRenderQueues[face]->m_renderables.getSize())
-			{
-				// Has renderables, need to allocate tiles for it so add it to the arrays
+	public:
+		PointLightQueueElement* m_pointLight;
+		SpotLightQueueElement* m_spotLight;
+		F32 m_importance;
+		U32 m_hierarchy;
+	};
 
-				faceIndices[numOfFacesThatHaveDrawcalls] = face;
-				timestamps[numOfFacesThatHaveDrawcalls] =
-					light->m_shadowRenderQueues[face]->m_shadowRenderablesLastUpdateTimestamp;
+	DynamicArrayAuto<LightToProcess> lightsToProcess(ctx.m_tempAllocator);
+	const Vec3 cameraPos = ctx.m_renderQueue->m_cameraTransform.getTranslationPart().xyz();
 
-				drawcallCounts[numOfFacesThatHaveDrawcalls] =
-					light->m_shadowRenderQueues[face]->m_renderables.getSize();
+	for(PointLightQueueElement* light : ctx.m_renderQueue->m_shadowPointLights)
+	{
+		LightToProcess l;
+		l.m_pointLight = light;
+		l.m_spotLight = nullptr;
+		l.m_hierarchy = chooseTileHierarchy(cameraPos, light->m_worldPosition, light->m_radius, l.m_importance);
+		lightsToProcess.emplaceBack(l);
+	}
 
-				++numOfFacesThatHaveDrawcalls;
-			}
-		}
-		const Bool allocationFailed = numOfFacesThatHaveDrawcalls == 0
-									  || allocateTilesAndScratchTiles(light->m_uuid,
-											 numOfFacesThatHaveDrawcalls,
-											 &timestamps[0],
-											 &faceIndices[0],
-											 &drawcallCounts[0],
-											 &tiles[0],
-											 &scratchTiles[0]);
-
-		if(!allocationFailed)
-		{
-			// All good, update the lights
+	for(SpotLightQueueElement* light : ctx.m_renderQueue->m_shadowSpotLights)
+	{
+		LightToProcess l;
+		l.m_pointLight = nullptr;
+		l.m_spotLight = light;
+		l.m_hierarchy = chooseTileHierarchy(
+			cameraPos, light->m_worldTransform.getTranslationPart().xyz(), light->m_distance, l.m_importance);
+		lightsToProcess.emplaceBack(l);
+	}
 
-			light->m_atlasTiles = UVec2(0u);
-			light->m_atlasTileSize = 1.0f / m_tileCountPerRowOrColumn;
+	std::sort(lightsToProcess.getBegin(),
+		lightsToProcess.getEnd(),
+		[](const LightToProcess& a, const LightToProcess& b) { return a.m_importance > b.m_importance; });
 
-			numOfFacesThatHaveDrawcalls = 0;
-			for(U face = 0; face < 6; ++face)
-			{
-				if(light->m_shadowRenderQueues[face]->m_renderables.getSize())
-				{
-					// Has drawcalls, asigned it to a tile
-
-					const U32 tileIdx = tiles[numOfFacesThatHaveDrawcalls];
-					const U32 tileIdxX = tileIdx % m_tileCountPerRowOrColumn;
-					const U32 tileIdxY = tileIdx / m_tileCountPerRowOrColumn;
-					ANKI_ASSERT(tileIdxX <= 31u && tileIdxY <= 31u);
-					light->m_atlasTiles.x() |= tileIdxX << (5u * face);
-					light->m_atlasTiles.y() |= tileIdxY << (5u * face);
-
-					if(scratchTiles[numOfFacesThatHaveDrawcalls] != MAX_U32)
-					{
-						newScratchAndEsmResloveRenderWorkItems(tiles[numOfFacesThatHaveDrawcalls],
-							scratchTiles[numOfFacesThatHaveDrawcalls],
-							light->m_shadowRenderQueues[face],
-							lightsToRender,
-							esmWorkItems,
-							drawcallCount);
-					}
-
-					++numOfFacesThatHaveDrawcalls;
-				}
-				else
-				{
-					// Doesn't have renderables, point the face to the 1st tile (that is pinned)
-					light->m_atlasTiles.x() |= 0u << (5u * face);
-					light->m_atlasTiles.y() |= 0u << (5u * face);
-				}
-			}
+	// Allocate tiles and create the work items
+	for(const LightToProcess& l : lightsToProcess)
+	{
+		if(l.m_pointLight)
+		{
+			processPointLight(*l.m_pointLight, l.m_hierarchy, plCtx);
 		}
 		else
 		{
-			// Light can't be a caster this frame
-			memset(&light->m_shadowRenderQueues[0], 0, sizeof(light->m_shadowRenderQueues));
+			processSpotLight(*l.m_spotLight, l.m_hierarchy, plCtx);
 		}
 	}
 
-	// Process the spot lights
-	for(SpotLightQueueElement* light : ctx.m_renderQueue->m_shadowSpotLights)
+	ANKI_TRACE_INC_COUNTER(R_SHADOW_STATIC_DRAWCALLS, plCtx.m_staticDrawcallCount);
+	ANKI_TRACE_INC_COUNTER(R_SHADOW_DYNAMIC_DRAWCALLS, plCtx.m_dynamicDrawcallCount);
+	ANKI_TRACE_INC_COUNTER(R_SHADOW_CACHED_STATIC_DRAWCALLS, plCtx.m_cachedStaticDrawcallCount);
+
+	// Split the work that will happen in the static atlas and the scratch buffer
+	splitRenderWork(ctx.m_tempAllocator,
+		ConstWeakArray<LightToRenderInfo>(
+			plCtx.m_staticLightsToRender.getBegin(), plCtx.m_staticLightsToRender.getSize()),
+		plCtx.m_staticDrawcallCount,
+		m_staticWorkItems,
+		m_staticThreadCount);
+
+	splitRenderWork(ctx.m_tempAllocator,
+		ConstWeakArray<LightToRenderInfo>(
+			plCtx.m_dynamicLightsToRender.getBegin(), plCtx.m_dynamicLightsToRender.getSize()),
+		plCtx.m_dynamicDrawcallCount,
+		m_scratchWorkItems,
+		m_scratchThreadCount);
+
+	// Store the rest of the work items for the passes to pick up
+	m_staticClearViewports = moveToWeakArray(plCtx.m_staticClearViewports);
+	m_copyStaticLayerWorkItems = moveToWeakArray(plCtx.m_copyStaticLayerWorkItems);
+	m_esmResolveWorkItems = moveToWeakArray(plCtx.m_esmWorkItems);
+	ANKI_ASSERT(m_copyStaticLayerWorkItems.getSize() == m_esmResolveWorkItems.getSize());
+}
+
+void ShadowMapping::splitRenderWork(StackAllocator<U8> alloc,
+	ConstWeakArray<LightToRenderInfo> lightsToRender,
+	U32 drawcallCount,
+	WeakArray<RenderShadowsWorkItem>& outWorkItems,
+	U32& threadCount) const
+{
+	if(drawcallCount == 0)
 	{
-		ANKI_ASSERT(light->m_shadowRenderQueue);
-
-		// Allocate tiles
-		U32 tileIdx, scratchTileIdx, faceIdx = 0;
-		const U32 localDrawcallCount = light->m_shadowRenderQueue->m_renderables.getSize();
-		const Bool allocationFailed = localDrawcallCount == 0
-									  || allocateTilesAndScratchTiles(light->m_uuid,
-											 1,
-											 &light->m_shadowRenderQueue->m_shadowRenderablesLastUpdateTimestamp,
-											 &faceIdx,
-											 &localDrawcallCount,
-											 &tileIdx,
-											 &scratchTileIdx);
-
-		if(!allocationFailed)
-		{
-			// All good, update the light
+		// Nothing to draw but the pass might need to do other things
+		outWorkItems = WeakArray<RenderShadowsWorkItem>();
+		threadCount = 1;
+		return;
+	}
+
+	DynamicArrayAuto<RenderShadowsWorkItem> workItems(alloc);
+	const LightToRenderInfo* lightToRender = lightsToRender.getBegin();
+	U lightToRenderDrawcallCount = lightToRender->m_drawcallCount;
+	const LightToRenderInfo* lightToRenderEnd = lightsToRender.getEnd();
+
+	threadCount = computeNumberOfSecondLevelCommandBuffers(drawcallCount);
+	for(U taskId = 0; taskId < threadCount; ++taskId)
+	{
+		PtrSize start, end;
+		splitThreadedProblem(taskId, threadCount, drawcallCount, start, end);
 
-			// Update the texture matrix to point to the correct region in the atlas
-			light->m_textureMatrix = createSpotLightTextureMatrix(m_tiles[tileIdx]) * light->m_textureMatrix;
+		// While there are drawcalls in this task emit new work items
+		U taskDrawcallCount = end - start;
+		ANKI_ASSERT(taskDrawcallCount > 0 && "Because we used computeNumberOfSecondLevelCommandBuffers()");
 
-			if(scratchTileIdx != MAX_U32)
+		while(taskDrawcallCount)
+		{
+			ANKI_ASSERT(lightToRender != lightToRenderEnd);
+			const U workItemDrawcallCount = min(lightToRenderDrawcallCount, taskDrawcallCount);
+
+			RenderShadowsWorkItem workItem;
+			workItem.m_viewport = lightToRender->m_viewport;
+			workItem.m_renderQueue = lightToRender->m_renderQueue;
+			workItem.m_renderables = lightToRender->m_renderables;
+			workItem.m_firstRenderableElement = lightToRender->m_drawcallCount - lightToRenderDrawcallCount;
+			workItem.m_renderableElementCount = workItemDrawcallCount;
+			workItem.m_threadPoolTaskIdx = taskId;
+			workItems.emplaceBack(workItem);
+
+			// Decrease the drawcall counts for the task and the light
+			ANKI_ASSERT(taskDrawcallCount >= workItemDrawcallCount);
+			taskDrawcallCount -= workItemDrawcallCount;
+			ANKI_ASSERT(lightToRenderDrawcallCount >= workItemDrawcallCount);
+			lightToRenderDrawcallCount -= workItemDrawcallCount;
+
+			// Move to the next light
+			if(lightToRenderDrawcallCount == 0)
 			{
-				newScratchAndEsmResloveRenderWorkItems(
-					tileIdx, scratchTileIdx, light->m_shadowRenderQueue, lightsToRender, esmWorkItems, drawcallCount);
+				++lightToRender;
+				lightToRenderDrawcallCount = (lightToRender != lightToRenderEnd) ? lightToRender->m_drawcallCount : 0;
 			}
 		}
-		else
-		{
-			// Doesn't have renderables or the allocation failed, won't be a shadow caster
-			light->m_shadowRenderQueue = nullptr;
-		}
 	}
 
-	// Split the work that will happen in the scratch buffer
-	if(lightsToRender.getSize())
+	ANKI_ASSERT(lightToRender == lightToRenderEnd);
+	ANKI_ASSERT(lightsToRender.getSize() <= workItems.getSize());
+
+	// All good, store the work items for the threads to pick up
+	outWorkItems = moveToWeakArray(workItems);
+}
+
+U32 ShadowMapping::chooseTileHierarchy(
+	const Vec3& cameraPos, const Vec3& lightPos, F32 lightRadius, F32& importance) const
+{
+	// The importance is roughly the size of the light's volume on the screen
+	const F32 dist = (lightPos - cameraPos).getLength();
+	importance = (dist <= lightRadius) ? 1.0f : (lightRadius / dist);
+
+	// Halve the resolution every time the size halves
+	U32 hierarchy = 0;
+	F32 threshold = 0.5f;
+	while(hierarchy + 1 < m_tileAlloc.getHierarchyCount() && importance < threshold)
 	{
-		DynamicArrayAuto<ScratchBufferWorkItem> workItems(ctx.m_tempAllocator);
-		LightToRenderToScratchInfo* lightToRender = lightsToRender.getBegin();
-		U lightToRenderDrawcallCount = lightToRender->m_drawcallCount;
-		const LightToRenderToScratchInfo* lightToRenderEnd = lightsToRender.getEnd();
+		++hierarchy;
+		threshold *= 0.5f;
+	}
 
-		const U threadCount = computeNumberOfSecondLevelCommandBuffers(drawcallCount);
-		threadCountForScratchPass = threadCount;
-		for(U taskId = 0; taskId < threadCount; ++taskId)
+	return hierarchy;
+}
+
+void ShadowMapping::processPointLight(PointLightQueueElement& light, U32 hierarchy, ProcessLightsContext& ctx)
+{
+	// Prepare data to allocate tiles and allocate
+	Array<LightFace, 6> faces;
+	U numOfFacesThatHaveDrawcalls = 0;
+	for(U face = 0; face < 6; ++face)
+	{
+		RenderQueue* queue = light.m_shadowRenderQueues[face];
+		ANKI_ASSERT(queue);
+		if(queue->m_renderables.getSize() || queue->m_dynamicShadowRenderables.getSize())
 		{
-			PtrSize start, end;
-			splitThreadedProblem(taskId, threadCount, drawcallCount, start, end);
+			// Has renderables, need to allocate tiles for it so add it to the arrays
+			faces[numOfFacesThatHaveDrawcalls].m_renderQueue = queue;
+			faces[numOfFacesThatHaveDrawcalls].m_face = face;
+			++numOfFacesThatHaveDrawcalls;
+		}
+	}
 
-			// While there are drawcalls in this task emit new work items
-			U taskDrawcallCount = end - start;
-			ANKI_ASSERT(taskDrawcallCount > 0 && "Because we used computeNumberOfSecondLevelCommandBuffers()");
+	const Bool allocationFailed =
+		numOfFacesThatHaveDrawcalls == 0
+		|| allocateTilesAndScratchTiles(
+			   light.m_uuid, WeakArray<LightFace>(&faces[0], numOfFacesThatHaveDrawcalls), hierarchy);
 
-			while(taskDrawcallCount)
-			{
-				ANKI_ASSERT(lightToRender != lightToRenderEnd);
-				const U workItemDrawcallCount = min(lightToRenderDrawcallCount, taskDrawcallCount);
-
-				ScratchBufferWorkItem workItem;
-				workItem.m_viewport = lightToRender->m_viewport;
-				workItem.m_renderQueue = lightToRender->m_renderQueue;
-				workItem.m_firstRenderableElement = lightToRender->m_drawcallCount - lightToRenderDrawcallCount;
-				workItem.m_renderableElementCount = workItemDrawcallCount;
-				workItem.m_threadPoolTaskIdx = taskId;
-				workItems.emplaceBack(workItem);
-
-				// Decrease the drawcall counts for the task and the light
-				ANKI_ASSERT(taskDrawcallCount >= workItemDrawcallCount);
-				taskDrawcallCount -= workItemDrawcallCount;
-				ANKI_ASSERT(lightToRenderDrawcallCount >= workItemDrawcallCount);
-				lightToRenderDrawcallCount -= workItemDrawcallCount;
-
-				// Move to the next light
-				if(lightToRenderDrawcallCount == 0)
-				{
-					++lightToRender;
-					lightToRenderDrawcallCount =
-						(lightToRender != lightToRenderEnd) ? lightToRender->m_drawcallCount : 0;
-				}
-			}
-		}
+	if(!allocationFailed)
+	{
+		// All good, update the light. All the faces have the same tile size so the shaders can find the tiles using
+		// their indices
 
-		ANKI_ASSERT(lightToRender == lightToRenderEnd);
-		ANKI_ASSERT(lightsToRender.getSize() <= workItems.getSize());
+		const U32 tileResolution = m_tileAlloc.getTileResolution(hierarchy);
+		light.m_atlasTiles = UVec2(0u);
+		light.m_atlasTileSize = F32(tileResolution) / F32(m_atlasResolution);
 
-		// All good, store the work items for the threads to pick up
+		// The faces that don't have renderables point to the 1st tile (that is reserved)
+		for(U i = 0; i < numOfFacesThatHaveDrawcalls; ++i)
 		{
-			ScratchBufferWorkItem* items;
-			PtrSize itemSize;
-			PtrSize itemStorageSize;
-			workItems.moveAndReset(items, itemSize, itemStorageSize);
-
-			ANKI_ASSERT(items && itemSize && itemStorageSize);
-			m_scratchWorkItems = WeakArray<ScratchBufferWorkItem>(items, itemSize);
-
-			EsmResolveWorkItem* esmItems;
-			esmWorkItems.moveAndReset(esmItems, itemSize, itemStorageSize);
-			ANKI_ASSERT(esmItems && itemSize && itemStorageSize);
-			m_esmResolveWorkItems = WeakArray<EsmResolveWorkItem>(esmItems, itemSize);
+			const LightFace& face = faces[i];
+			const U32 tileIdxX = face.m_atlasViewport[0] / tileResolution;
+			const U32 tileIdxY = face.m_atlasViewport[1] / tileResolution;
+			ANKI_ASSERT(tileIdxX <= 31u && tileIdxY <= 31u);
+			light.m_atlasTiles.x() |= tileIdxX << (5u * face.m_face);
+			light.m_atlasTiles.y() |= tileIdxY << (5u * face.m_face);
+
+			newRenderWorkItems(face, ctx);
 		}
 	}
 	else
 	{
-		m_scratchWorkItems = WeakArray<ScratchBufferWorkItem>();
-		m_esmResolveWorkItems = WeakArray<EsmResolveWorkItem>();
+		// Light can't be a caster this frame
+		memset(&light.m_shadowRenderQueues[0], 0, sizeof(light.m_shadowRenderQueues));
 	}
 }
 
-void ShadowMapping::newScratchAndEsmResloveRenderWorkItems(U32 tileIdx,
-	U32 scratchTileIdx,
-	RenderQueue* lightRenderQueue,
-	DynamicArrayAuto<LightToRenderToScratchInfo>& scratchWorkItem,
-	DynamicArrayAuto<EsmResolveWorkItem>& esmResolveWorkItem,
-	U32& drawcallCount) const
+void ShadowMapping::processSpotLight(SpotLightQueueElement& light, U32 hierarchy, ProcessLightsContext& ctx)
 {
-	// Scratch work item
+	ANKI_ASSERT(light.m_shadowRenderQueue);
+
+	// Allocate tiles
+	LightFace face;
+	face.m_renderQueue = light.m_shadowRenderQueue;
+	face.m_face = 0;
+	const Bool hasDrawcalls =
+		face.m_renderQueue->m_renderables.getSize() || face.m_renderQueue->m_dynamicShadowRenderables.getSize();
+	const Bool allocationFailed =
+		!hasDrawcalls || allocateTilesAndScratchTiles(light.m_uuid, WeakArray<LightFace>(&face, 1), hierarchy);
+
+	if(!allocationFailed)
+	{
+		// All good, update the light
+
+		// Update the texture matrix to point to the correct region in the atlas
+		light.m_textureMatrix = createSpotLightTextureMatrix(face.m_atlasViewport) * light.m_textureMatrix;
+
+		newRenderWorkItems(face, ctx);
+	}
+	else
 	{
-		Array<U32, 4> viewport;
-		viewport[0] = scratchTileIdx * m_scratchTileResolution;
-		viewport[1] = 0;
-		viewport[2] = m_scratchTileResolution;
-		viewport[3] = m_scratchTileResolution;
+		// Doesn't have renderables or the allocation failed, won't be a shadow caster
+		light.m_shadowRenderQueue = nullptr;
+	}
+}
 
-		LightToRenderToScratchInfo toRender = {
-			viewport, lightRenderQueue, U32(lightRenderQueue->m_renderables.getSize())};
-		scratchWorkItem.emplaceBack(toRender);
-		drawcallCount += lightRenderQueue->m_renderables.getSize();
+void ShadowMapping::newRenderWorkItems(const LightFace& face, ProcessLightsContext& ctx) const
+{
+	RenderQueue& queue = *face.m_renderQueue;
+	const U32 staticDrawcallCount = queue.m_renderables.getSize();
+	const U32 dynamicDrawcallCount = queue.m_dynamicShadowRenderables.getSize();
+
+	// Render the static layer in the static atlas
+	if(face.m_renderStaticLayer)
+	{
+		ANKI_ASSERT(face.m_scratchTileIdx != MAX_U32);
+		ctx.m_staticClearViewports.emplaceBack(face.m_atlasViewport);
+
+		if(staticDrawcallCount)
+		{
+			LightToRenderInfo toRender = {
+				face.m_atlasViewport, &queue, queue.m_renderables.getBegin(), staticDrawcallCount};
+			ctx.m_staticLightsToRender.emplaceBack(toRender);
+			ctx.m_staticDrawcallCount += staticDrawcallCount;
+		}
+	}
+	else if(face.m_scratchTileIdx != MAX_U32)
+	{
+		ctx.m_cachedStaticDrawcallCount += staticDrawcallCount;
+	}
+
+	if(face.m_scratchTileIdx == MAX_U32)
+	{
+		// The ESM tile is up to date
+		return;
+	}
+
+	// Render to a part of the scratch tile if the atlas tile is smaller
+	const U32 tileResolution = face.m_atlasViewport[2];
+	ANKI_ASSERT(tileResolution <= m_scratchTileResolution);
+
+	Array<U32, 4> scratchViewport;
+	scratchViewport[0] = face.m_scratchTileIdx * m_scratchTileResolution;
+	scratchViewport[1] = 0;
+	scratchViewport[2] = tileResolution;
+	scratchViewport[3] = tileResolution;
+
+	// Copy the static layer to the scratch buffer
+	{
+		CopyStaticLayerWorkItem copyItem;
+		copyItem.m_uvIn = Vec4(F32(face.m_atlasViewport[0]),
+							  F32(face.m_atlasViewport[1]),
+							  F32(face.m_atlasViewport[2]),
+							  F32(face.m_atlasViewport[3]))
+						  / F32(m_atlasResolution);
+		copyItem.m_viewportOut = scratchViewport;
+
+		ctx.m_copyStaticLayerWorkItems.emplaceBack(copyItem);
+	}
+
+	// Draw the dynamic shadow casters on top of the static layer
+	if(dynamicDrawcallCount)
+	{
+		LightToRenderInfo toRender = {
+			scratchViewport, &queue, queue.m_dynamicShadowRenderables.getBegin(), dynamicDrawcallCount};
+		ctx.m_dynamicLightsToRender.emplaceBack(toRender);
+		ctx.m_dynamicDrawcallCount += dynamicDrawcallCount;
 	}
 
 	// ESM resolve work item
 	{
 		EsmResolveWorkItem esmItem;
-		esmItem.m_uvIn[0] = F32(scratchTileIdx) / m_scratchTileCount;
+		esmItem.m_uvIn[0] = F32(face.m_scratchTileIdx) / m_scratchTileCount;
 		esmItem.m_uvIn[1] = 0.0f;
-		esmItem.m_uvIn[2] = 1.0f / m_scratchTileCount;
-		esmItem.m_uvIn[3] = 1.0f;
+		esmItem.m_uvIn[2] = F32(tileResolution) / F32(m_scratchTileResolution * m_scratchTileCount);
+		esmItem.m_uvIn[3] = F32(tileResolution) / F32(m_scratchTileResolution);
+
+		esmItem.m_viewportOut = face.m_atlasViewport;
 
-		esmItem.m_viewportOut = m_tiles[tileIdx].m_viewport;
+		esmItem.m_cameraFar = queue.m_cameraFar;
+		esmItem.m_cameraNear = queue.m_cameraNear;
+
+		ctx.m_esmWorkItems.emplaceBack(esmItem);
+	}
+}
 
-		esmItem.m_cameraFar = lightRenderQueue->m_cameraFar;
-		esmItem.m_cameraNear = lightRenderQueue->m_cameraNear;
+Bool ShadowMapping::allocateTilesAndScratchTiles(U64 lightUuid, WeakArray<LightFace> faces, U32& hierarchy)
+{
+	// Start from the preferred resolution and go lower if the atlas is full
+	Bool failed = true;
+	Bool atlasFull = true;
+	for(; hierarchy < m_tileAlloc.getHierarchyCount() && atlasFull; ++hierarchy)
+	{
+		failed = tryAllocateTilesAndScratchTiles(lightUuid, faces, hierarchy, atlasFull);
+
+		if(!failed)
+		{
+			break;
+		}
+	}
 
-		esmResolveWorkItem.emplaceBack(esmItem);
+	if(failed && atlasFull)
+	{
+		ANKI_R_LOGW("There is not enough space in the shadow atlas for more shadow maps. "
+					"Increase the r.shadowMapping.tileCountPerRowOrColumn or decrease the scene's shadow casters");
 	}
+
+	return failed;
 }
 
-Bool ShadowMapping::allocateTilesAndScratchTiles(U64 lightUuid,
-	U32 faceCount,
-	const U64* faceTimestamps,
-	const U32* faceIndices,
-	const U32* drawcallsCount,
-	U32* tileIndices,
-	U32* scratchTileIndices)
+Bool ShadowMapping::tryAllocateTilesAndScratchTiles(
+	U64 lightUuid, WeakArray<LightFace> faces, U32 hierarchy, Bool& atlasFull)
 {
-	ANKI_ASSERT(faceTimestamps);
 	ANKI_ASSERT(lightUuid > 0);
-	ANKI_ASSERT(faceCount > 0 && faceCount <= 6);
-	ANKI_ASSERT(faceIndices && tileIndices && scratchTileIndices && drawcallsCount);
+	ANKI_ASSERT(faces.getSize() > 0 && faces.getSize() <= 6);
 
 	Bool failed = false;
-	Array<Bool, 6> inTheCache;
+	atlasFull = false;
+	U32 facesAllocated = 0;
+	const Timestamp crntTimestamp = m_r->getGlobalTimestamp();
 
-	// Allocate ESM tiles
+	// Allocate ESM tiles. The cache of the tile allocator tracks the static layer. The ESM tile is cached if the static
+	// layer is cached and the dynamic shadow casters didn't change
+	for(U i = 0; i < faces.getSize() && !failed; ++i)
 	{
-		memset(tileIndices, 0xFF, sizeof(*tileIndices) * faceCount);
-		for(U i = 0; i < faceCount && !failed; ++i)
+		LightFace& face = faces[i];
+		const RenderQueue& queue = *face.m_renderQueue;
+
+		const TileAllocatorResult result = m_tileAlloc.allocate(crntTimestamp,
+			queue.m_staticShadowRenderablesLastUpdateTimestamp,
+			lightUuid,
+			face.m_face,
+			queue.m_staticShadowRenderablesHash,
+			hierarchy,
+			face.m_atlasViewport);
+
+		if(result == TileAllocatorResult::ALLOCATION_FAILED)
 		{
-			failed = allocateTile(faceTimestamps[i], lightUuid, faceIndices[i], tileIndices[i], inTheCache[i]);
+			failed = true;
+			atlasFull = true;
 		}
-
-		// Unpin the tiles
-		for(U i = 0; i < faceCount; ++i)
+		else
 		{
-			if(tileIndices[i] != MAX_U32)
-			{
-				m_tiles[tileIndices[i]].m_pinned = false;
-			}
+			face.m_renderStaticLayer = result != TileAllocatorResult::CACHED;
+			++facesAllocated;
 		}
 	}
 
 	// Allocate scratch tiles
+	if(!failed)
 	{
 		U32 freeScratchTiles = m_freeScratchTiles;
-		for(U i = 0; i < faceCount && !failed; ++i)
+		for(U i = 0; i < faces.getSize() && !failed; ++i)
 		{
-			scratchTileIndices[i] = MAX_U32;
-			const Bool shouldRender = shouldRenderTile(
-				faceTimestamps[i], lightUuid, faceIndices[i], m_tiles[tileIndices[i]], drawcallsCount[i]);
+			LightFace& face = faces[i];
+			face.m_scratchTileIdx = MAX_U32;
+			const Bool shouldRender =
+				face.m_renderStaticLayer || !dynamicLayerCached(lightUuid, face.m_face, *face.m_renderQueue);
 			const Bool scratchTileFailed = shouldRender && freeScratchTiles == 0;
 
 			if(scratchTileFailed)
@@ -570,7 +828,7 @@ Bool ShadowMapping::allocateTilesAndScratchTiles(U64 lightUuid,
 			else if(shouldRender)
 			{
 				ANKI_ASSERT(m_scratchTileCount >= freeScratchTiles);
-				scratchTileIndices[i] = m_scratchTileCount - freeScratchTiles;
+				face.m_scratchTileIdx = m_scratchTileCount - freeScratchTiles;
 				--freeScratchTiles;
 			}
 		}
@@ -581,121 +839,45 @@ Bool ShadowMapping::allocateTilesAndScratchTiles(U64 lightUuid,
 		}
 	}
 
-	// Update the tiles if everything was successful
-	if(!failed)
+	if(failed)
 	{
-		for(U i = 0; i < faceCount; ++i)
+		// Something failed, give back the tiles. Their contents won't be rendered this frame
+		for(U i = 0; i < facesAllocated; ++i)
 		{
-			Tile& tile = m_tiles[tileIndices[i]];
-			tile.m_face = faceIndices[i];
-			tile.m_lightUuid = lightUuid;
-			tile.m_lastUsedTimestamp = m_r->getGlobalTimestamp();
-			tile.m_drawcallCount = drawcallsCount[i];
-
-			// Update the cache
-			if(!inTheCache[i])
-			{
-				TileKey key{lightUuid, faceIndices[i]};
-				ANKI_ASSERT(m_lightUuidToTileIdx.find(key) == m_lightUuidToTileIdx.getEnd());
-				m_lightUuidToTileIdx.emplace(getAllocator(), key, tileIndices[i]);
-			}
+			m_tileAlloc.invalidateCache(lightUuid, faces[i].m_face);
 		}
 	}
-
-	return failed;
-}
-
-Bool ShadowMapping::shouldRenderTile(
-	U64 lightTimestamp, U64 lightUuid, U32 face, const Tile& tileIdx, U32 drawcallCount)
-{
-	if(tileIdx.m_face == face && tileIdx.m_lightUuid == lightUuid && tileIdx.m_lastUsedTimestamp >= lightTimestamp
-		&& tileIdx.m_drawcallCount == drawcallCount)
-	{
-		return false;
-	}
 	else
 	{
-		return true;
-	}
-}
-
-Bool ShadowMapping::allocateTile(U64 lightTimestamp, U64 lightUuid, U32 face, U32& tileAllocated, Bool& inTheCache)
-{
-	ANKI_ASSERT(lightTimestamp > 0);
-	ANKI_ASSERT(lightUuid > 0);
-	ANKI_ASSERT(face < 6);
-
-	// First, try to see if the light/face is in the cache
-	inTheCache = false;
-	TileKey key = TileKey{lightUuid, U64(face)};
-	auto it = m_lightUuidToTileIdx.find(key);
-	if(it != m_lightUuidToTileIdx.getEnd())
-	{
-		const U32 tileIdx = *it;
-		if(m_tiles[tileIdx].m_lightUuid == lightUuid && m_tiles[tileIdx].m_face == face && !m_tiles[tileIdx].m_pinned)
+		// Remember the dynamic shadow casters for the next frames
+		for(const LightFace& face : faces)
 		{
-			// Found it
-			tileAllocated = tileIdx;
-			inTheCache = true;
-			return false;
-		}
-		else
-		{
-			// Cache entry is wrong, remove it
-			m_lightUuidToTileIdx.erase(getAllocator(), it);
-		}
-	}
-
-	// 2nd and 3rd choice, find an empty tile or some tile to re-use
-	U32 emptyTile = MAX_U32;
-	U32 tileToKick = MAX_U32;
-	Timestamp tileToKickMinTimestamp = MAX_TIMESTAMP;
-	for(U32 tileIdx = 0; tileIdx < m_tiles.getSize(); ++tileIdx)
-	{
-		if(m_tiles[tileIdx].m_pinned)
-		{
-			continue;
-		}
+			const DynamicLayerInfo info = {
+				crntTimestamp, U32(face.m_renderQueue->m_dynamicShadowRenderables.getSize())};
+			const TileKey key{lightUuid, face.m_face};
 
-		if(m_tiles[tileIdx].m_lightUuid == 0)
-		{
-			// Found an empty
-			emptyTile = tileIdx;
-			break;
-		}
-		else if(m_tiles[tileIdx].m_lastUsedTimestamp != m_r->getGlobalTimestamp()
-				&& m_tiles[tileIdx].m_lastUsedTimestamp < tileToKickMinTimestamp)
-		{
-			// Found some with low timestamp
-			tileToKick = tileIdx;
-			tileToKickMinTimestamp = m_tiles[tileIdx].m_lastUsedTimestamp;
+			auto it = m_dynamicLayerInfos.find(key);
+			if(it != m_dynamicLayerInfos.getEnd())
+			{
+				*it = info;
+			}
+			else
+			{
+				m_dynamicLayerInfos.emplace(getAllocator(), key, info);
+			}
 		}
 	}
 
-	Bool failed = false;
-	if(emptyTile != MAX_U32)
-	{
-		tileAllocated = emptyTile;
-	}
-	else if(tileToKick != MAX_U32)
-	{
-		tileAllocated = tileToKick;
-	}
-	else
-	{
-		// We have a problem
-		failed = true;
-		ANKI_R_LOGW("There is not enough space in the shadow atlas for more shadow maps. "
-					"Increase the r.shadowMapping.tileCountPerRowOrColumn or decrease the scene's shadow casters");
-	}
-
-	if(!failed)
-	{
-		ANKI_ASSERT(!m_tiles[tileAllocated].m_pinned);
-		m_tiles[tileAllocated].m_pinned = true;
-	}
-
 	return failed;
 }
 
+Bool ShadowMapping::dynamicLayerCached(U64 lightUuid, U32 face, const RenderQueue& queue) const
+{
+	// The ESM tile has the same dynamic shadow casters if their count is the same and nothing changed since the last
+	// time the face was used
+	auto it = m_dynamicLayerInfos.find(TileKey{lightUuid, face});
+	return it != m_dynamicLayerInfos.getEnd() && it->m_drawcallCount == queue.m_dynamicShadowRenderables.getSize()
+		   && queue.m_shadowRenderablesLastUpdateTimestamp <= it->m_lastUsedTimestamp;
+}
+
 } // end namespace anki
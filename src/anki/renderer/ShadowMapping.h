@@ -6,6 +6,7 @@
 #pragma once
 
 #include <anki/renderer/RendererObject.h>
+#include <anki/renderer/TileAllocator.h>
 #include <anki/Gr.h>
 #include <anki/resource/TextureResource.h>
 
@@ -40,33 +41,6 @@ private:
 	/// @name ESM stuff
 	/// @{
 
-	/// The ESM map consists of tiles.
-	class Tile
-	{
-	public:
-		U64 m_lastUsedTimestamp = 0;
-		U64 m_lightUuid = 0;
-		U32 m_drawcallCount = 0;
-		U8 m_face = 0;
-		Bool8 m_pinned = false; ///< If true we cannot allocate from it.
-
-		Vec4 m_uv;
-		Array<U32, 4> m_viewport;
-	};
-
-	/// A HashMap key.
-	class TileKey
-	{
-	public:
-		U64 m_lightUuid;
-		U64 m_face;
-
-		U64 computeHash() const
-		{
-			return anki::computeHash(this, sizeof(*this), 693);
-		}
-	};
-
 	FramebufferDescription m_esmFbDescr; ///< The FB for ESM
 	TexturePtr m_esmAtlas; ///< ESM texture atlas.
 	RenderTargetHandle m_esmRt;
@@ -74,16 +48,11 @@ private:
 	U32 m_tileResolution = 0; ///< Tile resolution.
 	U32 m_atlasResolution = 0; ///< Atlas size is (m_atlasResolution, m_atlasResolution)
 	U32 m_tileCountPerRowOrColumn = 0;
-	DynamicArray<Tile> m_tiles;
+	TileAllocator m_tileAlloc; ///< Allocates tiles of variable resolution from the ESM atlas.
 
 	ShaderProgramResourcePtr m_esmResolveProg;
 	ShaderProgramPtr m_esmResolveGrProg;
 
-	HashMap<TileKey, U32> m_lightUuidToTileIdx;
-
-	Bool allocateTile(U64 lightTimestamp, U64 lightUuid, U32 face, U32& tileAllocated, Bool& inTheCache);
-	static Bool shouldRenderTile(U64 lightTimestamp, U64 lightUuid, U32 face, const Tile& tileIdx, U32 drawcallCount);
-
 	class EsmResolveWorkItem
 	{
 	public:
@@ -96,7 +65,7 @@ private:
 
 	ANKI_USE_RESULT Error initEsm(const ConfigSet& cfg);
 
-	static Mat4 createSpotLightTextureMatrix(const Tile& tile);
+	Mat4 createSpotLightTextureMatrix(const Array<U32, 4>& atlasViewport) const;
 
 	/// A RenderPassWorkCallback for ESM
 	static void runEsmCallback(RenderPassWorkContext& rgraphCtx)
@@ -107,6 +76,66 @@ private:
 	void runEsm(RenderPassWorkContext& rgraphCtx);
 	/// @}
 
+	/// @name Static layer stuff
+	/// @{
+
+	/// The depth of the static shadow casters. It has the same layout as the ESM atlas. It's rendered only when the
+	/// static shadow casters or the light change.
+	TexturePtr m_staticAtlas;
+	RenderTargetHandle m_staticRt;
+	FramebufferDescription m_staticFbDescr;
+
+	ShaderProgramResourcePtr m_copyDepthProg;
+	ShaderProgramPtr m_copyDepthGrProg;
+	ShaderProgramPtr m_clearDepthGrProg;
+
+	/// A HashMap key.
+	class TileKey
+	{
+	public:
+		U64 m_lightUuid;
+		U64 m_face;
+
+		U64 computeHash() const
+		{
+			return anki::computeHash(this, sizeof(*this), 693);
+		}
+	};
+
+	/// The dynamic shadow casters of a light's face the last time the face was used.
+	class DynamicLayerInfo
+	{
+	public:
+		Timestamp m_lastUsedTimestamp;
+		U32 m_drawcallCount;
+	};
+
+	HashMap<TileKey, DynamicLayerInfo> m_dynamicLayerInfos;
+
+	class CopyStaticLayerWorkItem
+	{
+	public:
+		Vec4 m_uvIn; ///< UV + size that point to the static atlas.
+		Array<U32, 4> m_viewportOut; ///< Viewport in the scratch buffer.
+	};
+
+	WeakArray<Array<U32, 4>> m_staticClearViewports; ///< The tiles of the static atlas that will be rendered.
+	WeakArray<CopyStaticLayerWorkItem> m_copyStaticLayerWorkItems;
+
+	ANKI_USE_RESULT Error initStatic(const ConfigSet& cfg);
+
+	/// A RenderPassWorkCallback for the static shadow casters.
+	static void runStaticShadowMappingCallback(RenderPassWorkContext& rgraphCtx)
+	{
+		scast<ShadowMapping*>(rgraphCtx.m_userData)->runStaticShadowMapping(rgraphCtx);
+	}
+
+	void runStaticShadowMapping(RenderPassWorkContext& rgraphCtx);
+
+	/// Return true if the dynamic shadow casters of a light's face didn't change since the last time it was used.
+	Bool dynamicLayerCached(U64 lightUuid, U32 face, const RenderQueue& queue) const;
+	/// @}
+
 	/// @name Scratch buffer stuff
 	/// @{
 	RenderTargetHandle m_scratchRt; ///< Size of the RT is (m_scratchTileSize * m_scratchTileCount, m_scratchTileSize).
@@ -117,19 +146,24 @@ private:
 	U32 m_scratchTileResolution = 0;
 	U32 m_freeScratchTiles = 0;
 
-	class ScratchBufferWorkItem
+	class RenderShadowsWorkItem
 	{
 	public:
 		Array<U32, 4> m_viewport;
 		RenderQueue* m_renderQueue;
+		const RenderableQueueElement* m_renderables;
 		U32 m_firstRenderableElement;
 		U32 m_renderableElementCount;
 		U32 m_threadPoolTaskIdx;
 	};
 
-	struct LightToRenderToScratchInfo;
+	struct LightToRenderInfo;
+	class ProcessLightsContext;
 
-	WeakArray<ScratchBufferWorkItem> m_scratchWorkItems;
+	WeakArray<RenderShadowsWorkItem> m_scratchWorkItems; ///< The dynamic shadow casters.
+	WeakArray<RenderShadowsWorkItem> m_staticWorkItems; ///< The static shadow casters.
+	U32 m_scratchThreadCount = 0;
+	U32 m_staticThreadCount = 0;
 
 	ANKI_USE_RESULT Error initScratch(const ConfigSet& cfg);
 
@@ -140,30 +174,56 @@ private:
 	}
 
 	void runShadowMapping(RenderPassWorkContext& rgraphCtx);
+
+	/// Draw the work items of a thread.
+	void renderWorkItems(const WeakArray<RenderShadowsWorkItem>& workItems, RenderPassWorkContext& rgraphCtx) const;
 	/// @}
 
 	/// @name Misc & common
 	/// @{
 
-	/// Try to allocate a number of scratch tiles and regular tiles.
-	Bool allocateTilesAndScratchTiles(U64 lightUuid,
-		U32 faceCount,
-		const U64* faceTimestamps,
-		const U32* faceIndices,
-		const U32* drawcallsCount,
-		U32* tileIndices,
-		U32* scratchTileIndices);
-
-	/// Add new work to render to scratch buffer and ESM buffer.
-	void newScratchAndEsmResloveRenderWorkItems(U32 tileIdx,
-		U32 scratchTileIdx,
-		RenderQueue* lightRenderQueue,
-		DynamicArrayAuto<LightToRenderToScratchInfo>& scratchWorkItem,
-		DynamicArrayAuto<EsmResolveWorkItem>& esmResolveWorkItem,
-		U32& drawcallCount) const;
+	/// A face of a light that needs a tile.
+	class LightFace
+	{
+	public:
+		RenderQueue* m_renderQueue;
+		U32 m_face;
+
+		Array<U32, 4> m_atlasViewport; ///< The viewport of the tile in the ESM and static atlases.
+		U32 m_scratchTileIdx; ///< MAX_U32 if the ESM tile doesn't need to be rendered.
+		Bool8 m_renderStaticLayer; ///< The static layer needs to be rendered.
+	};
+
+	/// Try to allocate a number of scratch tiles and regular tiles. All the regular tiles have the same resolution. If
+	/// the atlas is full it will try lower resolutions.
+	/// @param[in,out] hierarchy The preferred tile hierarchy in, the hierarchy of the allocated tiles out.
+	/// @return True if the allocation failed.
+	Bool allocateTilesAndScratchTiles(U64 lightUuid, WeakArray<LightFace> faces, U32& hierarchy);
+
+	/// Try to allocate a number of scratch tiles and regular tiles of a specific hierarchy.
+	/// @param[out] atlasFull True if it failed because there is no space in the atlas.
+	/// @return True if the allocation failed.
+	Bool tryAllocateTilesAndScratchTiles(U64 lightUuid, WeakArray<LightFace> faces, U32 hierarchy, Bool& atlasFull);
+
+	/// Choose the tile hierarchy (resolution) of a light depending on how big it is on the screen.
+	U32 chooseTileHierarchy(const Vec3& cameraPos, const Vec3& lightPos, F32 lightRadius, F32& importance) const;
+
+	/// Add new work to render the static layer, the scratch buffer and the ESM buffer.
+	void newRenderWorkItems(const LightFace& face, ProcessLightsContext& ctx) const;
+
+	/// Split the drawcalls of some lights to a number of work items.
+	void splitRenderWork(StackAllocator<U8> alloc,
+		ConstWeakArray<LightToRenderInfo> lightsToRender,
+		U32 drawcallCount,
+		WeakArray<RenderShadowsWorkItem>& workItems,
+		U32& threadCount) const;
 
 	/// Iterate lights and create work items.
-	void processLights(RenderingContext& ctx, U32& threadCountForScratchPass);
+	void processLights(RenderingContext& ctx);
+
+	void processPointLight(PointLightQueueElement& light, U32 hierarchy, ProcessLightsContext& ctx);
+
+	void processSpotLight(SpotLightQueueElement& light, U32 hierarchy, ProcessLightsContext& ctx);
 
 	ANKI_USE_RESULT Error initInternal(const ConfigSet& config);
 	/// @}
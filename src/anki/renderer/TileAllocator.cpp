@@ -0,0 +1,341 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/renderer/TileAllocator.h>
+
+namespace anki
+{
+
+Bool TileAllocator::EvictionCost::operator<(const EvictionCost& b) const
+{
+	// Prefer not to evict anything, then evict the least recently used tiles, then evict as few as possible
+	if(m_evictedTileCount == 0 || b.m_evictedTileCount == 0)
+	{
+		if(m_evictedTileCount != b.m_evictedTileCount)
+		{
+			return m_evictedTileCount == 0;
+		}
+
+		return m_packed && !b.m_packed;
+	}
+
+	if(m_maxLastUsedTimestamp != b.m_maxLastUsedTimestamp)
+	{
+		return m_maxLastUsedTimestamp < b.m_maxLastUsedTimestamp;
+	}
+
+	return m_evictedTileCount < b.m_evictedTileCount;
+}
+
+TileAllocator::~TileAllocator()
+{
+	m_lightInfoToTileIdx.destroy(m_alloc);
+	m_allTiles.destroy(m_alloc);
+	m_firstTileOfHierarchy.destroy(m_alloc);
+}
+
+void TileAllocator::init(
+	HeapAllocator<U8> alloc, U32 tileCountX, U32 tileCountY, U32 hierarchyCount, U32 tileResolution)
+{
+	ANKI_ASSERT(tileCountX > 0 && tileCountY > 0 && hierarchyCount > 0);
+	ANKI_ASSERT((tileResolution >> (hierarchyCount - 1)) > 0);
+	m_alloc = alloc;
+	m_tileCountX = tileCountX;
+	m_tileCountY = tileCountY;
+	m_hierarchyCount = hierarchyCount;
+	m_tileResolution = tileResolution;
+
+	// Count the tiles
+	m_firstTileOfHierarchy.create(m_alloc, hierarchyCount);
+	U32 tileCount = 0;
+	for(U32 h = 0; h < hierarchyCount; ++h)
+	{
+		m_firstTileOfHierarchy[h] = tileCount;
+		tileCount += (tileCountX << h) * (tileCountY << h);
+	}
+
+	// Create the tiles. Every hierarchy is a grid twice as dense as the previous
+	m_allTiles.create(m_alloc, tileCount);
+	for(U32 h = 0; h < hierarchyCount; ++h)
+	{
+		const U32 countX = tileCountX << h;
+		const U32 countY = tileCountY << h;
+		const U32 resolution = getTileResolution(h);
+
+		for(U32 y = 0; y < countY; ++y)
+		{
+			for(U32 x = 0; x < countX; ++x)
+			{
+				Tile& tile = m_allTiles[m_firstTileOfHierarchy[h] + y * countX + x];
+				tile.m_hierarchy = h;
+				tile.m_viewport = {{x * resolution, y * resolution, resolution, resolution}};
+
+				if(h > 0)
+				{
+					const U32 parentCountX = countX / 2;
+					tile.m_parent = m_firstTileOfHierarchy[h - 1] + (y / 2) * parentCountX + x / 2;
+				}
+
+				if(h + 1 < hierarchyCount)
+				{
+					const U32 subCountX = countX * 2;
+					const U32 firstSubTile = m_firstTileOfHierarchy[h + 1] + (y * 2) * subCountX + x * 2;
+					tile.m_subTiles = {
+						{firstSubTile, firstSubTile + 1, firstSubTile + subCountX, firstSubTile + subCountX + 1}};
+				}
+			}
+		}
+	}
+}
+
+void TileAllocator::reserveTile(U32 tileX, U32 tileY)
+{
+	ANKI_ASSERT(tileX < m_tileCountX && tileY < m_tileCountY);
+	Tile& tile = m_allTiles[tileY * m_tileCountX + tileX];
+	ANKI_ASSERT(!subtreeInUse(tileY * m_tileCountX + tileX) && "Reserve before allocating");
+	tile.m_reserved = true;
+}
+
+Bool TileAllocator::subtreeInUse(U32 tileIdx) const
+{
+	const Tile& tile = m_allTiles[tileIdx];
+	if(tile.m_lightUuid != 0 || tile.m_reserved)
+	{
+		return true;
+	}
+
+	if(tile.m_subTiles[0] != MAX_U32)
+	{
+		for(U32 subTileIdx : tile.m_subTiles)
+		{
+			if(subtreeInUse(subTileIdx))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+Bool TileAllocator::computeSubtreeEvictionCost(Timestamp crntTimestamp, U32 tileIdx, EvictionCost& cost) const
+{
+	const Tile& tile = m_allTiles[tileIdx];
+	if(tile.m_reserved)
+	{
+		return false;
+	}
+
+	if(tile.m_lightUuid != 0)
+	{
+		if(tile.m_lastUsedTimestamp == crntTimestamp)
+		{
+			// Used this frame, can't touch it
+			return false;
+		}
+
+		cost.m_maxLastUsedTimestamp = max(cost.m_maxLastUsedTimestamp, tile.m_lastUsedTimestamp);
+		++cost.m_evictedTileCount;
+
+		// A used tile doesn't have used sub tiles
+		return true;
+	}
+
+	if(tile.m_subTiles[0] != MAX_U32)
+	{
+		for(U32 subTileIdx : tile.m_subTiles)
+		{
+			if(!computeSubtreeEvictionCost(crntTimestamp, subTileIdx, cost))
+			{
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+Bool TileAllocator::computeEvictionCost(Timestamp crntTimestamp, U32 tileIdx, EvictionCost& cost) const
+{
+	cost = EvictionCost();
+
+	// The parents cover the tile
+	U32 parentIdx = m_allTiles[tileIdx].m_parent;
+	while(parentIdx != MAX_U32)
+	{
+		const Tile& parent = m_allTiles[parentIdx];
+		if(parent.m_reserved || (parent.m_lightUuid != 0 && parent.m_lastUsedTimestamp == crntTimestamp))
+		{
+			return false;
+		}
+		else if(parent.m_lightUuid != 0)
+		{
+			cost.m_maxLastUsedTimestamp = max(cost.m_maxLastUsedTimestamp, parent.m_lastUsedTimestamp);
+			++cost.m_evictedTileCount;
+		}
+
+		parentIdx = parent.m_parent;
+	}
+
+	if(!computeSubtreeEvictionCost(crntTimestamp, tileIdx, cost))
+	{
+		return false;
+	}
+
+	// Check if the siblings are used. If they are then the tile fills a hole instead of splitting a free tile
+	const U32 directParentIdx = m_allTiles[tileIdx].m_parent;
+	if(cost.m_evictedTileCount == 0 && directParentIdx != MAX_U32)
+	{
+		for(U32 siblingIdx : m_allTiles[directParentIdx].m_subTiles)
+		{
+			if(siblingIdx != tileIdx && subtreeInUse(siblingIdx))
+			{
+				cost.m_packed = true;
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+void TileAllocator::evict(U32 tileIdx)
+{
+	Tile& tile = m_allTiles[tileIdx];
+	ANKI_ASSERT(tile.m_lightUuid != 0);
+
+	auto it = m_lightInfoToTileIdx.find(TileKey{tile.m_lightUuid, tile.m_lightFace});
+	ANKI_ASSERT(it != m_lightInfoToTileIdx.getEnd() && *it == tileIdx);
+	m_lightInfoToTileIdx.erase(m_alloc, it);
+
+	tile.m_lightUuid = 0;
+	tile.m_lastUsedTimestamp = 0;
+	tile.m_contentsHash = 0;
+}
+
+void TileAllocator::evictSubtree(U32 tileIdx)
+{
+	Tile& tile = m_allTiles[tileIdx];
+	if(tile.m_lightUuid != 0)
+	{
+		evict(tileIdx);
+	}
+	else if(tile.m_subTiles[0] != MAX_U32)
+	{
+		for(U32 subTileIdx : tile.m_subTiles)
+		{
+			evictSubtree(subTileIdx);
+		}
+	}
+}
+
+TileAllocatorResult TileAllocator::allocate(Timestamp crntTimestamp,
+	Timestamp lightTimestamp,
+	U64 lightUuid,
+	U32 lightFace,
+	U64 contentsHash,
+	U32 hierarchy,
+	Array<U32, 4>& tileViewport)
+{
+	ANKI_ASSERT(crntTimestamp > 0);
+	ANKI_ASSERT(lightTimestamp > 0);
+	ANKI_ASSERT(lightUuid != 0);
+	ANKI_ASSERT(lightFace < 6);
+	ANKI_ASSERT(hierarchy < m_hierarchyCount);
+
+	// First, check the cache
+	auto it = m_lightInfoToTileIdx.find(TileKey{lightUuid, lightFace});
+	if(it != m_lightInfoToTileIdx.getEnd())
+	{
+		const U32 tileIdx = *it;
+		Tile& tile = m_allTiles[tileIdx];
+		ANKI_ASSERT(tile.m_lightUuid == lightUuid && tile.m_lightFace == lightFace);
+		ANKI_ASSERT(tile.m_lastUsedTimestamp != crntTimestamp && "Allocating twice in the same frame");
+
+		if(tile.m_hierarchy == hierarchy)
+		{
+			// Found it. Its contents are valid if nothing changed since the last time it was used
+			const Bool contentsValid =
+				tile.m_lastUsedTimestamp >= lightTimestamp && tile.m_contentsHash == contentsHash;
+
+			tile.m_lastUsedTimestamp = crntTimestamp;
+			tile.m_contentsHash = contentsHash;
+			tileViewport = tile.m_viewport;
+			return (contentsValid) ? TileAllocatorResult::CACHED : TileAllocatorResult::ALLOCATION_SUCCEEDED;
+		}
+		else
+		{
+			// The light wants a different resolution, free the old tile
+			evict(tileIdx);
+		}
+	}
+
+	// Find the tile with the lowest eviction cost
+	const U32 firstTile = m_firstTileOfHierarchy[hierarchy];
+	const U32 tileCount = (m_tileCountX << hierarchy) * (m_tileCountY << hierarchy);
+	U32 bestTileIdx = MAX_U32;
+	EvictionCost bestCost;
+	for(U32 tileIdx = firstTile; tileIdx < firstTile + tileCount; ++tileIdx)
+	{
+		EvictionCost cost;
+		if(!computeEvictionCost(crntTimestamp, tileIdx, cost))
+		{
+			continue;
+		}
+
+		if(bestTileIdx == MAX_U32 || cost < bestCost)
+		{
+			bestTileIdx = tileIdx;
+			bestCost = cost;
+
+			if(cost.m_evictedTileCount == 0 && cost.m_packed)
+			{
+				// Can't get any better
+				break;
+			}
+		}
+	}
+
+	if(bestTileIdx == MAX_U32)
+	{
+		return TileAllocatorResult::ALLOCATION_FAILED;
+	}
+
+	// Evict the parents and the sub tiles
+	U32 parentIdx = m_allTiles[bestTileIdx].m_parent;
+	while(parentIdx != MAX_U32)
+	{
+		if(m_allTiles[parentIdx].m_lightUuid != 0)
+		{
+			evict(parentIdx);
+		}
+
+		parentIdx = m_allTiles[parentIdx].m_parent;
+	}
+
+	evictSubtree(bestTileIdx);
+
+	// Allocate
+	Tile& tile = m_allTiles[bestTileIdx];
+	tile.m_lightUuid = lightUuid;
+	tile.m_lightFace = lightFace;
+	tile.m_contentsHash = contentsHash;
+	tile.m_lastUsedTimestamp = crntTimestamp;
+	m_lightInfoToTileIdx.emplace(m_alloc, TileKey{lightUuid, lightFace}, bestTileIdx);
+
+	tileViewport = tile.m_viewport;
+	return TileAllocatorResult::ALLOCATION_SUCCEEDED;
+}
+
+void TileAllocator::invalidateCache(U64 lightUuid, U32 lightFace)
+{
+	auto it = m_lightInfoToTileIdx.find(TileKey{lightUuid, lightFace});
+	if(it != m_lightInfoToTileIdx.getEnd())
+	{
+		evict(*it);
+	}
+}
+
+} // end namespace anki
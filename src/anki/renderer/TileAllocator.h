@@ -0,0 +1,146 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/util/DynamicArray.h>
+#include <anki/util/HashMap.h>
+#include <anki/util/Array.h>
+#include <anki/util/Hash.h>
+
+namespace anki
+{
+
+/// @addtogroup renderer
+/// @{
+
+/// The result of TileAllocator::allocate.
+enum class TileAllocatorResult : U8
+{
+	CACHED, ///< The tile was allocated in a previous frame and its contents are still valid.
+	ALLOCATION_SUCCEEDED, ///< Got a tile but its contents need to be rendered.
+	ALLOCATION_FAILED
+};
+
+/// Allocates tiles of variable size from an atlas (the shadow atlas for example). The atlas is a grid of top level
+/// tiles and every tile is a quadtree. Tiles of hierarchy 0 are the top level ones, tiles of hierarchy 1 are a quarter
+/// of them etc. A tile is owned by a light's face and it's kept across frames so its contents can be re-used. When
+/// there is no free space the tiles that haven't been used for the longest time are evicted. The tiles used in the
+/// current frame are never evicted.
+class TileAllocator : public NonCopyable
+{
+public:
+	TileAllocator()
+	{
+	}
+
+	~TileAllocator();
+
+	/// Initialize.
+	/// @param alloc The allocator.
+	/// @param tileCountX The number of the top level tiles in X.
+	/// @param tileCountY The number of the top level tiles in Y.
+	/// @param hierarchyCount The number of hierarchies. Every hierarchy splits the tiles to 4.
+	/// @param tileResolution The resolution of the top level tiles.
+	void init(HeapAllocator<U8> alloc, U32 tileCountX, U32 tileCountY, U32 hierarchyCount, U32 tileResolution);
+
+	/// Reserve a top level tile forever. Nothing will be allocated from it.
+	void reserveTile(U32 tileX, U32 tileY);
+
+	/// Allocate a tile for a light's face or get the one that it owns from a previous frame.
+	/// @param crntTimestamp The current frame's timestamp.
+	/// @param lightTimestamp The last time the light or the objects it sees changed.
+	/// @param lightUuid The light.
+	/// @param lightFace The light's face.
+	/// @param contentsHash A hash of what the light's face sees. If it changed the tile needs to be re-rendered.
+	/// @param hierarchy The hierarchy of the tile. It defines the resolution.
+	/// @param[out] tileViewport The viewport of the tile.
+	ANKI_USE_RESULT TileAllocatorResult allocate(Timestamp crntTimestamp,
+		Timestamp lightTimestamp,
+		U64 lightUuid,
+		U32 lightFace,
+		U64 contentsHash,
+		U32 hierarchy,
+		Array<U32, 4>& tileViewport);
+
+	/// Free the tile of a light's face. Use it if the contents of the tile won't be rendered after all.
+	void invalidateCache(U64 lightUuid, U32 lightFace);
+
+	U32 getHierarchyCount() const
+	{
+		return m_hierarchyCount;
+	}
+
+	/// The resolution of the tiles of a hierarchy.
+	U32 getTileResolution(U32 hierarchy) const
+	{
+		ANKI_ASSERT(hierarchy < m_hierarchyCount);
+		return m_tileResolution >> hierarchy;
+	}
+
+private:
+	class Tile
+	{
+	public:
+		Timestamp m_lastUsedTimestamp = 0;
+		U64 m_lightUuid = 0; ///< Zero if the tile is free.
+		U64 m_contentsHash = 0;
+		U32 m_parent = MAX_U32;
+		Array<U32, 4> m_subTiles = {{MAX_U32, MAX_U32, MAX_U32, MAX_U32}};
+		Array<U32, 4> m_viewport;
+		U8 m_lightFace = 0;
+		U8 m_hierarchy = 0;
+		Bool8 m_reserved = false;
+	};
+
+	/// A HashMap key.
+	class TileKey
+	{
+	public:
+		U64 m_lightUuid;
+		U64 m_face;
+
+		U64 computeHash() const
+		{
+			return anki::computeHash(this, sizeof(*this), 693);
+		}
+	};
+
+	/// The cost of evicting the tiles that overlap with a tile.
+	class EvictionCost
+	{
+	public:
+		Timestamp m_maxLastUsedTimestamp = 0; ///< The most recent use of the tiles that will be evicted.
+		U32 m_evictedTileCount = 0;
+		Bool8 m_packed = false; ///< The tile is next to used tiles. It's better for fragmentation.
+
+		Bool operator<(const EvictionCost& b) const;
+	};
+
+	HeapAllocator<U8> m_alloc;
+	DynamicArray<Tile> m_allTiles;
+	DynamicArray<U32> m_firstTileOfHierarchy; ///< The tiles of a hierarchy are contiguous in m_allTiles.
+	HashMap<TileKey, U32> m_lightInfoToTileIdx;
+	U32 m_tileCountX = 0;
+	U32 m_tileCountY = 0;
+	U32 m_hierarchyCount = 0;
+	U32 m_tileResolution = 0;
+
+	/// Return false if the tile can't be allocated because some overlapping tile is used this frame.
+	Bool computeEvictionCost(Timestamp crntTimestamp, U32 tileIdx, EvictionCost& cost) const;
+
+	/// Return false if a tile of the subtree can't be evicted.
+	Bool computeSubtreeEvictionCost(Timestamp crntTimestamp, U32 tileIdx, EvictionCost& cost) const;
+
+	/// Return true if some tile of the subtree is used or reserved.
+	Bool subtreeInUse(U32 tileIdx) const;
+
+	void evictSubtree(U32 tileIdx);
+
+	void evict(U32 tileIdx);
+};
+/// @}
+
+} // end namespace anki
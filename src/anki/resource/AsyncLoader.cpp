@@ -32,7 +32,7 @@ AsyncLoader::~AsyncLoader()
 	}
 }
 
-void AsyncLoader::init(const HeapAllocator<U8>& alloc)
+void AsyncLoader::init(const ResourceAllocator<U8>& alloc)
 {
 	m_alloc = alloc;
 	m_thread.start(this, threadCallback);
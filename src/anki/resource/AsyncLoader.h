@@ -47,7 +47,7 @@ public:
 
 	~AsyncLoader();
 
-	void init(const HeapAllocator<U8>& alloc);
+	void init(const ResourceAllocator<U8>& alloc);
 
 	/// Submit a task.
 	void submitTask(AsyncLoaderTask* task);
@@ -73,7 +73,7 @@ public:
 	/// Resume the async loading.
 	void resume();
 
-	HeapAllocator<U8> getAllocator() const
+	ResourceAllocator<U8> getAllocator() const
 	{
 		return m_alloc;
 	}
@@ -85,7 +85,7 @@ public:
 	}
 
 private:
-	HeapAllocator<U8> m_alloc;
+	ResourceAllocator<U8> m_alloc;
 	Thread m_thread;
 	Barrier m_barrier = {2};
 
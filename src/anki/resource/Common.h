@@ -33,9 +33,16 @@ class TransferGpuAllocatorHandle;
 /// @name Constants
 /// @{
 const U MAX_LOD_COUNT = 3;
-const U MAX_INSTANCES = 64;
+const U MAX_INSTANCES = 64; ///< Max instances that pass their instanced inputs as uniforms.
 const U MAX_SUB_DRAWCALLS = 64; ///< @warning If changed don't forget to change MAX_INSTANCE_GROUPS
-const U MAX_INSTANCE_GROUPS = 7; ///< It's log2(MAX_INSTANCES) + 1
+
+/// It's log2(MAX_INSTANCES) + 2. The last group is for more than MAX_INSTANCES instances. Those read the instanced
+/// inputs from a storage buffer and they have no limit.
+const U MAX_INSTANCE_GROUPS = 8;
+
+/// The binding of the storage buffer that holds the instanced inputs when there are more than MAX_INSTANCES instances.
+/// It's in the descriptor set of the program.
+const U INSTANCED_INPUTS_STORAGE_BUFFER_BINDING = 1;
 
 /// Standard attribute locations. Should be the same as in Common.glsl.
 enum class VertexAttributeLocation : U8
@@ -78,8 +85,9 @@ using ResourcePtr = IntrusivePtr<T, ResourcePtrDeleter<T>>;
 #undef ANKI_INSTANTIATE_RESOURCE
 #undef ANKI_INSTANSIATE_RESOURCE_DELIMITER
 
+/// The resources are loaded from many threads at the same time so their allocator caches per thread.
 template<typename T>
-using ResourceAllocator = HeapAllocator<T>;
+using ResourceAllocator = ThreadCachingAllocator<T>;
 
 template<typename T>
 using TempResourceAllocator = StackAllocator<T>;
@@ -317,6 +317,8 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 	U32& depth,
 	U32& layerCount,
 	U8& toLoadMipCount,
+	U8& firstMip,
+	U8& fullMipCount,
 	ImageLoader::TextureType& textureType,
 	ImageLoader::ColorFormat& colorFormat)
 {
@@ -377,9 +379,6 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 		return Error::USER_DATA;
 	}
 
-	width = header.m_width;
-	height = header.m_height;
-
 	// Check mip levels
 	U size = min(header.m_width, header.m_height);
 	U maxSize = max(header.m_width, header.m_height);
@@ -388,28 +387,32 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 		maxSize = max<U>(maxSize, header.m_depthOrLayerCount);
 		size = min<U>(size, header.m_depthOrLayerCount);
 	}
-	toLoadMipCount = 0;
 	U tmpMipLevels = 0;
 	while(size >= 4) // The minimum size is 4x4
 	{
 		++tmpMipLevels;
-
-		if(maxSize <= maxTextureSize)
-		{
-			++toLoadMipCount;
-		}
-
 		size /= 2;
-		maxSize /= 2;
 	}
 
-	if(header.m_mipLevels > tmpMipLevels)
+	if(header.m_mipLevels == 0 || header.m_mipLevels > tmpMipLevels)
 	{
 		ANKI_RESOURCE_LOGE("Incorrect number of mip levels");
 		return Error::USER_DATA;
 	}
 
-	toLoadMipCount = min<U>(toLoadMipCount, header.m_mipLevels);
+	// Skip the top mips that are bigger than the max size. Always load the smallest mip
+	firstMip = 0;
+	while(firstMip + 1u < header.m_mipLevels && maxSize > maxTextureSize)
+	{
+		++firstMip;
+		maxSize /= 2;
+	}
+
+	fullMipCount = header.m_mipLevels;
+	toLoadMipCount = header.m_mipLevels - firstMip;
+
+	width = header.m_width >> firstMip;
+	height = header.m_height >> firstMip;
 
 	colorFormat = header.m_colorFormat;
 
@@ -426,7 +429,7 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 		faceCount = 6;
 		break;
 	case ImageLoader::TextureType::_3D:
-		depth = header.m_depthOrLayerCount;
+		depth = header.m_depthOrLayerCount >> firstMip;
 		layerCount = 1;
 		break;
 	case ImageLoader::TextureType::_2D_ARRAY:
@@ -496,7 +499,7 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 					U dataSize = calcSurfaceSize(mipWidth, mipHeight, preferredCompression, header.m_colorFormat);
 
 					// Check if this mipmap can be skipped because of size
-					if(maxSize <= maxTextureSize)
+					if(mip >= firstMip)
 					{
 						ImageLoader::Surface& surf = surfaces[index++];
 						surf.m_width = mipWidth;
@@ -529,9 +532,9 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 			U dataSize = calcVolumeSize(mipWidth, mipHeight, mipDepth, preferredCompression, header.m_colorFormat);
 
 			// Check if this mipmap can be skipped because of size
-			if(maxSize <= maxTextureSize)
+			if(mip >= firstMip)
 			{
-				ImageLoader::Volume& vol = volumes[mip];
+				ImageLoader::Volume& vol = volumes[mip - firstMip];
 				vol.m_width = mipWidth;
 				vol.m_height = mipHeight;
 				vol.m_depth = mipDepth;
@@ -556,6 +559,9 @@ static ANKI_USE_RESULT Error loadAnkiTexture(ResourceFilePtr file,
 
 Error ImageLoader::load(ResourceFilePtr file, const CString& filename, U32 maxTextureSize)
 {
+	// Cleanup a previous load
+	destroy();
+
 	// get the extension
 	StringAuto ext(m_alloc);
 	getFilepathExtension(filename, ext);
@@ -576,6 +582,8 @@ Error ImageLoader::load(ResourceFilePtr file, const CString& filename, U32 maxTe
 		m_surfaces.create(m_alloc, 1);
 
 		m_mipLevels = 1;
+		m_firstMipLevel = 0;
+		m_fullMipLevels = 1;
 		m_depth = 1;
 		m_layerCount = 1;
 		ANKI_CHECK(loadTga(file, m_surfaces[0].m_width, m_surfaces[0].m_height, bpp, m_surfaces[0].m_data, m_alloc));
@@ -617,6 +625,8 @@ Error ImageLoader::load(ResourceFilePtr file, const CString& filename, U32 maxTe
 			m_depth,
 			m_layerCount,
 			m_mipLevels,
+			m_firstMipLevel,
+			m_fullMipLevels,
 			m_textureType,
 			m_colorFormat));
 	}
@@ -94,11 +94,27 @@ public:
 		return m_mipLevels;
 	}
 
+	/// The mip of the file that became the first mip of the loader. It's non zero if some mips were skipped because of
+	/// the maxTextureSize.
+	U getFirstMipLevel() const
+	{
+		return m_firstMipLevel;
+	}
+
+	/// The number of mips in the file. Including the skipped ones.
+	U getFullMipLevelsCount() const
+	{
+		ANKI_ASSERT(m_fullMipLevels != 0);
+		return m_fullMipLevels;
+	}
+
+	/// The width of the first loaded mip.
 	U getWidth() const
 	{
 		return m_width;
 	}
 
+	/// The height of the first loaded mip.
 	U getHeight() const
 	{
 		return m_height;
@@ -131,7 +147,8 @@ public:
 		return m_alloc;
 	}
 
-	/// Load an image file.
+	/// Load an image file. It can be called more than once to load a different image or the same with another
+	/// maxTextureSize.
 	ANKI_USE_RESULT Error load(ResourceFilePtr file, const CString& filename, U32 maxTextureSize = MAX_U32);
 
 	Atomic<I32>& getRefcount()
@@ -150,6 +167,8 @@ private:
 	DynamicArray<Volume> m_volumes;
 
 	U8 m_mipLevels = 0;
+	U8 m_firstMipLevel = 0;
+	U8 m_fullMipLevels = 0;
 	U32 m_width = 0;
 	U32 m_height = 0;
 	U32 m_depth = 0;
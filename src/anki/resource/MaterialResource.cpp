@@ -596,9 +596,25 @@ const MaterialVariant& MaterialResource::getOrCreateVariant(const RenderingKey&
 U MaterialResource::getInstanceGroupIdx(U instanceCount)
 {
 	ANKI_ASSERT(instanceCount > 0);
+	if(instanceCount > MAX_INSTANCES)
+	{
+		// The instanced inputs don't fit in the uniforms, use the last group that reads them from storage
+		return MAX_INSTANCE_GROUPS - 1;
+	}
+
 	instanceCount = nextPowerOfTwo(instanceCount);
-	ANKI_ASSERT(instanceCount <= MAX_INSTANCES);
 	return log2(instanceCount);
 }
 
+void MaterialResource::requestTextureDetail(F32 projectedSize) const
+{
+	for(const MaterialVariable& var : m_vars)
+	{
+		if(var.m_tex.isCreated())
+		{
+			var.m_tex->requestDetail(projectedSize);
+		}
+	}
+}
+
 } // end namespace anki
@@ -244,6 +244,11 @@ public:
 		return m_vars;
 	}
 
+	/// Ask the streamer for the texture detail that an object of some size on the screen needs.
+	/// @param projectedSize The fraction of the screen height the object occupies.
+	/// @note It's thread-safe.
+	void requestTextureDetail(F32 projectedSize) const;
+
 	ShaderProgramResourcePtr getShaderProgramResource() const
 	{
 		return m_prog;
@@ -18,6 +18,7 @@ MeshLoader::MeshLoader(ResourceManager* manager)
 MeshLoader::~MeshLoader()
 {
 	m_subMeshes.destroy(m_alloc);
+	m_subMeshLods.destroy(m_alloc);
 }
 
 Error MeshLoader::load(const ResourceFilename& filename)
@@ -26,7 +27,7 @@ Error MeshLoader::load(const ResourceFilename& filename)
 
 	// Load header
 	ANKI_CHECK(m_manager->getFilesystem().openFile(filename, m_file));
-	ANKI_CHECK(m_file->read(&m_header, sizeof(m_header)));
+	ANKI_CHECK(loadHeader());
 	ANKI_CHECK(checkHeader());
 
 	// Read submesh info
@@ -34,12 +35,18 @@ Error MeshLoader::load(const ResourceFilename& filename)
 		m_subMeshes.create(alloc, m_header.m_subMeshCount);
 		ANKI_CHECK(m_file->read(&m_subMeshes[0], m_subMeshes.getSizeInBytes()));
 
+		if(m_header.m_lodCount > 1)
+		{
+			m_subMeshLods.create(alloc, (m_header.m_lodCount - 1) * m_header.m_subMeshCount);
+			ANKI_CHECK(m_file->read(&m_subMeshLods[0], m_subMeshLods.getSizeInBytes()));
+		}
+
 		// Checks
 		const U32 indicesPerFace = !!(m_header.m_flags & MeshBinaryFile::Flag::QUAD) ? 4 : 3;
 		U idxSum = 0;
 		for(U i = 0; i < m_subMeshes.getSize(); i++)
 		{
-			const MeshBinaryFile::SubMesh& sm = m_subMeshes[0];
+			const MeshBinaryFile::SubMesh& sm = m_subMeshes[i];
 			if(sm.m_firstIndex != idxSum || (sm.m_indexCount % indicesPerFace) != 0)
 			{
 				ANKI_RESOURCE_LOGE("Incorrect sub mesh info");
@@ -48,7 +55,7 @@ Error MeshLoader::load(const ResourceFilename& filename)
 
 			for(U d = 0; d < 3; ++d)
 			{
-				if(sm.m_aabbMin[i] >= sm.m_aabbMax[i])
+				if(sm.m_aabbMin[d] >= sm.m_aabbMax[d])
 				{
 					ANKI_RESOURCE_LOGE("Wrong bounding box");
 					return Error::USER_DATA;
@@ -58,6 +65,18 @@ Error MeshLoader::load(const ResourceFilename& filename)
 			idxSum += sm.m_indexCount;
 		}
 
+		// The LODs follow LOD 0 in the index buffer
+		for(const MeshBinaryFile::SubMeshLod& sm : m_subMeshLods)
+		{
+			if(sm.m_firstIndex != idxSum || sm.m_indexCount == 0 || (sm.m_indexCount % indicesPerFace) != 0)
+			{
+				ANKI_RESOURCE_LOGE("Incorrect sub mesh LOD info");
+				return Error::USER_DATA;
+			}
+
+			idxSum += sm.m_indexCount;
+		}
+
 		if(idxSum != m_header.m_totalIndexCount)
 		{
 			ANKI_RESOURCE_LOGE("Incorrect sub mesh info");
@@ -95,9 +114,11 @@ Error MeshLoader::load(const ResourceFilename& filename)
 
 	// Count and check the file size
 	{
-		U32 totalSize = sizeof(m_header);
+		const Bool v4 = memcmp(&m_header.m_magic[0], MeshBinaryFile::MAGIC_V4, 8) == 0;
+		U32 totalSize = (v4) ? MeshBinaryFile::HEADER_V4_SIZE : sizeof(m_header);
 
 		totalSize += sizeof(MeshBinaryFile::SubMesh) * m_header.m_subMeshCount;
+		totalSize += m_subMeshLods.getSizeInBytes();
 		totalSize += getIndexBufferSize();
 
 		for(U i = 0; i < m_header.m_vertexBufferCount; ++i)
@@ -153,17 +174,32 @@ Error MeshLoader::checkFormat(VertexAttributeLocation type, ConstWeakArray<Forma
 	return Error::NONE;
 }
 
-Error MeshLoader::checkHeader() const
+Error MeshLoader::loadHeader()
 {
-	const MeshBinaryFile::Header& h = m_header;
+	// Read the part that is common in all versions
+	ANKI_CHECK(m_file->read(&m_header, MeshBinaryFile::HEADER_V4_SIZE));
 
-	// Header
-	if(memcmp(&h.m_magic[0], MeshBinaryFile::MAGIC, 8) != 0)
+	if(memcmp(&m_header.m_magic[0], MeshBinaryFile::MAGIC, 8) == 0)
+	{
+		ANKI_CHECK(m_file->read(&m_header.m_lodCount, sizeof(m_header.m_lodCount)));
+	}
+	else if(memcmp(&m_header.m_magic[0], MeshBinaryFile::MAGIC_V4, 8) == 0)
+	{
+		m_header.m_lodCount = 1;
+	}
+	else
 	{
 		ANKI_RESOURCE_LOGE("Wrong magic word");
 		return Error::USER_DATA;
 	}
 
+	return Error::NONE;
+}
+
+Error MeshLoader::checkHeader() const
+{
+	const MeshBinaryFile::Header& h = m_header;
+
 	// Flags
 	if((h.m_flags & ~MeshBinaryFile::Flag::ALL) != MeshBinaryFile::Flag::NONE)
 	{
@@ -212,6 +248,13 @@ Error MeshLoader::checkHeader() const
 		return Error::USER_DATA;
 	}
 
+	// m_lodCount
+	if(h.m_lodCount == 0 || h.m_lodCount > MAX_LOD_COUNT)
+	{
+		ANKI_RESOURCE_LOGE("Wrong LOD count");
+		return Error::USER_DATA;
+	}
+
 	// AABB
 	for(U d = 0; d < 3; ++d)
 	{
@@ -225,6 +268,29 @@ Error MeshLoader::checkHeader() const
 	return Error::NONE;
 }
 
+U32 MeshLoader::getLodIndexCount(U lod) const
+{
+	ANKI_ASSERT(isLoaded() && lod < m_header.m_lodCount);
+
+	U32 count = 0;
+	if(lod == 0)
+	{
+		for(const MeshBinaryFile::SubMesh& sm : m_subMeshes)
+		{
+			count += sm.m_indexCount;
+		}
+	}
+	else
+	{
+		for(const MeshBinaryFile::SubMeshLod& sm : getSubMeshLods(lod))
+		{
+			count += sm.m_indexCount;
+		}
+	}
+
+	return count;
+}
+
 Error MeshLoader::storeIndexBuffer(void* ptr, PtrSize size)
 {
 	ANKI_ASSERT(isLoaded());
@@ -268,8 +334,6 @@ Error MeshLoader::storeIndicesAndPosition(DynamicArrayAuto<U32>& indices, Dynami
 {
 	// Store indices
 	{
-		indices.resize(m_header.m_totalIndexCount);
-
 		// Create staging buff
 		const PtrSize idxBufferSize = getIndexBufferSize();
 		DynamicArrayAuto<U8> staging(m_alloc);
@@ -278,8 +342,9 @@ Error MeshLoader::storeIndicesAndPosition(DynamicArrayAuto<U32>& indices, Dynami
 		// Store to staging buff
 		ANKI_CHECK(storeIndexBuffer(&staging[0], staging.getSizeInBytes()));
 
-		// Copy
-		for(U i = 0; i < m_header.m_totalIndexCount; ++i)
+		// Copy. Only the LOD 0
+		indices.resize(getLodIndexCount(0));
+		for(U i = 0; i < indices.getSize(); ++i)
 		{
 			if(m_header.m_indexType == IndexType::U32)
 			{
@@ -21,7 +21,10 @@ namespace anki
 class MeshBinaryFile
 {
 public:
-	static constexpr const char* MAGIC = "ANKIMES4";
+	static constexpr const char* MAGIC = "ANKIMES5";
+
+	/// The previous version. It doesn't have LODs. It's still loadable.
+	static constexpr const char* MAGIC_V4 = "ANKIMES4";
 
 	enum class Flag : U32
 	{
@@ -46,6 +49,7 @@ public:
 		F32 m_scale;
 	};
 
+	/// Sub mesh info for the LOD 0.
 	struct SubMesh
 	{
 		U32 m_firstIndex;
@@ -54,6 +58,13 @@ public:
 		Vec3 m_aabbMax; ///< Bounding box max.
 	};
 
+	/// Sub mesh info for the LODs other than 0. They follow the SubMesh array, m_subMeshCount entries per LOD.
+	struct SubMeshLod
+	{
+		U32 m_firstIndex;
+		U32 m_indexCount;
+	};
+
 	struct Header
 	{
 		char m_magic[8]; ///< Magic word.
@@ -73,7 +84,14 @@ public:
 
 		Vec3 m_aabbMin; ///< Bounding box min.
 		Vec3 m_aabbMax; ///< Bounding box max.
+
+		/// The number of LODs embedded in the index buffer. The index buffer has all the sub meshes of LOD 0 then all
+		/// the sub meshes of LOD 1 etc. All LODs share the vertex buffers. Not present in ANKIMES4.
+		U32 m_lodCount;
 	};
+
+	/// The size of the header of the ANKIMES4 files.
+	static constexpr PtrSize HEADER_V4_SIZE = sizeof(Header) - sizeof(U32);
 };
 
 /// Mesh data. This class loads the mesh file and the Mesh class loads it to the CPU.
@@ -96,7 +114,8 @@ public:
 
 	ANKI_USE_RESULT Error storeVertexBuffer(U32 bufferIdx, void* ptr, PtrSize size);
 
-	/// Instead of calling storeIndexBuffer and storeVertexBuffer use this method to get those buffers into the CPU.
+	/// Instead of calling storeIndexBuffer and storeVertexBuffer use this method to get those buffers into the CPU. It
+	/// returns the indices of the LOD 0 only.
 	ANKI_USE_RESULT Error storeIndicesAndPosition(DynamicArrayAuto<U32>& indices, DynamicArrayAuto<Vec3>& positions);
 
 	const MeshBinaryFile::Header& getHeader() const
@@ -116,6 +135,17 @@ public:
 		return ConstWeakArray<MeshBinaryFile::SubMesh>(m_subMeshes);
 	}
 
+	/// Get the sub meshes of a LOD other than 0.
+	ConstWeakArray<MeshBinaryFile::SubMeshLod> getSubMeshLods(U lod) const
+	{
+		ANKI_ASSERT(lod > 0 && lod < m_header.m_lodCount);
+		return ConstWeakArray<MeshBinaryFile::SubMeshLod>(
+			&m_subMeshLods[(lod - 1) * m_header.m_subMeshCount], m_header.m_subMeshCount);
+	}
+
+	/// Get the number of indices of a LOD.
+	U32 getLodIndexCount(U lod) const;
+
 private:
 	ResourceManager* m_manager;
 	GenericMemoryPoolAllocator<U8> m_alloc;
@@ -125,6 +155,7 @@ private:
 	MeshBinaryFile::Header m_header;
 
 	DynamicArray<MeshBinaryFile::SubMesh> m_subMeshes;
+	DynamicArray<MeshBinaryFile::SubMeshLod> m_subMeshLods;
 
 	U32 m_loadedChunk = 0; ///< Because the store methods need to be called in sequence.
 
@@ -138,6 +169,7 @@ private:
 		return m_header.m_totalIndexCount * ((m_header.m_indexType == IndexType::U16) ? 2 : 4);
 	}
 
+	ANKI_USE_RESULT Error loadHeader();
 	ANKI_USE_RESULT Error checkHeader() const;
 	ANKI_USE_RESULT Error checkFormat(VertexAttributeLocation type, ConstWeakArray<Format> supportedFormats) const;
 };
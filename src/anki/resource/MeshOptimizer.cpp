@@ -0,0 +1,641 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/MeshOptimizer.h>
+#include <algorithm>
+#include <cmath>
+
+namespace anki
+{
+
+// Vertex cache optimization constants. Values taken from Forsyth's paper
+static const F32 CACHE_DECAY_POWER = 1.5f;
+static const F32 LAST_TRI_SCORE = 0.75f;
+static const F32 VALENCE_BOOST_SCALE = 2.0f;
+static const F32 VALENCE_BOOST_POWER = 0.5f;
+
+/// The max resolution of the grid the simplifier uses.
+static const U32 MAX_SIMPLIFICATION_GRID_SIZE = 1024;
+
+/// A LOD should have at most that fraction of the indices of the previous LOD. If not the mesh can't be simplified more.
+static const F32 MIN_LOD_REDUCTION = 0.8f;
+
+static F32 computeVertexScore(I32 cachePos, U32 remainingValence)
+{
+	if(remainingValence == 0)
+	{
+		// No triangle needs this vertex
+		return -1.0f;
+	}
+
+	F32 score = 0.0f;
+	if(cachePos >= 0)
+	{
+		if(cachePos < 3)
+		{
+			// It was used in the last triangle. Give it a fixed score so the algorithm doesn't prefer to use the same
+			// triangle edge
+			score = LAST_TRI_SCORE;
+		}
+		else
+		{
+			ANKI_ASSERT(cachePos < I32(MESH_OPTIMIZER_VERTEX_CACHE_SIZE));
+			const F32 scaler = 1.0f / F32(MESH_OPTIMIZER_VERTEX_CACHE_SIZE - 3);
+			score = std::pow(1.0f - F32(cachePos - 3) * scaler, CACHE_DECAY_POWER);
+		}
+	}
+
+	// Bonus for vertices with few triangles left. It helps getting rid of lone triangles
+	score += VALENCE_BOOST_SCALE * std::pow(F32(remainingValence), -VALENCE_BOOST_POWER);
+
+	return score;
+}
+
+void optimizeMeshVertexCache(WeakArray<U32> indices, U32 vertexCount, GenericMemoryPoolAllocator<U8> alloc)
+{
+	ANKI_ASSERT((indices.getSize() % 3) == 0);
+	const U32 triCount = indices.getSize() / 3;
+	if(triCount < 2)
+	{
+		return;
+	}
+
+	// Build the vertex to triangle adjacency
+	DynamicArrayAuto<U32> remainingValences(alloc);
+	remainingValences.create(vertexCount, 0);
+	for(U32 idx : indices)
+	{
+		ANKI_ASSERT(idx < vertexCount);
+		++remainingValences[idx];
+	}
+
+	DynamicArrayAuto<U32> vertTriOffsets(alloc);
+	vertTriOffsets.create(vertexCount);
+	U32 offset = 0;
+	for(U v = 0; v < vertexCount; ++v)
+	{
+		vertTriOffsets[v] = offset;
+		offset += remainingValences[v];
+	}
+
+	DynamicArrayAuto<U32> vertTris(alloc);
+	vertTris.create(indices.getSize());
+	{
+		DynamicArrayAuto<U32> counts(alloc);
+		counts.create(vertexCount, 0);
+		for(U i = 0; i < indices.getSize(); ++i)
+		{
+			const U32 v = indices[i];
+			vertTris[vertTriOffsets[v] + counts[v]++] = i / 3;
+		}
+	}
+
+	// Initial scores
+	DynamicArrayAuto<I32> cachePositions(alloc);
+	cachePositions.create(vertexCount, -1);
+
+	DynamicArrayAuto<F32> vertScores(alloc);
+	vertScores.create(vertexCount);
+	for(U v = 0; v < vertexCount; ++v)
+	{
+		vertScores[v] = computeVertexScore(-1, remainingValences[v]);
+	}
+
+	DynamicArrayAuto<F32> triScores(alloc);
+	triScores.create(triCount);
+	DynamicArrayAuto<Bool8> triEmitted(alloc);
+	triEmitted.create(triCount, false);
+
+	U32 bestTri = 0;
+	for(U t = 0; t < triCount; ++t)
+	{
+		triScores[t] = vertScores[indices[t * 3]] + vertScores[indices[t * 3 + 1]] + vertScores[indices[t * 3 + 2]];
+		if(triScores[t] > triScores[bestTri])
+		{
+			bestTri = t;
+		}
+	}
+
+	// Emit the triangles
+	DynamicArrayAuto<U32> newIndices(alloc);
+	newIndices.create(indices.getSize());
+
+	Array<U32, MESH_OPTIMIZER_VERTEX_CACHE_SIZE + 3> cache;
+	U32 cacheCount = 0;
+	Array<U32, MESH_OPTIMIZER_VERTEX_CACHE_SIZE + 3> newCache;
+	U32 searchCursor = 0;
+
+	for(U32 outTri = 0; outTri < triCount; ++outTri)
+	{
+		if(bestTri == MAX_U32)
+		{
+			// Nothing in the cache, pick the first triangle that is not emitted
+			while(triEmitted[searchCursor])
+			{
+				++searchCursor;
+			}
+
+			bestTri = searchCursor;
+		}
+
+		ANKI_ASSERT(!triEmitted[bestTri]);
+		triEmitted[bestTri] = true;
+
+		U32 newCacheCount = 0;
+		for(U i = 0; i < 3; ++i)
+		{
+			const U32 v = indices[bestTri * 3 + i];
+			newIndices[outTri * 3 + i] = v;
+			newCache[newCacheCount++] = v;
+
+			// Remove the triangle from the active triangles of the vertex
+			const U32 first = vertTriOffsets[v];
+			const U32 last = first + remainingValences[v] - 1;
+			for(U32 j = first; j <= last; ++j)
+			{
+				if(vertTris[j] == bestTri)
+				{
+					std::swap(vertTris[j], vertTris[last]);
+					break;
+				}
+			}
+
+			--remainingValences[v];
+		}
+
+		// Update the cache. The vertices of the new triangle go first
+		for(U i = 0; i < cacheCount; ++i)
+		{
+			const U32 v = cache[i];
+			if(v != newCache[0] && v != newCache[1] && v != newCache[2])
+			{
+				newCache[newCacheCount++] = v;
+			}
+		}
+
+		// Update the scores of the vertices that changed position in the cache
+		bestTri = MAX_U32;
+		F32 bestScore = -1.0f;
+		for(U i = 0; i < newCacheCount; ++i)
+		{
+			const U32 v = newCache[i];
+			cachePositions[v] = (i < MESH_OPTIMIZER_VERTEX_CACHE_SIZE) ? I32(i) : -1;
+
+			const F32 newScore = computeVertexScore(cachePositions[v], remainingValences[v]);
+			const F32 diff = newScore - vertScores[v];
+			vertScores[v] = newScore;
+
+			const U32 first = vertTriOffsets[v];
+			for(U32 j = first; j < first + remainingValences[v]; ++j)
+			{
+				const U32 tri = vertTris[j];
+				triScores[tri] += diff;
+
+				if(triScores[tri] > bestScore)
+				{
+					bestScore = triScores[tri];
+					bestTri = tri;
+				}
+			}
+		}
+
+		cacheCount = min(newCacheCount, MESH_OPTIMIZER_VERTEX_CACHE_SIZE);
+		memcpy(&cache[0], &newCache[0], cacheCount * sizeof(cache[0]));
+	}
+
+	memcpy(&indices[0], &newIndices[0], indices.getSizeInBytes());
+}
+
+void optimizeMeshOverdraw(
+	WeakArray<U32> indices, ConstWeakArray<Vec3> positions, GenericMemoryPoolAllocator<U8> alloc)
+{
+	ANKI_ASSERT((indices.getSize() % 3) == 0);
+	const U32 triCount = indices.getSize() / 3;
+	if(triCount < 2)
+	{
+		return;
+	}
+
+	class Cluster
+	{
+	public:
+		U32 m_firstTri;
+		U32 m_triCount;
+		F32 m_sortKey;
+	};
+
+	// Split the triangles into clusters. A new cluster starts when a triangle misses the cache on all of its vertices.
+	// Re-ordering the clusters at those points doesn't hurt the vertex cache much
+	DynamicArrayAuto<Cluster> clusters(alloc);
+	{
+		DynamicArrayAuto<U32> insertedAt(alloc);
+		insertedAt.create(positions.getSize(), MAX_U32);
+		U32 misses = 0;
+
+		for(U32 t = 0; t < triCount; ++t)
+		{
+			U32 triMisses = 0;
+			for(U i = 0; i < 3; ++i)
+			{
+				const U32 v = indices[t * 3 + i];
+				if(insertedAt[v] == MAX_U32 || misses - insertedAt[v] >= MESH_OPTIMIZER_VERTEX_CACHE_SIZE)
+				{
+					insertedAt[v] = misses++;
+					++triMisses;
+				}
+			}
+
+			if(t == 0 || triMisses == 3)
+			{
+				Cluster& c = *clusters.emplaceBack();
+				c.m_firstTri = t;
+				c.m_triCount = 0;
+				c.m_sortKey = 0.0f;
+			}
+
+			++clusters.getBack().m_triCount;
+		}
+	}
+
+	if(clusters.getSize() < 2)
+	{
+		return;
+	}
+
+	// Compute the centroid of the whole mesh
+	Vec3 meshCentroid(0.0f);
+	F32 meshArea = 0.0f;
+	for(U32 t = 0; t < triCount; ++t)
+	{
+		const Vec3& p0 = positions[indices[t * 3]];
+		const Vec3& p1 = positions[indices[t * 3 + 1]];
+		const Vec3& p2 = positions[indices[t * 3 + 2]];
+
+		const F32 area = (p1 - p0).cross(p2 - p0).getLength();
+		meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+		meshArea += area;
+	}
+
+	if(meshArea > 0.0f)
+	{
+		meshCentroid /= meshArea;
+	}
+
+	// The clusters that point away from the center are more likely to occlude the rest so they should go first
+	for(Cluster& c : clusters)
+	{
+		Vec3 centroid(0.0f);
+		Vec3 normal(0.0f);
+		F32 area = 0.0f;
+		for(U32 t = c.m_firstTri; t < c.m_firstTri + c.m_triCount; ++t)
+		{
+			const Vec3& p0 = positions[indices[t * 3]];
+			const Vec3& p1 = positions[indices[t * 3 + 1]];
+			const Vec3& p2 = positions[indices[t * 3 + 2]];
+
+			const Vec3 n = (p1 - p0).cross(p2 - p0);
+			const F32 triArea = n.getLength();
+			centroid += (p0 + p1 + p2) * (triArea / 3.0f);
+			normal += n;
+			area += triArea;
+		}
+
+		const F32 normalLength = normal.getLength();
+		if(area > 0.0f && normalLength > 0.0f)
+		{
+			centroid /= area;
+			c.m_sortKey = (centroid - meshCentroid).dot(normal / normalLength);
+		}
+	}
+
+	std::stable_sort(clusters.getBegin(), clusters.getEnd(), [](const Cluster& a, const Cluster& b) {
+		return a.m_sortKey > b.m_sortKey;
+	});
+
+	// Write the new order
+	DynamicArrayAuto<U32> newIndices(alloc);
+	newIndices.create(indices.getSize());
+	U32 count = 0;
+	for(const Cluster& c : clusters)
+	{
+		memcpy(&newIndices[count], &indices[c.m_firstTri * 3], c.m_triCount * 3 * sizeof(U32));
+		count += c.m_triCount * 3;
+	}
+
+	ANKI_ASSERT(count == indices.getSize());
+	memcpy(&indices[0], &newIndices[0], indices.getSizeInBytes());
+}
+
+U32 optimizeMeshVertexFetch(WeakArray<U32> indices, WeakArray<U32> remap)
+{
+	for(U32& r : remap)
+	{
+		r = MAX_U32;
+	}
+
+	U32 newVertexCount = 0;
+	for(U32& idx : indices)
+	{
+		ANKI_ASSERT(idx < remap.getSize());
+		if(remap[idx] == MAX_U32)
+		{
+			remap[idx] = newVertexCount++;
+		}
+
+		idx = remap[idx];
+	}
+
+	return newVertexCount;
+}
+
+/// Cluster the vertices in a uniform grid and output the triangles that survive.
+static void simplifyMeshWithGrid(ConstWeakArray<U32> indices,
+	ConstWeakArray<Vec3> positions,
+	const Vec3& aabbMin,
+	const Vec3& aabbMax,
+	U32 gridSize,
+	GenericMemoryPoolAllocator<U8> alloc,
+	DynamicArrayAuto<U32>& vertRepresentatives,
+	DynamicArrayAuto<U32>& outIndices)
+{
+	const Vec3 extend = aabbMax - aabbMin;
+	const F32 cellSize = max(max(extend.x(), extend.y()), max(extend.z(), EPSILON)) / F32(gridSize);
+
+	class VertCell
+	{
+	public:
+		U64 m_cell;
+		U32 m_vert;
+	};
+
+	// Find the cell of each referenced vertex
+	DynamicArrayAuto<VertCell> vertCells(alloc);
+	for(U v = 0; v < positions.getSize(); ++v)
+	{
+		if(vertRepresentatives[v] == MAX_U32)
+		{
+			continue;
+		}
+
+		const Vec3 cellf = (positions[v] - aabbMin) / cellSize;
+		U64 cell = 0;
+		for(U d = 0; d < 3; ++d)
+		{
+			const U64 c = min<U64>(U64(max(cellf[d], 0.0f)), gridSize - 1);
+			cell = cell * gridSize + c;
+		}
+
+		VertCell& vc = *vertCells.emplaceBack();
+		vc.m_cell = cell;
+		vc.m_vert = v;
+	}
+
+	std::sort(vertCells.getBegin(), vertCells.getEnd(), [](const VertCell& a, const VertCell& b) {
+		return (a.m_cell != b.m_cell) ? a.m_cell < b.m_cell : a.m_vert < b.m_vert;
+	});
+
+	// Each cell is represented by the vertex that is closer to the average position of the cell
+	for(U begin = 0; begin < vertCells.getSize();)
+	{
+		U end = begin + 1;
+		Vec3 avg = positions[vertCells[begin].m_vert];
+		while(end < vertCells.getSize() && vertCells[end].m_cell == vertCells[begin].m_cell)
+		{
+			avg += positions[vertCells[end].m_vert];
+			++end;
+		}
+
+		avg /= F32(end - begin);
+
+		U32 representative = MAX_U32;
+		F32 minDist = MAX_F32;
+		for(U i = begin; i < end; ++i)
+		{
+			const F32 dist = (positions[vertCells[i].m_vert] - avg).getLengthSquared();
+			if(dist < minDist)
+			{
+				minDist = dist;
+				representative = vertCells[i].m_vert;
+			}
+		}
+
+		for(U i = begin; i < end; ++i)
+		{
+			vertRepresentatives[vertCells[i].m_vert] = representative;
+		}
+
+		begin = end;
+	}
+
+	// Remap the triangles and remove the degenerate ones
+	class Triangle
+	{
+	public:
+		Array<U32, 3> m_idx;
+	};
+
+	DynamicArrayAuto<Triangle> tris(alloc);
+	for(U i = 0; i < indices.getSize(); i += 3)
+	{
+		const U32 a = vertRepresentatives[indices[i]];
+		const U32 b = vertRepresentatives[indices[i + 1]];
+		const U32 c = vertRepresentatives[indices[i + 2]];
+		if(a == b || b == c || a == c)
+		{
+			continue;
+		}
+
+		// Rotate so the smallest index goes first. It keeps the winding and makes the duplicates identical
+		Triangle& tri = *tris.emplaceBack();
+		if(a < b && a < c)
+		{
+			tri.m_idx = {{a, b, c}};
+		}
+		else if(b < a && b < c)
+		{
+			tri.m_idx = {{b, c, a}};
+		}
+		else
+		{
+			tri.m_idx = {{c, a, b}};
+		}
+	}
+
+	// Remove the duplicates
+	std::sort(tris.getBegin(), tris.getEnd(), [](const Triangle& a, const Triangle& b) {
+		return (a.m_idx[0] != b.m_idx[0]) ? a.m_idx[0] < b.m_idx[0]
+										  : ((a.m_idx[1] != b.m_idx[1]) ? a.m_idx[1] < b.m_idx[1]
+																		: a.m_idx[2] < b.m_idx[2]);
+	});
+
+	outIndices.resize(0);
+	for(U i = 0; i < tris.getSize(); ++i)
+	{
+		if(i > 0 && tris[i].m_idx[0] == tris[i - 1].m_idx[0] && tris[i].m_idx[1] == tris[i - 1].m_idx[1]
+			&& tris[i].m_idx[2] == tris[i - 1].m_idx[2])
+		{
+			continue;
+		}
+
+		outIndices.emplaceBack(tris[i].m_idx[0]);
+		outIndices.emplaceBack(tris[i].m_idx[1]);
+		outIndices.emplaceBack(tris[i].m_idx[2]);
+	}
+}
+
+void simplifyMesh(ConstWeakArray<U32> indices,
+	ConstWeakArray<Vec3> positions,
+	U32 targetIndexCount,
+	GenericMemoryPoolAllocator<U8> alloc,
+	DynamicArrayAuto<U32>& outIndices)
+{
+	ANKI_ASSERT((indices.getSize() % 3) == 0);
+	outIndices.resize(0);
+	if(indices.getSize() == 0)
+	{
+		return;
+	}
+
+	// Compute the bounding box of the referenced vertices
+	Vec3 aabbMin(MAX_F32);
+	Vec3 aabbMax(MIN_F32);
+	for(U32 idx : indices)
+	{
+		aabbMin = aabbMin.min(positions[idx]);
+		aabbMax = aabbMax.max(positions[idx]);
+	}
+
+	DynamicArrayAuto<U32> vertRepresentatives(alloc);
+	vertRepresentatives.create(positions.getSize());
+
+	auto simplify = [&](U32 gridSize, DynamicArrayAuto<U32>& out) {
+		for(U32& r : vertRepresentatives)
+		{
+			r = MAX_U32;
+		}
+
+		// Mark the referenced vertices
+		for(U32 idx : indices)
+		{
+			vertRepresentatives[idx] = idx;
+		}
+
+		simplifyMeshWithGrid(indices, positions, aabbMin, aabbMax, gridSize, alloc, vertRepresentatives, out);
+	};
+
+	// Binary search the biggest grid that gives less indices than the target
+	DynamicArrayAuto<U32> tmp(alloc);
+	U32 low = 1;
+	U32 high = MAX_SIMPLIFICATION_GRID_SIZE;
+	U32 best = MAX_U32;
+	while(low <= high)
+	{
+		const U32 mid = (low + high) / 2;
+		simplify(mid, tmp);
+
+		if(tmp.getSize() <= targetIndexCount)
+		{
+			best = mid;
+			low = mid + 1;
+
+			if(tmp.getSize() > 0)
+			{
+				outIndices = std::move(tmp);
+				tmp = DynamicArrayAuto<U32>(alloc);
+			}
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+
+	// If the best grid collapses everything use the next resolution even if it gives more indices than the target
+	if(outIndices.getSize() == 0 && best < MAX_SIMPLIFICATION_GRID_SIZE)
+	{
+		simplify((best == MAX_U32) ? 1 : best + 1, outIndices);
+	}
+}
+
+F32 computeMeshAcmr(ConstWeakArray<U32> indices, U32 vertexCount, U32 cacheSize, GenericMemoryPoolAllocator<U8> alloc)
+{
+	ANKI_ASSERT((indices.getSize() % 3) == 0 && cacheSize > 0);
+	if(indices.getSize() == 0)
+	{
+		return 0.0f;
+	}
+
+	// A vertex is in the FIFO cache if less than cacheSize vertices were inserted after it
+	DynamicArrayAuto<U32> insertedAt(alloc);
+	insertedAt.create(vertexCount, MAX_U32);
+	U32 misses = 0;
+
+	for(U32 idx : indices)
+	{
+		if(insertedAt[idx] == MAX_U32 || misses - insertedAt[idx] >= cacheSize)
+		{
+			insertedAt[idx] = misses++;
+		}
+	}
+
+	return F32(misses) / F32(indices.getSize() / 3);
+}
+
+U32 optimizeMeshAndGenerateLods(ConstWeakArray<U32> indices,
+	ConstWeakArray<Vec3> positions,
+	U32 maxLodCount,
+	GenericMemoryPoolAllocator<U8> alloc,
+	DynamicArrayAuto<U32>& outIndices,
+	Array<U32, MAX_LOD_COUNT>& outLodIndexCounts,
+	DynamicArrayAuto<U32>& outRemap,
+	U32& outVertexCount)
+{
+	ANKI_ASSERT(maxLodCount > 0 && maxLodCount <= MAX_LOD_COUNT);
+	const U32 vertexCount = positions.getSize();
+
+	// LOD 0
+	outIndices.resize(indices.getSize());
+	memcpy(&outIndices[0], &indices[0], indices.getSizeInBytes());
+	optimizeMeshVertexCache(WeakArray<U32>(outIndices), vertexCount, alloc);
+	optimizeMeshOverdraw(WeakArray<U32>(outIndices), positions, alloc);
+
+	for(U32& count : outLodIndexCounts)
+	{
+		count = 0;
+	}
+	outLodIndexCounts[0] = indices.getSize();
+
+	// Other LODs. Always simplify the LOD 0 to avoid accumulating errors
+	U32 lodCount = 1;
+	DynamicArrayAuto<U32> lodIndices(alloc);
+	for(U32 lod = 1; lod < maxLodCount; ++lod)
+	{
+		const U32 target = (indices.getSize() >> lod) / 3 * 3;
+		simplifyMesh(indices, positions, target, alloc, lodIndices);
+
+		if(lodIndices.getSize() == 0
+			|| F32(lodIndices.getSize()) > F32(outLodIndexCounts[lod - 1]) * MIN_LOD_REDUCTION)
+		{
+			break;
+		}
+
+		optimizeMeshVertexCache(WeakArray<U32>(lodIndices), vertexCount, alloc);
+
+		const U32 offset = outIndices.getSize();
+		outIndices.resize(offset + lodIndices.getSize());
+		memcpy(&outIndices[offset], &lodIndices[0], lodIndices.getSizeInBytes());
+
+		outLodIndexCounts[lod] = lodIndices.getSize();
+		++lodCount;
+	}
+
+	// Vertex fetch optimization goes last because it needs all the LODs
+	outRemap.resize(vertexCount);
+	outVertexCount = optimizeMeshVertexFetch(WeakArray<U32>(outIndices), WeakArray<U32>(outRemap));
+
+	return lodCount;
+}
+
+} // end namespace anki
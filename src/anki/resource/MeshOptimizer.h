@@ -0,0 +1,104 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/Common.h>
+#include <anki/Math.h>
+#include <anki/util/WeakArray.h>
+#include <anki/util/DynamicArray.h>
+
+namespace anki
+{
+
+/// @addtogroup resource
+/// @{
+
+/// The size of the post-transform vertex cache the optimizations target.
+const U32 MESH_OPTIMIZER_VERTEX_CACHE_SIZE = 32;
+
+/// Reorder the triangles to make better use of the post-transform vertex cache. It's based on Tom Forsyth's "Linear-Speed
+/// Vertex Cache Optimisation".
+/// @param[in,out] indices The triangle list.
+/// @param vertexCount The number of vertices the indices reference.
+/// @param alloc Allocator for temporary memory.
+void optimizeMeshVertexCache(WeakArray<U32> indices, U32 vertexCount, GenericMemoryPoolAllocator<U8> alloc);
+
+/// Reorder groups of triangles so the ones that face outwards are drawn first. It reduces the overdraw. Call it after
+/// optimizeMeshVertexCache because it keeps the order of the triangles inside the groups.
+/// @param[in,out] indices The triangle list.
+/// @param positions The positions of the vertices.
+/// @param alloc Allocator for temporary memory.
+void optimizeMeshOverdraw(
+	WeakArray<U32> indices, ConstWeakArray<Vec3> positions, GenericMemoryPoolAllocator<U8> alloc);
+
+/// Reorder the vertices in the order they are first referenced by the indices. It improves the locality of the vertex
+/// fetches. It rewrites the indices and returns a remap table that should be applied to the vertex attributes with
+/// remapMeshVertices.
+/// @param[in,out] indices The triangle list.
+/// @param[out] remap The new index of each old vertex or MAX_U32 if the vertex is not referenced. It's size should be
+///                   the vertex count.
+/// @return The new vertex count.
+U32 optimizeMeshVertexFetch(WeakArray<U32> indices, WeakArray<U32> remap);
+
+/// Apply the remap table of optimizeMeshVertexFetch to some vertex attribute.
+template<typename T>
+void remapMeshVertices(
+	ConstWeakArray<U32> remap, U32 newVertexCount, DynamicArrayAuto<T>& attribute, GenericMemoryPoolAllocator<U8> alloc)
+{
+	ANKI_ASSERT(remap.getSize() == attribute.getSize());
+
+	DynamicArrayAuto<T> newAttribute(alloc);
+	newAttribute.create(newVertexCount);
+
+	for(U i = 0; i < remap.getSize(); ++i)
+	{
+		if(remap[i] != MAX_U32)
+		{
+			newAttribute[remap[i]] = attribute[i];
+		}
+	}
+
+	attribute = std::move(newAttribute);
+}
+
+/// Create a simplified version of a triangle list. It uses vertex clustering so the output references a subset of the
+/// input vertices and the vertex buffers can be shared between the LODs.
+/// @param indices The triangle list.
+/// @param positions The positions of the vertices.
+/// @param targetIndexCount The simplifier will try to output this number of indices. It might output more.
+/// @param alloc Allocator for temporary memory.
+/// @param[out] outIndices The simplified triangle list.
+void simplifyMesh(ConstWeakArray<U32> indices,
+	ConstWeakArray<Vec3> positions,
+	U32 targetIndexCount,
+	GenericMemoryPoolAllocator<U8> alloc,
+	DynamicArrayAuto<U32>& outIndices);
+
+/// Compute the average cache miss ratio (vertex transformations per triangle) of a triangle list assuming a FIFO cache.
+/// Useful to measure the vertex cache optimization.
+F32 computeMeshAcmr(ConstWeakArray<U32> indices, U32 vertexCount, U32 cacheSize, GenericMemoryPoolAllocator<U8> alloc);
+
+/// Run all the optimizations and generate the LODs of a triangle list. The LODs are placed one after the other in the
+/// output index buffer and all of them share the same vertices.
+/// @param indices The LOD 0 triangle list.
+/// @param positions The positions of the vertices.
+/// @param maxLodCount The max number of LODs to generate. It might generate less if the mesh can't be simplified.
+/// @param alloc Allocator for temporary memory.
+/// @param[out] outIndices The indices of all LODs.
+/// @param[out] outLodIndexCounts The index count of each LOD.
+/// @param[out] outRemap The remap table that needs to be applied to the vertex attributes with remapMeshVertices.
+/// @return The number of LODs.
+U32 optimizeMeshAndGenerateLods(ConstWeakArray<U32> indices,
+	ConstWeakArray<Vec3> positions,
+	U32 maxLodCount,
+	GenericMemoryPoolAllocator<U8> alloc,
+	DynamicArrayAuto<U32>& outIndices,
+	Array<U32, MAX_LOD_COUNT>& outLodIndexCounts,
+	DynamicArrayAuto<U32>& outRemap,
+	U32& outVertexCount);
+/// @}
+
+} // end namespace anki
@@ -83,20 +83,32 @@ Error MeshResource::load(const ResourceFilename& filename, Bool async)
 	const MeshBinaryFile::Header& header = loader.getHeader();
 
 	// Get submeshes
+	m_lodCount = header.m_lodCount;
 	m_subMeshes.create(getAllocator(), header.m_subMeshCount);
 	for(U i = 0; i < m_subMeshes.getSize(); ++i)
 	{
-		m_subMeshes[i].m_firstIndex = loader.getSubMeshes()[i].m_firstIndex;
-		m_subMeshes[i].m_indexCount = loader.getSubMeshes()[i].m_indexCount;
+		m_subMeshes[i].m_firstIndices[0] = loader.getSubMeshes()[i].m_firstIndex;
+		m_subMeshes[i].m_indexCounts[0] = loader.getSubMeshes()[i].m_indexCount;
+
+		for(U lod = 1; lod < m_lodCount; ++lod)
+		{
+			m_subMeshes[i].m_firstIndices[lod] = loader.getSubMeshLods(lod)[i].m_firstIndex;
+			m_subMeshes[i].m_indexCounts[lod] = loader.getSubMeshLods(lod)[i].m_indexCount;
+		}
 
 		const Vec3 obbCenter = (loader.getSubMeshes()[i].m_aabbMax + loader.getSubMeshes()[i].m_aabbMin) / 2.0f;
 		const Vec3 obbExtend = loader.getSubMeshes()[i].m_aabbMax - obbCenter;
 		m_subMeshes[i].m_obb = Obb(obbCenter.xyz0(), Mat3x4::getIdentity(), obbExtend.xyz0());
 	}
 
-	// Index stuff
+	// Index stuff. The sub meshes of each LOD are contiguous
 	m_indexCount = header.m_totalIndexCount;
 	ANKI_ASSERT((m_indexCount % 3) == 0 && "Expecting triangles");
+	for(U lod = 0; lod < m_lodCount; ++lod)
+	{
+		m_lodFirstIndices[lod] = m_subMeshes[0].m_firstIndices[lod];
+		m_lodIndexCounts[lod] = loader.getLodIndexCount(lod);
+	}
 	m_indexType = header.m_indexType;
 
 	const PtrSize indexBuffSize = m_indexCount * ((m_indexType == IndexType::U32) ? 4 : 2);
@@ -40,12 +40,19 @@ public:
 		return m_obb;
 	}
 
-	/// Get submesh info.
+	/// Get submesh info of the LOD 0.
 	void getSubMeshInfo(U subMeshId, U32& firstIndex, U32& indexCount, const Obb*& obb) const
 	{
+		getSubMeshInfo(subMeshId, 0, firstIndex, indexCount, obb);
+	}
+
+	/// Get submesh info of some LOD.
+	void getSubMeshInfo(U subMeshId, U lod, U32& firstIndex, U32& indexCount, const Obb*& obb) const
+	{
+		ANKI_ASSERT(lod < m_lodCount);
 		const SubMesh& sm = m_subMeshes[subMeshId];
-		firstIndex = sm.m_firstIndex;
-		indexCount = sm.m_indexCount;
+		firstIndex = sm.m_firstIndices[lod];
+		indexCount = sm.m_indexCounts[lod];
 		obb = &sm.m_obb;
 	}
 
@@ -54,15 +61,29 @@ public:
 		return m_subMeshes.getSize();
 	}
 
-	/// Get all info around vertex indices.
+	/// Get all info around vertex indices. The index count is the count of LOD 0.
 	void getIndexBufferInfo(BufferPtr& buff, PtrSize& buffOffset, U32& indexCount, IndexType& indexType) const
 	{
 		buff = m_indexBuff;
 		buffOffset = 0;
-		indexCount = m_indexCount;
+		indexCount = m_lodIndexCounts[0];
 		indexType = m_indexType;
 	}
 
+	/// Get the number of LODs that are embedded in the index buffer.
+	U32 getLodCount() const
+	{
+		return m_lodCount;
+	}
+
+	/// Get the range of the index buffer that contains all the sub meshes of a LOD.
+	void getLodIndexInfo(U lod, U32& firstIndex, U32& indexCount) const
+	{
+		ANKI_ASSERT(lod < m_lodCount);
+		firstIndex = m_lodFirstIndices[lod];
+		indexCount = m_lodIndexCounts[lod];
+	}
+
 	/// Get the number of logical vertex buffers.
 	U32 getVertexBufferCount() const
 	{
@@ -114,14 +135,17 @@ protected:
 	/// Sub-mesh data
 	struct SubMesh
 	{
-		U32 m_firstIndex;
-		U32 m_indexCount;
+		Array<U32, MAX_LOD_COUNT> m_firstIndices;
+		Array<U32, MAX_LOD_COUNT> m_indexCounts;
 		Obb m_obb;
 	};
 	DynamicArray<SubMesh> m_subMeshes;
 
 	// Index stuff
-	U32 m_indexCount = 0;
+	U32 m_indexCount = 0; ///< The index count of all LODs.
+	Array<U32, MAX_LOD_COUNT> m_lodFirstIndices = {};
+	Array<U32, MAX_LOD_COUNT> m_lodIndexCounts = {};
+	U8 m_lodCount = 1;
 	BufferPtr m_indexBuff;
 	IndexType m_indexType = IndexType::COUNT;
 
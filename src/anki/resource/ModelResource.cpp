@@ -46,9 +46,8 @@ void ModelPatch::getRenderingDataSub(
 	const Bool hasSkin = m_model->getSkeleton().isCreated();
 
 	// Get the resources
-	RenderingKey meshKey = key;
-	meshKey.m_lod = min<U>(key.m_lod, m_meshCount - 1);
-	const MeshResource& mesh = getMesh(meshKey);
+	U embeddedLod;
+	const MeshResource& mesh = getMeshForLod(key.m_lod, embeddedLod);
 
 	// Get program
 	{
@@ -104,16 +103,50 @@ void ModelPatch::getRenderingDataSub(
 	U32 indexCount;
 	mesh.getIndexBufferInfo(inf.m_indexBuffer, inf.m_indexBufferOffset, indexCount, inf.m_indexType);
 
+	U32 firstIndex;
+	mesh.getLodIndexInfo(embeddedLod, firstIndex, indexCount);
+
 	// Other
 	ANKI_ASSERT(subMeshIndicesArray.getSize() == 0 && mesh.getSubMeshCount() == 1 && "Not supported ATM");
 	inf.m_drawcallCount = 1;
-	inf.m_indicesOffsetArray[0] = 0;
+	inf.m_indicesOffsetArray[0] = firstIndex * ((inf.m_indexType == IndexType::U16) ? sizeof(U16) : sizeof(U32));
 	inf.m_indicesCountArray[0] = indexCount;
 }
 
+const MeshResource& ModelPatch::getMeshForLod(U lod, U& embeddedLod) const
+{
+	ANKI_ASSERT(m_meshCount > 0);
+
+	if(lod < m_meshCount)
+	{
+		embeddedLod = 0;
+		return *m_meshes[lod];
+	}
+	else
+	{
+		const MeshResource& mesh = *m_meshes[m_meshCount - 1];
+		embeddedLod = min<U>(lod - (m_meshCount - 1), mesh.getLodCount() - 1);
+		return mesh;
+	}
+}
+
 U ModelPatch::getLodCount() const
 {
-	return max<U>(m_meshCount, getMaterial()->getLodCount());
+	const U meshLodCount = m_meshCount - 1 + m_meshes[m_meshCount - 1]->getLodCount();
+	return max<U>(meshLodCount, getMaterial()->getLodCount());
+}
+
+U32 ModelPatch::getLodTriangleCount(U lod) const
+{
+	ANKI_ASSERT(lod < getLodCount());
+
+	U embeddedLod;
+	const MeshResource& mesh = getMeshForLod(lod, embeddedLod);
+
+	U32 firstIndex, indexCount;
+	mesh.getLodIndexInfo(embeddedLod, firstIndex, indexCount);
+
+	return indexCount / 3;
 }
 
 Error ModelPatch::create(
@@ -129,6 +129,12 @@ public:
 	/// offsets and counts.
 	void getRenderingDataSub(const RenderingKey& key, WeakArray<U8> subMeshIndicesArray, ModelRenderingInfo& inf) const;
 
+	/// Return the maximum number of LODs
+	U getLodCount() const;
+
+	/// Get the number of triangles that will be drawn for a LOD.
+	U32 getLodTriangleCount(U lod) const;
+
 private:
 	ModelResource* m_model ANKI_DBG_NULLIFY;
 
@@ -136,8 +142,8 @@ private:
 	U8 m_meshCount = 0;
 	MaterialResourcePtr m_mtl;
 
-	/// Return the maximum number of LODs
-	U getLodCount() const;
+	/// Get the mesh of a LOD. If the LOD doesn't have a separate mesh it will use a LOD embedded in the last mesh.
+	const MeshResource& getMeshForLod(U lod, U& embeddedLod) const;
 };
 
 /// Model is an entity that acts as a container for other resources. Models are all the non static objects in a map.
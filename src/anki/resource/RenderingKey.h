@@ -27,18 +27,18 @@ class RenderingKey
 public:
 	Pass m_pass;
 	U8 m_lod;
-	U8 m_instanceCount;
 	Bool8 m_skinned;
 	Bool8 m_velocity;
+	U32 m_instanceCount; ///< It can be more than MAX_INSTANCES.
 
 	RenderingKey(Pass pass, U8 lod, U instanceCount, Bool8 skinned, Bool8 velocity)
 		: m_pass(pass)
 		, m_lod(lod)
-		, m_instanceCount(instanceCount)
 		, m_skinned(skinned)
 		, m_velocity(velocity)
+		, m_instanceCount(instanceCount)
 	{
-		ANKI_ASSERT(m_instanceCount <= MAX_INSTANCES && m_instanceCount != 0);
+		ANKI_ASSERT(m_instanceCount != 0);
 		ANKI_ASSERT(m_lod <= MAX_LOD_COUNT);
 	}
 
@@ -62,7 +62,7 @@ public:
 template<>
 constexpr Bool isPacked<RenderingKey>()
 {
-	return sizeof(RenderingKey) == 5;
+	return sizeof(RenderingKey) == 8;
 }
 
 /// The hash function
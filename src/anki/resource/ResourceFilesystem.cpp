@@ -413,4 +413,53 @@ Error ResourceFilesystem::openFile(const ResourceFilename& filename, ResourceFil
 	return Error::NONE;
 }
 
+Error ResourceFilesystem::getFileModificationTime(const ResourceFilename& filename, U64& time) const
+{
+	StringAuto location(m_alloc);
+	ANKI_CHECK(getFileLocation(filename, location));
+	return anki::getFileModificationTime(location.toCString(), time);
+}
+
+Error ResourceFilesystem::getFileLocation(const ResourceFilename& filename, StringAuto& location) const
+{
+	// Search the paths the same way openFile() does
+	for(const Path& p : m_paths)
+	{
+		if(p.m_isCache)
+		{
+			location.destroy();
+			location.sprintf("%s/%s", &p.m_path[0], &filename[0]);
+			if(fileExists(location.toCString()))
+			{
+				return Error::NONE;
+			}
+		}
+		else
+		{
+			for(const String& pfname : p.m_files)
+			{
+				if(pfname != filename)
+				{
+					continue;
+				}
+
+				location.destroy();
+				if(p.m_isArchive)
+				{
+					location.create(p.m_path.toCString());
+				}
+				else
+				{
+					location.sprintf("%s/%s", &p.m_path[0], &filename[0]);
+				}
+
+				return Error::NONE;
+			}
+		}
+	}
+
+	ANKI_RESOURCE_LOGE("File not found: %s", &filename[0]);
+	return Error::USER_DATA;
+}
+
 } // end namespace anki
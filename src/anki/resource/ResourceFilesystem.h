@@ -89,6 +89,33 @@ public:
 	/// Search the path list to find the file. Then open the file for reading. It's thread-safe.
 	ANKI_USE_RESULT Error openFile(const ResourceFilename& filename, ResourceFilePtr& file);
 
+	/// Get the time the file was last modified. For files inside archives it's the time of the archive. It's
+	/// thread-safe.
+	ANKI_USE_RESULT Error getFileModificationTime(const ResourceFilename& filename, U64& time) const;
+
+	/// Get the file of the OS filesystem that holds a file. It's the file itself or the archive it's in. It's
+	/// thread-safe.
+	ANKI_USE_RESULT Error getFileLocation(const ResourceFilename& filename, StringAuto& location) const;
+
+	/// Iterate the filenames of all the files in the data paths and archives. The cache is not included.
+	/// @param func Called as func(CString filename) and returns Error.
+	template<typename TFunc>
+	ANKI_USE_RESULT Error iterateAllFilenames(TFunc func) const
+	{
+		for(const Path& p : m_paths)
+		{
+			if(!p.m_isCache)
+			{
+				for(const String& fname : p.m_files)
+				{
+					ANKI_CHECK(func(fname.toCString()));
+				}
+			}
+		}
+
+		return Error::NONE;
+	}
+
 #if !ANKI_TESTS
 private:
 #endif
@@ -16,9 +16,17 @@
 #include <anki/resource/GenericResource.h>
 #include <anki/resource/TextureAtlasResource.h>
 #include <anki/resource/ShaderProgramResource.h>
+#include <anki/resource/ShaderProgramPackage.h>
+#include <anki/resource/ShaderProgramPreProcessor.h>
+#include <anki/resource/ResourceFilesystem.h>
+#include <anki/resource/TextureStreamer.h>
+#include <anki/resource/ResourceWatcher.h>
 #include <anki/util/Logger.h>
 #include <anki/misc/ConfigSet.h>
 #include <anki/gr/ShaderCompiler.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/Filesystem.h>
+#include <anki/core/Trace.h>
 
 namespace anki
 {
@@ -31,7 +39,11 @@ ResourceManager::~ResourceManager()
 {
 	m_cacheDir.destroy(m_alloc);
 	m_alloc.deleteInstance(m_asyncLoader);
+	m_alloc.deleteInstance(m_textureStreamer);
+	m_alloc.deleteInstance(m_resourceWatcher);
 	m_alloc.deleteInstance(m_transferGpuAlloc);
+	m_alloc.deleteInstance(m_shaderPackage);
+	m_alloc.deleteInstance(m_shaderPreprocessorCache);
 	m_alloc.deleteInstance(m_shaderCompiler);
 }
 
@@ -70,9 +82,110 @@ Error ResourceManager::init(ResourceManagerInitInfo& init)
 
 	m_shaderCompiler = m_alloc.newInstance<ShaderCompilerCache>(m_alloc, m_cacheDir.toCString());
 
+	m_shaderPreprocessorCache = m_alloc.newInstance<ShaderProgramPreprocessorCache>(m_alloc, m_fs);
+
+	m_shaderPackage = m_alloc.newInstance<ShaderProgramPackage>();
+	CString packageFilename = init.m_config->getString("rsrc.shaderProgramPackage");
+	if(packageFilename)
+	{
+		ShaderCompilerOptions options;
+		options.setFromGrManager(*m_gr);
+		ANKI_CHECK(m_shaderPackage->load(m_alloc, packageFilename, options));
+	}
+
+	m_textureStreamer = m_alloc.newInstance<TextureStreamer>(this);
+	ANKI_CHECK(m_textureStreamer->init(*init.m_config));
+
+	if(init.m_config->getNumber("rsrc.hotReload"))
+	{
+		m_resourceWatcher = m_alloc.newInstance<ResourceWatcher>(this);
+		ANKI_RESOURCE_LOGI("Resource hot-reloading is enabled");
+	}
+
 	return Error::NONE;
 }
 
+void ResourceManager::preprocessShaderPrograms(ThreadHive& hive)
+{
+	ANKI_TRACE_SCOPED_EVENT(RSRC_PREPROCESS_SHADER_PROGRAMS);
+
+	class Context
+	{
+	public:
+		ResourceManager* m_manager;
+		DynamicArrayAuto<CString> m_filenames;
+		Atomic<U32> m_crntFilename = {0};
+
+		Context(ResourceManager* manager)
+			: m_manager(manager)
+			, m_filenames(manager->m_alloc)
+		{
+		}
+	} ctx(this);
+
+	// Gather the programs
+	const Error err = m_fs->iterateAllFilenames([&](CString fname) -> Error {
+		StringAuto ext(m_tmpAlloc);
+		getFilepathExtension(fname, ext);
+		if(ext == "glslp")
+		{
+			ctx.m_filenames.emplaceBack(fname);
+		}
+
+		return Error::NONE;
+	});
+	ANKI_ASSERT(!err);
+	(void)err;
+
+	// Every task takes programs until there are no more
+	DynamicArrayAuto<ThreadHiveTask> tasks(m_alloc);
+	tasks.create(hive.getThreadCount());
+	for(ThreadHiveTask& task : tasks)
+	{
+		task = ANKI_THREAD_HIVE_TASK(
+			{
+				U32 idx;
+				while((idx = self->m_crntFilename.fetchAdd(1)) < self->m_filenames.getSize())
+				{
+					ANKI_TRACE_SCOPED_EVENT(RSRC_PREPROCESS_SHADER_PROGRAM);
+					ResourceManager& manager = *self->m_manager;
+					ShaderProgramPreprocessor pp(self->m_filenames[idx],
+						manager.m_fs,
+						manager.m_tmpAlloc,
+						manager.m_shaderPreprocessorCache);
+
+					// The errors are logged. Ignore them, loading the program will fail later
+					const Error err = pp.parse();
+					(void)err;
+				}
+			},
+			&ctx,
+			nullptr,
+			nullptr);
+	}
+
+	hive.submitTasks(&tasks[0], tasks.getSize());
+	hive.waitAllTasks();
+
+	ANKI_RESOURCE_LOGI("Preprocessed %u shader programs", ctx.m_filenames.getSize());
+}
+
+void ResourceManager::watchResource(ResourceObject& rsrc)
+{
+	if(m_resourceWatcher)
+	{
+		m_resourceWatcher->watchResource(rsrc);
+	}
+}
+
+void ResourceManager::unwatchResource(ResourceObject& rsrc)
+{
+	if(m_resourceWatcher)
+	{
+		m_resourceWatcher->unwatchResource(rsrc);
+	}
+}
+
 U64 ResourceManager::getAsyncTaskCompletedCount() const
 {
 	return m_asyncLoader->getCompletedTaskCount();
@@ -20,7 +20,13 @@ class PhysicsWorld;
 class ResourceManager;
 class AsyncLoader;
 class ResourceManagerModel;
+class ResourceObject;
+class ResourceWatcher;
 class ShaderCompilerCache;
+class ShaderProgramPackage;
+class ShaderProgramPreprocessorCache;
+class ThreadHive;
+class TextureStreamer;
 
 /// @addtogroup resource
 /// @{
@@ -127,6 +133,10 @@ public:
 	template<typename T>
 	ANKI_USE_RESULT Error loadResource(const CString& filename, ResourcePtr<T>& out, Bool async = true);
 
+	/// Preprocess all the shader programs of the data paths in parallel. It fills the cache of the preprocessor so the
+	/// shader programs that are loaded later don't read and tokenize their include files again.
+	void preprocessShaderPrograms(ThreadHive& hive);
+
 anki_internal:
 	U32 getMaxTextureSize() const
 	{
@@ -191,6 +201,7 @@ anki_internal:
 	template<typename T>
 	void unregisterResource(T* ptr)
 	{
+		unwatchResource(*ptr);
 		TypeResourceManager<T>::unregisterResource(ptr);
 	}
 
@@ -199,12 +210,37 @@ anki_internal:
 		return *m_asyncLoader;
 	}
 
+	TextureStreamer& getTextureStreamer()
+	{
+		ANKI_ASSERT(m_textureStreamer);
+		return *m_textureStreamer;
+	}
+
 	const ShaderCompilerCache& getShaderCompiler() const
 	{
 		ANKI_ASSERT(m_shaderCompiler);
 		return *m_shaderCompiler;
 	}
 
+	ShaderProgramPreprocessorCache& getShaderProgramPreprocessorCache()
+	{
+		ANKI_ASSERT(m_shaderPreprocessorCache);
+		return *m_shaderPreprocessorCache;
+	}
+
+	/// It's nullptr if the resources are not hot-reloaded.
+	ResourceWatcher* getResourceWatcher()
+	{
+		return m_resourceWatcher;
+	}
+
+	/// The precompiled shader programs. It's not loaded if there is no package.
+	const ShaderProgramPackage& getShaderProgramPackage() const
+	{
+		ANKI_ASSERT(m_shaderPackage);
+		return *m_shaderPackage;
+	}
+
 	/// Get the number of times loadResource() was called.
 	U64 getLoadingRequestCount() const
 	{
@@ -228,6 +264,15 @@ private:
 	U64 m_loadRequestCount = 0;
 	TransferGpuAllocator* m_transferGpuAlloc = nullptr;
 	ShaderCompilerCache* m_shaderCompiler = nullptr;
+	ShaderProgramPackage* m_shaderPackage = nullptr;
+	ShaderProgramPreprocessorCache* m_shaderPreprocessorCache = nullptr;
+	TextureStreamer* m_textureStreamer = nullptr;
+	ResourceWatcher* m_resourceWatcher = nullptr;
+
+	/// Start watching the files of a loaded resource if hot-reloading is enabled.
+	void watchResource(ResourceObject& rsrc);
+
+	void unwatchResource(ResourceObject& rsrc);
 };
 /// @}
 
@@ -59,6 +59,7 @@ Error ResourceManager::loadResource(const CString& filename, ResourcePtr<T>& out
 
 		// Register resource
 		registerResource(ptr);
+		watchResource(*ptr);
 		out.reset(ptr);
 	}
 
@@ -6,6 +6,9 @@
 #include <anki/resource/ResourceObject.h>
 #include <anki/resource/ResourceManager.h>
 #include <anki/misc/Xml.h>
+#include <anki/util/Filesystem.h>
+#include <anki/util/Hash.h>
+#include <anki/util/Thread.h>
 
 namespace anki
 {
@@ -54,8 +57,37 @@ Error ResourceObject::openFileParseXml(const CString& filename, XmlDocument& xml
 	StringAuto txt(getTempAllocator());
 	ANKI_CHECK(openFileReadAllText(filename, txt));
 
+	const String& cacheDir = m_manager->getCacheDirectory();
+	if(cacheDir.isEmpty() || txt.isEmpty())
+	{
+		return xml.parse(txt.toCString(), getTempAllocator());
+	}
+
+	// Search the cache for the compiled document. It's keyed by the text so edited files are compiled again
+	const U64 hash = computeHash(&txt[0], txt.getLength());
+	StringAuto binFname(getTempAllocator());
+	binFname.sprintf("%s/%llu.xmlbin", cacheDir.cstr(), hash);
+	if(fileExists(binFname.toCString()))
+	{
+		if(!xml.loadBinaryFile(binFname.toCString(), getTempAllocator()))
+		{
+			return Error::NONE;
+		}
+
+		ANKI_RESOURCE_LOGW("Will parse the XML again: %s", &filename[0]);
+	}
+
 	ANKI_CHECK(xml.parse(txt.toCString(), getTempAllocator()));
 
+	// The resource can load without the cache. Write to a file of this thread and move it over the cached one so other
+	// threads or processes never read a half written file
+	StringAuto tmpFname(getTempAllocator());
+	tmpFname.sprintf("%s.%llu.tmp", binFname.cstr(), Thread::getCurrentThreadId());
+	if(xml.writeBinaryFile(tmpFname.toCString()) || renameFile(tmpFname.toCString(), binFname.toCString()))
+	{
+		ANKI_RESOURCE_LOGW("Failed to cache the compiled XML: %s", &filename[0]);
+	}
+
 	return Error::NONE;
 }
 
@@ -9,6 +9,7 @@
 #include <anki/resource/ResourceFilesystem.h>
 #include <anki/util/Atomic.h>
 #include <anki/util/String.h>
+#include <anki/util/StringList.h>
 
 namespace anki
 {
@@ -80,6 +81,26 @@ anki_internal:
 
 	ANKI_USE_RESULT Error openFileParseXml(const ResourceFilename& filename, XmlDocument& xml);
 
+	/// Get the files the resource is loaded from. The ResourceWatcher reloads the resource when one of them changes.
+	/// The resources that can't be reloaded leave it empty.
+	virtual void getReloadDependencies(StringListAuto& files) const
+	{
+	}
+
+	/// Load the resource again from its files. It runs in the async loader while the resource is in use so it shouldn't
+	/// change anything the users of the resource see.
+	virtual ANKI_USE_RESULT Error prepareReload()
+	{
+		ANKI_ASSERT(!"Not supported");
+		return Error::FUNCTION_FAILED;
+	}
+
+	/// Start using what prepareReload() loaded. It runs between frames.
+	virtual void finishReload()
+	{
+		ANKI_ASSERT(!"Not supported");
+	}
+
 private:
 	ResourceManager* m_manager;
 	Atomic<I32> m_refcount;
@@ -0,0 +1,369 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/ResourceWatcher.h>
+#include <anki/resource/ResourceManager.h>
+#include <anki/resource/ResourceObject.h>
+#include <anki/resource/AsyncLoader.h>
+#include <anki/util/INotify.h>
+#include <anki/util/Filesystem.h>
+#include <anki/core/Trace.h>
+
+namespace anki
+{
+
+/// Get the directory of a path.
+static void getParentDirectory(CString path, StringAuto& out)
+{
+	const char* slash = strrchr(path.cstr(), '/');
+	if(slash)
+	{
+		out.create(path.cstr(), slash);
+	}
+	else
+	{
+		out.create(".");
+	}
+}
+
+/// Loads a resource again in the async loader.
+class ResourceWatcher::ReloadTask : public AsyncLoaderTask
+{
+public:
+	ResourceWatcher* m_watcher = nullptr;
+	ResourceReloadRequest* m_req = nullptr;
+
+	Error operator()(AsyncLoaderTaskContext& ctx) final
+	{
+		ResourceObject* rsrc;
+		{
+			LockGuard<Mutex> lock(m_watcher->m_mtx);
+			rsrc = m_req->m_resource;
+			if(!rsrc)
+			{
+				// The resource is gone
+				m_req->m_state = ResourceReloadRequest::State::FAILED;
+				return Error::NONE;
+			}
+
+			// Mark it so the resource is not destroyed while it's reloading
+			m_req->m_state = ResourceReloadRequest::State::RUNNING;
+		}
+
+		Error err = Error::NONE;
+		{
+			ANKI_TRACE_SCOPED_EVENT(RSRC_RELOAD);
+			err = rsrc->prepareReload();
+		}
+
+		LockGuard<Mutex> lock(m_watcher->m_mtx);
+		m_req->m_state = (err) ? ResourceReloadRequest::State::FAILED : ResourceReloadRequest::State::DONE;
+		m_watcher->m_condVar.notifyAll();
+
+		// The failure is reported by the watcher
+		return Error::NONE;
+	}
+};
+
+ResourceWatcher::ResourceWatcher(ResourceManager* manager)
+	: m_manager(manager)
+{
+}
+
+ResourceWatcher::~ResourceWatcher()
+{
+	ResourceAllocator<U8> alloc = m_manager->getAllocator();
+
+	// The async loader is already gone so no one references the requests
+	for(ResourceReloadRequest* req : m_requests)
+	{
+		alloc.deleteInstance(req);
+	}
+	m_requests.destroy(alloc);
+
+	for(Resource* entry : m_resources)
+	{
+		destroyFiles(entry->m_files);
+		alloc.deleteInstance(entry);
+	}
+	m_resources.destroy(alloc);
+
+	for(Directory& dir : m_dirs)
+	{
+		dir.m_path.destroy(alloc);
+		alloc.deleteInstance(dir.m_inotify);
+	}
+	m_dirs.destroy(alloc);
+}
+
+void ResourceWatcher::watchResource(ResourceObject& rsrc)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	Resource* entry = m_manager->getAllocator().newInstance<Resource>();
+	entry->m_resource = &rsrc;
+	initFiles(rsrc, entry->m_files);
+
+	if(entry->m_files.getSize() == 0)
+	{
+		// Can't be reloaded
+		m_manager->getAllocator().deleteInstance(entry);
+		return;
+	}
+
+	m_resources.emplace(m_manager->getAllocator(), rsrc.getUuid(), entry);
+}
+
+void ResourceWatcher::unwatchResource(ResourceObject& rsrc)
+{
+	LockGuard<Mutex> lock(m_mtx);
+
+	auto it = m_resources.find(rsrc.getUuid());
+	if(it == m_resources.getEnd())
+	{
+		return;
+	}
+
+	Resource* entry = *it;
+	if(entry->m_request)
+	{
+		// Wait for the reload that is using the resource and then orphan the request. It will be deleted in update()
+		while(entry->m_request->m_state == ResourceReloadRequest::State::RUNNING)
+		{
+			m_condVar.wait(m_mtx);
+		}
+
+		entry->m_request->m_resource = nullptr;
+	}
+
+	// Find it again, other resources might have been added while waiting
+	m_resources.erase(m_manager->getAllocator(), m_resources.find(rsrc.getUuid()));
+	destroyFiles(entry->m_files);
+	m_manager->getAllocator().deleteInstance(entry);
+}
+
+void ResourceWatcher::update()
+{
+	ANKI_TRACE_SCOPED_EVENT(RSRC_RESOURCE_WATCHER_UPDATE);
+	LockGuard<Mutex> lock(m_mtx);
+	ResourceAllocator<U8> alloc = m_manager->getAllocator();
+
+	// Apply the reloads that the async loader finished
+	U32 pendingCount = 0;
+	U32 requestCount = m_requests.getSize();
+	for(U32 i = 0; i < requestCount; ++i)
+	{
+		ResourceReloadRequest* req = m_requests[i];
+		if(req->m_state == ResourceReloadRequest::State::PENDING)
+		{
+			m_requests[pendingCount++] = req;
+			continue;
+		}
+
+		ANKI_ASSERT(req->m_state != ResourceReloadRequest::State::RUNNING && "The async loader should be paused");
+
+		if(req->m_resource)
+		{
+			ResourceObject& rsrc = *req->m_resource;
+			auto it = m_resources.find(rsrc.getUuid());
+			ANKI_ASSERT(it != m_resources.getEnd());
+			Resource& entry = **it;
+			entry.m_request = nullptr;
+
+			if(req->m_state == ResourceReloadRequest::State::DONE)
+			{
+				rsrc.finishReload();
+				ANKI_RESOURCE_LOGI("Resource reloaded: %s", &rsrc.getFilename()[0]);
+
+				// The files might be different now
+				destroyFiles(entry.m_files);
+				initFiles(rsrc, entry.m_files);
+			}
+			else
+			{
+				ANKI_RESOURCE_LOGE("Failed to reload resource, will keep the old one: %s", &rsrc.getFilename()[0]);
+			}
+
+			if(entry.m_reloadAgain)
+			{
+				entry.m_reloadAgain = false;
+				scheduleReload(entry);
+			}
+		}
+
+		alloc.deleteInstance(req);
+	}
+
+	if(pendingCount < requestCount)
+	{
+		// Remove the finished ones but keep the ones that were just scheduled
+		for(U32 i = requestCount; i < m_requests.getSize(); ++i)
+		{
+			m_requests[pendingCount++] = m_requests[i];
+		}
+
+		m_requests.resize(alloc, pendingCount);
+	}
+
+	// Find the modified directories
+	++m_updateCount;
+	Bool anyModified = false;
+	for(Directory& dir : m_dirs)
+	{
+		if(dir.m_inotify)
+		{
+			Bool modified;
+			if(dir.m_inotify->pollEvents(modified))
+			{
+				ANKI_RESOURCE_LOGW("INotify failed, will poll the directory instead: %s", &dir.m_path[0]);
+				alloc.deleteInstance(dir.m_inotify);
+				dir.m_inotify = nullptr;
+				modified = true;
+			}
+
+			dir.m_modified = modified;
+		}
+		else
+		{
+			dir.m_modified = (m_updateCount % POLL_PERIOD) == 0;
+		}
+
+		anyModified = anyModified || dir.m_modified;
+	}
+
+	if(!anyModified)
+	{
+		return;
+	}
+
+	// Reload the resources whose files changed
+	for(Resource* entry : m_resources)
+	{
+		if(filesChanged(entry->m_files))
+		{
+			if(entry->m_request)
+			{
+				entry->m_reloadAgain = true;
+			}
+			else
+			{
+				scheduleReload(*entry);
+			}
+		}
+	}
+}
+
+void ResourceWatcher::scheduleReload(Resource& entry)
+{
+	ANKI_ASSERT(entry.m_request == nullptr);
+
+	ResourceReloadRequest* req = m_manager->getAllocator().newInstance<ResourceReloadRequest>();
+	req->m_resource = entry.m_resource;
+	m_requests.emplaceBack(m_manager->getAllocator(), req);
+	entry.m_request = req;
+
+	AsyncLoader& loader = m_manager->getAsyncLoader();
+	ReloadTask* task = loader.newTask<ReloadTask>();
+	task->m_watcher = this;
+	task->m_req = req;
+	loader.submitTask(task);
+}
+
+void ResourceWatcher::initFiles(ResourceObject& rsrc, DynamicArray<File>& files)
+{
+	ANKI_ASSERT(files.getSize() == 0);
+	ResourceAllocator<U8> alloc = m_manager->getAllocator();
+
+	StringListAuto dependencies(alloc);
+	rsrc.getReloadDependencies(dependencies);
+
+	for(const String& dep : dependencies)
+	{
+		// Watch the file that holds the dependency. It's the archive for the files that are in archives
+		StringAuto location(alloc);
+		U64 time;
+		if(m_manager->getFilesystem().getFileLocation(dep.toCString(), location)
+			|| getFileModificationTime(location.toCString(), time))
+		{
+			ANKI_RESOURCE_LOGW("Can't watch file: %s", &dep[0]);
+			continue;
+		}
+
+		StringAuto dirPath(alloc);
+		getParentDirectory(location.toCString(), dirPath);
+
+		File& file = *files.emplaceBack(alloc);
+		file.m_filename.create(alloc, location.toCString());
+		file.m_modificationTime = time;
+		file.m_dirIdx = findOrCreateDirectory(dirPath.toCString());
+	}
+}
+
+void ResourceWatcher::destroyFiles(DynamicArray<File>& files)
+{
+	for(File& file : files)
+	{
+		file.m_filename.destroy(m_manager->getAllocator());
+	}
+
+	files.destroy(m_manager->getAllocator());
+}
+
+U32 ResourceWatcher::findOrCreateDirectory(CString path)
+{
+	for(U32 i = 0; i < m_dirs.getSize(); ++i)
+	{
+		if(m_dirs[i].m_path == path)
+		{
+			return i;
+		}
+	}
+
+	ResourceAllocator<U8> alloc = m_manager->getAllocator();
+	Directory& dir = *m_dirs.emplaceBack(alloc);
+	dir.m_path.create(alloc, path);
+	dir.m_inotify = nullptr;
+	dir.m_modified = false;
+
+#if ANKI_OS == ANKI_OS_LINUX
+	// There is a limit of INotify instances per user. Poll the directories that don't get one
+	INotify* inotify = alloc.newInstance<INotify>();
+	if(inotify->init(alloc, path))
+	{
+		ANKI_RESOURCE_LOGW("Can't use INotify, will poll the directory instead: %s", &path[0]);
+		alloc.deleteInstance(inotify);
+	}
+	else
+	{
+		dir.m_inotify = inotify;
+	}
+#endif
+
+	return m_dirs.getSize() - 1;
+}
+
+Bool ResourceWatcher::filesChanged(DynamicArray<File>& files)
+{
+	Bool changed = false;
+	for(File& file : files)
+	{
+		if(!m_dirs[file.m_dirIdx].m_modified)
+		{
+			continue;
+		}
+
+		// The file might be missing for a while when editors save it, ignore it until it's back
+		U64 time;
+		if(!getFileModificationTime(file.m_filename.toCString(), time) && time != file.m_modificationTime)
+		{
+			file.m_modificationTime = time;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+} // end namespace anki
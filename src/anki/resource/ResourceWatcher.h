@@ -0,0 +1,114 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/Common.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/HashMap.h>
+#include <anki/util/Thread.h>
+
+namespace anki
+{
+
+// Forward
+class INotify;
+class ResourceObject;
+
+/// @addtogroup resource
+/// @{
+
+/// A reload of a resource that runs in the async loader.
+class ResourceReloadRequest
+{
+public:
+	enum class State : U32
+	{
+		PENDING,
+		RUNNING,
+		DONE,
+		FAILED
+	};
+
+	ResourceObject* m_resource; ///< It's nullptr if the resource was destroyed while the request was in flight.
+	State m_state = State::PENDING; ///< Protected by the mutex of the ResourceWatcher.
+};
+
+/// Watches the files of the loaded resources and reloads the resources when their files change. The files are
+/// watched per directory with INotify. Where INotify is not available the modification times of the files are polled
+/// every few frames. The resources are loaded again in the async loader and they start using the new data between
+/// frames so the rest of the engine keeps the same ResourcePtrs. Only the resources that implement
+/// ResourceObject::getReloadDependencies() are watched.
+class ResourceWatcher : public NonCopyable
+{
+public:
+	ResourceWatcher(ResourceManager* manager);
+
+	~ResourceWatcher();
+
+	/// Call it once a frame when the async loader is paused. It applies the reloads that the async loader finished and
+	/// it schedules the reloads of the resources whose files changed.
+	void update();
+
+anki_internal:
+	/// Start watching the files of a resource that was just loaded.
+	/// @note It's thread-safe.
+	void watchResource(ResourceObject& rsrc);
+
+	/// Stop watching a resource that is about to be destroyed. If the resource is reloading it waits for the reload.
+	/// @note It's thread-safe.
+	void unwatchResource(ResourceObject& rsrc);
+
+private:
+	/// A watched file.
+	class File
+	{
+	public:
+		String m_filename;
+		U64 m_modificationTime;
+		U32 m_dirIdx; ///< Index to m_dirs.
+	};
+
+	/// A watched resource.
+	class Resource
+	{
+	public:
+		ResourceObject* m_resource;
+		DynamicArray<File> m_files;
+		ResourceReloadRequest* m_request = nullptr; ///< The reload in flight.
+		Bool8 m_reloadAgain = false; ///< The files changed while the reload was in flight.
+	};
+
+	/// A directory of the OS filesystem that holds watched files.
+	class Directory
+	{
+	public:
+		String m_path;
+		INotify* m_inotify; ///< It's nullptr if the modification times are polled.
+		Bool8 m_modified;
+	};
+
+	class ReloadTask;
+
+	/// Poll the directories that don't have INotify every that many updates.
+	static const U32 POLL_PERIOD = 60;
+
+	ResourceManager* m_manager;
+	Mutex m_mtx; ///< Resources are loaded and destroyed from many threads.
+	ConditionVariable m_condVar; ///< Signaled when a request stops RUNNING.
+	HashMap<U64, Resource*> m_resources; ///< The key is the UUID of the resource.
+	DynamicArray<Directory> m_dirs;
+	DynamicArray<ResourceReloadRequest*> m_requests; ///< In flight requests.
+	U32 m_updateCount = 0;
+
+	void initFiles(ResourceObject& rsrc, DynamicArray<File>& files);
+	void destroyFiles(DynamicArray<File>& files);
+	U32 findOrCreateDirectory(CString path);
+	Bool filesChanged(DynamicArray<File>& files);
+	void scheduleReload(Resource& entry);
+};
+/// @}
+
+} // end namespace anki
@@ -0,0 +1,325 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/ShaderProgramPackage.h>
+#include <anki/util/File.h>
+#include <anki/util/Hash.h>
+#include <algorithm>
+
+namespace anki
+{
+
+/// The alignment of the binaries inside the binary data. SPIR-V is made of words.
+static const U32 BINARY_ALIGNMENT = sizeof(U32);
+
+U64 ShaderProgramPackageFile::computeCompilerOptionsHash(const ShaderCompilerOptions& options)
+{
+	// Copy member by member, the constructor zeroes the padding
+	ShaderCompilerOptions copy;
+	copy.m_outLanguage = options.m_outLanguage;
+	copy.m_gpuCapabilities = options.m_gpuCapabilities;
+	return computeHash(&copy, sizeof(copy));
+}
+
+U64 ShaderProgramPackageFile::computeMutationHash(ConstWeakArray<I32> values)
+{
+	return (values.getSize()) ? computeHash(&values[0], values.getSizeInBytes()) : 1;
+}
+
+ShaderProgramPackage::~ShaderProgramPackage()
+{
+	if(m_outOfDateWarned)
+	{
+		m_alloc.deleteArray(m_outOfDateWarned, m_header->m_programCount);
+	}
+
+	if(m_data)
+	{
+		m_alloc.getMemoryPool().free(m_data);
+	}
+}
+
+Error ShaderProgramPackage::load(
+	GenericMemoryPoolAllocator<U8> alloc, CString filename, const ShaderCompilerOptions& options)
+{
+	ANKI_ASSERT(!m_data);
+	m_alloc = alloc;
+
+	// Read the whole file at once. The structures are used in place
+	File file;
+	ANKI_CHECK(file.open(filename, FileOpenFlag::READ | FileOpenFlag::BINARY));
+	m_dataSize = file.getSize();
+	if(m_dataSize < sizeof(ShaderProgramPackageFile::Header))
+	{
+		ANKI_RESOURCE_LOGE("Shader program package is too small: %s", &filename[0]);
+		return Error::USER_DATA;
+	}
+
+	m_data = m_alloc.getMemoryPool().allocate(m_dataSize, ANKI_SAFE_ALIGNMENT);
+	ANKI_CHECK(file.read(m_data, m_dataSize));
+
+	const U8* ptr = static_cast<const U8*>(m_data);
+	const ShaderProgramPackageFile::Header* header = reinterpret_cast<const ShaderProgramPackageFile::Header*>(ptr);
+	ptr += sizeof(ShaderProgramPackageFile::Header);
+	m_programs = reinterpret_cast<const ShaderProgramPackageFile::Program*>(ptr);
+	ptr += sizeof(ShaderProgramPackageFile::Program) * header->m_programCount;
+	m_variants = reinterpret_cast<const ShaderProgramPackageFile::Variant*>(ptr);
+	ptr += sizeof(ShaderProgramPackageFile::Variant) * header->m_variantCount;
+	m_binaries = reinterpret_cast<const ShaderProgramPackageFile::Binary*>(ptr);
+	ptr += sizeof(ShaderProgramPackageFile::Binary) * header->m_binaryCount;
+	m_binaryData = ptr;
+
+	m_header = header;
+	if(validate())
+	{
+		ANKI_RESOURCE_LOGE("Shader program package is corrupted: %s", &filename[0]);
+		m_header = nullptr;
+		return Error::USER_DATA;
+	}
+
+	if(header->m_compilerOptionsHash != ShaderProgramPackageFile::computeCompilerOptionsHash(options))
+	{
+		ANKI_RESOURCE_LOGW("Shader program package is compiled for a different GPU or backend, will not use it: %s",
+			&filename[0]);
+		m_header = nullptr;
+		return Error::NONE;
+	}
+
+	m_outOfDateWarned = m_alloc.newArray<Atomic<U32>>(header->m_programCount);
+	for(U32 i = 0; i < header->m_programCount; ++i)
+	{
+		m_outOfDateWarned[i].set(0);
+	}
+
+	ANKI_RESOURCE_LOGI("Loaded shader program package with %u programs and %u variants: %s",
+		header->m_programCount,
+		header->m_variantCount,
+		&filename[0]);
+
+	return Error::NONE;
+}
+
+Error ShaderProgramPackage::validate() const
+{
+	if(memcmp(&m_header->m_magic[0], ShaderProgramPackageFile::MAGIC, 8) != 0)
+	{
+		return Error::USER_DATA;
+	}
+
+	const PtrSize expectedSize = sizeof(ShaderProgramPackageFile::Header)
+								 + sizeof(ShaderProgramPackageFile::Program) * m_header->m_programCount
+								 + sizeof(ShaderProgramPackageFile::Variant) * m_header->m_variantCount
+								 + sizeof(ShaderProgramPackageFile::Binary) * m_header->m_binaryCount
+								 + m_header->m_binaryDataSize;
+	if(expectedSize != m_dataSize)
+	{
+		return Error::USER_DATA;
+	}
+
+	for(U32 i = 0; i < m_header->m_programCount; ++i)
+	{
+		const ShaderProgramPackageFile::Program& prog = m_programs[i];
+		if(prog.m_firstVariant + prog.m_variantCount > m_header->m_variantCount)
+		{
+			return Error::USER_DATA;
+		}
+	}
+
+	for(U32 i = 0; i < m_header->m_variantCount; ++i)
+	{
+		for(U32 bin : m_variants[i].m_binaries)
+		{
+			if(bin != MAX_U32 && bin >= m_header->m_binaryCount)
+			{
+				return Error::USER_DATA;
+			}
+		}
+	}
+
+	for(U32 i = 0; i < m_header->m_binaryCount; ++i)
+	{
+		if(m_binaries[i].m_offset + m_binaries[i].m_size > m_header->m_binaryDataSize)
+		{
+			return Error::USER_DATA;
+		}
+	}
+
+	return Error::NONE;
+}
+
+const ShaderProgramPackageFile::Variant* ShaderProgramPackage::findVariant(
+	CString programFilename, U64 sourceHash, ConstWeakArray<I32> mutationValues) const
+{
+	if(!isLoaded())
+	{
+		return nullptr;
+	}
+
+	// Find the program
+	const U64 filenameHash = computeHash(&programFilename[0], programFilename.getLength());
+	const ShaderProgramPackageFile::Program* programsEnd = m_programs + m_header->m_programCount;
+	const ShaderProgramPackageFile::Program* prog = std::lower_bound(m_programs,
+		programsEnd,
+		filenameHash,
+		[](const ShaderProgramPackageFile::Program& p, U64 hash) { return p.m_filenameHash < hash; });
+	if(prog == programsEnd || prog->m_filenameHash != filenameHash)
+	{
+		return nullptr;
+	}
+
+	if(prog->m_sourceHash != sourceHash)
+	{
+		// The program or one of its includes was edited after the package was built. The binaries and the layout
+		// might not match the new source
+		if(m_outOfDateWarned[prog - m_programs].exchange(1) == 0)
+		{
+			ANKI_RESOURCE_LOGW(
+				"Shader program package is out of date, will compile the program: %s", &programFilename[0]);
+		}
+		return nullptr;
+	}
+
+	// Find the variant
+	const U64 mutationHash = ShaderProgramPackageFile::computeMutationHash(mutationValues);
+	const ShaderProgramPackageFile::Variant* variantsBegin = m_variants + prog->m_firstVariant;
+	const ShaderProgramPackageFile::Variant* variantsEnd = variantsBegin + prog->m_variantCount;
+	const ShaderProgramPackageFile::Variant* variant = std::lower_bound(variantsBegin,
+		variantsEnd,
+		mutationHash,
+		[](const ShaderProgramPackageFile::Variant& v, U64 hash) { return v.m_mutationHash < hash; });
+	if(variant == variantsEnd || variant->m_mutationHash != mutationHash)
+	{
+		return nullptr;
+	}
+
+	return variant;
+}
+
+ShaderProgramPackageBuilder::ShaderProgramPackageBuilder(
+	GenericMemoryPoolAllocator<U8> alloc, const ShaderCompilerOptions& options)
+	: m_alloc(alloc)
+	, m_compilerOptionsHash(ShaderProgramPackageFile::computeCompilerOptionsHash(options))
+{
+}
+
+ShaderProgramPackageBuilder::~ShaderProgramPackageBuilder()
+{
+	m_variants.destroy(m_alloc);
+	m_binaries.destroy(m_alloc);
+	m_binaryData.destroy(m_alloc);
+	m_binaryIndices.destroy(m_alloc);
+}
+
+void ShaderProgramPackageBuilder::addVariant(CString programFilename,
+	U64 sourceHash,
+	ConstWeakArray<I32> mutationValues,
+	Bool usesPushConstants,
+	const Array<ConstWeakArray<U8>, U(ShaderType::COUNT)>& binaries)
+{
+	PendingVariant& pending = *m_variants.emplaceBack(m_alloc);
+	pending.m_filenameHash = computeHash(&programFilename[0], programFilename.getLength());
+	pending.m_sourceHash = sourceHash;
+	pending.m_variant.m_mutationHash = ShaderProgramPackageFile::computeMutationHash(mutationValues);
+	pending.m_variant.m_usesPushConstants = usesPushConstants;
+	pending.m_variant._m_padding = 0;
+
+	for(ShaderType type = ShaderType::FIRST; type < ShaderType::COUNT; ++type)
+	{
+		const ConstWeakArray<U8>& bin = binaries[type];
+		if(bin.getSize() == 0)
+		{
+			pending.m_variant.m_binaries[type] = MAX_U32;
+			continue;
+		}
+
+		// Store the binary once
+		const U64 hash = computeHash(&bin[0], bin.getSize());
+		auto it = m_binaryIndices.find(hash);
+		if(it != m_binaryIndices.getEnd())
+		{
+			ANKI_ASSERT(m_binaries[*it].m_size == bin.getSize()
+						&& memcmp(&m_binaryData[m_binaries[*it].m_offset], &bin[0], bin.getSize()) == 0
+						&& "Hash collision");
+			pending.m_variant.m_binaries[type] = *it;
+			continue;
+		}
+
+		ShaderProgramPackageFile::Binary& outBin = *m_binaries.emplaceBack(m_alloc);
+		outBin.m_offset = getAlignedRoundUp(BINARY_ALIGNMENT, m_binaryData.getSize());
+		outBin.m_size = bin.getSize();
+		m_binaryData.resize(m_alloc, outBin.m_offset + outBin.m_size, 0);
+		memcpy(&m_binaryData[outBin.m_offset], &bin[0], bin.getSize());
+
+		const U32 idx = m_binaries.getSize() - 1;
+		m_binaryIndices.emplace(m_alloc, hash, idx);
+		pending.m_variant.m_binaries[type] = idx;
+	}
+}
+
+Error ShaderProgramPackageBuilder::write(CString filename)
+{
+	// Sort the variants by program and then by mutation so the loader can search them
+	std::sort(m_variants.getBegin(), m_variants.getEnd(), [](const PendingVariant& a, const PendingVariant& b) {
+		return (a.m_filenameHash != b.m_filenameHash) ? a.m_filenameHash < b.m_filenameHash
+													  : a.m_variant.m_mutationHash < b.m_variant.m_mutationHash;
+	});
+
+	// Gather the programs
+	DynamicArrayAuto<ShaderProgramPackageFile::Program> programs(m_alloc);
+	for(U32 i = 0; i < m_variants.getSize(); ++i)
+	{
+		if(i == 0 || m_variants[i].m_filenameHash != m_variants[i - 1].m_filenameHash)
+		{
+			ShaderProgramPackageFile::Program& prog = *programs.emplaceBack();
+			prog.m_filenameHash = m_variants[i].m_filenameHash;
+			prog.m_sourceHash = m_variants[i].m_sourceHash;
+			prog.m_firstVariant = i;
+			prog.m_variantCount = 0;
+		}
+		else
+		{
+			ANKI_ASSERT(m_variants[i].m_variant.m_mutationHash != m_variants[i - 1].m_variant.m_mutationHash
+						&& "The same variant was added twice");
+			ANKI_ASSERT(m_variants[i].m_sourceHash == m_variants[i - 1].m_sourceHash
+						&& "The variants of a program should be compiled from the same source");
+		}
+
+		++programs.getBack().m_variantCount;
+	}
+
+	// Write
+	ShaderProgramPackageFile::Header header;
+	zeroMemory(header);
+	memcpy(&header.m_magic[0], ShaderProgramPackageFile::MAGIC, 8);
+	header.m_compilerOptionsHash = m_compilerOptionsHash;
+	header.m_programCount = programs.getSize();
+	header.m_variantCount = m_variants.getSize();
+	header.m_binaryCount = m_binaries.getSize();
+	header.m_binaryDataSize = m_binaryData.getSize();
+
+	File file;
+	ANKI_CHECK(file.open(filename, FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+	ANKI_CHECK(file.write(&header, sizeof(header)));
+
+	if(programs.getSize())
+	{
+		ANKI_CHECK(file.write(&programs[0], programs.getSizeInBytes()));
+	}
+
+	for(const PendingVariant& pending : m_variants)
+	{
+		ANKI_CHECK(file.write(&pending.m_variant, sizeof(pending.m_variant)));
+	}
+
+	if(m_binaries.getSize())
+	{
+		ANKI_CHECK(file.write(&m_binaries[0], m_binaries.getSizeInBytes()));
+		ANKI_CHECK(file.write(&m_binaryData[0], m_binaryData.getSizeInBytes()));
+	}
+
+	return Error::NONE;
+}
+
+} // end namespace anki
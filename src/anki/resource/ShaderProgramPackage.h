@@ -0,0 +1,180 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/Common.h>
+#include <anki/gr/ShaderCompiler.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/HashMap.h>
+#include <anki/util/WeakArray.h>
+#include <anki/util/Atomic.h>
+
+namespace anki
+{
+
+/// @addtogroup resource
+/// @{
+
+/// Information to decode shader program package files. A package holds the precompiled binaries of many variants of
+/// many shader programs. The binaries are stored once even if many variants share them.
+///
+/// The file has the Header, then Header::m_programCount Program, then Header::m_variantCount Variant, then
+/// Header::m_binaryCount Binary and then the data of the binaries. Everything is referenced by offsets so the file can
+/// be used as is after it's read or mapped.
+class ShaderProgramPackageFile
+{
+public:
+	static constexpr const char* MAGIC = "ANKISPK2";
+
+	struct Header
+	{
+		char m_magic[8]; ///< Magic word.
+		U64 m_compilerOptionsHash; ///< The options the binaries are compiled with. See computeCompilerOptionsHash().
+		U32 m_programCount;
+		U32 m_variantCount;
+		U32 m_binaryCount;
+		U32 _m_padding;
+		U64 m_binaryDataSize;
+	};
+
+	/// The programs are sorted by m_filenameHash.
+	struct Program
+	{
+		U64 m_filenameHash;
+		U64 m_sourceHash; ///< The hash of the preprocessed source. The package is out of date if it's different.
+		U32 m_firstVariant;
+		U32 m_variantCount;
+	};
+
+	/// The variants of a program are sorted by m_mutationHash.
+	struct Variant
+	{
+		U64 m_mutationHash; ///< See computeMutationHash().
+		Array<U32, U(ShaderType::COUNT)> m_binaries; ///< Indices to the Binary array or MAX_U32 for missing stages.
+		U32 m_usesPushConstants;
+		U32 _m_padding;
+	};
+
+	struct Binary
+	{
+		U64 m_offset; ///< Offset from the start of the binary data.
+		U64 m_size;
+	};
+
+	/// Hash the options that affect the binaries. The shader type is not part of it.
+	static U64 computeCompilerOptionsHash(const ShaderCompilerOptions& options);
+
+	/// Hash the values of a mutation.
+	/// @param values The values of all the mutators of the program in the order the program declares them.
+	static U64 computeMutationHash(ConstWeakArray<I32> values);
+};
+
+/// A shader program package file that is loaded to memory.
+class ShaderProgramPackage : public NonCopyable
+{
+public:
+	ShaderProgramPackage()
+	{
+	}
+
+	~ShaderProgramPackage();
+
+	/// Load a package. If the package is compiled with different options it won't be used.
+	/// @param options The options of the shader compilation of this run.
+	ANKI_USE_RESULT Error load(
+		GenericMemoryPoolAllocator<U8> alloc, CString filename, const ShaderCompilerOptions& options);
+
+	Bool isLoaded() const
+	{
+		return m_header != nullptr;
+	}
+
+	/// Find a variant of a program.
+	/// @param programFilename The resource filename of the program.
+	/// @param sourceHash The hash of the preprocessed source of the program.
+	/// @param mutationValues See ShaderProgramPackageFile::computeMutationHash().
+	/// @return The variant or nullptr if the package doesn't have it or if it has an older source of the program.
+	const ShaderProgramPackageFile::Variant* findVariant(
+		CString programFilename, U64 sourceHash, ConstWeakArray<I32> mutationValues) const;
+
+	/// Get the binary of a stage of a variant.
+	ConstWeakArray<U8> getBinary(const ShaderProgramPackageFile::Variant& variant, ShaderType type) const
+	{
+		ANKI_ASSERT(isLoaded());
+		ANKI_ASSERT(variant.m_binaries[type] < m_header->m_binaryCount);
+		const ShaderProgramPackageFile::Binary& bin = m_binaries[variant.m_binaries[type]];
+		return ConstWeakArray<U8>(m_binaryData + bin.m_offset, bin.m_size);
+	}
+
+private:
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	void* m_data = nullptr; ///< The whole file.
+	PtrSize m_dataSize = 0;
+
+	const ShaderProgramPackageFile::Header* m_header = nullptr;
+	const ShaderProgramPackageFile::Program* m_programs = nullptr;
+	const ShaderProgramPackageFile::Variant* m_variants = nullptr;
+	const ShaderProgramPackageFile::Binary* m_binaries = nullptr;
+	const U8* m_binaryData = nullptr;
+
+	/// One per program. Set when findVariant() warned that the program is out of date so it warns only once.
+	mutable Atomic<U32>* m_outOfDateWarned = nullptr;
+
+	ANKI_USE_RESULT Error validate() const;
+};
+
+/// Creates shader program package files.
+class ShaderProgramPackageBuilder : public NonCopyable
+{
+public:
+	/// @param options The options that the binaries were compiled with.
+	ShaderProgramPackageBuilder(GenericMemoryPoolAllocator<U8> alloc, const ShaderCompilerOptions& options);
+
+	~ShaderProgramPackageBuilder();
+
+	/// Add a variant of a program.
+	/// @param programFilename The resource filename of the program.
+	/// @param sourceHash The hash of the preprocessed source of the program.
+	/// @param mutationValues See ShaderProgramPackageFile::computeMutationHash().
+	/// @param usesPushConstants If the variant was compiled to use push constants.
+	/// @param binaries The binaries of the stages. Empty for the stages that the program doesn't have.
+	void addVariant(CString programFilename,
+		U64 sourceHash,
+		ConstWeakArray<I32> mutationValues,
+		Bool usesPushConstants,
+		const Array<ConstWeakArray<U8>, U(ShaderType::COUNT)>& binaries);
+
+	U32 getVariantCount() const
+	{
+		return m_variants.getSize();
+	}
+
+	U32 getBinaryCount() const
+	{
+		return m_binaries.getSize();
+	}
+
+	ANKI_USE_RESULT Error write(CString filename);
+
+private:
+	class PendingVariant
+	{
+	public:
+		U64 m_filenameHash;
+		U64 m_sourceHash;
+		ShaderProgramPackageFile::Variant m_variant;
+	};
+
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	U64 m_compilerOptionsHash;
+	DynamicArray<PendingVariant> m_variants;
+	DynamicArray<ShaderProgramPackageFile::Binary> m_binaries;
+	DynamicArray<U8> m_binaryData;
+	HashMap<U64, U32> m_binaryIndices; ///< Binary hash to index to m_binaries.
+};
+/// @}
+
+} // end namespace anki
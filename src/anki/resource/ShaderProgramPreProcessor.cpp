@@ -5,6 +5,7 @@
 
 #include <anki/resource/ShaderProgramPreProcessor.h>
 #include <anki/resource/ResourceFilesystem.h>
+#include <anki/core/Trace.h>
 
 namespace anki
 {
@@ -151,6 +152,10 @@ Error ShaderProgramPreprocessor::parse()
 			StringAuto str(m_alloc);
 			str.sprintf("#define GEN_INSTANCE_COUNT_ %s\n", m_mutators[m_instancedMutatorIdx].m_name.cstr());
 			m_finalSource.append(str.toCString());
+
+			// Too many instances for the uniforms
+			str.sprintf("#define GEN_INSTANCES_IN_STORAGE_ (GEN_INSTANCE_COUNT_ > %u)\n", MAX_INSTANCES);
+			m_finalSource.append(str.toCString());
 		}
 
 		{
@@ -163,6 +168,13 @@ Error ShaderProgramPreprocessor::parse()
 		if(m_uboStructLines.getSize() > 0)
 		{
 			m_uboStructLines.pushFront("struct GenUniforms_ {");
+			if(m_instancedMutatorIdx < MAX_U32)
+			{
+				// The instanced inputs might have left the struct empty
+				m_uboStructLines.pushBack("#if GEN_INSTANCES_IN_STORAGE_");
+				m_uboStructLines.pushBack("U32 gen_padding_;");
+				m_uboStructLines.pushBack("#endif");
+			}
 			m_uboStructLines.pushBack("};");
 
 			m_uboStructLines.pushBack("#if USE_PUSH_CONSTANTS == 1");
@@ -177,6 +189,22 @@ Error ShaderProgramPreprocessor::parse()
 			m_finalSource.append(ubo.toCString());
 		}
 
+		// The storage buffer of the instanced inputs
+		if(m_instanceStructLines.getSize() > 0)
+		{
+			m_instanceStructLines.pushFront("struct GenInstance_ {");
+			m_instanceStructLines.pushFront("#if GEN_INSTANCES_IN_STORAGE_");
+			m_instanceStructLines.pushBack("};");
+			m_instanceStructLines.pushBackSprintf("layout(ANKI_SS_BINDING(GEN_SET_, %u), std430, row_major) readonly "
+												  "buffer geninstss_ {GenInstance_ gen_instances_[];};",
+				INSTANCED_INPUTS_STORAGE_BUFFER_BINDING);
+			m_instanceStructLines.pushBack("#endif\n");
+
+			StringAuto instances(m_alloc);
+			m_instanceStructLines.join("\n", instances);
+			m_finalSource.append(instances.toCString());
+		}
+
 		// The globals
 		if(m_globalsLines.getSize() > 0)
 		{
@@ -199,6 +227,7 @@ Error ShaderProgramPreprocessor::parse()
 	m_lines.destroy();
 	m_globalsLines.destroy();
 	m_uboStructLines.destroy();
+	m_instanceStructLines.destroy();
 
 	return Error::NONE;
 }
@@ -211,36 +240,57 @@ Error ShaderProgramPreprocessor::parseFile(CString fname, U32 depth)
 		ANKI_PP_ERROR("The include depth is too high. Probably circular includance");
 	}
 
-	Bool foundPragmaOnce = false;
+	// Remember the file
+	Bool newDependency = true;
+	for(const String& dep : m_dependencies)
+	{
+		if(dep == fname)
+		{
+			newDependency = false;
+			break;
+		}
+	}
 
-	// Load file in lines
-	ResourceFilePtr file;
-	ANKI_CHECK(m_fsystem->openFile(fname, file));
-	StringAuto txt(m_alloc);
-	ANKI_CHECK(file->readAllText(m_alloc, txt));
+	if(newDependency)
+	{
+		m_dependencies.pushBack(fname);
+	}
 
-	StringListAuto lines(m_alloc);
-	lines.splitString(txt.toCString(), '\n');
-	if(lines.getSize() < 1)
+	Bool foundPragmaOnce = false;
+
+	// Get the file split in lines
+	const ShaderProgramPreprocessorFile* file = nullptr;
+	ShaderProgramPreprocessorFile localFile;
+	Error err = Error::NONE;
+	if(m_cache)
 	{
-		ANKI_PP_ERROR("Source is empty");
+		err = m_cache->getFile(fname, file);
+	}
+	else
+	{
+		err = localFile.load(m_alloc, fname, *m_fsystem);
+		file = &localFile;
 	}
 
 	// Parse lines
-	for(const String& line : lines)
+	for(U i = 0; !err && i < file->m_lines.getSize(); ++i)
 	{
-		if(line.find("pragma") != CString::NPOS || line.find("include") != CString::NPOS)
+		const ShaderProgramPreprocessorFile::Line& line = file->m_lines[i];
+		if(line.m_tokens.getSize())
 		{
 			// Possibly a preprocessor directive we care
-			ANKI_CHECK(parseLine(line.toCString(), fname, foundPragmaOnce, depth));
+			err = parseLine(line.m_text.toCString(), line.m_tokens, fname, foundPragmaOnce, depth);
 		}
 		else
 		{
 			// Just append the line
-			m_lines.pushBack(line.toCString());
+			m_lines.pushBack(line.m_text.toCString());
 		}
 	}
 
+	localFile.destroy(m_alloc);
+	ANKI_CHECK(err);
+
 	if(foundPragmaOnce)
 	{
 		// Append the guard
@@ -250,15 +300,13 @@ Error ShaderProgramPreprocessor::parseFile(CString fname, U32 depth)
 	return Error::NONE;
 }
 
-Error ShaderProgramPreprocessor::parseLine(CString line, CString fname, Bool& foundPragmaOnce, U32 depth)
+Error ShaderProgramPreprocessor::parseLine(
+	CString line, ConstWeakArray<String> tokens, CString fname, Bool& foundPragmaOnce, U32 depth)
 {
-	// Tokenize
-	DynamicArrayAuto<StringAuto> tokens(m_alloc);
-	tokenizeLine(line, tokens);
 	ANKI_ASSERT(tokens.getSize() > 0);
 
-	const StringAuto* token = tokens.getBegin();
-	const StringAuto* end = tokens.getEnd();
+	const String* token = tokens.getBegin();
+	const String* end = tokens.getEnd();
 
 	// Skip the hash
 	Bool foundAloneHash = false;
@@ -345,13 +393,13 @@ Error ShaderProgramPreprocessor::parseLine(CString line, CString fname, Bool& fo
 }
 
 Error ShaderProgramPreprocessor::parseInclude(
-	const StringAuto* begin, const StringAuto* end, CString line, CString fname, U32 depth)
+	const String* begin, const String* end, CString line, CString fname, U32 depth)
 {
 	// Gather the path
 	StringAuto path(m_alloc);
 	for(; begin < end; ++begin)
 	{
-		path.append(*begin);
+		path.append(begin->toCString());
 	}
 
 	if(path.isEmpty())
@@ -382,7 +430,7 @@ Error ShaderProgramPreprocessor::parseInclude(
 }
 
 Error ShaderProgramPreprocessor::parsePragmaMutator(
-	const StringAuto* begin, const StringAuto* end, CString line, CString fname)
+	const String* begin, const String* end, CString line, CString fname)
 {
 	ANKI_ASSERT(begin && end);
 
@@ -480,7 +528,7 @@ Error ShaderProgramPreprocessor::parsePragmaMutator(
 }
 
 Error ShaderProgramPreprocessor::parsePragmaInput(
-	const StringAuto* begin, const StringAuto* end, CString line, CString fname)
+	const String* begin, const String* end, CString line, CString fname)
 {
 	ANKI_ASSERT(begin && end);
 
@@ -519,7 +567,7 @@ Error ShaderProgramPreprocessor::parsePragmaInput(
 	}
 
 	// type
-	const StringAuto& dataTypeStr = *begin;
+	const String& dataTypeStr = *begin;
 	{
 		if(begin >= end)
 		{
@@ -669,14 +717,29 @@ Error ShaderProgramPreprocessor::parsePragmaInput(
 
 		if(input.m_instanced)
 		{
-			m_uboStructLines.pushBack("#if GEN_INSTANCE_COUNT_ > 1");
+			if(preproc)
+			{
+				m_instanceStructLines.pushBackSprintf("#if %s", preproc.cstr());
+			}
+
+			m_instanceStructLines.pushBackSprintf("%s gen_inst_%s;", type, name);
+
+			if(preproc)
+			{
+				m_instanceStructLines.pushBack("#endif");
+			}
+
+			m_uboStructLines.pushBack("#if GEN_INSTANCES_IN_STORAGE_");
+			m_uboStructLines.pushBack("#elif GEN_INSTANCE_COUNT_ > 1");
 			m_uboStructLines.pushBackSprintf("%s gen_uni_%s[GEN_INSTANCE_COUNT_];", type, name);
 			m_uboStructLines.pushBack("#else");
 			m_uboStructLines.pushBackSprintf("%s gen_uni_%s;", type, name);
 			m_uboStructLines.pushBack("#endif");
 
 			m_globalsLines.pushBack("#ifdef ANKI_VERTEX_SHADER");
-			m_globalsLines.pushBack("#if GEN_INSTANCE_COUNT_ > 1");
+			m_globalsLines.pushBack("#if GEN_INSTANCES_IN_STORAGE_");
+			m_globalsLines.pushBackSprintf("%s %s = gen_instances_[gl_InstanceID].gen_inst_%s;", type, name, name);
+			m_globalsLines.pushBack("#elif GEN_INSTANCE_COUNT_ > 1");
 			m_globalsLines.pushBackSprintf("%s %s = gen_unis_.gen_uni_%s[gl_InstanceID];", type, name, name);
 			m_globalsLines.pushBack("#else");
 			m_globalsLines.pushBackSprintf("%s %s = gen_unis_.gen_uni_%s;", type, name, name);
@@ -704,7 +767,7 @@ Error ShaderProgramPreprocessor::parsePragmaInput(
 }
 
 Error ShaderProgramPreprocessor::parsePragmaStart(
-	const StringAuto* begin, const StringAuto* end, CString line, CString fname)
+	const String* begin, const String* end, CString line, CString fname)
 {
 	ANKI_ASSERT(begin && end);
 
@@ -775,7 +838,7 @@ Error ShaderProgramPreprocessor::parsePragmaStart(
 }
 
 Error ShaderProgramPreprocessor::parsePragmaEnd(
-	const StringAuto* begin, const StringAuto* end, CString line, CString fname)
+	const String* begin, const String* end, CString line, CString fname)
 {
 	ANKI_ASSERT(begin && end);
 
@@ -799,7 +862,7 @@ Error ShaderProgramPreprocessor::parsePragmaEnd(
 }
 
 Error ShaderProgramPreprocessor::parsePragmaDescriptorSet(
-	const StringAuto* begin, const StringAuto* end, CString line, CString fname)
+	const String* begin, const String* end, CString line, CString fname)
 {
 	ANKI_ASSERT(begin && end);
 
@@ -821,11 +884,11 @@ Error ShaderProgramPreprocessor::parsePragmaDescriptorSet(
 	return Error::NONE;
 }
 
-void ShaderProgramPreprocessor::tokenizeLine(CString line, DynamicArrayAuto<StringAuto>& tokens)
+static void tokenizeLine(GenericMemoryPoolAllocator<U8> alloc, CString line, DynamicArray<String>& tokens)
 {
 	ANKI_ASSERT(line.getLength() > 0);
 
-	StringAuto l(m_alloc);
+	StringAuto l(alloc);
 	l.create(line);
 
 	// Replace all tabs with spaces
@@ -838,14 +901,135 @@ void ShaderProgramPreprocessor::tokenizeLine(CString line, DynamicArrayAuto<Stri
 	}
 
 	// Split
-	StringListAuto spaceTokens(m_alloc);
+	StringListAuto spaceTokens(alloc);
 	spaceTokens.splitString(l.toCString(), ' ', false);
 
 	// Create the array
+	tokens.create(alloc, spaceTokens.getSize());
+	U i = 0;
 	for(const String& s : spaceTokens)
 	{
-		tokens.emplaceBack(m_alloc, s.toCString());
+		tokens[i++].create(alloc, s.toCString());
+	}
+}
+
+Error ShaderProgramPreprocessorFile::load(
+	GenericMemoryPoolAllocator<U8> alloc, CString fname, ResourceFilesystem& fsystem)
+{
+	ANKI_ASSERT(m_lines.getSize() == 0);
+
+	// Load file in lines
+	ResourceFilePtr file;
+	ANKI_CHECK(fsystem.openFile(fname, file));
+	StringAuto txt(alloc);
+	ANKI_CHECK(file->readAllText(alloc, txt));
+
+	StringListAuto lines(alloc);
+	lines.splitString(txt.toCString(), '\n');
+	if(lines.getSize() < 1)
+	{
+		ANKI_PP_ERROR("Source is empty");
+	}
+
+	// Tokenize only the lines that might be directives we care about
+	m_lines.create(alloc, lines.getSize());
+	U i = 0;
+	for(const String& text : lines)
+	{
+		Line& line = m_lines[i++];
+		line.m_text.create(alloc, text.toCString());
+
+		if(text.find("pragma") != CString::NPOS || text.find("include") != CString::NPOS)
+		{
+			tokenizeLine(alloc, text.toCString(), line.m_tokens);
+		}
 	}
+
+	return Error::NONE;
+}
+
+void ShaderProgramPreprocessorFile::destroy(GenericMemoryPoolAllocator<U8> alloc)
+{
+	for(Line& line : m_lines)
+	{
+		line.m_text.destroy(alloc);
+		for(String& token : line.m_tokens)
+		{
+			token.destroy(alloc);
+		}
+		line.m_tokens.destroy(alloc);
+	}
+
+	m_lines.destroy(alloc);
+}
+
+ShaderProgramPreprocessorCache::~ShaderProgramPreprocessorCache()
+{
+	for(ShaderProgramPreprocessorFile* file : m_files)
+	{
+		file->destroy(m_alloc);
+		m_alloc.deleteInstance(file);
+	}
+	m_files.destroy(m_alloc);
+
+	for(ShaderProgramPreprocessorFile* file : m_staleFiles)
+	{
+		file->destroy(m_alloc);
+		m_alloc.deleteInstance(file);
+	}
+	m_staleFiles.destroy(m_alloc);
+}
+
+Error ShaderProgramPreprocessorCache::getFile(CString fname, const ShaderProgramPreprocessorFile*& file)
+{
+	U64 modificationTime;
+	ANKI_CHECK(m_fsystem->getFileModificationTime(fname, modificationTime));
+	const U64 hash = fname.computeHash();
+
+	// Search the cache
+	{
+		LockGuard<Mutex> lock(m_mtx);
+		auto it = m_files.find(hash);
+		if(it != m_files.getEnd() && (*it)->m_modificationTime == modificationTime)
+		{
+			file = *it;
+			return Error::NONE;
+		}
+	}
+
+	// Not there or modified, load it outside the lock
+	ANKI_TRACE_SCOPED_EVENT(RSRC_SHADER_PREPROCESS_LOAD_FILE);
+	ShaderProgramPreprocessorFile* newFile = m_alloc.newInstance<ShaderProgramPreprocessorFile>();
+	newFile->m_modificationTime = modificationTime;
+	const Error err = newFile->load(m_alloc, fname, *m_fsystem);
+	if(err)
+	{
+		newFile->destroy(m_alloc);
+		m_alloc.deleteInstance(newFile);
+		return err;
+	}
+
+	LockGuard<Mutex> lock(m_mtx);
+	auto it = m_files.find(hash);
+	if(it == m_files.getEnd())
+	{
+		m_files.emplace(m_alloc, hash, newFile);
+	}
+	else if((*it)->m_modificationTime == modificationTime)
+	{
+		// Some other thread loaded it in the meantime
+		newFile->destroy(m_alloc);
+		m_alloc.deleteInstance(newFile);
+		newFile = *it;
+	}
+	else
+	{
+		m_staleFiles.emplaceBack(m_alloc, *it);
+		*it = newFile;
+	}
+
+	file = newFile;
+	return Error::NONE;
 }
 
 } // end namespace anki
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include <anki/resource/Common.h>
 #include <anki/util/StringList.h>
 #include <anki/util/WeakArray.h>
+#include <anki/util/HashMap.h>
+#include <anki/util/Thread.h>
 #include <anki/gr/Common.h>
 
 namespace anki
@@ -99,6 +101,67 @@ private:
 	Bool8 m_instanced = false;
 };
 
+/// A source file that is split in lines. The lines that might have a directive of the ShaderProgramPreprocessor are
+/// also split in tokens.
+/// @memberof ShaderProgramPreprocessor
+class ShaderProgramPreprocessorFile : public NonCopyable
+{
+	friend ShaderProgramPreprocessor;
+	friend class ShaderProgramPreprocessorCache;
+
+public:
+	ShaderProgramPreprocessorFile()
+	{
+	}
+
+	~ShaderProgramPreprocessorFile()
+	{
+		ANKI_ASSERT(m_lines.getSize() == 0 && "Forgot to destroy");
+	}
+
+	ANKI_USE_RESULT Error load(GenericMemoryPoolAllocator<U8> alloc, CString fname, ResourceFilesystem& fsystem);
+
+	void destroy(GenericMemoryPoolAllocator<U8> alloc);
+
+private:
+	class Line
+	{
+	public:
+		String m_text;
+		DynamicArray<String> m_tokens; ///< Empty if the line doesn't have a directive.
+	};
+
+	DynamicArray<Line> m_lines;
+	U64 m_modificationTime = 0;
+};
+
+/// A thread-safe cache of the files that the ShaderProgramPreprocessor reads. The shader programs share many include
+/// files so they are read and tokenized once. A file is read again if it's modified.
+/// @memberof ShaderProgramPreprocessor
+class ShaderProgramPreprocessorCache : public NonCopyable
+{
+public:
+	ShaderProgramPreprocessorCache(GenericMemoryPoolAllocator<U8> alloc, ResourceFilesystem* fsystem)
+		: m_alloc(alloc)
+		, m_fsystem(fsystem)
+	{
+		ANKI_ASSERT(fsystem);
+	}
+
+	~ShaderProgramPreprocessorCache();
+
+	/// Get a file. The file stays valid as long as the cache lives.
+	ANKI_USE_RESULT Error getFile(CString fname, const ShaderProgramPreprocessorFile*& file);
+
+private:
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	ResourceFilesystem* m_fsystem;
+	HashMap<U64, ShaderProgramPreprocessorFile*> m_files; ///< The hash of the filename to the file.
+	/// The old versions of modified files. Some preprocessor might still use them.
+	DynamicArray<ShaderProgramPreprocessorFile*> m_staleFiles;
+	Mutex m_mtx;
+};
+
 /// This is a special preprocessor that run before the usual preprocessor. Its purpose is to add some meta information
 /// in the shader programs.
 ///
@@ -113,14 +176,21 @@ private:
 class ShaderProgramPreprocessor : public NonCopyable
 {
 public:
-	ShaderProgramPreprocessor(CString fname, ResourceFilesystem* fsystem, GenericMemoryPoolAllocator<U8> alloc)
+	/// @param cache Optional cache of the files. If it's nullptr the files are read every time.
+	ShaderProgramPreprocessor(CString fname,
+		ResourceFilesystem* fsystem,
+		GenericMemoryPoolAllocator<U8> alloc,
+		ShaderProgramPreprocessorCache* cache = nullptr)
 		: m_alloc(alloc)
 		, m_fname(alloc, fname)
 		, m_fsystem(fsystem)
+		, m_cache(cache)
 		, m_lines(alloc)
 		, m_globalsLines(alloc)
 		, m_uboStructLines(alloc)
+		, m_instanceStructLines(alloc)
 		, m_finalSource(alloc)
+		, m_dependencies(alloc)
 		, m_mutators(alloc)
 		, m_inputs(alloc)
 	{
@@ -158,6 +228,12 @@ public:
 		return m_set;
 	}
 
+	/// Get the files the program is made of. It's the program file and all the files it includes.
+	const StringListAuto& getDependencies() const
+	{
+		return m_dependencies;
+	}
+
 private:
 	using Mutator = ShaderProgramPreprocessorMutator;
 	using Input = ShaderProgramPreprocessorInput;
@@ -167,11 +243,14 @@ private:
 	GenericMemoryPoolAllocator<U8> m_alloc;
 	StringAuto m_fname;
 	ResourceFilesystem* m_fsystem = nullptr;
+	ShaderProgramPreprocessorCache* m_cache = nullptr;
 
 	StringListAuto m_lines; ///< The code.
 	StringListAuto m_globalsLines;
 	StringListAuto m_uboStructLines;
+	StringListAuto m_instanceStructLines; ///< The instanced inputs when they are in a storage buffer.
 	StringAuto m_finalSource;
+	StringListAuto m_dependencies; ///< Every file once.
 
 	DynamicArrayAuto<Mutator> m_mutators;
 	DynamicArrayAuto<Input> m_inputs;
@@ -183,18 +262,15 @@ private:
 	Bool8 m_foundInstancedInput = false;
 
 	ANKI_USE_RESULT Error parseFile(CString fname, U32 depth);
-	ANKI_USE_RESULT Error parseLine(CString line, CString fname, Bool& foundPragmaOnce, U32 depth);
-	ANKI_USE_RESULT Error parseInclude(
-		const StringAuto* begin, const StringAuto* end, CString line, CString fname, U32 depth);
-	ANKI_USE_RESULT Error parsePragmaMutator(
-		const StringAuto* begin, const StringAuto* end, CString line, CString fname);
-	ANKI_USE_RESULT Error parsePragmaInput(const StringAuto* begin, const StringAuto* end, CString line, CString fname);
-	ANKI_USE_RESULT Error parsePragmaStart(const StringAuto* begin, const StringAuto* end, CString line, CString fname);
-	ANKI_USE_RESULT Error parsePragmaEnd(const StringAuto* begin, const StringAuto* end, CString line, CString fname);
+	ANKI_USE_RESULT Error parseLine(
+		CString line, ConstWeakArray<String> tokens, CString fname, Bool& foundPragmaOnce, U32 depth);
+	ANKI_USE_RESULT Error parseInclude(const String* begin, const String* end, CString line, CString fname, U32 depth);
+	ANKI_USE_RESULT Error parsePragmaMutator(const String* begin, const String* end, CString line, CString fname);
+	ANKI_USE_RESULT Error parsePragmaInput(const String* begin, const String* end, CString line, CString fname);
+	ANKI_USE_RESULT Error parsePragmaStart(const String* begin, const String* end, CString line, CString fname);
+	ANKI_USE_RESULT Error parsePragmaEnd(const String* begin, const String* end, CString line, CString fname);
 	ANKI_USE_RESULT Error parsePragmaDescriptorSet(
-		const StringAuto* begin, const StringAuto* end, CString line, CString fname);
-
-	void tokenizeLine(CString line, DynamicArrayAuto<StringAuto>& tokens);
+		const String* begin, const String* end, CString line, CString fname);
 
 	static Bool tokenIsComment(CString token)
 	{
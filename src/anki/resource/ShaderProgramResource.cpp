@@ -6,6 +6,7 @@
 #include <anki/resource/ShaderProgramResource.h>
 #include <anki/resource/ResourceManager.h>
 #include <anki/util/Filesystem.h>
+#include <anki/util/Hash.h>
 #include <tinyexpr.h>
 
 namespace anki
@@ -134,6 +135,29 @@ Bool ShaderProgramResourceInputVariable::acceptAllMutations(
 	return false;
 }
 
+/// The programs that ShaderProgramResource::prepareReload() compiled.
+class ShaderProgramResource::ReloadContext
+{
+public:
+	class Variant
+	{
+	public:
+		ShaderProgramResourceVariant* m_variant;
+		ShaderProgramPtr m_prog;
+	};
+
+	String m_source;
+	StringList m_dependencies;
+	DynamicArray<Variant> m_variants;
+
+	void destroy(ResourceAllocator<U8> alloc)
+	{
+		m_source.destroy(alloc);
+		m_dependencies.destroy(alloc);
+		m_variants.destroy(alloc);
+	}
+};
+
 ShaderProgramResource::ShaderProgramResource(ResourceManager* manager)
 	: ResourceObject(manager)
 {
@@ -143,15 +167,20 @@ ShaderProgramResource::~ShaderProgramResource()
 {
 	auto alloc = getAllocator();
 
-	while(!m_variants.isEmpty())
-	{
-		auto it = m_variants.getBegin();
-		ShaderProgramResourceVariant* variant = *it;
-		m_variants.erase(getAllocator(), it);
-
+	m_variants.iterate([&](ShaderProgramResourceVariant* variant) {
 		variant->m_blockInfos.destroy(alloc);
 		variant->m_texUnits.destroy(alloc);
+		variant->m_mutation.destroy(alloc);
+		variant->m_constants.destroy(alloc);
 		alloc.deleteInstance(variant);
+	});
+	m_variants.destroy(alloc);
+
+	if(m_reload)
+	{
+		// Destroyed after it was reloaded but before the reload was applied
+		m_reload->destroy(alloc);
+		alloc.deleteInstance(m_reload);
 	}
 
 	for(Input& var : m_inputVars)
@@ -169,16 +198,26 @@ ShaderProgramResource::~ShaderProgramResource()
 	m_mutators.destroy(alloc);
 
 	m_source.destroy(alloc);
+	m_dependencies.destroy(alloc);
 }
 
 Error ShaderProgramResource::load(const ResourceFilename& filename, Bool async)
 {
 	// Preprocess
-	ShaderProgramPreprocessor pp(filename, &getManager().getFilesystem(), getTempAllocator());
+	ShaderProgramPreprocessor pp(filename,
+		&getManager().getFilesystem(),
+		getTempAllocator(),
+		&getManager().getShaderProgramPreprocessorCache());
 	ANKI_CHECK(pp.parse());
 
 	// Create the source
 	m_source.create(getAllocator(), pp.getSource());
+	m_sourceHash = computeHash(&m_source[0], m_source.getLength());
+
+	for(const String& dep : pp.getDependencies())
+	{
+		m_dependencies.pushBack(getAllocator(), dep.toCString());
+	}
 
 	// Create the mutators
 	U instancedMutatorIdx = MAX_U;
@@ -288,27 +327,111 @@ void ShaderProgramResource::getOrCreateVariant(ConstWeakArray<ShaderProgramResou
 	// Compute hash
 	U64 hash = computeVariantHash(mutation, constants);
 
-	LockGuard<Mutex> lock(m_mtx);
-
-	auto it = m_variants.find(hash);
-	if(it != m_variants.getEnd())
+	// Find it without locking or create it. Only one thread creates it, that thread will also compile it
+	Bool initialize = false;
+	ShaderProgramResourceVariant** pv;
+	const Error err = m_variants.findOrCreate(getAllocator(),
+		hash,
+		[&](ShaderProgramResourceVariant*& newVariant) -> Error {
+			newVariant = getAllocator().newInstance<ShaderProgramResourceVariant>();
+			initialize = true;
+			return Error::NONE;
+		},
+		pv);
+	ANKI_ASSERT(!err && "The creation can't fail");
+	(void)err;
+	ShaderProgramResourceVariant* v = *pv;
+
+	if(initialize)
 	{
-		variant = *it;
+		// Keep what's needed to compile the variant again if the program is reloaded
+		if(getManager().getResourceWatcher())
+		{
+			if(mutation.getSize())
+			{
+				v->m_mutation.create(getAllocator(), mutation.getSize());
+				memcpy(&v->m_mutation[0], &mutation[0], mutation.getSizeInBytes());
+			}
+
+			if(constants.getSize())
+			{
+				v->m_constants.create(getAllocator(), constants.getSize());
+				memcpy(&v->m_constants[0], &constants[0], constants.getSizeInBytes());
+			}
+		}
+
+		// Compile without holding any lock
+		initVariant(mutation, constants, *v);
+
+		LockGuard<Mutex> lock(m_variantInitializedMtx);
+		v->m_initialized.store(true, AtomicMemoryOrder::RELEASE);
+		m_variantInitializedCondVar.notifyAll();
 	}
-	else
+	else if(!v->m_initialized.load(AtomicMemoryOrder::ACQUIRE))
 	{
-		// Create one
-		ShaderProgramResourceVariant* v = getAllocator().newInstance<ShaderProgramResourceVariant>();
-		initVariant(mutation, constants, *v);
+		// Some other thread is compiling it, wait for that thread
+		LockGuard<Mutex> lock(m_variantInitializedMtx);
+		while(!v->m_initialized.load(AtomicMemoryOrder::ACQUIRE))
+		{
+			m_variantInitializedCondVar.wait(m_variantInitializedMtx);
+		}
+	}
 
-		m_variants.emplace(getAllocator(), hash, v);
-		variant = v;
+	variant = v;
+}
+
+/// Compute the std430 size and alignment of a member of the struct that holds the instanced inputs of an instance.
+static void computeInstanceStorageMemberInfo(
+	ShaderVariableDataType type, U32& size, U32& alignment, ShaderVariableBlockInfo& blockInfo)
+{
+	switch(type)
+	{
+	case ShaderVariableDataType::FLOAT:
+	case ShaderVariableDataType::INT:
+	case ShaderVariableDataType::UINT:
+		size = sizeof(F32);
+		alignment = sizeof(F32);
+		break;
+	case ShaderVariableDataType::VEC2:
+	case ShaderVariableDataType::IVEC2:
+	case ShaderVariableDataType::UVEC2:
+		size = sizeof(Vec2);
+		alignment = sizeof(Vec2);
+		break;
+	case ShaderVariableDataType::VEC3:
+	case ShaderVariableDataType::IVEC3:
+	case ShaderVariableDataType::UVEC3:
+		size = sizeof(Vec3);
+		alignment = sizeof(Vec4);
+		break;
+	case ShaderVariableDataType::VEC4:
+	case ShaderVariableDataType::IVEC4:
+	case ShaderVariableDataType::UVEC4:
+		size = sizeof(Vec4);
+		alignment = sizeof(Vec4);
+		break;
+	case ShaderVariableDataType::MAT3:
+		// Row major, every row is aligned like a vec4
+		size = sizeof(Vec4) * 3;
+		alignment = sizeof(Vec4);
+		blockInfo.m_matrixStride = sizeof(Vec4);
+		break;
+	case ShaderVariableDataType::MAT4:
+		size = sizeof(Mat4);
+		alignment = sizeof(Vec4);
+		blockInfo.m_matrixStride = sizeof(Vec4);
+		break;
+	default:
+		ANKI_ASSERT(0);
+		size = 0;
+		alignment = 1;
 	}
 }
 
-void ShaderProgramResource::initVariant(ConstWeakArray<ShaderProgramResourceMutation> mutations,
+void ShaderProgramResource::initVariantLayout(ConstWeakArray<ShaderProgramResourceMutation> mutations,
 	ConstWeakArray<ShaderProgramResourceConstantValue> constants,
-	ShaderProgramResourceVariant& variant) const
+	ShaderProgramResourceVariant& variant,
+	StringAuto& shaderHeader) const
 {
 	variant.m_activeInputVars.unsetAll();
 	variant.m_blockInfos.create(getAllocator(), m_inputVars.getSize());
@@ -333,13 +456,17 @@ void ShaderProgramResource::initVariant(ConstWeakArray<ShaderProgramResourceMuta
 		}
 	}
 
+	// Too many instances for the uniforms, the instanced inputs go to a storage buffer
+	const Bool instancesInStorage = instanceCount > MAX_INSTANCES;
+	U32 instanceStorageAlignment = 1;
+
 	// - Compute the block info for each var
 	// - Activate vars
 	// - Compute varius strings
 	StringListAuto headerSrc(getTempAllocator());
 	U texUnit = 0;
 
-	for(const Input& in : m_inputVars)
+	for(const ShaderProgramResourceInputVariable& in : m_inputVars)
 	{
 		if(!in.acceptAllMutations(mutations))
 		{
@@ -349,7 +476,20 @@ void ShaderProgramResource::initVariant(ConstWeakArray<ShaderProgramResourceMuta
 		variant.m_activeInputVars.set(in.m_idx);
 
 		// Init block info
-		if(in.inBlock())
+		if(in.inBlock() && in.m_instanced && instancesInStorage)
+		{
+			ShaderVariableBlockInfo& blockInfo = variant.m_blockInfos[in.m_idx];
+
+			// std430 rules. The stride is known after all the instanced inputs are visited
+			U32 size, alignment;
+			computeInstanceStorageMemberInfo(in.m_dataType, size, alignment, blockInfo);
+			alignRoundUp(alignment, variant.m_instanceStorageStride);
+			blockInfo.m_offset = variant.m_instanceStorageStride;
+			blockInfo.m_arraySize = MAX_I16;
+			variant.m_instanceStorageStride += size;
+			instanceStorageAlignment = max(instanceStorageAlignment, alignment);
+		}
+		else if(in.inBlock())
 		{
 			ShaderVariableBlockInfo& blockInfo = variant.m_blockInfos[in.m_idx];
 
@@ -527,9 +667,28 @@ void ShaderProgramResource::initVariant(ConstWeakArray<ShaderProgramResourceMuta
 		}
 	}
 
+	if(instancesInStorage)
+	{
+		// Now that the struct of the instance is known set the strides
+		ANKI_ASSERT(variant.m_instanceStorageStride > 0);
+		alignRoundUp(instanceStorageAlignment, variant.m_instanceStorageStride);
+
+		for(const ShaderProgramResourceInputVariable& in : m_inputVars)
+		{
+			if(in.m_instanced && variant.m_activeInputVars.get(in.m_idx))
+			{
+				variant.m_blockInfos[in.m_idx].m_arrayStride = variant.m_instanceStorageStride;
+			}
+		}
+
+		// The uniform block has a padding member at the end to never be empty
+		alignRoundUp(sizeof(U32), variant.m_uniBlockSize);
+		variant.m_uniBlockSize += sizeof(U32);
+	}
+
 	// Check if we can use push constants
 	variant.m_usesPushConstants =
-		instanceCount == 1
+		(instanceCount == 1 || instancesInStorage)
 		&& variant.m_uniBlockSize <= getManager().getGrManager().getDeviceCapabilities().m_pushConstantsSize;
 
 	// Write the source header
@@ -548,9 +707,67 @@ void ShaderProgramResource::initVariant(ConstWeakArray<ShaderProgramResourceMuta
 		shaderHeaderSrc.pushBack(str.toCString());
 	}
 
-	StringAuto shaderHeader(getTempAllocator());
 	shaderHeaderSrc.join("", shaderHeader);
+}
 
+Error ShaderProgramResource::compileVariantStage(
+	CString source, CString shaderHeader, ShaderType type, DynamicArrayAuto<U8>& bin) const
+{
+	StringAuto src(getTempAllocator());
+	src.append(shaderHeader);
+	src.append(source);
+
+	ShaderCompilerOptions compileOptions;
+	compileOptions.setFromGrManager(getManager().getGrManager());
+	compileOptions.m_shaderType = type;
+
+	return getManager().getShaderCompiler().compile(src.toCString(), nullptr, compileOptions, bin);
+}
+
+void ShaderProgramResource::getMutationValues(
+	ConstWeakArray<ShaderProgramResourceMutation> mutations, DynamicArrayAuto<I32>& values) const
+{
+	values.create(m_mutators.getSize(), 0);
+	for(const ShaderProgramResourceMutation& m : mutations)
+	{
+		values[m.m_mutator - &m_mutators[0]] = m.m_value;
+	}
+}
+
+void ShaderProgramResource::initVariant(ConstWeakArray<ShaderProgramResourceMutation> mutations,
+	ConstWeakArray<ShaderProgramResourceConstantValue> constants,
+	ShaderProgramResourceVariant& variant) const
+{
+	variant.m_sourceVersion = m_sourceVersion;
+
+	StringAuto shaderHeader(getTempAllocator());
+	initVariantLayout(mutations, constants, variant, shaderHeader);
+
+	// Try to find the binaries in the shader program package. The variants with constants can't be there. The package
+	// is not used if the source changed since it was built
+	const ShaderProgramPackage& package = getManager().getShaderProgramPackage();
+	const ShaderProgramPackageFile::Variant* packageVariant = nullptr;
+	if(constants.getSize() == 0 && package.isLoaded())
+	{
+		DynamicArrayAuto<I32> values(getTempAllocator());
+		getMutationValues(mutations, values);
+		packageVariant = package.findVariant(getFilename(), m_sourceHash, values);
+
+		// The package is compiled for the same GPU so the layout is the same
+		ANKI_ASSERT(!packageVariant || Bool(packageVariant->m_usesPushConstants) == variant.m_usesPushConstants);
+	}
+
+	if(createVariantProgram(m_source.toCString(), shaderHeader.toCString(), packageVariant, variant.m_prog))
+	{
+		ANKI_RESOURCE_LOGF("Shader compilation failed");
+	}
+}
+
+Error ShaderProgramResource::createVariantProgram(CString source,
+	CString shaderHeader,
+	const ShaderProgramPackageFile::Variant* packageVariant,
+	ShaderProgramPtr& prog) const
+{
 	// Create the program name
 	StringAuto progName(getTempAllocator());
 	getFilepathFilename(getFilename(), progName);
@@ -569,31 +786,287 @@ void ShaderProgramResource::initVariant(ConstWeakArray<ShaderProgramResourceMuta
 			continue;
 		}
 
-		StringAuto src(getTempAllocator());
-		src.append(shaderHeader);
-		src.append(m_source);
-
-		// Compile
 		DynamicArrayAuto<U8> bin(getTempAllocator());
+		ShaderInitInfo inf(cprogName);
+		inf.m_shaderType = i;
+
+		if(packageVariant)
+		{
+			inf.m_binary = getManager().getShaderProgramPackage().getBinary(*packageVariant, i);
+		}
+		else
+		{
+			ANKI_CHECK(compileVariantStage(source, shaderHeader, i, bin));
+			inf.m_binary = ConstWeakArray<U8>(&bin[0], bin.getSize());
+		}
+
+		progInf.m_shaders[i] = getManager().getGrManager().newShader(inf);
+	}
 
-		ShaderCompilerOptions compileOptions;
-		compileOptions.setFromGrManager(getManager().getGrManager());
-		compileOptions.m_shaderType = i;
+	prog = getManager().getGrManager().newShaderProgram(progInf);
+	return Error::NONE;
+}
 
-		Error err = getManager().getShaderCompiler().compile(src.toCString(), nullptr, compileOptions, bin);
-		if(err)
+Error ShaderProgramResource::addToPackage(ShaderProgramPackageBuilder& builder) const
+{
+	DynamicArrayAuto<ShaderProgramResourceMutation> mutations(getTempAllocator());
+	DynamicArrayAuto<U32> valueIndices(getTempAllocator());
+	if(m_mutators.getSize())
+	{
+		mutations.create(m_mutators.getSize());
+		valueIndices.create(m_mutators.getSize(), 0);
+		for(U i = 0; i < m_mutators.getSize(); ++i)
 		{
-			ANKI_RESOURCE_LOGF("Shader compilation failed");
+			mutations[i].m_mutator = &m_mutators[i];
 		}
+	}
 
-		ShaderInitInfo inf(cprogName);
-		inf.m_shaderType = i;
-		inf.m_binary = ConstWeakArray<U8>(&bin[0], bin.getSize());
+	// Walk all the combinations of the mutator values
+	U32 variantCount = 0;
+	U32 skippedVariantCount = 0;
+	Bool done = false;
+	while(!done)
+	{
+		for(U i = 0; i < m_mutators.getSize(); ++i)
+		{
+			mutations[i].m_value = m_mutators[i].getValues()[valueIndices[i]];
+		}
 
-		progInf.m_shaders[i] = getManager().getGrManager().newShader(inf);
+		// The users of the program set the constants so the variants that use constants can't be compiled offline
+		Bool usesConstants = false;
+		for(const ShaderProgramResourceInputVariable& in : m_inputVars)
+		{
+			usesConstants = usesConstants || (in.m_const && in.acceptAllMutations(mutations));
+		}
+
+		if(usesConstants)
+		{
+			++skippedVariantCount;
+		}
+		else
+		{
+			ShaderProgramResourceVariant variant;
+			StringAuto shaderHeader(getTempAllocator());
+			initVariantLayout(mutations, ConstWeakArray<ShaderProgramResourceConstantValue>(), variant, shaderHeader);
+			variant.m_blockInfos.destroy(getAllocator());
+			variant.m_texUnits.destroy(getAllocator());
+
+			Array<DynamicArrayAuto<U8>*, U(ShaderType::COUNT)> bins = {};
+			Array<ConstWeakArray<U8>, U(ShaderType::COUNT)> binArrays;
+			for(ShaderType i = ShaderType::FIRST; i < ShaderType::COUNT; ++i)
+			{
+				if(!!(m_shaderStages & ShaderTypeBit(1 << U(i))))
+				{
+					bins[i] = getTempAllocator().newInstance<DynamicArrayAuto<U8>>(getTempAllocator());
+					if(compileVariantStage(m_source.toCString(), shaderHeader.toCString(), i, *bins[i]))
+					{
+						ANKI_RESOURCE_LOGF("Shader compilation failed");
+					}
+
+					binArrays[i] = ConstWeakArray<U8>(&(*bins[i])[0], bins[i]->getSize());
+				}
+			}
+
+			DynamicArrayAuto<I32> values(getTempAllocator());
+			getMutationValues(mutations, values);
+			builder.addVariant(getFilename(), m_sourceHash, values, variant.m_usesPushConstants, binArrays);
+			++variantCount;
+
+			for(DynamicArrayAuto<U8>* bin : bins)
+			{
+				if(bin)
+				{
+					getTempAllocator().deleteInstance(bin);
+				}
+			}
+		}
+
+		// Next combination
+		done = true;
+		for(U i = 0; i < m_mutators.getSize(); ++i)
+		{
+			if(++valueIndices[i] < m_mutators[i].getValues().getSize())
+			{
+				done = false;
+				break;
+			}
+
+			valueIndices[i] = 0;
+		}
+	}
+
+	ANKI_RESOURCE_LOGI("Added %u variants of %s to the package. Skipped %u variants that use constants",
+		variantCount,
+		&getFilename()[0],
+		skippedVariantCount);
+
+	return Error::NONE;
+}
+
+void ShaderProgramResource::getReloadDependencies(StringListAuto& files) const
+{
+	for(const String& dep : m_dependencies)
+	{
+		files.pushBack(dep.toCString());
+	}
+}
+
+Bool ShaderProgramResource::interfaceMatches(const ShaderProgramPreprocessor& pp) const
+{
+	if(pp.getMutators().getSize() != m_mutators.getSize() || pp.getInputs().getSize() != m_inputVars.getSize()
+		|| pp.getShaderStages() != m_shaderStages || pp.getDescritproSet() != m_descriptorSet)
+	{
+		return false;
+	}
+
+	for(U i = 0; i < m_mutators.getSize(); ++i)
+	{
+		const ShaderProgramPreprocessorMutator& in = pp.getMutators()[i];
+		const Mutator& crnt = m_mutators[i];
+
+		if(crnt.m_name != in.getName() || crnt.m_values.getSize() != in.getValues().getSize()
+			|| in.isInstanced() != (m_instancingMutator == &crnt))
+		{
+			return false;
+		}
+
+		for(U j = 0; j < crnt.m_values.getSize(); ++j)
+		{
+			if(crnt.m_values[j] != in.getValues()[j])
+			{
+				return false;
+			}
+		}
+	}
+
+	for(U i = 0; i < m_inputVars.getSize(); ++i)
+	{
+		const ShaderProgramPreprocessorInput& in = pp.getInputs()[i];
+		const Input& crnt = m_inputVars[i];
+
+		const CString preprocExpr = in.getPreprocessorCondition();
+		if(crnt.m_name != in.getName() || Bool(crnt.m_preprocExpr) != Bool(preprocExpr)
+			|| (preprocExpr && crnt.m_preprocExpr != preprocExpr) || crnt.m_dataType != in.getDataType()
+			|| crnt.m_const != in.isConstant() || crnt.m_instanced != in.isInstanced())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+Error ShaderProgramResource::recompileVariant(
+	CString source, const ShaderProgramResourceVariant& variant, ShaderProgramPtr& prog) const
+{
+	// The interface is the same so only the header is needed, the layout of the variant stays the same
+	ShaderProgramResourceVariant tmpVariant;
+	StringAuto shaderHeader(getTempAllocator());
+	initVariantLayout(variant.m_mutation, variant.m_constants, tmpVariant, shaderHeader);
+	tmpVariant.m_blockInfos.destroy(getAllocator());
+	tmpVariant.m_texUnits.destroy(getAllocator());
+
+	return createVariantProgram(source, shaderHeader.toCString(), nullptr, prog);
+}
+
+Error ShaderProgramResource::prepareReload()
+{
+	ANKI_ASSERT(m_reload == nullptr);
+
+	ShaderProgramPreprocessor pp(getFilename(),
+		&getManager().getFilesystem(),
+		getTempAllocator(),
+		&getManager().getShaderProgramPreprocessorCache());
+	ANKI_CHECK(pp.parse());
+
+	// The users of the program hold pointers to the mutators and the inputs and they have made decisions based on them
+	if(!interfaceMatches(pp))
+	{
+		ANKI_RESOURCE_LOGE("The mutators, the inputs, the shader stages or the descriptor set of the program changed. "
+						   "Restart to see the changes: %s",
+			&getFilename()[0]);
+		return Error::USER_DATA;
+	}
+
+	ReloadContext* ctx = getAllocator().newInstance<ReloadContext>();
+	ctx->m_source.create(getAllocator(), pp.getSource());
+	for(const String& dep : pp.getDependencies())
+	{
+		ctx->m_dependencies.pushBack(getAllocator(), dep.toCString());
+	}
+
+	// Compile the variants that are ready. The rest will be compiled in finishReload()
+	Error err = Error::NONE;
+	m_variants.iterate([&](ShaderProgramResourceVariant* variant) {
+		if(err || !variant->m_initialized.load(AtomicMemoryOrder::ACQUIRE))
+		{
+			return;
+		}
+
+		ShaderProgramPtr prog;
+		err = recompileVariant(ctx->m_source.toCString(), *variant, prog);
+		if(!err)
+		{
+			ReloadContext::Variant& out = *ctx->m_variants.emplaceBack(getAllocator());
+			out.m_variant = variant;
+			out.m_prog = prog;
+		}
+	});
+
+	if(err)
+	{
+		ctx->destroy(getAllocator());
+		getAllocator().deleteInstance(ctx);
+		return err;
+	}
+
+	m_reload = ctx;
+	return Error::NONE;
+}
+
+void ShaderProgramResource::finishReload()
+{
+	ANKI_ASSERT(m_reload);
+
+	++m_sourceVersion;
+
+	m_source.destroy(getAllocator());
+	m_source = std::move(m_reload->m_source);
+	m_sourceHash = computeHash(&m_source[0], m_source.getLength());
+
+	m_dependencies.destroy(getAllocator());
+	m_dependencies = std::move(m_reload->m_dependencies);
+
+	for(ReloadContext::Variant& v : m_reload->m_variants)
+	{
+		v.m_variant->m_prog = v.m_prog;
+		v.m_variant->m_sourceVersion = m_sourceVersion;
 	}
 
-	variant.m_prog = getManager().getGrManager().newShaderProgram(progInf);
+	m_reload->destroy(getAllocator());
+	getAllocator().deleteInstance(m_reload);
+	m_reload = nullptr;
+
+	// The variants that were created while reloading are compiled from the old source
+	m_variants.iterate([&](ShaderProgramResourceVariant* variant) {
+		if(variant->m_sourceVersion == m_sourceVersion || !variant->m_initialized.load(AtomicMemoryOrder::ACQUIRE))
+		{
+			return;
+		}
+
+		ShaderProgramPtr prog;
+		if(recompileVariant(m_source.toCString(), *variant, prog))
+		{
+			ANKI_RESOURCE_LOGE("Failed to compile a variant of the reloaded program, will keep the old one: %s",
+				&getFilename()[0]);
+		}
+		else
+		{
+			variant->m_prog = prog;
+		}
+
+		variant->m_sourceVersion = m_sourceVersion;
+	});
 }
 
 } // end namespace anki
@@ -7,8 +7,10 @@
 
 #include <anki/resource/ResourceObject.h>
 #include <anki/resource/ShaderProgramPreProcessor.h>
+#include <anki/resource/ShaderProgramPackage.h>
 #include <anki/Gr.h>
 #include <anki/util/BitSet.h>
+#include <anki/util/ConcurrentHashMap.h>
 
 // Forward
 struct te_variable;
@@ -132,6 +134,9 @@ private:
 		U32 varIdxOffset) const;
 };
 
+// Forward
+class ShaderProgramResourceConstantValue;
+
 /// Shader program resource variant.
 class ShaderProgramResourceVariant
 {
@@ -162,6 +167,20 @@ public:
 		return m_usesPushConstants;
 	}
 
+	/// Return true if the instanced inputs live in a storage buffer and not in the uniforms. In that case the block
+	/// info of the instanced inputs describes the storage buffer and there is no limit to the instance count.
+	Bool instancedInputsInStorage() const
+	{
+		return m_instanceStorageStride > 0;
+	}
+
+	/// The size of the instanced inputs of a single instance in the storage buffer.
+	U getInstanceStorageStride() const
+	{
+		ANKI_ASSERT(instancedInputsInStorage());
+		return m_instanceStorageStride;
+	}
+
 	const ShaderVariableBlockInfo& getVariableBlockInfo(const ShaderProgramResourceInputVariable& var) const
 	{
 		ANKI_ASSERT(!var.isTexture() && variableActive(var));
@@ -197,8 +216,16 @@ private:
 	BitSet<128, U64> m_activeInputVars = {false};
 	DynamicArray<ShaderVariableBlockInfo> m_blockInfos;
 	U32 m_uniBlockSize = 0;
+	U32 m_instanceStorageStride = 0;
 	DynamicArray<I16> m_texUnits;
 	Bool8 m_usesPushConstants = false;
+
+	Atomic<Bool> m_initialized = {false}; ///< It's false while the variant is compiled.
+
+	/// The mutation and the constants are kept to compile the variant again when the program is reloaded.
+	DynamicArray<ShaderProgramResourceMutation> m_mutation;
+	DynamicArray<ShaderProgramResourceConstantValue> m_constants;
+	U32 m_sourceVersion = 0; ///< The ShaderProgramResource::m_sourceVersion it's compiled from.
 };
 
 /// The value of a constant.
@@ -284,7 +311,9 @@ public:
 	}
 
 	/// Get or create a graphics shader program variant.
-	/// @note It's thread-safe.
+	/// @note It's thread-safe. Getting a variant that is already created doesn't lock. A missing variant is created
+	///       without holding the lock so the rest of the variants can be used meanwhile. If many threads ask for the
+	///       same missing variant it's created once and the rest of the threads wait for it.
 	void getOrCreateVariant(ConstWeakArray<ShaderProgramResourceMutation> mutation,
 		ConstWeakArray<ShaderProgramResourceConstantValue> constants,
 		const ShaderProgramResourceVariant*& variant) const;
@@ -338,17 +367,38 @@ public:
 		return m_descriptorSet;
 	}
 
+anki_internal:
+	/// Compile all the variants that don't use constants and add them to a package.
+	ANKI_USE_RESULT Error addToPackage(ShaderProgramPackageBuilder& builder) const;
+
+	void getReloadDependencies(StringListAuto& files) const override;
+
+	/// Preprocess the program again and compile the variants that exist from the new source. The mutators, the inputs,
+	/// the stages and the descriptor set can't change.
+	ANKI_USE_RESULT Error prepareReload() override;
+
+	/// Swap the programs of the variants with the ones prepareReload() compiled. The variants that were created
+	/// meanwhile are compiled here.
+	void finishReload() override;
+
 private:
 	using Mutator = ShaderProgramResourceMutator;
 	using Input = ShaderProgramResourceInputVariable;
 
+	class ReloadContext;
+
 	DynamicArray<Input> m_inputVars;
 	DynamicArray<Mutator> m_mutators;
 
 	String m_source;
+	U64 m_sourceHash = 0; ///< The hash of m_source. It's used to check if the shader program package is up to date.
+	U32 m_sourceVersion = 0; ///< Incremented every time the program is reloaded.
+	StringList m_dependencies; ///< The file of the program and the files it includes.
+	ReloadContext* m_reload = nullptr; ///< What prepareReload() created.
 
-	mutable HashMap<U64, ShaderProgramResourceVariant*> m_variants;
-	mutable Mutex m_mtx;
+	mutable ConcurrentHashMap<U64, ShaderProgramResourceVariant*> m_variants; ///< Some might still be compiled.
+	mutable Mutex m_variantInitializedMtx;
+	mutable ConditionVariable m_variantInitializedCondVar;
 
 	U8 m_descriptorSet = 0;
 	ShaderTypeBit m_shaderStages = ShaderTypeBit::NONE;
@@ -360,6 +410,33 @@ private:
 	void initVariant(ConstWeakArray<ShaderProgramResourceMutation> mutations,
 		ConstWeakArray<ShaderProgramResourceConstantValue> constants,
 		ShaderProgramResourceVariant& variant) const;
+
+	/// Compute the layout of the variant and the header of its source. It doesn't compile anything.
+	void initVariantLayout(ConstWeakArray<ShaderProgramResourceMutation> mutations,
+		ConstWeakArray<ShaderProgramResourceConstantValue> constants,
+		ShaderProgramResourceVariant& variant,
+		StringAuto& shaderHeader) const;
+
+	ANKI_USE_RESULT Error compileVariantStage(
+		CString source, CString shaderHeader, ShaderType type, DynamicArrayAuto<U8>& bin) const;
+
+	/// Create the GR program of a variant.
+	/// @param packageVariant If it's not nullptr the binaries are taken from the package instead of compiling source.
+	ANKI_USE_RESULT Error createVariantProgram(CString source,
+		CString shaderHeader,
+		const ShaderProgramPackageFile::Variant* packageVariant,
+		ShaderProgramPtr& prog) const;
+
+	/// Compile an existing variant from a different source.
+	ANKI_USE_RESULT Error recompileVariant(
+		CString source, const ShaderProgramResourceVariant& variant, ShaderProgramPtr& prog) const;
+
+	/// Check if a preprocessed program has the same interface as this one.
+	Bool interfaceMatches(const ShaderProgramPreprocessor& pp) const;
+
+	/// Get the values of a mutation in the order of m_mutators.
+	void getMutationValues(
+		ConstWeakArray<ShaderProgramResourceMutation> mutations, DynamicArrayAuto<I32>& values) const;
 };
 
 /// Smart initializer of multiple ShaderProgramResourceConstantValue.
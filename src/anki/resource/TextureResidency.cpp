@@ -0,0 +1,273 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/TextureResidency.h>
+#include <algorithm>
+#include <cmath>
+
+namespace anki
+{
+
+class TextureResidency::Entry
+{
+public:
+	Array<PtrSize, MAX_STREAMED_TEXTURE_MIPS> m_mipSizes;
+	void* m_userData;
+	U64 m_lastRequestFrame = 0;
+	Atomic<U32> m_requestedMip = {MAX_U32};
+	U32 m_index; ///< Index in TextureResidency::m_entries.
+	U8 m_mipCount;
+	U8 m_maxFirstMip; ///< The mips after that are always resident.
+	U8 m_residentFirstMip;
+	U8 m_wantedFirstMip;
+	Bool8 m_changePending = false;
+
+	PtrSize computeMemory(U firstMip) const
+	{
+		PtrSize size = 0;
+		for(U mip = firstMip; mip < m_mipCount; ++mip)
+		{
+			size += m_mipSizes[mip];
+		}
+		return size;
+	}
+};
+
+TextureResidency::~TextureResidency()
+{
+	ANKI_ASSERT(m_entries.getSize() == 0 && "Forgot to unregister some textures");
+	m_entries.destroy(m_alloc);
+}
+
+void TextureResidency::init(PtrSize memoryBudget, U32 evictionFrameCount, U32 maxStreamInsPerFrame)
+{
+	ANKI_ASSERT(memoryBudget > 0 && maxStreamInsPerFrame > 0);
+	m_memoryBudget = memoryBudget;
+	m_evictionFrameCount = evictionFrameCount;
+	m_maxStreamInsPerFrame = maxStreamInsPerFrame;
+}
+
+TextureResidency::Entry* TextureResidency::registerTexture(
+	ConstWeakArray<PtrSize> mipSizes, U32 residentFirstMip, void* userData)
+{
+	ANKI_ASSERT(mipSizes.getSize() > 0 && mipSizes.getSize() <= MAX_STREAMED_TEXTURE_MIPS);
+	ANKI_ASSERT(residentFirstMip < mipSizes.getSize());
+
+	Entry* entry = m_alloc.newInstance<Entry>();
+	for(U mip = 0; mip < mipSizes.getSize(); ++mip)
+	{
+		entry->m_mipSizes[mip] = mipSizes[mip];
+	}
+	entry->m_userData = userData;
+	entry->m_lastRequestFrame = m_frame;
+	entry->m_index = m_entries.getSize();
+	entry->m_mipCount = mipSizes.getSize();
+	entry->m_maxFirstMip = residentFirstMip;
+	entry->m_residentFirstMip = residentFirstMip;
+	entry->m_wantedFirstMip = residentFirstMip;
+
+	m_entries.emplaceBack(m_alloc, entry);
+	m_residentMemory += entry->computeMemory(residentFirstMip);
+
+	return entry;
+}
+
+void TextureResidency::unregisterTexture(Entry* entry)
+{
+	ANKI_ASSERT(entry && entry->m_index < m_entries.getSize() && m_entries[entry->m_index] == entry);
+
+	m_residentMemory -= entry->computeMemory(entry->m_residentFirstMip);
+
+	// Swap with the last
+	Entry* last = m_entries.getBack();
+	m_entries[entry->m_index] = last;
+	last->m_index = entry->m_index;
+	m_entries.resize(m_alloc, m_entries.getSize() - 1);
+
+	m_alloc.deleteInstance(entry);
+}
+
+void TextureResidency::requestMip(Entry* entry, U32 mip)
+{
+	ANKI_ASSERT(entry);
+	entry->m_requestedMip.min(mip);
+}
+
+U32 TextureResidency::computeRequiredMip(U32 textureSize, F32 screenPixels)
+{
+	ANKI_ASSERT(textureSize > 0);
+	if(screenPixels >= F32(textureSize))
+	{
+		return 0;
+	}
+
+	if(screenPixels < 1.0f)
+	{
+		return MAX_STREAMED_TEXTURE_MIPS - 1;
+	}
+
+	// Each mip halves the texel density
+	const F32 mip = std::log2(F32(textureSize) / screenPixels);
+	return min<U32>(U32(mip), MAX_STREAMED_TEXTURE_MIPS - 1);
+}
+
+void TextureResidency::update(DynamicArrayAuto<TextureResidencyChange>& changes)
+{
+	++m_frame;
+
+	// Gather the requests of the previous frame
+	PtrSize wantedMemory = 0;
+	for(Entry* e : m_entries)
+	{
+		const U32 requested = e->m_requestedMip.exchange(MAX_U32);
+		if(requested != MAX_U32)
+		{
+			e->m_lastRequestFrame = m_frame;
+			e->m_wantedFirstMip = min<U32>(requested, e->m_maxFirstMip);
+		}
+		else if(m_frame - e->m_lastRequestFrame > m_evictionFrameCount)
+		{
+			// Not used for some time, keep only the minimum
+			e->m_wantedFirstMip = e->m_maxFirstMip;
+		}
+
+		wantedMemory += e->computeMemory(e->m_wantedFirstMip);
+	}
+
+	// Enforce the budget
+	if(wantedMemory > m_memoryBudget)
+	{
+		DynamicArrayAuto<Entry*> sorted(m_alloc);
+		sorted.create(m_entries.getSize());
+		memcpy(&sorted[0], &m_entries[0], m_entries.getSizeInBytes());
+
+		// Least recently requested first and then the ones with the biggest top mip
+		std::sort(sorted.getBegin(), sorted.getEnd(), [](const Entry* a, const Entry* b) {
+			if(a->m_lastRequestFrame != b->m_lastRequestFrame)
+			{
+				return a->m_lastRequestFrame < b->m_lastRequestFrame;
+			}
+
+			return a->m_mipSizes[a->m_wantedFirstMip] > b->m_mipSizes[b->m_wantedFirstMip];
+		});
+
+		// First drop everything from the textures that were not requested this frame
+		for(Entry* e : sorted)
+		{
+			if(wantedMemory <= m_memoryBudget || e->m_lastRequestFrame == m_frame)
+			{
+				break;
+			}
+
+			while(e->m_wantedFirstMip < e->m_maxFirstMip && wantedMemory > m_memoryBudget)
+			{
+				wantedMemory -= e->m_mipSizes[e->m_wantedFirstMip];
+				++e->m_wantedFirstMip;
+			}
+		}
+
+		// Then drop one mip at a time from all textures to share the pain
+		Bool progress = true;
+		while(wantedMemory > m_memoryBudget && progress)
+		{
+			progress = false;
+			for(Entry* e : sorted)
+			{
+				if(wantedMemory <= m_memoryBudget)
+				{
+					break;
+				}
+
+				if(e->m_wantedFirstMip < e->m_maxFirstMip)
+				{
+					wantedMemory -= e->m_mipSizes[e->m_wantedFirstMip];
+					++e->m_wantedFirstMip;
+					progress = true;
+				}
+			}
+		}
+	}
+
+	// Evictions go first because they free memory
+	changes.resize(0);
+	DynamicArrayAuto<Entry*> streamIns(m_alloc);
+	for(Entry* e : m_entries)
+	{
+		if(e->m_changePending || e->m_wantedFirstMip == e->m_residentFirstMip)
+		{
+			continue;
+		}
+
+		if(e->m_wantedFirstMip > e->m_residentFirstMip)
+		{
+			TextureResidencyChange& change = *changes.emplaceBack();
+			change.m_userData = e->m_userData;
+			change.m_fromFirstMip = e->m_residentFirstMip;
+			change.m_toFirstMip = e->m_wantedFirstMip;
+			e->m_changePending = true;
+		}
+		else
+		{
+			streamIns.emplaceBack(e);
+		}
+	}
+
+	// Stream in the ones that need more detail first
+	std::sort(streamIns.getBegin(), streamIns.getEnd(), [](const Entry* a, const Entry* b) {
+		return (a->m_residentFirstMip - a->m_wantedFirstMip) > (b->m_residentFirstMip - b->m_wantedFirstMip);
+	});
+
+	PtrSize projectedMemory = m_residentMemory;
+	U32 streamInCount = 0;
+	for(Entry* e : streamIns)
+	{
+		if(streamInCount >= m_maxStreamInsPerFrame)
+		{
+			break;
+		}
+
+		// Wait for the evictions if there is no space
+		const PtrSize extraMemory =
+			e->computeMemory(e->m_wantedFirstMip) - e->computeMemory(e->m_residentFirstMip);
+		if(projectedMemory + extraMemory > m_memoryBudget)
+		{
+			continue;
+		}
+
+		projectedMemory += extraMemory;
+
+		TextureResidencyChange& change = *changes.emplaceBack();
+		change.m_userData = e->m_userData;
+		change.m_fromFirstMip = e->m_residentFirstMip;
+		change.m_toFirstMip = e->m_wantedFirstMip;
+		e->m_changePending = true;
+		++streamInCount;
+	}
+}
+
+void TextureResidency::completeChange(Entry* entry, U32 newFirstMip)
+{
+	ANKI_ASSERT(entry && entry->m_changePending);
+	ANKI_ASSERT(newFirstMip <= entry->m_maxFirstMip);
+
+	m_residentMemory -= entry->computeMemory(entry->m_residentFirstMip);
+	m_residentMemory += entry->computeMemory(newFirstMip);
+	entry->m_residentFirstMip = newFirstMip;
+	entry->m_changePending = false;
+}
+
+void TextureResidency::cancelChange(Entry* entry)
+{
+	ANKI_ASSERT(entry && entry->m_changePending);
+	entry->m_changePending = false;
+}
+
+U32 TextureResidency::getResidentFirstMip(const Entry* entry) const
+{
+	ANKI_ASSERT(entry);
+	return entry->m_residentFirstMip;
+}
+
+} // end namespace anki
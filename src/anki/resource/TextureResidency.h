@@ -0,0 +1,111 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/Common.h>
+#include <anki/util/Atomic.h>
+#include <anki/util/DynamicArray.h>
+#include <anki/util/WeakArray.h>
+
+namespace anki
+{
+
+/// @addtogroup resource
+/// @{
+
+/// The max number of mips a streamed texture can have.
+const U32 MAX_STREAMED_TEXTURE_MIPS = 16;
+
+/// A residency change that the texture streamer needs to perform.
+class TextureResidencyChange
+{
+public:
+	void* m_userData; ///< The user data of the texture.
+	U32 m_fromFirstMip; ///< The first mip that is resident now.
+	U32 m_toFirstMip; ///< The first mip that should become resident.
+};
+
+/// The CPU side of the texture streaming. It decides which mips of the streamed textures should be resident based on the
+/// requests of the visibility tests and a memory budget. It doesn't touch the GPU.
+/// @note requestMip is thread-safe. The rest of the methods should be called from a single thread.
+class TextureResidency : public NonCopyable
+{
+public:
+	/// Opaque handle of a registered texture.
+	class Entry;
+
+	TextureResidency(GenericMemoryPoolAllocator<U8> alloc)
+		: m_alloc(alloc)
+	{
+	}
+
+	~TextureResidency();
+
+	/// @param memoryBudget The max memory of all the resident mips.
+	/// @param evictionFrameCount After how many frames without requests a texture will drop to its minimum mips.
+	/// @param maxStreamInsPerFrame The max number of textures that will be scheduled for streaming in per frame.
+	void init(PtrSize memoryBudget, U32 evictionFrameCount, U32 maxStreamInsPerFrame);
+
+	/// Register a texture.
+	/// @param mipSizes The memory of each mip, including all faces and layers.
+	/// @param residentFirstMip The first mip that is resident right after loading. The mips after that will always stay
+	///                         resident.
+	/// @param userData Something that will be passed to TextureResidencyChange.
+	Entry* registerTexture(ConstWeakArray<PtrSize> mipSizes, U32 residentFirstMip, void* userData);
+
+	void unregisterTexture(Entry* entry);
+
+	/// Request a mip. The lowest mip requested in a frame wins.
+	/// @note It's thread-safe.
+	void requestMip(Entry* entry, U32 mip);
+
+	/// Compute the mip that is required for an object that occupies some pixels on the screen.
+	/// @param textureSize The max dimension of the texture's mip 0.
+	/// @param screenPixels The size of the object on the screen in pixels.
+	static U32 computeRequiredMip(U32 textureSize, F32 screenPixels);
+
+	/// Decide what needs to change. Call it once a frame.
+	/// @param[out] changes The changes that need to happen. The changes that drop mips come first.
+	void update(DynamicArrayAuto<TextureResidencyChange>& changes);
+
+	/// Inform the residency that a change requested by update was completed.
+	void completeChange(Entry* entry, U32 newFirstMip);
+
+	/// Inform the residency that a change requested by update failed.
+	void cancelChange(Entry* entry);
+
+	/// Get the first resident mip of a texture.
+	U32 getResidentFirstMip(const Entry* entry) const;
+
+	/// Get the memory of the resident mips.
+	PtrSize getResidentMemory() const
+	{
+		return m_residentMemory;
+	}
+
+	PtrSize getMemoryBudget() const
+	{
+		return m_memoryBudget;
+	}
+
+	U32 getTextureCount() const
+	{
+		return m_entries.getSize();
+	}
+
+private:
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	DynamicArray<Entry*> m_entries;
+
+	PtrSize m_memoryBudget = MAX_PTR_SIZE;
+	PtrSize m_residentMemory = 0;
+	U64 m_frame = 0;
+	U32 m_evictionFrameCount = 60;
+	U32 m_maxStreamInsPerFrame = 4;
+};
+/// @}
+
+} // end namespace anki
@@ -7,6 +7,8 @@
 #include <anki/resource/ImageLoader.h>
 #include <anki/resource/ResourceManager.h>
 #include <anki/resource/AsyncLoader.h>
+#include <anki/resource/TextureStreamer.h>
+#include <anki/core/Trace.h>
 
 namespace anki
 {
@@ -45,8 +47,76 @@ public:
 	}
 };
 
+/// Texture streaming async task.
+class TextureResource::StreamingTask : public AsyncLoaderTask
+{
+public:
+	TextureResource::LoadingContext m_ctx;
+	StringAuto m_filename;
+	ResourceManager* m_manager ANKI_DBG_NULLIFY;
+	TextureStreamingRequest* m_req ANKI_DBG_NULLIFY;
+	U32 m_maxTextureSize = MAX_U32;
+
+	StreamingTask(GenericMemoryPoolAllocator<U8> alloc)
+		: m_ctx(alloc)
+		, m_filename(alloc)
+	{
+	}
+
+	Error operator()(AsyncLoaderTaskContext& ctx) final
+	{
+		ANKI_TRACE_SCOPED_EVENT(RSRC_TEXTURE_STREAM);
+
+		const Error err = stream();
+		if(err)
+		{
+			ANKI_RESOURCE_LOGE("Failed to stream texture: %s", m_filename.cstr());
+		}
+
+		// The streamer will pick the result in the next frame. Failures are not fatal, the texture just keeps the mips
+		// it already has
+		m_req->m_state.store((err) ? TextureStreamingRequest::State::FAILED : TextureStreamingRequest::State::DONE);
+		return Error::NONE;
+	}
+
+private:
+	ANKI_USE_RESULT Error stream()
+	{
+		ResourceFilePtr file;
+		ANKI_CHECK(m_manager->getFilesystem().openFile(m_filename.toCString(), file));
+		ANKI_CHECK(m_ctx.m_loader.load(file, m_filename.toCString(), m_maxTextureSize));
+
+		TextureInitInfo init("RsrcStreamTex");
+		U faces;
+		TextureResource::fillTextureInitInfo(m_ctx.m_loader, init, faces);
+
+		m_ctx.m_faces = faces;
+		m_ctx.m_layerCount = init.m_layerCount;
+		m_ctx.m_gr = &m_manager->getGrManager();
+		m_ctx.m_trfAlloc = &m_manager->getTransferGpuAllocator();
+		m_ctx.m_texType = init.m_type;
+		m_ctx.m_tex = m_manager->getGrManager().newTexture(init);
+
+		ANKI_CHECK(TextureResource::load(m_ctx));
+
+		m_req->m_newTexture = m_ctx.m_tex;
+		return Error::NONE;
+	}
+};
+
 TextureResource::~TextureResource()
 {
+	if(m_streamingEntry)
+	{
+		getManager().getTextureStreamer().unregisterTexture(this, m_streamingEntry);
+	}
+
+	m_streamingFilename.destroy(getAllocator());
+
+	if(m_reload)
+	{
+		getAllocator().deleteInstance(m_reload);
+	}
 }
 
 Error TextureResource::load(const ResourceFilename& filename, Bool async)
@@ -67,15 +137,99 @@ Error TextureResource::load(const ResourceFilename& filename, Bool async)
 	}
 	ImageLoader& loader = ctx->m_loader;
 
+	ResourceFilePtr file;
+	ANKI_CHECK(openFile(filename, file));
+
+	// If the texture will be streamed load only the mips that will always be resident
+	const U32 maxTextureSize = getManager().getMaxTextureSize();
+	TextureStreamer& streamer = getManager().getTextureStreamer();
+	const U32 loadSize = (streamer.isEnabled()) ? min(maxTextureSize, streamer.getResidentMipSize()) : maxTextureSize;
+	ANKI_CHECK(loader.load(file, filename, loadSize));
+
+	// Find the mip of the file that would have been the first without streaming
+	const U32 fullSize = max(loader.getWidth(), loader.getHeight()) << loader.getFirstMipLevel();
+	U32 baseMip = 0;
+	while((fullSize >> baseMip) > maxTextureSize && baseMip + 1 < loader.getFullMipLevelsCount())
+	{
+		++baseMip;
+	}
+
+	// Only 2D textures can be streamed. Load the rest of the mips of the others
+	const Bool streamable = (loader.getTextureType() == ImageLoader::TextureType::_2D
+								|| loader.getTextureType() == ImageLoader::TextureType::_2D_ARRAY)
+							&& loader.getFullMipLevelsCount() - baseMip <= MAX_STREAMED_TEXTURE_MIPS;
+	if(loader.getFirstMipLevel() > baseMip && !streamable)
+	{
+		ANKI_CHECK(openFile(filename, file));
+		ANKI_CHECK(loader.load(file, filename, maxTextureSize));
+	}
+
+	const U32 residentFirstMip = loader.getFirstMipLevel() - baseMip;
+	const U32 streamedMipCount = loader.getFullMipLevelsCount() - baseMip;
+
 	TextureInitInfo init("RsrcTex");
-	init.m_usage = TextureUsageBit::SAMPLED_ALL | TextureUsageBit::TRANSFER_DESTINATION;
-	init.m_initialUsage = TextureUsageBit::SAMPLED_ALL;
 	U faces = 0;
+	fillTextureInitInfo(loader, init, faces);
 
-	ResourceFilePtr file;
-	ANKI_CHECK(openFile(filename, file));
+	// Create the texture
+	m_tex = getManager().getGrManager().newTexture(init);
 
-	ANKI_CHECK(loader.load(file, filename, getManager().getMaxTextureSize()));
+	// Set the context
+	ctx->m_faces = faces;
+	ctx->m_layerCount = init.m_layerCount;
+	ctx->m_gr = &getManager().getGrManager();
+	ctx->m_trfAlloc = &getManager().getTransferGpuAllocator();
+	ctx->m_texType = init.m_type;
+	ctx->m_tex = m_tex;
+
+	// Upload the data
+	if(async)
+	{
+		getManager().getAsyncLoader().submitTask(task);
+	}
+	else
+	{
+		ANKI_CHECK(load(*ctx));
+	}
+
+	// Create sampler
+	SamplerInitInfo samplerInit("TextureRsrc");
+	samplerInit.m_minMagFilter = SamplingFilter::LINEAR;
+	samplerInit.m_mipmapFilter = SamplingFilter::LINEAR;
+	samplerInit.m_addressing = SamplingAddressing::REPEAT;
+	samplerInit.m_anisotropyLevel = getManager().getTextureAnisotropy();
+	m_sampler = getManager().getGrManager().newSampler(samplerInit);
+
+	// The size is the one without streaming
+	m_size = UVec3(init.m_width << residentFirstMip, init.m_height << residentFirstMip, init.m_depth);
+	m_layerCount = init.m_layerCount;
+
+	// Create the texture view
+	TextureViewInitInfo viewInit(m_tex, "Rsrc");
+	m_texView = getManager().getGrManager().newTextureView(viewInit);
+
+	// Register to the streamer
+	if(residentFirstMip > 0)
+	{
+		Array<PtrSize, MAX_STREAMED_TEXTURE_MIPS> mipSizes;
+		for(U mip = 0; mip < streamedMipCount; ++mip)
+		{
+			mipSizes[mip] = computeSurfaceSize(max(1u, m_size.x() >> mip), max(1u, m_size.y() >> mip), init.m_format)
+							* m_layerCount;
+		}
+
+		m_streamingFilename.create(getAllocator(), filename);
+		m_streamingEntry = streamer.registerTexture(
+			this, ConstWeakArray<PtrSize>(&mipSizes[0], streamedMipCount), residentFirstMip);
+	}
+
+	return Error::NONE;
+}
+
+void TextureResource::fillTextureInitInfo(const ImageLoader& loader, TextureInitInfo& init, U& faces)
+{
+	init.m_usage = TextureUsageBit::SAMPLED_ALL | TextureUsageBit::TRANSFER_DESTINATION;
+	init.m_initialUsage = TextureUsageBit::SAMPLED_ALL;
 
 	// Various sizes
 	init.m_width = loader.getWidth();
@@ -159,44 +313,81 @@ Error TextureResource::load(const ResourceFilename& filename, Bool async)
 
 	// mipmapsCount
 	init.m_mipmapCount = loader.getMipLevelsCount();
+}
 
-	// Create the texture
-	m_tex = getManager().getGrManager().newTexture(init);
+void TextureResource::requestDetail(F32 projectedSize)
+{
+	if(m_streamingEntry)
+	{
+		getManager().getTextureStreamer().requestScreenSize(
+			m_streamingEntry, max(m_size.x(), m_size.y()), projectedSize);
+	}
+}
 
-	// Set the context
-	ctx->m_faces = faces;
-	ctx->m_layerCount = init.m_layerCount;
-	ctx->m_gr = &getManager().getGrManager();
-	ctx->m_trfAlloc = &getManager().getTransferGpuAllocator();
-	ctx->m_texType = init.m_type;
-	ctx->m_tex = m_tex;
+void TextureResource::newStreamingTask(TextureStreamingRequest& req)
+{
+	ANKI_ASSERT(m_streamingEntry);
 
-	// Upload the data
-	if(async)
+	AsyncLoader& asyncLoader = getManager().getAsyncLoader();
+	StreamingTask* task = asyncLoader.newTask<StreamingTask>(asyncLoader.getAllocator());
+	task->m_filename.create(m_streamingFilename.toCString());
+	task->m_manager = &getManager();
+	task->m_req = &req;
+
+	// Loading with that max size will skip the mips before the requested
+	task->m_maxTextureSize = max(m_size.x(), m_size.y()) >> req.m_firstMip;
+
+	asyncLoader.submitTask(task);
+}
+
+void TextureResource::swapStreamedTexture(TexturePtr tex)
+{
+	ANKI_ASSERT(tex.isCreated());
+	m_tex = tex;
+
+	TextureViewInitInfo viewInit(m_tex, "Rsrc");
+	m_texView = getManager().getGrManager().newTextureView(viewInit);
+}
+
+void TextureResource::getReloadDependencies(StringListAuto& files) const
+{
+	// With streaming the TextureStreamer holds state that depends on the mips of the file
+	if(!getManager().getTextureStreamer().isEnabled())
 	{
-		getManager().getAsyncLoader().submitTask(task);
+		files.pushBack(getFilename());
 	}
-	else
+}
+
+Error TextureResource::prepareReload()
+{
+	ANKI_ASSERT(m_reload == nullptr);
+
+	// Load it into a different resource object and take its GR objects later. Load it synchronously since it's
+	// already in the async loader
+	TextureResource* tex = getAllocator().newInstance<TextureResource>(&getManager());
+	const Error err = tex->load(getFilename(), false);
+	if(err)
 	{
-		ANKI_CHECK(load(*ctx));
+		getAllocator().deleteInstance(tex);
+		return err;
 	}
 
-	// Create sampler
-	SamplerInitInfo samplerInit("TextureRsrc");
-	samplerInit.m_minMagFilter = SamplingFilter::LINEAR;
-	samplerInit.m_mipmapFilter = SamplingFilter::LINEAR;
-	samplerInit.m_addressing = SamplingAddressing::REPEAT;
-	samplerInit.m_anisotropyLevel = getManager().getTextureAnisotropy();
-	m_sampler = getManager().getGrManager().newSampler(samplerInit);
+	m_reload = tex;
+	return Error::NONE;
+}
 
-	m_size = UVec3(init.m_width, init.m_height, init.m_depth);
-	m_layerCount = init.m_layerCount;
+void TextureResource::finishReload()
+{
+	ANKI_ASSERT(m_reload);
 
-	// Create the texture view
-	TextureViewInitInfo viewInit(m_tex, "Rsrc");
-	m_texView = getManager().getGrManager().newTextureView(viewInit);
+	m_tex = m_reload->m_tex;
+	m_texView = m_reload->m_texView;
+	m_sampler = m_reload->m_sampler;
+	m_size = m_reload->m_size;
+	m_layerCount = m_reload->m_layerCount;
 
-	return Error::NONE;
+	getAllocator().deleteInstance(m_reload);
+	m_reload = nullptr;
 }
 
 Error TextureResource::load(LoadingContext& ctx)
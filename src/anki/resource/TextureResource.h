@@ -6,18 +6,24 @@
 #pragma once
 
 #include <anki/resource/ResourceObject.h>
+#include <anki/resource/TextureResidency.h>
 #include <anki/Gr.h>
 
 namespace anki
 {
 
+// Forward
+class ImageLoader;
+class TextureStreamingRequest;
+
 /// @addtogroup resource
 /// @{
 
 /// Texture resource class.
 ///
 /// It loads or creates an image and then loads it in the GPU. It supports compressed and uncompressed TGAs and AnKi's
-/// texture format.
+/// texture format. If the texture streaming is enabled the 2D textures load only their small mips and the rest are
+/// streamed by the TextureStreamer. Streaming replaces the GR texture and view so don't cache them across frames.
 class TextureResource : public ResourceObject
 {
 public:
@@ -73,10 +79,38 @@ public:
 		return m_layerCount;
 	}
 
+	/// Ask for the detail that an object of some size on the screen needs. It does nothing if the texture is not
+	/// streamed.
+	/// @param projectedSize The fraction of the screen height the object occupies.
+	/// @note It's thread-safe.
+	void requestDetail(F32 projectedSize);
+
+anki_internal:
+	/// Schedule the streaming of a new set of mips. Called by the TextureStreamer.
+	void newStreamingTask(TextureStreamingRequest& req);
+
+	/// Replace the texture with the outcome of a streaming request. Called by the TextureStreamer between frames.
+	void swapStreamedTexture(TexturePtr tex);
+
+	TextureResidency::Entry* getStreamingEntry() const
+	{
+		return m_streamingEntry;
+	}
+
+	/// Only the textures that are not streamed can be reloaded.
+	void getReloadDependencies(StringListAuto& files) const override;
+
+	/// Load the texture again on the side.
+	ANKI_USE_RESULT Error prepareReload() override;
+
+	/// Replace the texture with the one prepareReload() loaded.
+	void finishReload() override;
+
 private:
 	static constexpr U MAX_COPIES_BEFORE_FLUSH = 4;
 
 	class TexUploadTask;
+	class StreamingTask;
 	class LoadingContext;
 
 	TexturePtr m_tex;
@@ -85,7 +119,15 @@ private:
 	UVec3 m_size = UVec3(0u);
 	U32 m_layerCount = 0;
 
+	TextureResidency::Entry* m_streamingEntry = nullptr;
+	String m_streamingFilename; ///< Keep it because the ResourceObject's filename is set after load.
+
+	TextureResource* m_reload = nullptr; ///< What prepareReload() loaded.
+
 	ANKI_USE_RESULT static Error load(LoadingContext& ctx);
+
+	/// Fill the info to create a texture from the loaded image.
+	static void fillTextureInitInfo(const ImageLoader& loader, TextureInitInfo& init, U& faces);
 };
 /// @}
 
@@ -0,0 +1,146 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/resource/TextureStreamer.h>
+#include <anki/resource/TextureResource.h>
+#include <anki/resource/ResourceManager.h>
+#include <anki/misc/ConfigSet.h>
+#include <anki/core/Trace.h>
+
+namespace anki
+{
+
+TextureStreamer::TextureStreamer(ResourceManager* manager)
+	: m_manager(manager)
+	, m_residency(manager->getAllocator())
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	// The async loader is already gone so no one references the requests
+	for(TextureStreamingRequest* req : m_requests)
+	{
+		m_manager->getAllocator().deleteInstance(req);
+	}
+
+	m_requests.destroy(m_manager->getAllocator());
+}
+
+Error TextureStreamer::init(const ConfigSet& config)
+{
+	m_enabled = config.getNumber("rsrc.textureStreaming") != 0.0;
+	if(!m_enabled)
+	{
+		return Error::NONE;
+	}
+
+	m_residentMipSize = config.getNumber("rsrc.textureStreamingResidentSize");
+	m_screenHeight = config.getNumber("height");
+
+	m_residency.init(PtrSize(config.getNumber("rsrc.textureStreamingMemoryBudget")),
+		config.getNumber("rsrc.textureStreamingEvictionFrameCount"),
+		config.getNumber("rsrc.textureStreamingMaxUploadsPerFrame"));
+
+	if(m_residentMipSize == 0 || m_screenHeight <= 0.0f)
+	{
+		ANKI_RESOURCE_LOGE("Wrong texture streaming configuration");
+		return Error::USER_DATA;
+	}
+
+	return Error::NONE;
+}
+
+TextureResidency::Entry* TextureStreamer::registerTexture(
+	TextureResource* tex, ConstWeakArray<PtrSize> mipSizes, U32 residentFirstMip)
+{
+	ANKI_ASSERT(m_enabled && tex);
+	LockGuard<Mutex> lock(m_mtx);
+	return m_residency.registerTexture(mipSizes, residentFirstMip, tex);
+}
+
+void TextureStreamer::unregisterTexture(TextureResource* tex, TextureResidency::Entry* entry)
+{
+	ANKI_ASSERT(tex && entry);
+	LockGuard<Mutex> lock(m_mtx);
+
+	// Orphan the requests in flight. They will be deleted when the async loader is done with them
+	for(TextureStreamingRequest* req : m_requests)
+	{
+		if(req->m_texture == tex)
+		{
+			req->m_texture = nullptr;
+		}
+	}
+
+	m_residency.unregisterTexture(entry);
+}
+
+void TextureStreamer::update()
+{
+	if(!m_enabled)
+	{
+		return;
+	}
+
+	ANKI_TRACE_SCOPED_EVENT(RSRC_TEXTURE_STREAMER_UPDATE);
+	LockGuard<Mutex> lock(m_mtx);
+
+	// Apply the requests that the async loader finished
+	U32 pendingCount = 0;
+	U32 swapCount = 0;
+	for(TextureStreamingRequest* req : m_requests)
+	{
+		const TextureStreamingRequest::State state = req->m_state.load();
+		if(state == TextureStreamingRequest::State::PENDING)
+		{
+			m_requests[pendingCount++] = req;
+			continue;
+		}
+
+		if(req->m_texture)
+		{
+			TextureResidency::Entry* entry = req->m_texture->getStreamingEntry();
+			if(state == TextureStreamingRequest::State::DONE)
+			{
+				req->m_texture->swapStreamedTexture(req->m_newTexture);
+				m_residency.completeChange(entry, req->m_firstMip);
+				++swapCount;
+			}
+			else
+			{
+				m_residency.cancelChange(entry);
+			}
+		}
+
+		m_manager->getAllocator().deleteInstance(req);
+	}
+
+	if(pendingCount < m_requests.getSize())
+	{
+		m_requests.resize(m_manager->getAllocator(), pendingCount);
+	}
+
+	// Decide what to stream and schedule it. Evictions also go through the async loader because the textures are
+	// immutable and they need to be recreated with less mips
+	DynamicArrayAuto<TextureResidencyChange> changes(m_manager->getAllocator());
+	m_residency.update(changes);
+
+	for(const TextureResidencyChange& change : changes)
+	{
+		TextureStreamingRequest* req = m_manager->getAllocator().newInstance<TextureStreamingRequest>();
+		req->m_texture = static_cast<TextureResource*>(change.m_userData);
+		req->m_firstMip = change.m_toFirstMip;
+		m_requests.emplaceBack(m_manager->getAllocator(), req);
+
+		req->m_texture->newStreamingTask(*req);
+	}
+
+	ANKI_TRACE_INC_COUNTER(RSRC_TEXTURE_STREAMING_MEMORY, m_residency.getResidentMemory());
+	ANKI_TRACE_INC_COUNTER(RSRC_TEXTURE_STREAMING_REQUESTS, changes.getSize());
+	ANKI_TRACE_INC_COUNTER(RSRC_TEXTURE_STREAMING_SWAPS, swapCount);
+}
+
+} // end namespace anki
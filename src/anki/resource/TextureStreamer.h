@@ -0,0 +1,96 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/resource/TextureResidency.h>
+#include <anki/util/Thread.h>
+#include <anki/Gr.h>
+
+namespace anki
+{
+
+// Forward
+class ConfigSet;
+class TextureResource;
+
+/// @addtogroup resource
+/// @{
+
+/// A streaming operation that runs in the async loader.
+class TextureStreamingRequest
+{
+public:
+	enum class State : U32
+	{
+		PENDING,
+		DONE,
+		FAILED
+	};
+
+	TextureResource* m_texture; ///< It's nullptr if the texture was destroyed while the request was in flight.
+	TexturePtr m_newTexture; ///< The texture that will replace the old.
+	U32 m_firstMip; ///< The mip of the file that will be the first mip of the new texture.
+	Atomic<State> m_state = {State::PENDING};
+};
+
+/// Streams the mips of the textures in and out. The textures load their smallest mips synchronously and the finer mips
+/// are streamed in the async loader as the visibility tests request them. The finer mips are evicted when the memory
+/// budget is exceeded or when the textures are not requested for some time. The decisions are made by the
+/// TextureResidency.
+class TextureStreamer : public NonCopyable
+{
+public:
+	TextureStreamer(ResourceManager* manager);
+
+	~TextureStreamer();
+
+	ANKI_USE_RESULT Error init(const ConfigSet& config);
+
+	Bool isEnabled() const
+	{
+		return m_enabled;
+	}
+
+	/// The mips with max dimension less or equal to that will always be resident.
+	U32 getResidentMipSize() const
+	{
+		return m_residentMipSize;
+	}
+
+	/// Call it once a frame when the async loader is paused. It swaps the textures that finished streaming and it
+	/// schedules new streaming operations.
+	void update();
+
+	const TextureResidency& getResidency() const
+	{
+		return m_residency;
+	}
+
+anki_internal:
+	TextureResidency::Entry* registerTexture(
+		TextureResource* tex, ConstWeakArray<PtrSize> mipSizes, U32 residentFirstMip);
+
+	void unregisterTexture(TextureResource* tex, TextureResidency::Entry* entry);
+
+	/// @note It's thread-safe.
+	void requestScreenSize(TextureResidency::Entry* entry, U32 textureSize, F32 projectedScreenSize)
+	{
+		m_residency.requestMip(
+			entry, TextureResidency::computeRequiredMip(textureSize, projectedScreenSize * m_screenHeight));
+	}
+
+private:
+	ResourceManager* m_manager;
+	Mutex m_mtx; ///< Textures are loaded and destroyed from many threads.
+	TextureResidency m_residency;
+	DynamicArray<TextureStreamingRequest*> m_requests; ///< In flight requests.
+	F32 m_screenHeight = 0.0f;
+	U32 m_residentMipSize = MAX_U32;
+	Bool8 m_enabled = false;
+};
+/// @}
+
+} // end namespace anki
@@ -0,0 +1,153 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/scene/LodSelector.h>
+#include <anki/misc/ConfigSet.h>
+#include <anki/core/Trace.h>
+
+namespace anki
+{
+
+/// Max value of the budget bias. Above that the bias doesn't make a difference.
+static const F32 MAX_BUDGET_BIAS = 64.0f;
+
+/// The rate the bias relaxes when the budget is met.
+static const F32 BUDGET_BIAS_RELAX_RATE = 0.95f;
+
+/// If the triangles are lower than this fraction of the budget the bias will start relaxing. It's there to avoid
+/// oscillations between LODs.
+static const F32 BUDGET_RELAX_THRESHOLD = 0.85f;
+
+LodSelector::LodSelector()
+{
+	for(U i = 0; i < MAX_LOD_COUNT; ++i)
+	{
+		m_triangleCounts[i].set(0);
+		m_lastFrameTriangleCounts[i] = 0;
+	}
+
+	for(U i = 0; i < MAX_LOD_COUNT - 1; ++i)
+	{
+		m_screenSizeThresholds[i] = 0.0f;
+	}
+}
+
+LodSelector::~LodSelector()
+{
+}
+
+void LodSelector::init(const ConfigSet& config)
+{
+	Array<F32, MAX_LOD_COUNT - 1> thresholds;
+	ANKI_ASSERT(thresholds.getSize() == 2);
+	thresholds[0] = config.getNumber("scene.lodScreenSize0");
+	thresholds[1] = config.getNumber("scene.lodScreenSize1");
+
+	init(ConstWeakArray<F32>(&thresholds[0], thresholds.getSize()),
+		config.getNumber("scene.lodHysteresis"),
+		config.getNumber("scene.lodTriangleBudget"));
+}
+
+void LodSelector::init(ConstWeakArray<F32> screenSizeThresholds, F32 hysteresis, U64 triangleBudget)
+{
+	ANKI_ASSERT(screenSizeThresholds.getSize() == m_screenSizeThresholds.getSize());
+	ANKI_ASSERT(hysteresis >= 0.0f && hysteresis < 1.0f);
+
+	for(U i = 0; i < m_screenSizeThresholds.getSize(); ++i)
+	{
+		ANKI_ASSERT(i == 0 || screenSizeThresholds[i] <= screenSizeThresholds[i - 1]);
+		m_screenSizeThresholds[i] = screenSizeThresholds[i];
+	}
+
+	m_hysteresis = hysteresis;
+	m_triangleBudget = triangleBudget;
+	m_budgetBias = 1.0f;
+}
+
+F32 LodSelector::computeProjectedSize(const Vec4& sphereCenter, F32 sphereRadius, const Vec4& eye, const Mat4& projMat)
+{
+	ANKI_ASSERT(sphereCenter.w() == 0.0f && eye.w() == 0.0f);
+	ANKI_ASSERT(sphereRadius >= 0.0f);
+
+	// The (1, 1) element of the projection matrix is cot(fovY/2) for perspective and 2/(top-bottom) for orthographic
+	const F32 scale = projMat(1, 1);
+
+	const Bool perspective = projMat(3, 3) == 0.0f;
+	if(!perspective)
+	{
+		return sphereRadius * scale;
+	}
+
+	const F32 dist = (sphereCenter - eye).getLength();
+	if(dist <= sphereRadius)
+	{
+		// The eye is inside the sphere
+		return MAX_F32;
+	}
+
+	return sphereRadius * scale / dist;
+}
+
+U8 LodSelector::selectLodInternal(F32 projectedSize, U8 lodCount, U8 prevLod) const
+{
+	ANKI_ASSERT(lodCount > 0 && lodCount <= MAX_LOD_COUNT);
+
+	U8 lod = 0;
+	while(lod + 1u < lodCount)
+	{
+		F32 threshold = m_screenSizeThresholds[lod] * m_budgetBias;
+
+		// Move the threshold away from the previous LOD to make it stick
+		if(prevLod != MAX_U8)
+		{
+			threshold *= (lod < prevLod) ? (1.0f + m_hysteresis) : (1.0f - m_hysteresis);
+		}
+
+		if(projectedSize < threshold)
+		{
+			++lod;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return lod;
+}
+
+void LodSelector::endFrame()
+{
+	U64 total = 0;
+	for(U i = 0; i < MAX_LOD_COUNT; ++i)
+	{
+		m_lastFrameTriangleCounts[i] = m_triangleCounts[i].exchange(0);
+		total += m_lastFrameTriangleCounts[i];
+	}
+
+	ANKI_ASSERT(MAX_LOD_COUNT == 3);
+	ANKI_TRACE_INC_COUNTER(SCENE_LOD0_TRIANGLES, m_lastFrameTriangleCounts[0]);
+	ANKI_TRACE_INC_COUNTER(SCENE_LOD1_TRIANGLES, m_lastFrameTriangleCounts[1]);
+	ANKI_TRACE_INC_COUNTER(SCENE_LOD2_TRIANGLES, m_lastFrameTriangleCounts[2]);
+
+	if(m_triangleBudget == 0)
+	{
+		m_budgetBias = 1.0f;
+		return;
+	}
+
+	// Scale the thresholds. Bigger thresholds push the smaller (usually distant) objects to coarser LODs first
+	const F32 ratio = F32(total) / F32(m_triangleBudget);
+	if(ratio > 1.0f)
+	{
+		m_budgetBias = min(m_budgetBias * min(ratio, 2.0f), MAX_BUDGET_BIAS);
+	}
+	else if(ratio < BUDGET_RELAX_THRESHOLD)
+	{
+		m_budgetBias = max(m_budgetBias * BUDGET_BIAS_RELAX_RATE, 1.0f);
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,100 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/scene/Common.h>
+#include <anki/resource/Common.h>
+#include <anki/Math.h>
+#include <anki/util/Atomic.h>
+#include <anki/util/WeakArray.h>
+
+namespace anki
+{
+
+// Forward
+class ConfigSet;
+
+/// @addtogroup scene
+/// @{
+
+/// Selects the level of detail of the renderables. It's driven by the projected size of the renderables on the screen
+/// and it's constrained by a global per-frame triangle budget.
+class LodSelector : public NonCopyable
+{
+public:
+	LodSelector();
+
+	~LodSelector();
+
+	void init(const ConfigSet& config);
+
+	/// Manually set the options. Used mainly in tests.
+	void init(ConstWeakArray<F32> screenSizeThresholds, F32 hysteresis, U64 triangleBudget);
+
+	/// Compute the size of a sphere on the screen. It's the fraction of the screen height the sphere occupies.
+	/// @param sphereCenter The center of the sphere in world space.
+	/// @param sphereRadius The radius of the sphere.
+	/// @param eye The origin of the frustum in world space.
+	/// @param projMat The projection matrix of the frustum.
+	static F32 computeProjectedSize(const Vec4& sphereCenter, F32 sphereRadius, const Vec4& eye, const Mat4& projMat);
+
+	/// Select a LOD without taking into account the previous selection.
+	/// @note It's thread-safe.
+	U8 selectLod(F32 projectedSize, U8 lodCount) const
+	{
+		return selectLodInternal(projectedSize, lodCount, MAX_U8);
+	}
+
+	/// Select a LOD. The previous LOD of the renderable is used to avoid popping when the projected size is close to
+	/// the LOD thresholds.
+	/// @note It's thread-safe.
+	U8 selectLod(F32 projectedSize, U8 lodCount, U8 prevLod) const
+	{
+		ANKI_ASSERT(prevLod < MAX_LOD_COUNT);
+		return selectLodInternal(projectedSize, lodCount, prevLod);
+	}
+
+	/// Inform the selector about the triangles that will be submitted for a LOD.
+	/// @note It's thread-safe.
+	void accountTriangles(U lod, U64 triangleCount)
+	{
+		ANKI_ASSERT(lod < MAX_LOD_COUNT);
+		if(triangleCount)
+		{
+			m_triangleCounts[lod].fetchAdd(triangleCount);
+		}
+	}
+
+	/// Call it after all the visibility tests of a frame. It will adjust the thresholds if the budget was exceeded.
+	void endFrame();
+
+	/// The factor that scales the screen size thresholds to satisfy the triangle budget.
+	F32 getBudgetBias() const
+	{
+		return m_budgetBias;
+	}
+
+	/// Get the triangles submitted on the last frame.
+	U64 getLastFrameTriangleCount(U lod) const
+	{
+		return m_lastFrameTriangleCounts[lod];
+	}
+
+private:
+	/// If the projected size is lower than the threshold then the next LOD is selected.
+	Array<F32, MAX_LOD_COUNT - 1> m_screenSizeThresholds;
+	F32 m_hysteresis = 0.0f;
+	U64 m_triangleBudget = 0; ///< Zero means no budget.
+	F32 m_budgetBias = 1.0f;
+
+	Array<Atomic<U64>, MAX_LOD_COUNT> m_triangleCounts;
+	Array<U64, MAX_LOD_COUNT> m_lastFrameTriangleCounts;
+
+	U8 selectLodInternal(F32 projectedSize, U8 lodCount, U8 prevLod) const;
+};
+/// @}
+
+} // end namespace anki
@@ -46,6 +46,12 @@ public:
 	MyRenderComponent(ModelNode* node)
 		: MaterialRenderComponent(node, node->m_model->getModelPatches()[node->m_modelPatchIdx]->getMaterial())
 	{
+		const ModelPatch& patch = *node->m_model->getModelPatches()[node->m_modelPatchIdx];
+		m_lodCount = min<U>(patch.getLodCount(), MAX_LOD_COUNT);
+		for(U i = 0; i < m_lodCount; ++i)
+		{
+			m_lodTriangleCounts[i] = patch.getLodTriangleCount(i);
+		}
 	}
 
 	void setupRenderableQueueElement(RenderableQueueElement& el) const override
@@ -121,7 +127,7 @@ void ModelNode::onMoveComponentUpdate(const MoveComponent& move)
 
 void ModelNode::draw(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData) const
 {
-	ANKI_ASSERT(userData.getSize() > 0 && userData.getSize() <= MAX_INSTANCES);
+	ANKI_ASSERT(userData.getSize() > 0);
 	ANKI_ASSERT(ctx.m_key.m_instanceCount == userData.getSize());
 
 	CommandBufferPtr& cmdb = ctx.m_commandBuffer;
@@ -134,9 +140,11 @@ void ModelNode::draw(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData
 		// anywhere
 		ANKI_ASSERT(patch->getSubMeshCount() == 1);
 
-		// Transforms
-		Array<Mat4, MAX_INSTANCES> trfs;
-		Array<Mat4, MAX_INSTANCES> prevTrfs;
+		// Transforms. More than MAX_INSTANCES go to a storage buffer so don't use fixed arrays
+		DynamicArrayAuto<Mat4> trfs(getFrameAllocator());
+		DynamicArrayAuto<Mat4> prevTrfs(getFrameAllocator());
+		trfs.create(userData.getSize());
+		prevTrfs.create(userData.getSize());
 		const MoveComponent& movec = getComponent<MoveComponent>();
 		trfs[0] = Mat4(movec.getWorldTransform());
 		prevTrfs[0] = Mat4(movec.getPreviousWorldTransform());
@@ -259,42 +267,7 @@ void ModelNode::draw(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData
 
 		ANKI_ASSERT(c == INDEX_COUNT);
 
-		// Set the uniforms
-		StagingGpuMemoryToken unisToken;
-		Mat4* mvps = static_cast<Mat4*>(ctx.m_stagingGpuAllocator->allocateFrame(
-			sizeof(Mat4) * userData.getSize() + sizeof(Vec4), StagingGpuMemoryType::UNIFORM, unisToken));
-
-		for(U i = 0; i < userData.getSize(); ++i)
-		{
-			const ModelNode& self2 = *static_cast<const ModelNode*>(userData[i]);
-
-			Mat3 rot = self2.m_obb.getRotation().getRotationPart();
-			const Vec4 tsl = self2.m_obb.getCenter().xyz1();
-			const Vec3 scale = self2.m_obb.getExtend().xyz();
-
-			// Set non uniform scale. Add a margin to avoid flickering
-			const F32 MARGIN = 1.02;
-			rot(0, 0) *= scale.x() * MARGIN;
-			rot(1, 1) *= scale.y() * MARGIN;
-			rot(2, 2) *= scale.z() * MARGIN;
-
-			*mvps = ctx.m_viewProjectionMatrix * Mat4(tsl, rot, 1.0f);
-			++mvps;
-		}
-
-		Vec4* color = reinterpret_cast<Vec4*>(mvps);
-		*color = Vec4(1.0f, 0.0f, 1.0f, 1.0f);
-
 		// Setup state
-		ShaderProgramResourceMutationInitList<2> mutators(m_dbgProg);
-		mutators.add("COLOR_TEXTURE", 0);
-		mutators.add("DITHERED_DEPTH_TEST", ctx.m_debugDrawFlags.get(RenderQueueDebugDrawFlag::DITHERED_DEPTH_TEST_ON));
-		ShaderProgramResourceConstantValueInitList<1> consts(m_dbgProg);
-		consts.add("INSTANCE_COUNT", U32(userData.getSize()));
-		const ShaderProgramResourceVariant* variant;
-		m_dbgProg->getOrCreateVariant(mutators.get(), consts.get(), variant);
-		cmdb->bindShaderProgram(variant->getProgram());
-
 		const Bool enableDepthTest = ctx.m_debugDrawFlags.get(RenderQueueDebugDrawFlag::DEPTH_TEST_ON);
 		if(enableDepthTest)
 		{
@@ -309,9 +282,51 @@ void ModelNode::draw(RenderQueueDrawContext& ctx, ConstWeakArray<void*> userData
 		cmdb->bindVertexBuffer(0, vertToken.m_buffer, vertToken.m_offset, sizeof(Vec3));
 		cmdb->bindIndexBuffer(indicesToken.m_buffer, indicesToken.m_offset, IndexType::U16);
 
-		cmdb->bindUniformBuffer(1, 0, unisToken.m_buffer, unisToken.m_offset, unisToken.m_range);
-
-		cmdb->drawElements(PrimitiveTopology::LINES, INDEX_COUNT, userData.getSize());
+		// The MVPs are uniforms so draw in batches of MAX_INSTANCES. This also bounds the variants of the program
+		for(U batchBegin = 0; batchBegin < userData.getSize(); batchBegin += MAX_INSTANCES)
+		{
+			const U batchCount = min<U>(userData.getSize() - batchBegin, MAX_INSTANCES);
+
+			// Set the uniforms
+			StagingGpuMemoryToken unisToken;
+			Mat4* mvps = static_cast<Mat4*>(ctx.m_stagingGpuAllocator->allocateFrame(
+				sizeof(Mat4) * batchCount + sizeof(Vec4), StagingGpuMemoryType::UNIFORM, unisToken));
+
+			for(U i = batchBegin; i < batchBegin + batchCount; ++i)
+			{
+				const ModelNode& self2 = *static_cast<const ModelNode*>(userData[i]);
+
+				Mat3 rot = self2.m_obb.getRotation().getRotationPart();
+				const Vec4 tsl = self2.m_obb.getCenter().xyz1();
+				const Vec3 scale = self2.m_obb.getExtend().xyz();
+
+				// Set non uniform scale. Add a margin to avoid flickering
+				const F32 MARGIN = 1.02;
+				rot(0, 0) *= scale.x() * MARGIN;
+				rot(1, 1) *= scale.y() * MARGIN;
+				rot(2, 2) *= scale.z() * MARGIN;
+
+				*mvps = ctx.m_viewProjectionMatrix * Mat4(tsl, rot, 1.0f);
+				++mvps;
+			}
+
+			Vec4* color = reinterpret_cast<Vec4*>(mvps);
+			*color = Vec4(1.0f, 0.0f, 1.0f, 1.0f);
+
+			ShaderProgramResourceMutationInitList<2> mutators(m_dbgProg);
+			mutators.add("COLOR_TEXTURE", 0);
+			mutators.add(
+				"DITHERED_DEPTH_TEST", ctx.m_debugDrawFlags.get(RenderQueueDebugDrawFlag::DITHERED_DEPTH_TEST_ON));
+			ShaderProgramResourceConstantValueInitList<1> consts(m_dbgProg);
+			consts.add("INSTANCE_COUNT", U32(batchCount));
+			const ShaderProgramResourceVariant* variant;
+			m_dbgProg->getOrCreateVariant(mutators.get(), consts.get(), variant);
+			cmdb->bindShaderProgram(variant->getProgram());
+
+			cmdb->bindUniformBuffer(1, 0, unisToken.m_buffer, unisToken.m_offset, unisToken.m_range);
+
+			cmdb->drawElements(PrimitiveTopology::LINES, INDEX_COUNT, batchCount);
+		}
 
 		// Restore state
 		if(!enableDepthTest)
@@ -11,6 +11,7 @@
 #include <anki/resource/ModelResource.h>
 #include <anki/resource/ResourceManager.h>
 #include <anki/util/Functions.h>
+#include <anki/util/ThreadHive.h>
 #include <anki/physics/PhysicsBody.h>
 #include <anki/physics/PhysicsWorld.h>
 #include <anki/physics/PhysicsCollisionShape.h>
@@ -34,173 +35,32 @@ static Vec3 getRandom(const Vec3& min, const Vec3& max)
 	return out;
 }
 
-/// Particle base
-class ParticleEmitterNode::ParticleBase
+/// Simulates a range of the particles of a big emitter.
+class ParticleEmitterNode::SimulateTask
 {
 public:
-	Second m_timeOfBirth; ///< Keep the time of birth for nice effects
-	Second m_timeOfDeath = -1.0; ///< Time of death. If < 0.0 then dead
+	ParticleEmitterNode* m_node;
+	U32 m_begin;
+	U32 m_end;
 
-	F32 m_initialSize;
-	F32 m_finalSize;
-	F32 m_crntSize;
-
-	F32 m_initialAlpha;
-	F32 m_finalAlpha;
-	F32 m_crntAlpha;
-
-	Vec4 m_crntPosition;
-
-	virtual ~ParticleBase()
-	{
-	}
-
-	Bool isDead() const
-	{
-		return m_timeOfDeath < 0.0;
-	}
-
-	/// Kill the particle
-	virtual void kill()
-	{
-		ANKI_ASSERT(m_timeOfDeath > 0.0);
-		m_timeOfDeath = -1.0;
-	}
-
-	/// Revive the particle
-	virtual void revive(
-		const ParticleEmitterProperties& props, const Transform& trf, Second prevUpdateTime, Second crntTime)
-	{
-		ANKI_ASSERT(isDead());
-
-		// life
-		m_timeOfDeath = crntTime + getRandom(props.m_particle.m_minLife, props.m_particle.m_maxLife);
-		m_timeOfBirth = crntTime;
-
-		// Size
-		m_initialSize = getRandom(props.m_particle.m_minInitialSize, props.m_particle.m_maxInitialSize);
-		m_finalSize = getRandom(props.m_particle.m_minFinalSize, props.m_particle.m_maxFinalSize);
-
-		// Alpha
-		m_initialAlpha = getRandom(props.m_particle.m_minInitialAlpha, props.m_particle.m_maxInitialAlpha);
-		m_finalAlpha = getRandom(props.m_particle.m_minFinalAlpha, props.m_particle.m_maxFinalAlpha);
-	}
-
-	/// Common sumulation code
-	virtual void simulate(Second prevUpdateTime, Second crntTime)
-	{
-		const F32 lifeFactor = (crntTime - m_timeOfBirth) / (m_timeOfDeath - m_timeOfBirth);
-
-		m_crntSize = mix(m_initialSize, m_finalSize, lifeFactor);
-		m_crntAlpha = mix(m_initialAlpha, m_finalAlpha, lifeFactor);
-	}
-};
-
-/// Simple particle for simple simulation
-class ParticleEmitterNode::ParticleSimple : public ParticleEmitterNode::ParticleBase
-{
-public:
-	Vec4 m_velocity = Vec4(0.0);
-	Vec4 m_acceleration = Vec4(0.0);
-
-	void revive(
-		const ParticleEmitterProperties& props, const Transform& trf, Second prevUpdateTime, Second crntTime) override
-	{
-		ParticleBase::revive(props, trf, prevUpdateTime, crntTime);
-		m_velocity = Vec4(0.0);
-
-		m_acceleration = getRandom(props.m_particle.m_minGravity, props.m_particle.m_maxGravity).xyz0();
-
-		// Set the initial position
-		m_crntPosition =
-			getRandom(props.m_particle.m_minStartingPosition, props.m_particle.m_maxStartingPosition).xyz0();
-
-		m_crntPosition += trf.getOrigin();
-	}
-
-	void simulate(Second prevUpdateTime, Second crntTime) override
-	{
-		ParticleBase::simulate(prevUpdateTime, crntTime);
-
-		Second dt = crntTime - prevUpdateTime;
-
-		Vec4 xp = m_crntPosition;
-		Vec4 xc = m_acceleration * (dt * dt) + m_velocity * dt + xp;
-
-		m_crntPosition = xc;
-
-		m_velocity += m_acceleration * dt;
-	}
-};
-
-/// Particle for bullet simulations
-class ParticleEmitterNode::PhysParticle : public ParticleEmitterNode::ParticleBase
-{
-public:
-	PhysicsBodyPtr m_body;
-
-	PhysParticle(const PhysicsBodyInitInfo& init, SceneNode* node)
+	static void callback(void* ud, U32 threadId, ThreadHive& hive, ThreadHiveSemaphore* sem)
 	{
-		m_body = node->getSceneGraph().getPhysicsWorld().newInstance<PhysicsBody>(init);
-		m_body->setUserData(node);
-		m_body->activate(false);
-		m_body->setMaterialGroup(PhysicsMaterialBit::PARTICLE);
-		m_body->setMaterialMask(PhysicsMaterialBit::STATIC_GEOMETRY);
-		m_body->setAngularFactor(Vec3(0.0f, 0.0f, 0.0f));
-	}
-
-	void kill() override
-	{
-		ParticleBase::kill();
-		m_body->activate(false);
-	}
+		SimulateTask& self = *static_cast<SimulateTask*>(ud);
+		ParticleEmitterNode& node = *self.m_node;
 
-	void revive(
-		const ParticleEmitterProperties& props, const Transform& trf, Second prevUpdateTime, Second crntTime) override
-	{
-		ParticleBase::revive(props, trf, prevUpdateTime, crntTime);
-
-		// pre calculate
-		const Bool forceFlag = props.forceEnabled();
-		const Bool worldGravFlag = props.wordGravityEnabled();
+		ParticleBounds bounds;
+		node.simulate(self.m_begin, self.m_end, bounds);
 
-		// Activate it
-		m_body->activate(true);
-		m_body->setLinearVelocity(Vec3(0.0f));
-		m_body->setAngularVelocity(Vec3(0.0f));
-		m_body->clearForces();
-
-		// force
-		if(forceFlag)
 		{
-			Vec3 forceDir = getRandom(props.m_particle.m_minForceDirection, props.m_particle.m_maxForceDirection);
-			forceDir.normalize();
-
-			// the forceDir depends on the particle emitter rotation
-			forceDir = trf.getRotation().getRotationPart() * forceDir;
-
-			const F32 forceMag = getRandom(props.m_particle.m_minForceMagnitude, props.m_particle.m_maxForceMagnitude);
-			m_body->applyForce(forceDir * forceMag, Vec3(0.0f));
+			LockGuard<SpinLock> lock(node.m_boundsMtx);
+			node.m_bounds.merge(bounds);
 		}
 
-		// gravity
-		if(!worldGravFlag)
+		// The last task does the rest of the update. Acquire-release so it sees the work of the other tasks
+		if(node.m_pendingSimulateTaskCount.fetchSub(1, AtomicMemoryOrder::ACQ_REL) == 1)
 		{
-			m_body->setGravity(getRandom(props.m_particle.m_minGravity, props.m_particle.m_maxGravity));
+			node.finalizeUpdate(node.m_bounds);
 		}
-
-		// Starting pos. In local space
-		Vec3 pos = getRandom(props.m_particle.m_minStartingPosition, props.m_particle.m_maxStartingPosition);
-		pos = trf.transform(pos);
-
-		m_body->setTransform(Transform(pos.xyz0(), trf.getRotation(), 1.0f));
-		m_crntPosition = pos.xyz0();
-	}
-
-	void simulate(Second prevUpdateTime, Second crntTime) override
-	{
-		ParticleBase::simulate(prevUpdateTime, crntTime);
-		m_crntPosition = m_body->getTransform().getOrigin();
 	}
 };
 
@@ -212,6 +72,8 @@ public:
 		: MaterialRenderComponent(
 			  node, static_cast<ParticleEmitterNode*>(node)->m_particleEmitterResource->getMaterial())
 	{
+		// The triangle count varies so don't report any
+		m_lodCount = getMaterial().getLodCount();
 	}
 
 	void setupRenderableQueueElement(RenderableQueueElement& el) const override
@@ -250,13 +112,7 @@ ParticleEmitterNode::ParticleEmitterNode(SceneGraph* scene, CString name)
 
 ParticleEmitterNode::~ParticleEmitterNode()
 {
-	// Delete simple particles
-	for(ParticleBase* part : m_particles)
-	{
-		getAllocator().deleteInstance(part);
-	}
-
-	m_particles.destroy(getAllocator());
+	m_bodies.destroy(getAllocator());
 }
 
 Error ParticleEmitterNode::init(const CString& filename)
@@ -286,6 +142,8 @@ Error ParticleEmitterNode::init(const CString& filename)
 	const ParticleEmitterProperties& other = m_particleEmitterResource->getProperties();
 	me = other;
 
+	m_particles.init(getAllocator(), m_maxNumOfParticles);
+
 	if(m_usePhysicsEngine)
 	{
 		createParticlesPhysicsSimulation(&getSceneGraph());
@@ -293,13 +151,9 @@ Error ParticleEmitterNode::init(const CString& filename)
 	}
 	else
 	{
-		createParticlesSimpleSimulation();
 		m_simulationType = SimulationType::SIMPLE;
 	}
 
-	// Create the vertex buffer and object
-	m_vertBuffSize = m_maxNumOfParticles * VERTEX_SIZE;
-
 	return Error::NONE;
 }
 
@@ -310,7 +164,7 @@ void ParticleEmitterNode::drawCallback(RenderQueueDrawContext& ctx, ConstWeakArr
 	const ParticleEmitterNode& self = *static_cast<const ParticleEmitterNode*>(userData[0]);
 
 	// Early exit
-	if(ANKI_UNLIKELY(self.m_aliveParticlesCount == 0))
+	if(ANKI_UNLIKELY(self.m_simulatedParticleCount == 0))
 	{
 		return;
 	}
@@ -319,12 +173,6 @@ void ParticleEmitterNode::drawCallback(RenderQueueDrawContext& ctx, ConstWeakArr
 
 	if(!ctx.m_debugDraw)
 	{
-		// Load verts
-		StagingGpuMemoryToken token;
-		void* gpuStorage = ctx.m_stagingGpuAllocator->allocateFrame(
-			self.m_aliveParticlesCount * VERTEX_SIZE, StagingGpuMemoryType::VERTEX, token);
-		memcpy(gpuStorage, self.m_verts, self.m_aliveParticlesCount * VERTEX_SIZE);
-
 		// Program
 		ShaderProgramPtr prog;
 		self.m_particleEmitterResource->getRenderingInfo(ctx.m_key.m_lod, prog);
@@ -335,8 +183,12 @@ void ParticleEmitterNode::drawCallback(RenderQueueDrawContext& ctx, ConstWeakArr
 		cmdb->setVertexAttribute(1, 0, Format::R32_SFLOAT, sizeof(Vec3));
 		cmdb->setVertexAttribute(2, 0, Format::R32_SFLOAT, sizeof(Vec3) + sizeof(F32));
 
-		// Vertex buff
-		cmdb->bindVertexBuffer(0, token.m_buffer, token.m_offset, VERTEX_SIZE, VertexStepRate::INSTANCE);
+		// Vertex buff. The simulation wrote the vertices there
+		cmdb->bindVertexBuffer(0,
+			self.m_vertsToken.m_buffer,
+			self.m_vertsToken.m_offset,
+			ParticleStore::VERTEX_SIZE,
+			VertexStepRate::INSTANCE);
 
 		// Uniforms
 		Array<Mat4, 1> trf = {{Mat4::getIdentity()}};
@@ -348,7 +200,7 @@ void ParticleEmitterNode::drawCallback(RenderQueueDrawContext& ctx, ConstWeakArr
 				*ctx.m_stagingGpuAllocator);
 
 		// Draw
-		cmdb->drawArrays(PrimitiveTopology::TRIANGLE_STRIP, 4, self.m_aliveParticlesCount, 0, 0);
+		cmdb->drawArrays(PrimitiveTopology::TRIANGLE_STRIP, 4, self.m_simulatedParticleCount, 0, 0);
 	}
 	else
 	{
@@ -373,142 +225,203 @@ void ParticleEmitterNode::createParticlesPhysicsSimulation(SceneGraph* scene)
 	PhysicsBodyInitInfo binit;
 	binit.m_shape = collisionShape;
 
-	m_particles.create(getAllocator(), m_maxNumOfParticles);
+	m_bodies.create(getAllocator(), m_maxNumOfParticles);
 
-	for(U i = 0; i < m_maxNumOfParticles; i++)
+	for(PhysicsBodyPtr& body : m_bodies)
 	{
 		binit.m_mass = getRandom(m_particle.m_minMass, m_particle.m_maxMass);
 
-		PhysParticle* part = getAllocator().newInstance<PhysParticle>(binit, this);
-
-		m_particles[i] = part;
+		body = getSceneGraph().getPhysicsWorld().newInstance<PhysicsBody>(binit);
+		body->setUserData(this);
+		body->activate(false);
+		body->setMaterialGroup(PhysicsMaterialBit::PARTICLE);
+		body->setMaterialMask(PhysicsMaterialBit::STATIC_GEOMETRY);
+		body->setAngularFactor(Vec3(0.0f, 0.0f, 0.0f));
 	}
 }
 
-void ParticleEmitterNode::createParticlesSimpleSimulation()
+Error ParticleEmitterNode::frameUpdate(Second prevUpdateTime, Second crntTime)
 {
-	m_particles.create(getAllocator(), m_maxNumOfParticles);
+	m_prevUpdateTime = prevUpdateTime;
+	m_crntTime = crntTime;
+	const F32 dt = crntTime - prevUpdateTime;
 
-	for(U i = 0; i < m_maxNumOfParticles; i++)
+	// Kill the particles that are about to die. Keep the bodies in the same order as the particles
+	if(m_simulationType == SimulationType::PHYSICS_ENGINE)
 	{
-		ParticleSimple* part = getAllocator().newInstance<ParticleSimple>();
-
-		m_particles[i] = part;
+		m_particles.killDeadParticles(dt, [this](U32 deadIdx, U32 lastAliveIdx) {
+			m_bodies[deadIdx]->activate(false);
+			std::swap(m_bodies[deadIdx], m_bodies[lastAliveIdx]);
+		});
+	}
+	else
+	{
+		m_particles.killDeadParticles(dt, [](U32, U32) {});
 	}
-}
-
-Error ParticleEmitterNode::frameUpdate(Second prevUpdateTime, Second crntTime)
-{
-	// - Deactivate the dead particles
-	// - Calc the AABB
-	// - Calc the instancing stuff
-	//
-	Vec4 aabbmin(MAX_F32, MAX_F32, MAX_F32, 0.0f);
-	Vec4 aabbmax(MIN_F32, MIN_F32, MIN_F32, 0.0f);
-	m_aliveParticlesCount = 0;
-
-	F32* verts = reinterpret_cast<F32*>(getFrameAllocator().allocate(m_vertBuffSize));
-	m_verts = verts;
 
-	const F32* verts_base = verts;
-	(void)verts_base;
+	m_simulatedParticleCount = m_particles.getAliveParticleCount();
+	if(m_simulatedParticleCount == 0)
+	{
+		finalizeUpdate(ParticleBounds());
+		return Error::NONE;
+	}
 
-	F32 maxParticleSize = -1.0f;
+	// The simulation writes the vertices to the staging memory of the frame. The drawCallback just binds them
+	m_verts = getSceneGraph().getStagingGpuMemoryManager().allocateFrame(
+		m_simulatedParticleCount * ParticleStore::VERTEX_SIZE, StagingGpuMemoryType::VERTEX, m_vertsToken);
 
-	for(ParticleBase* p : m_particles)
+	const U32 taskCount = (m_simulatedParticleCount + PARTICLES_PER_TASK - 1) / PARTICLES_PER_TASK;
+	if(taskCount == 1)
 	{
-		if(p->isDead())
-		{
-			// if its already dead so dont deactivate it again
-			continue;
-		}
-
-		if(p->m_timeOfDeath < crntTime)
-		{
-			// Just died
-			p->kill();
-		}
-		else
+		ParticleBounds bounds;
+		simulate(0, m_simulatedParticleCount, bounds);
+		finalizeUpdate(bounds);
+	}
+	else
+	{
+		// Big emitter, split it. The main thread waits for all the tasks of the hive so the tasks will be done before
+		// the scene update ends. The last task calls finalizeUpdate()
+		m_bounds = ParticleBounds();
+		m_pendingSimulateTaskCount.set(taskCount);
+
+		SimulateTask* tasks = getFrameAllocator().newArray<SimulateTask>(taskCount);
+		Array<ThreadHiveTask, 16> hiveTasks;
+		U32 submittedTaskCount = 0;
+		for(U32 i = 0; i < taskCount; ++i)
 		{
-			// It's alive
-
-			// Do checks
-			ANKI_ASSERT((PtrSize(verts) + VERTEX_SIZE - PtrSize(verts_base)) <= m_vertBuffSize);
-
-			// This will calculate a new world transformation
-			p->simulate(prevUpdateTime, crntTime);
-
-			const Vec4& origin = p->m_crntPosition;
+			tasks[i].m_node = this;
+			tasks[i].m_begin = i * PARTICLES_PER_TASK;
+			tasks[i].m_end = min(m_simulatedParticleCount, (i + 1) * PARTICLES_PER_TASK);
 
-			aabbmin = aabbmin.min(origin);
-			aabbmax = aabbmax.max(origin);
+			ThreadHiveTask& htask = hiveTasks[submittedTaskCount++];
+			htask.m_callback = SimulateTask::callback;
+			htask.m_argument = &tasks[i];
 
-			verts[0] = origin.x();
-			verts[1] = origin.y();
-			verts[2] = origin.z();
-
-			verts[3] = p->m_crntSize;
-			maxParticleSize = max(maxParticleSize, p->m_crntSize);
+			if(submittedTaskCount == hiveTasks.getSize() || i == taskCount - 1)
+			{
+				getSceneGraph().getThreadHive().submitTasks(&hiveTasks[0], submittedTaskCount);
+				submittedTaskCount = 0;
+			}
+		}
+	}
 
-			verts[4] = clamp(p->m_crntAlpha, 0.0f, 1.0f);
+	return Error::NONE;
+}
 
-			++m_aliveParticlesCount;
-			verts += 5;
+void ParticleEmitterNode::simulate(U32 begin, U32 end, ParticleBounds& bounds)
+{
+	if(m_simulationType == SimulationType::PHYSICS_ENGINE)
+	{
+		for(U32 i = begin; i < end; ++i)
+		{
+			m_particles.setPosition(i, m_bodies[i]->getInterpolatedTransform().getOrigin().xyz());
 		}
 	}
 
-	if(m_aliveParticlesCount != 0)
+	const Bool integratePositions = m_simulationType == SimulationType::SIMPLE;
+	m_particles.simulate(begin,
+		end,
+		m_crntTime - m_prevUpdateTime,
+		integratePositions,
+		static_cast<U8*>(m_verts) + begin * ParticleStore::VERTEX_SIZE,
+		bounds);
+}
+
+void ParticleEmitterNode::finalizeUpdate(const ParticleBounds& bounds)
+{
+	if(m_simulatedParticleCount != 0)
 	{
-		ANKI_ASSERT(maxParticleSize > 0.0f);
-		Vec4 min = aabbmin - maxParticleSize;
-		Vec4 max = aabbmax + maxParticleSize;
-		Vec4 center = (min + max) / 2.0;
+		ANKI_ASSERT(bounds.m_maxSize > 0.0f);
+		const Vec4 min = bounds.m_min.xyz0() - bounds.m_maxSize;
+		const Vec4 max = bounds.m_max.xyz0() + bounds.m_maxSize;
+		const Vec4 center = (min + max) / 2.0;
 
 		m_obb = Obb(center.xyz0(), Mat3x4::getIdentity(), (max - center).xyz0());
 	}
 	else
 	{
 		m_obb = Obb(Vec4(0.0), Mat3x4::getIdentity(), Vec4(Vec3(0.001f), 0.0f));
-		m_verts = nullptr;
 	}
 
 	getComponent<SpatialComponent>().markForUpdate();
 
-	//
 	// Emit new particles
-	//
 	if(m_timeLeftForNextEmission <= 0.0)
 	{
-		MoveComponent& move = getComponent<MoveComponent>();
+		emitParticles(m_particlesPerEmission);
+		m_timeLeftForNextEmission = m_emissionPeriod;
+	}
+	else
+	{
+		m_timeLeftForNextEmission -= m_crntTime - m_prevUpdateTime;
+	}
+}
+
+void ParticleEmitterNode::emitParticles(U32 count)
+{
+	const Transform& trf = getComponent<MoveComponent>().getWorldTransform();
 
-		U particlesCount = 0; // How many particles I am allowed to emmit
-		for(ParticleBase* pp : m_particles)
+	for(U32 i = 0; i < count; ++i)
+	{
+		ParticleInitInfo init;
+		init.m_life = getRandom(m_particle.m_minLife, m_particle.m_maxLife);
+		init.m_initialSize = getRandom(m_particle.m_minInitialSize, m_particle.m_maxInitialSize);
+		init.m_finalSize = getRandom(m_particle.m_minFinalSize, m_particle.m_maxFinalSize);
+		init.m_initialAlpha = getRandom(m_particle.m_minInitialAlpha, m_particle.m_maxInitialAlpha);
+		init.m_finalAlpha = getRandom(m_particle.m_minFinalAlpha, m_particle.m_maxFinalAlpha);
+
+		// Starting pos. In local space
+		const Vec3 pos = getRandom(m_particle.m_minStartingPosition, m_particle.m_maxStartingPosition);
+
+		if(m_simulationType == SimulationType::SIMPLE)
 		{
-			ParticleBase& p = *pp;
-			if(!p.isDead())
+			init.m_position = pos + trf.getOrigin().xyz();
+			init.m_acceleration = getRandom(m_particle.m_minGravity, m_particle.m_maxGravity);
+		}
+		else
+		{
+			init.m_position = trf.transform(pos);
+		}
+
+		const U32 idx = m_particles.emit(init);
+		if(idx == MAX_U32)
+		{
+			// No more space
+			break;
+		}
+
+		if(m_simulationType == SimulationType::PHYSICS_ENGINE)
+		{
+			PhysicsBodyPtr& body = m_bodies[idx];
+
+			// Activate it
+			body->activate(true);
+			body->setLinearVelocity(Vec3(0.0f));
+			body->setAngularVelocity(Vec3(0.0f));
+			body->clearForces();
+
+			// force
+			if(forceEnabled())
 			{
-				// its alive so skip it
-				continue;
-			}
+				Vec3 forceDir = getRandom(m_particle.m_minForceDirection, m_particle.m_maxForceDirection);
+				forceDir.normalize();
 
-			p.revive(*this, move.getWorldTransform(), prevUpdateTime, crntTime);
+				// the forceDir depends on the particle emitter rotation
+				forceDir = trf.getRotation().getRotationPart() * forceDir;
 
-			// do the rest
-			++particlesCount;
-			if(particlesCount >= m_particlesPerEmission)
+				const F32 forceMag = getRandom(m_particle.m_minForceMagnitude, m_particle.m_maxForceMagnitude);
+				body->applyForce(forceDir * forceMag, Vec3(0.0f));
+			}
+
+			// gravity
+			if(!wordGravityEnabled())
 			{
-				break;
+				body->setGravity(getRandom(m_particle.m_minGravity, m_particle.m_maxGravity));
 			}
-		} // end for all particles
 
-		m_timeLeftForNextEmission = m_emissionPeriod;
-	} // end if can emit
-	else
-	{
-		m_timeLeftForNextEmission -= crntTime - prevUpdateTime;
+			body->setTransform(Transform(init.m_position.xyz0(), trf.getRotation(), 1.0f));
+		}
 	}
-
-	return Error::NONE;
 }
 
 } // end namespace anki
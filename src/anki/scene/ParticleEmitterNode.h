@@ -6,10 +6,12 @@
 #pragma once
 
 #include <anki/scene/SceneNode.h>
+#include <anki/scene/ParticleStore.h>
 #include <anki/resource/ParticleEmitterResource.h>
 #include <anki/renderer/RenderQueue.h>
 #include <anki/collision/Obb.h>
 #include <anki/physics/Forward.h>
+#include <anki/core/StagingGpuMemoryManager.h>
 
 namespace anki
 {
@@ -19,7 +21,8 @@ class ParticleEmitterNode;
 /// @addtogroup scene
 /// @{
 
-/// The particle emitter scene node. This scene node emitts
+/// The particle emitter scene node. This scene node emitts particles. The particles live in a ParticleStore, the big
+/// emitters are simulated in many ThreadHive tasks and the vertices are written directly to GPU staging memory.
 class ParticleEmitterNode : public SceneNode, private ParticleEmitterProperties
 {
 public:
@@ -37,9 +40,7 @@ public:
 private:
 	class MyRenderComponent;
 	class MoveFeedbackComponent;
-	class ParticleBase;
-	class ParticleSimple;
-	class PhysParticle;
+	class SimulateTask;
 
 	enum class SimulationType : U8
 	{
@@ -48,32 +49,49 @@ private:
 		PHYSICS_ENGINE
 	};
 
-	/// Size of a single vertex.
-	static const U VERTEX_SIZE = 5 * sizeof(F32);
+	/// Emitters with more particles than that are simulated in many ThreadHive tasks. It's a multiple of
+	/// ParticleStore::PARTICLES_PER_PACKET so the tasks don't share packets.
+	static const U32 PARTICLES_PER_TASK = 1024;
 
 	ParticleEmitterResourcePtr m_particleEmitterResource;
-	DynamicArray<ParticleBase*> m_particles;
+	ParticleStore m_particles;
+	DynamicArray<PhysicsBodyPtr> m_bodies; ///< One per particle of the store if the physics engine is used.
 	Second m_timeLeftForNextEmission = 0.0;
 	Obb m_obb;
 
 	// Opt: We dont have to make extra calculations if the ParticleEmitterNode's rotation is the identity
 	Bool8 m_identityRotation = true;
 
-	U32 m_aliveParticlesCount = 0;
+	/// @name Simulation state of the frame
+	/// @{
+	Second m_prevUpdateTime = 0.0;
+	Second m_crntTime = 0.0;
+	Atomic<U32> m_pendingSimulateTaskCount = {0};
+	SpinLock m_boundsMtx;
+	ParticleBounds m_bounds;
+	/// @}
 
 	/// @name Graphics
 	/// @{
-	U32 m_vertBuffSize = 0;
-	void* m_verts = nullptr;
+	U32 m_simulatedParticleCount = 0; ///< The particles that have vertices this frame.
+	StagingGpuMemoryToken m_vertsToken;
+	void* m_verts = nullptr; ///< The mapped memory of m_vertsToken.
 	/// @}
 
 	SimulationType m_simulationType = SimulationType::UNDEFINED;
 
 	void createParticlesPhysicsSimulation(SceneGraph* scene);
-	void createParticlesSimpleSimulation();
 
 	void onMoveComponentUpdate(MoveComponent& move);
 
+	/// Simulate a range of particles and write their vertices.
+	void simulate(U32 begin, U32 end, ParticleBounds& bounds);
+
+	/// Update the bounds and emit. It runs after all the particles of the frame are simulated.
+	void finalizeUpdate(const ParticleBounds& bounds);
+
+	void emitParticles(U32 count);
+
 	void setupRenderableQueueElement(RenderableQueueElement& el) const
 	{
 		el.m_callback = drawCallback;
@@ -0,0 +1,175 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/scene/ParticleStore.h>
+
+namespace anki
+{
+
+ParticleStore::~ParticleStore()
+{
+	if(m_packets)
+	{
+		m_alloc.deleteArray(m_packets, m_packetCount * COUNT);
+	}
+}
+
+void ParticleStore::init(SceneAllocator<U8> alloc, U32 maxParticleCount)
+{
+	ANKI_ASSERT(m_packets == nullptr);
+	ANKI_ASSERT(maxParticleCount > 0);
+
+	m_alloc = alloc;
+	m_maxParticleCount = maxParticleCount;
+	m_packetCount = (maxParticleCount + PARTICLES_PER_PACKET - 1) / PARTICLES_PER_PACKET;
+
+	// Give sane values to the unused lanes of the last packets so the math doesn't produce NaNs
+	m_packets = m_alloc.newArray<Vec4>(m_packetCount * COUNT, Vec4(0.0f));
+	Vec4* lives = getPackets(LIFE);
+	for(U32 i = 0; i < m_packetCount; ++i)
+	{
+		lives[i] = Vec4(1.0f);
+	}
+}
+
+U32 ParticleStore::emit(const ParticleInitInfo& init)
+{
+	ANKI_ASSERT(m_packets);
+	ANKI_ASSERT(init.m_life > 0.0f);
+
+	if(m_aliveParticleCount == m_maxParticleCount)
+	{
+		return MAX_U32;
+	}
+
+	const U32 idx = m_aliveParticleCount++;
+
+	setPosition(idx, init.m_position);
+	setAttribute(VELOCITY_X, idx, init.m_velocity.x());
+	setAttribute(VELOCITY_Y, idx, init.m_velocity.y());
+	setAttribute(VELOCITY_Z, idx, init.m_velocity.z());
+	setAttribute(ACCELERATION_X, idx, init.m_acceleration.x());
+	setAttribute(ACCELERATION_Y, idx, init.m_acceleration.y());
+	setAttribute(ACCELERATION_Z, idx, init.m_acceleration.z());
+	setAttribute(AGE, idx, 0.0f);
+	setAttribute(LIFE, idx, init.m_life);
+	setAttribute(INITIAL_SIZE, idx, init.m_initialSize);
+	setAttribute(SIZE_DELTA, idx, init.m_finalSize - init.m_initialSize);
+	setAttribute(INITIAL_ALPHA, idx, init.m_initialAlpha);
+	setAttribute(ALPHA_DELTA, idx, init.m_finalAlpha - init.m_initialAlpha);
+
+	return idx;
+}
+
+void ParticleStore::moveParticle(U32 from, U32 to)
+{
+	for(U attrib = 0; attrib < COUNT; ++attrib)
+	{
+		setAttribute(Attribute(attrib), to, getAttribute(Attribute(attrib), from));
+	}
+}
+
+void ParticleStore::simulate(
+	U32 begin, U32 end, F32 dt, Bool integratePositions, void* vertices, ParticleBounds& bounds)
+{
+	ANKI_ASSERT(begin % PARTICLES_PER_PACKET == 0 && "Ranges shouldn't share packets");
+	ANKI_ASSERT(begin < end && end <= m_aliveParticleCount);
+	ANKI_ASSERT(vertices);
+
+	Vec4* posX = getPackets(POSITION_X);
+	Vec4* posY = getPackets(POSITION_Y);
+	Vec4* posZ = getPackets(POSITION_Z);
+	Vec4* velX = getPackets(VELOCITY_X);
+	Vec4* velY = getPackets(VELOCITY_Y);
+	Vec4* velZ = getPackets(VELOCITY_Z);
+	const Vec4* accX = getPackets(ACCELERATION_X);
+	const Vec4* accY = getPackets(ACCELERATION_Y);
+	const Vec4* accZ = getPackets(ACCELERATION_Z);
+	Vec4* ages = getPackets(AGE);
+	const Vec4* lives = getPackets(LIFE);
+	const Vec4* initialSizes = getPackets(INITIAL_SIZE);
+	const Vec4* sizeDeltas = getPackets(SIZE_DELTA);
+	const Vec4* initialAlphas = getPackets(INITIAL_ALPHA);
+	const Vec4* alphaDeltas = getPackets(ALPHA_DELTA);
+
+	const Vec4 dt4(dt);
+	const Vec4 dtSquared4(dt * dt);
+
+	// The bounds of the full packets are accumulated per lane
+	Vec4 minX(MAX_F32), minY(MAX_F32), minZ(MAX_F32);
+	Vec4 maxX(MIN_F32), maxY(MIN_F32), maxZ(MIN_F32);
+	Vec4 maxSize(0.0f);
+
+	F32* outVerts = static_cast<F32*>(vertices);
+	const U32 beginPacket = begin / PARTICLES_PER_PACKET;
+	const U32 endPacket = (end + PARTICLES_PER_PACKET - 1) / PARTICLES_PER_PACKET;
+	for(U32 p = beginPacket; p < endPacket; ++p)
+	{
+		const Vec4 age = ages[p] + dt4;
+		ages[p] = age;
+
+		const Vec4 lifeFactor = age / lives[p];
+		const Vec4 size = initialSizes[p] + sizeDeltas[p] * lifeFactor;
+		const Vec4 alpha = (initialAlphas[p] + alphaDeltas[p] * lifeFactor).getClamped(0.0f, 1.0f);
+
+		if(integratePositions)
+		{
+			posX[p] += accX[p] * dtSquared4 + velX[p] * dt4;
+			posY[p] += accY[p] * dtSquared4 + velY[p] * dt4;
+			posZ[p] += accZ[p] * dtSquared4 + velZ[p] * dt4;
+
+			velX[p] += accX[p] * dt4;
+			velY[p] += accY[p] * dt4;
+			velZ[p] += accZ[p] * dt4;
+		}
+
+		const Vec4 x = posX[p];
+		const Vec4 y = posY[p];
+		const Vec4 z = posZ[p];
+
+		const U32 laneCount = min(PARTICLES_PER_PACKET, end - p * PARTICLES_PER_PACKET);
+		if(laneCount == PARTICLES_PER_PACKET)
+		{
+			minX = minX.min(x);
+			minY = minY.min(y);
+			minZ = minZ.min(z);
+			maxX = maxX.max(x);
+			maxY = maxY.max(y);
+			maxZ = maxZ.max(z);
+			maxSize = maxSize.max(size);
+		}
+		else
+		{
+			// The last lanes of the last packet are not alive
+			for(U32 lane = 0; lane < laneCount; ++lane)
+			{
+				bounds.m_min = bounds.m_min.min(Vec3(x[lane], y[lane], z[lane]));
+				bounds.m_max = bounds.m_max.max(Vec3(x[lane], y[lane], z[lane]));
+				bounds.m_maxSize = max(bounds.m_maxSize, size[lane]);
+			}
+		}
+
+		// Interleave the attributes. Write sequentially because the vertices might be in write-combined memory
+		for(U32 lane = 0; lane < laneCount; ++lane)
+		{
+			outVerts[0] = x[lane];
+			outVerts[1] = y[lane];
+			outVerts[2] = z[lane];
+			outVerts[3] = size[lane];
+			outVerts[4] = alpha[lane];
+			outVerts += VERTEX_SIZE / sizeof(F32);
+		}
+	}
+
+	// Reduce the lanes
+	for(U32 lane = 0; lane < PARTICLES_PER_PACKET; ++lane)
+	{
+		bounds.m_min = bounds.m_min.min(Vec3(minX[lane], minY[lane], minZ[lane]));
+		bounds.m_max = bounds.m_max.max(Vec3(maxX[lane], maxY[lane], maxZ[lane]));
+		bounds.m_maxSize = max(bounds.m_maxSize, maxSize[lane]);
+	}
+}
+
+} // end namespace anki
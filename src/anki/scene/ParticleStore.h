@@ -0,0 +1,181 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/scene/Common.h>
+#include <anki/Math.h>
+
+namespace anki
+{
+
+/// @addtogroup scene
+/// @{
+
+/// The initial state of a particle.
+class ParticleInitInfo
+{
+public:
+	Vec3 m_position = Vec3(0.0f);
+	Vec3 m_velocity = Vec3(0.0f);
+	Vec3 m_acceleration = Vec3(0.0f);
+	F32 m_life = 1.0f;
+	F32 m_initialSize = 1.0f;
+	F32 m_finalSize = 1.0f;
+	F32 m_initialAlpha = 1.0f;
+	F32 m_finalAlpha = 1.0f;
+};
+
+/// The bounds of a range of particles.
+class ParticleBounds
+{
+public:
+	Vec3 m_min = Vec3(MAX_F32);
+	Vec3 m_max = Vec3(MIN_F32);
+	F32 m_maxSize = 0.0f;
+
+	void merge(const ParticleBounds& b)
+	{
+		m_min = m_min.min(b.m_min);
+		m_max = m_max.max(b.m_max);
+		m_maxSize = max(m_maxSize, b.m_maxSize);
+	}
+};
+
+/// The particles of an emitter stored as a structure of arrays. Every array holds one attribute and every Vec4 of an
+/// array holds that attribute for 4 consecutive particles so the simulation works on 4 particles at once using the
+/// SIMD of the math library. The alive particles are always packed at the start of the arrays.
+class ParticleStore : public NonCopyable
+{
+public:
+	/// The size of a vertex: position, size and alpha.
+	static const U32 VERTEX_SIZE = 5 * sizeof(F32);
+
+	/// The particles that simulate() works on at once.
+	static const U32 PARTICLES_PER_PACKET = 4;
+
+	ParticleStore()
+	{
+	}
+
+	~ParticleStore();
+
+	void init(SceneAllocator<U8> alloc, U32 maxParticleCount);
+
+	U32 getMaxParticleCount() const
+	{
+		return m_maxParticleCount;
+	}
+
+	U32 getAliveParticleCount() const
+	{
+		return m_aliveParticleCount;
+	}
+
+	/// Add a particle after the alive ones.
+	/// @return The index of the new particle or MAX_U32 if the store is full.
+	U32 emit(const ParticleInitInfo& init);
+
+	/// Kill the particles that won't be alive after dt seconds. The last alive particle takes the place of every dead
+	/// one so the alive particles stay packed.
+	/// @param onKill Called as onKill(U32 deadIdx, U32 lastAliveIdx) before the particle at lastAliveIdx takes the
+	///               place of the dead one. The indices can be the same. Use it to move any per-particle data that
+	///               lives outside the store.
+	template<typename TFunc>
+	void killDeadParticles(F32 dt, TFunc onKill)
+	{
+		U32 i = 0;
+		while(i < m_aliveParticleCount)
+		{
+			if(getAttribute(AGE, i) + dt >= getAttribute(LIFE, i))
+			{
+				const U32 last = m_aliveParticleCount - 1;
+				onKill(i, last);
+				if(i != last)
+				{
+					moveParticle(last, i);
+				}
+				--m_aliveParticleCount;
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
+
+	/// Age and move a range of alive particles and write their vertices. Different ranges can be simulated in
+	/// parallel.
+	/// @param begin The first particle of the range. It should be a multiple of PARTICLES_PER_PACKET.
+	/// @param end One past the last particle of the range.
+	/// @param dt The time since the last simulation.
+	/// @param integratePositions If false the positions are not integrated. Set them with setPosition().
+	/// @param[out] vertices Where to write the vertices of the range. The vertex of the first particle goes to the
+	///                      start. It can be write-combined memory.
+	/// @param[out] bounds The bounds of the range.
+	void simulate(U32 begin, U32 end, F32 dt, Bool integratePositions, void* vertices, ParticleBounds& bounds);
+
+	void setPosition(U32 idx, const Vec3& pos)
+	{
+		setAttribute(POSITION_X, idx, pos.x());
+		setAttribute(POSITION_Y, idx, pos.y());
+		setAttribute(POSITION_Z, idx, pos.z());
+	}
+
+	Vec3 getPosition(U32 idx) const
+	{
+		return Vec3(getAttribute(POSITION_X, idx), getAttribute(POSITION_Y, idx), getAttribute(POSITION_Z, idx));
+	}
+
+private:
+	enum Attribute : U8
+	{
+		POSITION_X,
+		POSITION_Y,
+		POSITION_Z,
+		VELOCITY_X,
+		VELOCITY_Y,
+		VELOCITY_Z,
+		ACCELERATION_X,
+		ACCELERATION_Y,
+		ACCELERATION_Z,
+		AGE,
+		LIFE,
+		INITIAL_SIZE,
+		SIZE_DELTA,
+		INITIAL_ALPHA,
+		ALPHA_DELTA,
+
+		COUNT
+	};
+
+	SceneAllocator<U8> m_alloc;
+	Vec4* m_packets = nullptr; ///< All the attributes, one after the other.
+	U32 m_packetCount = 0; ///< The packets of one attribute.
+	U32 m_maxParticleCount = 0;
+	U32 m_aliveParticleCount = 0;
+
+	Vec4* getPackets(Attribute attrib)
+	{
+		return m_packets + attrib * m_packetCount;
+	}
+
+	F32 getAttribute(Attribute attrib, U32 idx) const
+	{
+		ANKI_ASSERT(idx < m_maxParticleCount);
+		return m_packets[attrib * m_packetCount + idx / PARTICLES_PER_PACKET][idx % PARTICLES_PER_PACKET];
+	}
+
+	void setAttribute(Attribute attrib, U32 idx, F32 value)
+	{
+		ANKI_ASSERT(idx < m_maxParticleCount);
+		m_packets[attrib * m_packetCount + idx / PARTICLES_PER_PACKET][idx % PARTICLES_PER_PACKET] = value;
+	}
+
+	void moveParticle(U32 from, U32 to);
+};
+/// @}
+
+} // end namespace anki
@@ -38,6 +38,11 @@ SceneGraph::SceneGraph()
 
 SceneGraph::~SceneGraph()
 {
+	if(m_asyncPhysics)
+	{
+		m_physics->waitUpdate();
+	}
+
 	Error err = iterateSceneNodes([&](SceneNode& s) -> Error {
 		s.setMarkedForDeletion();
 		return Error::NONE;
@@ -50,6 +55,8 @@ SceneGraph::~SceneGraph()
 	{
 		m_alloc.deleteInstance(m_octree);
 	}
+
+	m_threadFrameAllocs.destroy(m_alloc);
 }
 
 Error SceneGraph::init(AllocAlignedCallback allocCb,
@@ -58,11 +65,13 @@ Error SceneGraph::init(AllocAlignedCallback allocCb,
 	ResourceManager* resources,
 	Input* input,
 	ScriptManager* scriptManager,
+	StagingGpuMemoryManager* stagingMem,
 	const Timestamp* globalTimestamp,
 	const ConfigSet& config)
 {
 	m_globalTimestamp = globalTimestamp;
 	m_threadHive = threadHive;
+	m_stagingMem = stagingMem;
 	m_resources = resources;
 	m_objectsMarkedForDeletionCount.store(0);
 	m_gr = &m_resources->getGrManager();
@@ -73,7 +82,20 @@ Error SceneGraph::init(AllocAlignedCallback allocCb,
 	m_alloc = SceneAllocator<U8>(allocCb, allocCbData);
 	m_frameAlloc = SceneFrameAllocator<U8>(allocCb, allocCbData, 1 * 1024 * 1024);
 
+	if(config.getNumber("scene.threadFrameAllocators"))
+	{
+		// Not thread safe since only a single thread will use them
+		m_threadFrameAllocs.create(m_alloc, m_threadHive->getThreadCount());
+		for(ThreadFrameAllocator& talloc : m_threadFrameAllocs)
+		{
+			talloc.m_alloc = SceneFrameAllocator<U8>(
+				allocCb, allocCbData, 256 * 1024, 2.0f, 0, true, ANKI_SAFE_ALIGNMENT, false);
+		}
+	}
+
+	m_asyncPhysics = config.getNumber("physics.async");
 	m_earlyZDist = config.getNumber("scene.earlyZDistance");
+	m_lodSelector.init(config);
 
 	ANKI_CHECK(m_events.init(this));
 
@@ -189,9 +211,29 @@ Error SceneGraph::update(Second prevUpdateTime, Second crntTime)
 	m_timestamp = *m_globalTimestamp;
 	ANKI_ASSERT(m_timestamp > 0);
 
-	// Reset the framepool
+	// Reset the framepools
 	m_frameAlloc.getMemoryPool().reset();
 
+	PtrSize maxHighWaterMark = 0;
+	for(ThreadFrameAllocator& talloc : m_threadFrameAllocs)
+	{
+		StackMemoryPool& pool = talloc.m_alloc.getMemoryPool();
+		talloc.m_highWaterMark = max(talloc.m_highWaterMark, pool.getMemoryUsed());
+		maxHighWaterMark = max(maxHighWaterMark, talloc.m_highWaterMark);
+		pool.reset();
+	}
+	ANKI_TRACE_INC_COUNTER(SCENE_THREAD_FRAME_ALLOC_HIGH_WATER_MARK, maxHighWaterMark);
+
+	// Sync with the physics step that started at the end of the previous update. Do that before anything touches the
+	// physics objects
+	if(m_asyncPhysics)
+	{
+		ANKI_TRACE_SCOPED_EVENT(SCENE_PHYSICS_UPDATE);
+		m_stats.m_physicsUpdate = HighRezTimer::getCurrentTime();
+		m_physics->waitUpdate();
+		m_stats.m_physicsUpdate = HighRezTimer::getCurrentTime() - m_stats.m_physicsUpdate;
+	}
+
 	// Delete stuff
 	{
 		ANKI_TRACE_SCOPED_EVENT(SCENE_MARKED_FOR_DELETION);
@@ -200,6 +242,7 @@ Error SceneGraph::update(Second prevUpdateTime, Second crntTime)
 	}
 
 	// Update
+	if(!m_asyncPhysics)
 	{
 		ANKI_TRACE_SCOPED_EVENT(SCENE_PHYSICS_UPDATE);
 		m_stats.m_physicsUpdate = HighRezTimer::getCurrentTime();
@@ -237,6 +280,13 @@ Error SceneGraph::update(Second prevUpdateTime, Second crntTime)
 		m_threadHive->waitAllTasks();
 	}
 
+	// The nodes are done with the physics objects. Step the physics while the visibility tests and the rendering of
+	// this frame run. The results will be visible in the next update
+	if(m_asyncPhysics)
+	{
+		m_physics->updateAsync(crntTime - prevUpdateTime);
+	}
+
 	m_stats.m_updateTime = HighRezTimer::getCurrentTime() - m_stats.m_updateTime;
 	return Error::NONE;
 }
@@ -13,6 +13,7 @@
 #include <anki/util/HashMap.h>
 #include <anki/core/App.h>
 #include <anki/scene/events/EventManager.h>
+#include <anki/scene/LodSelector.h>
 
 namespace anki
 {
@@ -26,6 +27,7 @@ class ConfigSet;
 class PerspectiveCameraNode;
 class UpdateSceneNodesCtx;
 class Octree;
+class StagingGpuMemoryManager;
 
 /// @addtogroup scene
 /// @{
@@ -56,6 +58,7 @@ public:
 		ResourceManager* resources,
 		Input* input,
 		ScriptManager* scriptManager,
+		StagingGpuMemoryManager* stagingMem,
 		const Timestamp* globalTimestamp,
 		const ConfigSet& config);
 
@@ -76,6 +79,20 @@ public:
 		return m_frameAlloc;
 	}
 
+	/// Get the frame allocator of a ThreadHive thread. It's faster than getFrameAllocator because no other thread
+	/// allocates from it. If the per-thread frame allocators are disabled it returns the shared one.
+	/// @note Return a copy
+	SceneFrameAllocator<U8> getThreadFrameAllocator(U32 threadId) const
+	{
+		return (m_threadFrameAllocs.getSize()) ? m_threadFrameAllocs[threadId].m_alloc : m_frameAlloc;
+	}
+
+	/// Get the max memory that a ThreadHive thread allocated from its frame allocator in a single frame.
+	PtrSize getThreadFrameAllocatorHighWaterMark(U32 threadId) const
+	{
+		return (m_threadFrameAllocs.getSize()) ? m_threadFrameAllocs[threadId].m_highWaterMark : 0;
+	}
+
 	SceneNode& getActiveCameraNode()
 	{
 		ANKI_ASSERT(m_mainCam != nullptr);
@@ -114,6 +131,12 @@ public:
 		return *m_threadHive;
 	}
 
+	StagingGpuMemoryManager& getStagingGpuMemoryManager()
+	{
+		ANKI_ASSERT(m_stagingMem);
+		return *m_stagingMem;
+	}
+
 	ANKI_USE_RESULT Error update(Second prevUpdateTime, Second crntTime);
 
 	void doVisibilityTests(RenderQueue& rqueue);
@@ -229,19 +252,29 @@ anki_internal:
 private:
 	class UpdateSceneNodesCtx;
 
+	class ThreadFrameAllocator
+	{
+	public:
+		SceneFrameAllocator<U8> m_alloc;
+		PtrSize m_highWaterMark = 0;
+	};
+
 	const Timestamp* m_globalTimestamp = nullptr;
 	Timestamp m_timestamp = 0; ///< Cached timestamp
 
 	// Sub-systems
 	ThreadHive* m_threadHive = nullptr;
+	StagingGpuMemoryManager* m_stagingMem = nullptr;
 	ResourceManager* m_resources = nullptr;
 	GrManager* m_gr = nullptr;
 	PhysicsWorld* m_physics = nullptr;
+	Bool8 m_asyncPhysics = false; ///< Step the physics while the previous frame is rendered.
 	Input* m_input = nullptr;
 	ScriptManager* m_scriptManager = nullptr;
 
 	SceneAllocator<U8> m_alloc;
 	SceneFrameAllocator<U8> m_frameAlloc;
+	DynamicArray<ThreadFrameAllocator> m_threadFrameAllocs; ///< One for each ThreadHive thread.
 
 	IntrusiveList<SceneNode> m_nodes;
 	U32 m_nodesCount = 0;
@@ -266,6 +299,8 @@ private:
 
 	F32 m_earlyZDist = -1.0;
 
+	LodSelector m_lodSelector;
+
 	SceneGraphStats m_stats;
 
 	/// Put a node in the appropriate containers
@@ -17,6 +17,7 @@
 #include <anki/renderer/MainRenderer.h>
 #include <anki/util/Logger.h>
 #include <anki/util/ThreadHive.h>
+#include <anki/util/Hash.h>
 
 namespace anki
 {
@@ -91,7 +92,7 @@ void VisibilityContext::submitNewWork(const FrustumComponent& frc, RenderQueue&
 	}
 
 	// Gather visibles from the octree. No need to signal anything because it will spawn new tasks
-	ThreadHiveTask gatherTask = ANKI_THREAD_HIVE_TASK({ self->gather(hive); },
+	ThreadHiveTask gatherTask = ANKI_THREAD_HIVE_TASK({ self->gather(hive, threadId); },
 		alloc.newInstance<GatherVisiblesFromOctreeTask>(frcCtx),
 		prepareRasterizerSem,
 		nullptr);
@@ -100,7 +101,7 @@ void VisibilityContext::submitNewWork(const FrustumComponent& frc, RenderQueue&
 	// Combind results task
 	ANKI_ASSERT(frcCtx->m_visTestsSignalSem);
 	ThreadHiveTask combineTask = ANKI_THREAD_HIVE_TASK(
-		{ self->combine(); }, alloc.newInstance<CombineResultsTask>(frcCtx), frcCtx->m_visTestsSignalSem, nullptr);
+		{ self->combine(hive); }, alloc.newInstance<CombineResultsTask>(frcCtx), frcCtx->m_visTestsSignalSem, nullptr);
 	hive.submitTasks(&combineTask, 1);
 }
 
@@ -126,7 +127,7 @@ void FillRasterizerWithCoverageTask::fill()
 	m_frcCtx->m_r->fillDepthBuffer(depthBuff);
 }
 
-void GatherVisiblesFromOctreeTask::gather(ThreadHive& hive)
+void GatherVisiblesFromOctreeTask::gather(ThreadHive& hive, U32 threadId)
 {
 	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_OCTREE);
 
@@ -153,25 +154,25 @@ void GatherVisiblesFromOctreeTask::gather(ThreadHive& hive)
 
 			if(m_spatialCount == m_spatials.getSize())
 			{
-				flush(hive);
+				flush(hive, threadId);
 			}
 		});
 
 	// Flush the remaining
-	flush(hive);
+	flush(hive, threadId);
 
 	// Fire an additional dummy task to decrease the semaphore to zero
 	ThreadHiveTask task = ANKI_THREAD_HIVE_TASK({}, this, nullptr, m_frcCtx->m_visTestsSignalSem);
 	hive.submitTasks(&task, 1);
 }
 
-void GatherVisiblesFromOctreeTask::flush(ThreadHive& hive)
+void GatherVisiblesFromOctreeTask::flush(ThreadHive& hive, U32 threadId)
 {
 	if(m_spatialCount)
 	{
 		// Create the task
 		VisibilityTestTask* vis =
-			m_frcCtx->m_visCtx->m_scene->getFrameAllocator().newInstance<VisibilityTestTask>(m_frcCtx);
+			m_frcCtx->m_visCtx->m_scene->getThreadFrameAllocator(threadId).newInstance<VisibilityTestTask>(m_frcCtx);
 		memcpy(&vis->m_spatialsToTest[0], &m_spatials[0], sizeof(m_spatials[0]) * m_spatialCount);
 		vis->m_spatialToTestCount = m_spatialCount;
 
@@ -196,10 +197,15 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 	ANKI_ASSERT(testedFrc.anyVisibilityTestEnabled());
 
 	const SceneNode& testedNode = testedFrc.getSceneNode();
-	auto alloc = m_frcCtx->m_visCtx->m_scene->getFrameAllocator();
+	auto alloc = m_frcCtx->m_visCtx->m_scene->getThreadFrameAllocator(taskId);
 
 	Timestamp& timestamp = m_frcCtx->m_queueViews[taskId].m_timestamp;
 	timestamp = testedNode.getComponentMaxTimestamp();
+	Timestamp& staticShadowCastersTimestamp = m_frcCtx->m_queueViews[taskId].m_staticShadowCastersTimestamp;
+	staticShadowCastersTimestamp = timestamp;
+	U64& staticShadowCastersHash = m_frcCtx->m_queueViews[taskId].m_staticShadowCastersHash;
+	staticShadowCastersHash = 0;
+	const Timestamp crntTimestamp = m_frcCtx->m_visCtx->m_scene->getGlobalTimestamp();
 
 	const Bool wantsRenderComponents =
 		testedFrc.visibilityTestsEnabled(FrustumComponentVisibilityTestFlag::RENDER_COMPONENTS);
@@ -224,6 +230,10 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 	const Bool wantsEarlyZ = testedFrc.visibilityTestsEnabled(FrustumComponentVisibilityTestFlag::EARLY_Z)
 							 && m_frcCtx->m_visCtx->m_earlyZDist > 0.0f;
 
+	LodSelector& lodSelector = *m_frcCtx->m_visCtx->m_lodSelector;
+	const Bool drivesLods = &testedFrc == m_frcCtx->m_visCtx->m_lodFrc;
+	Array<U64, MAX_LOD_COUNT> lodTriangleCounts = {};
+
 	// Iterate
 	RenderQueueView& result = m_frcCtx->m_queueViews[taskId];
 	for(U i = 0; i < m_spatialToTestCount; ++i)
@@ -241,7 +251,7 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 		// Check what components the frustum needs
 		Bool wantNode = false;
 
-		const RenderComponent* rc = nullptr;
+		RenderComponent* rc = nullptr;
 		if(wantsRenderComponents && (rc = node.tryGetComponent<RenderComponent>()))
 		{
 			wantNode = true;
@@ -336,14 +346,33 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 
 		if(rc)
 		{
+			// The shadow casters that haven't changed for a while are static and their shadows can be cached
+			const Timestamp nodeTimestamp = node.getComponentMaxTimestamp();
+			const Bool dynamicShadowCaster =
+				wantsShadowCasters && nodeTimestamp + STATIC_SHADOW_CASTER_FRAME_COUNT > crntTimestamp;
+
 			RenderableQueueElement* el;
 			if(rc->isForwardShading())
 			{
 				el = result.m_forwardShadingRenderables.newElement(alloc);
 			}
+			else if(dynamicShadowCaster)
+			{
+				el = result.m_dynamicShadowRenderables.newElement(alloc);
+			}
 			else
 			{
 				el = result.m_renderables.newElement(alloc);
+
+				if(wantsShadowCasters)
+				{
+					staticShadowCastersTimestamp = max(staticShadowCastersTimestamp, nodeTimestamp);
+
+					// The max timestamp and the count can stay the same when a caster leaves the static set and
+					// another joins it. Sum the hashes of the casters so that the order of the tests doesn't matter
+					const Array<U64, 2> casterInfo = {{node.getUuid(), nodeTimestamp}};
+					staticShadowCastersHash += computeHash(&casterInfo[0], sizeof(casterInfo));
+				}
 			}
 
 			rc->setupRenderableQueueElement(*el);
@@ -352,10 +381,33 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 			const Plane& nearPlane = testedFrc.getFrustum().getPlanesWorldSpace()[FrustumPlaneType::NEAR];
 			el->m_distanceFromCamera = max(0.0f, sps[0].m_sp->getAabb().testPlane(nearPlane));
 
+			// Select the LOD using the projected size of the bounding sphere
+			const Aabb& aabb = sps[0].m_sp->getAabb();
+			const F32 projectedSize = LodSelector::computeProjectedSize((aabb.getMin() + aabb.getMax()) * 0.5f,
+				(aabb.getMax() - aabb.getMin()).getLength() * 0.5f,
+				testedFrc.getFrustumOrigin(),
+				testedFrc.getProjectionMatrix());
+
+			if(drivesLods)
+			{
+				el->m_lod = lodSelector.selectLod(projectedSize, rc->getLodCount(), rc->getLastLod());
+				rc->setLastLod(el->m_lod);
+				lodTriangleCounts[el->m_lod] += rc->getLodTriangleCount(el->m_lod);
+				rc->requestTextureStreaming(projectedSize);
+			}
+			else
+			{
+				el->m_lod = lodSelector.selectLod(projectedSize, rc->getLodCount());
+			}
+
+			// Forward shading is sorted back to front for blending, the rest by state for instancing
+			el->m_sortKey = (rc->isForwardShading()) ? computeBackToFrontSortKey(*el) : computeStateSortKey(*el);
+
 			if(wantsEarlyZ && el->m_distanceFromCamera < m_frcCtx->m_visCtx->m_earlyZDist && !rc->isForwardShading())
 			{
 				RenderableQueueElement* el2 = result.m_earlyZRenderables.newElement(alloc);
 				*el2 = *el;
+				el2->m_sortKey = computeFrontToBackSortKey(*el2);
 			}
 		}
 
@@ -471,9 +523,14 @@ void VisibilityTestTask::test(ThreadHive& hive, U32 taskId)
 		// Update timestamp
 		timestamp = max(timestamp, node.getComponentMaxTimestamp());
 	} // end for
+
+	for(U lod = 0; lod < MAX_LOD_COUNT; ++lod)
+	{
+		lodSelector.accountTriangles(lod, lodTriangleCounts[lod]);
+	}
 }
 
-void CombineResultsTask::combine()
+void CombineResultsTask::combine(ThreadHive& hive)
 {
 	ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_COMBINE_RESULTS);
 
@@ -483,12 +540,18 @@ void CombineResultsTask::combine()
 	// Compute the timestamp
 	const U threadCount = m_frcCtx->m_queueViews.getSize();
 	results.m_shadowRenderablesLastUpdateTimestamp = 0;
+	results.m_staticShadowRenderablesLastUpdateTimestamp = 0;
+	results.m_staticShadowRenderablesHash = 0;
 	for(U i = 0; i < threadCount; ++i)
 	{
+		results.m_staticShadowRenderablesHash += m_frcCtx->m_queueViews[i].m_staticShadowCastersHash;
 		results.m_shadowRenderablesLastUpdateTimestamp =
 			max(results.m_shadowRenderablesLastUpdateTimestamp, m_frcCtx->m_queueViews[i].m_timestamp);
+		results.m_staticShadowRenderablesLastUpdateTimestamp = max(results.m_staticShadowRenderablesLastUpdateTimestamp,
+			m_frcCtx->m_queueViews[i].m_staticShadowCastersTimestamp);
 	}
 	ANKI_ASSERT(results.m_shadowRenderablesLastUpdateTimestamp);
+	ANKI_ASSERT(results.m_staticShadowRenderablesLastUpdateTimestamp);
 
 #define ANKI_VIS_COMBINE(t_, member_) \
 	{ \
@@ -522,6 +585,7 @@ void CombineResultsTask::combine()
 	}
 
 	ANKI_VIS_COMBINE(RenderableQueueElement, m_renderables);
+	ANKI_VIS_COMBINE(RenderableQueueElement, m_dynamicShadowRenderables);
 	ANKI_VIS_COMBINE(RenderableQueueElement, m_earlyZRenderables);
 	ANKI_VIS_COMBINE(RenderableQueueElement, m_forwardShadingRenderables);
 	ANKI_VIS_COMBINE_AND_PTR(PointLightQueueElement, m_pointLights, m_shadowPointLights);
@@ -547,15 +611,10 @@ void CombineResultsTask::combine()
 #endif
 
 	// Sort some of the arrays
-	std::sort(results.m_renderables.getBegin(), results.m_renderables.getEnd(), MaterialDistanceSortFunctor(20.0f));
-
-	std::sort(results.m_earlyZRenderables.getBegin(),
-		results.m_earlyZRenderables.getEnd(),
-		DistanceSortFunctor<RenderableQueueElement>());
-
-	std::sort(results.m_forwardShadingRenderables.getBegin(),
-		results.m_forwardShadingRenderables.getEnd(),
-		RevDistanceSortFunctor<RenderableQueueElement>());
+	sortRenderables(hive, alloc, results.m_renderables);
+	sortRenderables(hive, alloc, results.m_dynamicShadowRenderables);
+	sortRenderables(hive, alloc, results.m_earlyZRenderables);
+	sortRenderables(hive, alloc, results.m_forwardShadingRenderables);
 
 	// Cleanup
 	if(m_frcCtx->m_r)
@@ -564,6 +623,56 @@ void CombineResultsTask::combine()
 	}
 }
 
+void CombineResultsTask::sortRenderables(
+	ThreadHive& hive, SceneFrameAllocator<U8>& alloc, WeakArray<RenderableQueueElement>& renderables)
+{
+	const U32 count = renderables.getSize();
+	if(count < 2)
+	{
+		return;
+	}
+
+	class SortContext
+	{
+	public:
+		WeakArray<RadixSortKey> m_keys;
+		WeakArray<RenderableQueueElement>* m_renderables;
+		SceneFrameAllocator<U8> m_alloc;
+	};
+
+	SortContext* ctx = alloc.newInstance<SortContext>();
+	ctx->m_renderables = &renderables;
+	ctx->m_alloc = alloc;
+
+	RadixSortKey* keys = alloc.newArray<RadixSortKey>(count * 2);
+	ctx->m_keys = WeakArray<RadixSortKey>(keys, count);
+	for(U32 i = 0; i < count; ++i)
+	{
+		keys[i].m_key = renderables[i].m_sortKey;
+		keys[i].m_index = i;
+	}
+
+	// The keys are sorted in parallel and then the renderables are reordered
+	radixSortParallel(hive,
+		alloc,
+		ctx->m_keys,
+		WeakArray<RadixSortKey>(keys + count, count),
+		[](void* ud) {
+			ANKI_TRACE_SCOPED_EVENT(SCENE_VIS_SORT_RENDERABLES);
+			SortContext& ctx = *static_cast<SortContext*>(ud);
+			const WeakArray<RenderableQueueElement>& unsorted = *ctx.m_renderables;
+
+			RenderableQueueElement* sorted = ctx.m_alloc.newArray<RenderableQueueElement>(unsorted.getSize());
+			for(U32 i = 0; i < unsorted.getSize(); ++i)
+			{
+				sorted[i] = unsorted[ctx.m_keys[i].m_index];
+			}
+
+			*ctx.m_renderables = WeakArray<RenderableQueueElement>(sorted, unsorted.getSize());
+		},
+		ctx);
+}
+
 template<typename T>
 void CombineResultsTask::combineQueueElements(SceneFrameAllocator<U8>& alloc,
 	WeakArray<TRenderQueueElementStorage<T>> subStorages,
@@ -669,10 +778,14 @@ void SceneGraph::doVisibilityTests(SceneNode& fsn, SceneGraph& scene, RenderQueu
 	VisibilityContext ctx;
 	ctx.m_scene = &scene;
 	ctx.m_earlyZDist = scene.getEarlyZDistance();
+	ctx.m_lodSelector = &scene.m_lodSelector;
+	ctx.m_lodFrc = &fsn.getComponent<FrustumComponent>();
 	ctx.submitNewWork(fsn.getComponent<FrustumComponent>(), rqueue, hive);
 
 	hive.waitAllTasks();
 	ctx.m_testedFrcs.destroy(scene.getFrameAllocator());
+
+	scene.m_lodSelector.endFrame();
 }
 
 } // end namespace anki
@@ -9,7 +9,9 @@
 #include <anki/scene/SoftwareRasterizer.h>
 #include <anki/scene/components/FrustumComponent.h>
 #include <anki/scene/Octree.h>
+#include <anki/scene/LodSelector.h>
 #include <anki/util/Thread.h>
+#include <anki/util/RadixSort.h>
 #include <anki/core/Trace.h>
 #include <anki/renderer/RenderQueue.h>
 
@@ -23,54 +25,47 @@ static const U32 MAX_SPATIALS_PER_VIS_TEST = 48; ///< Num of spatials to test in
 static const U32 SW_RASTERIZER_WIDTH = 80;
 static const U32 SW_RASTERIZER_HEIGHT = 50;
 
-/// Sort objects on distance
-template<typename T>
-class DistanceSortFunctor
-{
-public:
-	Bool operator()(const T& a, const T& b)
-	{
-		return a.m_distanceFromCamera < b.m_distanceFromCamera;
-	}
-};
+/// A shadow caster that hasn't changed for that many frames is static. The renderer caches the shadows of the static
+/// shadow casters.
+static const Timestamp STATIC_SHADOW_CASTER_FRAME_COUNT = 30;
 
-template<typename T>
-class RevDistanceSortFunctor
-{
-public:
-	Bool operator()(const T& a, const T& b)
-	{
-		return a.m_distanceFromCamera > b.m_distanceFromCamera;
-	}
-};
+/// The distance granularity of computeStateSortKey.
+static const F32 RENDERABLE_SORT_DISTANCE_GRANULARITY = 20.0f;
 
-/// Material and distance sort.
-class MaterialDistanceSortFunctor
+inline U64 floatToSortKey(F32 f)
 {
-public:
-	MaterialDistanceSortFunctor(F32 distanceGranularity)
-		: m_distGranularity(1.0f / distanceGranularity)
-	{
-	}
+	// The bits of positive floats sort like the floats
+	ANKI_ASSERT(f >= 0.0f);
+	U32 u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+/// Sort key for front to back ordering.
+inline U64 computeFrontToBackSortKey(const RenderableQueueElement& el)
+{
+	return floatToSortKey(el.m_distanceFromCamera);
+}
 
-	Bool operator()(const RenderableQueueElement& a, const RenderableQueueElement& b)
-	{
-		const U aClass = a.m_distanceFromCamera * m_distGranularity;
-		const U bClass = b.m_distanceFromCamera * m_distGranularity;
+/// Sort key for back to front ordering.
+inline U64 computeBackToFrontSortKey(const RenderableQueueElement& el)
+{
+	return ~floatToSortKey(el.m_distanceFromCamera) & MAX_U32;
+}
 
-		if(aClass == bClass && a.m_callback == b.m_callback)
-		{
-			return a.m_mergeKey < b.m_mergeKey;
-		}
-		else
-		{
-			return a.m_distanceFromCamera < b.m_distanceFromCamera;
-		}
-	}
+/// Sort key that groups the renderables of the same distance class by state so they can be merged into instanced
+/// drawcalls. From the MSB to the LSB: 4 bits of distance class, 42 bits of the merge key, 2 bits of LOD and 16 bits of
+/// distance inside the class.
+inline U64 computeStateSortKey(const RenderableQueueElement& el)
+{
+	const F32 dist = el.m_distanceFromCamera / RENDERABLE_SORT_DISTANCE_GRANULARITY;
+	const U64 distClass = min<U64>(U64(dist), 0xF);
+	const U64 fineDist = U64(min(dist - F32(distClass), 1.0f) * F32(MAX_U16));
+	const U64 mergeKey = el.m_mergeKey >> 22;
+	const U64 lod = min<U64>(el.m_lod, 0x3);
 
-private:
-	F32 m_distGranularity;
-};
+	return (distClass << 60) | (mergeKey << 18) | (lod << 16) | fineDist;
+}
 
 /// Storage for a single element type.
 template<typename T, U INITIAL_STORAGE_SIZE = 32, U STORAGE_GROW_RATE = 4>
@@ -103,7 +98,8 @@ public:
 class RenderQueueView
 {
 public:
-	TRenderQueueElementStorage<RenderableQueueElement> m_renderables; ///< Deferred shading or shadow renderables.
+	TRenderQueueElementStorage<RenderableQueueElement> m_renderables; ///< Deferred shading or static shadow casters.
+	TRenderQueueElementStorage<RenderableQueueElement> m_dynamicShadowRenderables;
 	TRenderQueueElementStorage<RenderableQueueElement> m_forwardShadingRenderables;
 	TRenderQueueElementStorage<RenderableQueueElement> m_earlyZRenderables;
 	TRenderQueueElementStorage<PointLightQueueElement> m_pointLights;
@@ -116,6 +112,8 @@ public:
 	TRenderQueueElementStorage<FogDensityQueueElement> m_fogDensityVolumes;
 
 	Timestamp m_timestamp = 0;
+	Timestamp m_staticShadowCastersTimestamp = 0;
+	U64 m_staticShadowCastersHash = 0; ///< The sum of the hashes of the static shadow casters.
 };
 
 static_assert(std::is_trivially_destructible<RenderQueueView>::value == true, "Should be trivially destructible");
@@ -129,6 +127,9 @@ public:
 
 	F32 m_earlyZDist = -1.0f; ///< Cache this.
 
+	LodSelector* m_lodSelector = nullptr;
+	const FrustumComponent* m_lodFrc = nullptr; ///< The frustum that drives the LOD hysteresis and the triangle budget.
+
 	List<const FrustumComponent*> m_testedFrcs;
 	Mutex m_mtx;
 
@@ -185,14 +186,14 @@ public:
 		ANKI_ASSERT(m_frcCtx);
 	}
 
-	void gather(ThreadHive& hive);
+	void gather(ThreadHive& hive, U32 threadId);
 
 private:
 	Array<SpatialComponent*, MAX_SPATIALS_PER_VIS_TEST> m_spatials;
 	U32 m_spatialCount = 0;
 
 	/// Submit tasks to test the m_spatials.
-	void flush(ThreadHive& hive);
+	void flush(ThreadHive& hive, U32 threadId);
 };
 static_assert(
 	std::is_trivially_destructible<GatherVisiblesFromOctreeTask>::value == true, "Should be trivially destructible");
@@ -234,9 +235,13 @@ public:
 		ANKI_ASSERT(m_frcCtx);
 	}
 
-	void combine();
+	void combine(ThreadHive& hive);
 
 private:
+	/// Sort the renderables using their m_sortKey.
+	static void sortRenderables(
+		ThreadHive& hive, SceneFrameAllocator<U8>& alloc, WeakArray<RenderableQueueElement>& renderables);
+
 	template<typename T>
 	static void combineQueueElements(SceneFrameAllocator<U8>& alloc,
 		WeakArray<TRenderQueueElementStorage<T>> subStorages,
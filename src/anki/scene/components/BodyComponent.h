@@ -45,7 +45,8 @@ public:
 
 	ANKI_USE_RESULT Error update(SceneNode& node, Second, Second, Bool& updated) override
 	{
-		Transform newTrf = m_body->getTransform();
+		// The physics may run at a lower rate than the frames, use the interpolated transform for smooth motion
+		Transform newTrf = m_body->getInterpolatedTransform();
 		updated = newTrf != m_trf;
 		m_trf = newTrf;
 		return Error::NONE;
@@ -7,6 +7,7 @@
 #include <anki/scene/SceneNode.h>
 #include <anki/resource/TextureResource.h>
 #include <anki/resource/ResourceManager.h>
+#include <anki/core/Trace.h>
 #include <anki/util/Logger.h>
 
 namespace anki
@@ -41,7 +42,6 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 	ConstWeakArray<Mat4> prevTransforms,
 	StagingGpuMemoryManager& alloc) const
 {
-	ANKI_ASSERT(transforms.getSize() <= MAX_INSTANCES);
 	ANKI_ASSERT(prevTransforms.getSize() == transforms.getSize());
 
 	const MaterialVariant& variant = m_mtl->getOrCreateVariant(ctx.m_key);
@@ -68,6 +68,25 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 	uniformsBegin = uniforms;
 	uniformsEnd = uniforms + variant.getUniformBlockSize();
 
+	// Allocate storage memory for the instanced inputs. There is no limit to the instance count
+	void* instancesBegin = nullptr;
+	const void* instancesEnd = nullptr;
+	if(progVariant.instancedInputsInStorage())
+	{
+		ANKI_ASSERT(transforms.getSize() > 0);
+		const PtrSize size = progVariant.getInstanceStorageStride() * transforms.getSize();
+
+		StagingGpuMemoryToken token;
+		instancesBegin = alloc.allocateFrame(size, StagingGpuMemoryType::STORAGE, token);
+		instancesEnd = static_cast<U8*>(instancesBegin) + size;
+
+		ctx.m_commandBuffer->bindStorageBuffer(
+			set, INSTANCED_INPUTS_STORAGE_BUFFER_BINDING, token.m_buffer, token.m_offset, token.m_range);
+
+		ANKI_TRACE_INC_COUNTER(R_STORAGE_INSTANCED_DRAWCALLS, 1);
+		ANKI_TRACE_INC_COUNTER(R_STORAGE_INSTANCED_BYTES, size);
+	}
+
 	// Iterate variables
 	for(auto it = m_vars.getBegin(); it != m_vars.getEnd(); ++it)
 	{
@@ -80,18 +99,27 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 			continue;
 		}
 
+		// Where to write the variable
+		void* blockBegin = uniformsBegin;
+		const void* blockEnd = uniformsEnd;
+		if(progvar.isInstanced() && instancesBegin)
+		{
+			blockBegin = instancesBegin;
+			blockEnd = instancesEnd;
+		}
+
 		switch(progvar.getShaderVariableDataType())
 		{
 		case ShaderVariableDataType::FLOAT:
 		{
 			F32 val = mvar.getValue<F32>();
-			progVariant.writeShaderBlockMemory(progvar, &val, 1, uniformsBegin, uniformsEnd);
+			progVariant.writeShaderBlockMemory(progvar, &val, 1, blockBegin, blockEnd);
 			break;
 		}
 		case ShaderVariableDataType::VEC2:
 		{
 			Vec2 val = mvar.getValue<Vec2>();
-			progVariant.writeShaderBlockMemory(progvar, &val, 1, uniformsBegin, uniformsEnd);
+			progVariant.writeShaderBlockMemory(progvar, &val, 1, blockBegin, blockEnd);
 			break;
 		}
 		case ShaderVariableDataType::VEC3:
@@ -101,13 +129,13 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 			case BuiltinMaterialVariableId::NONE:
 			{
 				Vec3 val = mvar.getValue<Vec3>();
-				progVariant.writeShaderBlockMemory(progvar, &val, 1, uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &val, 1, blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::CAMERA_POSITION:
 			{
 				Vec3 val = ctx.m_cameraTransform.getTranslationPart().xyz();
-				progVariant.writeShaderBlockMemory(progvar, &val, 1, uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &val, 1, blockBegin, blockEnd);
 				break;
 			}
 			default:
@@ -119,7 +147,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 		case ShaderVariableDataType::VEC4:
 		{
 			Vec4 val = mvar.getValue<Vec4>();
-			progVariant.writeShaderBlockMemory(progvar, &val, 1, uniformsBegin, uniformsEnd);
+			progVariant.writeShaderBlockMemory(progvar, &val, 1, blockBegin, blockEnd);
 			break;
 		}
 		case ShaderVariableDataType::MAT3:
@@ -129,7 +157,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 			case BuiltinMaterialVariableId::NONE:
 			{
 				Mat3 val = mvar.getValue<Mat3>();
-				progVariant.writeShaderBlockMemory(progvar, &val, 1, uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &val, 1, blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::NORMAL_MATRIX:
@@ -146,8 +174,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 					normMats[i].reorthogonalize();
 				}
 
-				progVariant.writeShaderBlockMemory(
-					progvar, &normMats[0], transforms.getSize(), uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &normMats[0], transforms.getSize(), blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::ROTATION_MATRIX:
@@ -162,13 +189,13 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 					rots[i] = transforms[i].getRotationPart();
 				}
 
-				progVariant.writeShaderBlockMemory(progvar, &rots[0], transforms.getSize(), uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &rots[0], transforms.getSize(), blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::CAMERA_ROTATION_MATRIX:
 			{
 				Mat3 rot = ctx.m_cameraTransform.getRotationPart();
-				progVariant.writeShaderBlockMemory(progvar, &rot, 1, uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &rot, 1, blockBegin, blockEnd);
 				break;
 			}
 			default:
@@ -184,7 +211,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 			case BuiltinMaterialVariableId::NONE:
 			{
 				Mat4 val = mvar.getValue<Mat4>();
-				progVariant.writeShaderBlockMemory(progvar, &val, 1, uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &val, 1, blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::MODEL_VIEW_PROJECTION_MATRIX:
@@ -199,7 +226,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 					mvp[i] = ctx.m_viewProjectionMatrix * transforms[i];
 				}
 
-				progVariant.writeShaderBlockMemory(progvar, &mvp[0], transforms.getSize(), uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &mvp[0], transforms.getSize(), blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::PREVIOUS_MODEL_VIEW_PROJECTION_MATRIX:
@@ -214,8 +241,7 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 					mvp[i] = ctx.m_previousViewProjectionMatrix * prevTransforms[i];
 				}
 
-				progVariant.writeShaderBlockMemory(
-					progvar, &mvp[0], prevTransforms.getSize(), uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &mvp[0], prevTransforms.getSize(), blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::MODEL_VIEW_MATRIX:
@@ -230,26 +256,25 @@ void MaterialRenderComponent::allocateAndSetupUniforms(U set,
 					mv[i] = ctx.m_viewMatrix * transforms[i];
 				}
 
-				progVariant.writeShaderBlockMemory(progvar, &mv[0], transforms.getSize(), uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &mv[0], transforms.getSize(), blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::MODEL_MATRIX:
 			{
 				ANKI_ASSERT(transforms.getSize() > 0);
 
-				progVariant.writeShaderBlockMemory(
-					progvar, &transforms[0], transforms.getSize(), uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &transforms[0], transforms.getSize(), blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::VIEW_PROJECTION_MATRIX:
 			{
 				ANKI_ASSERT(transforms.getSize() == 0 && "Cannot have transform");
-				progVariant.writeShaderBlockMemory(progvar, &ctx.m_viewProjectionMatrix, 1, uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &ctx.m_viewProjectionMatrix, 1, blockBegin, blockEnd);
 				break;
 			}
 			case BuiltinMaterialVariableId::VIEW_MATRIX:
 			{
-				progVariant.writeShaderBlockMemory(progvar, &ctx.m_viewMatrix, 1, uniformsBegin, uniformsEnd);
+				progVariant.writeShaderBlockMemory(progvar, &ctx.m_viewMatrix, 1, blockBegin, blockEnd);
 				break;
 			}
 			default:
@@ -40,9 +40,48 @@ public:
 
 	virtual void setupRenderableQueueElement(RenderableQueueElement& el) const = 0;
 
+	/// Request the texture detail that is needed for the size the component occupies on the screen. Used by the
+	/// texture streaming.
+	/// @param projectedSize The fraction of the screen height the component occupies.
+	/// @note It's thread-safe.
+	virtual void requestTextureStreaming(F32 projectedSize) const
+	{
+	}
+
+	/// The number of LODs the visibility can choose from.
+	U8 getLodCount() const
+	{
+		return m_lodCount;
+	}
+
+	/// Get the number of triangles of a LOD. Used to enforce the triangle budget.
+	U32 getLodTriangleCount(U lod) const
+	{
+		ANKI_ASSERT(lod < m_lodCount);
+		return m_lodTriangleCounts[lod];
+	}
+
+	/// Get the LOD that was selected in the previous frame.
+	U8 getLastLod() const
+	{
+		return m_lastLod;
+	}
+
+	/// @note Only the visibility tests of the main camera should set this.
+	void setLastLod(U8 lod)
+	{
+		ANKI_ASSERT(lod < m_lodCount);
+		m_lastLod = lod;
+	}
+
 protected:
+	Array<U32, MAX_LOD_COUNT> m_lodTriangleCounts = {};
+	U8 m_lodCount = 1;
 	Bool8 m_castsShadow = false;
 	Bool8 m_isForwardShading = false;
+
+private:
+	U8 m_lastLod = 0;
 };
 
 /// A wrapper on top of MaterialVariable
@@ -130,6 +169,11 @@ public:
 		return err;
 	}
 
+	void requestTextureStreaming(F32 projectedSize) const override
+	{
+		m_mtl->requestTextureDetail(projectedSize);
+	}
+
 	void allocateAndSetupUniforms(U set,
 		const RenderQueueDrawContext& ctx,
 		ConstWeakArray<Mat4> transforms,
@@ -0,0 +1,333 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/util/HashMap.h>
+#include <anki/util/Atomic.h>
+#include <anki/util/Thread.h>
+
+namespace anki
+{
+
+/// @addtogroup util_containers
+/// @{
+
+/// A hash map for read-mostly caches. The lookups are lock-free and the insertions are serialized with a mutex. The
+/// elements can't be removed one by one, only all of them with destroy(). Like HashMap it identifies the keys by their
+/// hash only.
+///
+/// The nodes are never moved or freed before destroy() so the pointers that find() returns stay valid. When the slot
+/// table grows the old one is kept around (it might be read by other threads) and it's freed in destroy().
+template<typename TKey, typename TValue, typename THasher = DefaultHasher<TKey>>
+class ConcurrentHashMap : public NonCopyable
+{
+public:
+	using Value = TValue;
+	using Key = TKey;
+	using Hasher = THasher;
+
+	static constexpr U32 INITIAL_CAPACITY = 32;
+
+	ConcurrentHashMap()
+	{
+		m_table.set(nullptr);
+		m_size.set(0);
+	}
+
+	~ConcurrentHashMap()
+	{
+		ANKI_ASSERT(m_table.get() == nullptr && "Requires manual destruction");
+	}
+
+	/// Destroy all the elements. It's not thread-safe.
+	template<typename TAllocator>
+	void destroy(TAllocator alloc);
+
+	/// Find a value. It's thread-safe and it doesn't lock.
+	/// @return The value or nullptr if it's not there. The pointer is valid until destroy().
+	const TValue* find(const TKey& key) const
+	{
+		const Node* node = findNode(THasher()(key));
+		return (node) ? &node->m_value : nullptr;
+	}
+
+	/// @copydoc find
+	TValue* find(const TKey& key)
+	{
+		Node* node = findNode(THasher()(key));
+		return (node) ? &node->m_value : nullptr;
+	}
+
+	/// Find a value or create it if it's not there. The @a createCallback is called only if the key is not present and
+	/// while a lock is held. This guarantees that a value is created only once. It's thread-safe.
+	/// @param alloc The allocator.
+	/// @param key The key.
+	/// @param createCallback A functor with signature: Error(TValue& newValue).
+	/// @param[out] value The value that was found or created.
+	template<typename TAllocator, typename TFunc>
+	ANKI_USE_RESULT Error findOrCreate(TAllocator alloc, const TKey& key, TFunc createCallback, TValue*& value);
+
+	/// Insert a value if the key is not present. It's thread-safe.
+	/// @return The value that was already there or the new one.
+	template<typename TAllocator, typename... TArgs>
+	TValue& emplace(TAllocator alloc, const TKey& key, TArgs&&... args);
+
+	/// Iterate all the elements. It can run concurrently with insertions but it might miss the elements that are
+	/// inserted meanwhile.
+	/// @param func A functor with signature: void(TValue& value).
+	template<typename TFunc>
+	void iterate(TFunc func);
+
+	U32 getSize() const
+	{
+		return m_size.load();
+	}
+
+	Bool isEmpty() const
+	{
+		return getSize() == 0;
+	}
+
+private:
+	class Node
+	{
+	public:
+		U64 m_hash;
+		TValue m_value;
+
+		template<typename... TArgs>
+		Node(U64 hash, TArgs&&... args)
+			: m_hash(hash)
+			, m_value(std::forward<TArgs>(args)...)
+		{
+		}
+	};
+
+	class Table
+	{
+	public:
+		Atomic<Node*>* m_slots = nullptr;
+		U32 m_capacity = 0;
+		Table* m_prev = nullptr; ///< The tables that were replaced. They are freed in destroy().
+	};
+
+	Atomic<Table*> m_table;
+	Atomic<U32> m_size;
+	Mutex m_mtx; ///< Serializes the writers.
+
+	Node* findNode(U64 hash) const;
+
+	/// Insert a node. Needs to be called while holding the lock.
+	template<typename TAllocator>
+	void insertNode(TAllocator alloc, Node* node);
+
+	static void insertNodeToTable(Table& table, Node* node);
+};
+
+template<typename TKey, typename TValue, typename THasher>
+typename ConcurrentHashMap<TKey, TValue, THasher>::Node* ConcurrentHashMap<TKey, TValue, THasher>::findNode(
+	U64 hash) const
+{
+	const Table* table = m_table.load(AtomicMemoryOrder::ACQUIRE);
+	if(table == nullptr)
+	{
+		return nullptr;
+	}
+
+	const U32 mask = table->m_capacity - 1;
+	U32 idx = hash & mask;
+	while(true)
+	{
+		// Acquire to see the contents of the node. The slots are written once so there is no ABA
+		Node* node = table->m_slots[idx].load(AtomicMemoryOrder::ACQUIRE);
+		if(node == nullptr)
+		{
+			return nullptr;
+		}
+		else if(node->m_hash == hash)
+		{
+			return node;
+		}
+
+		idx = (idx + 1) & mask;
+	}
+}
+
+template<typename TKey, typename TValue, typename THasher>
+void ConcurrentHashMap<TKey, TValue, THasher>::insertNodeToTable(Table& table, Node* node)
+{
+	const U32 mask = table.m_capacity - 1;
+	U32 idx = node->m_hash & mask;
+	while(table.m_slots[idx].load(AtomicMemoryOrder::RELAXED) != nullptr)
+	{
+		ANKI_ASSERT(table.m_slots[idx].load(AtomicMemoryOrder::RELAXED)->m_hash != node->m_hash);
+		idx = (idx + 1) & mask;
+	}
+
+	// Release to publish the contents of the node
+	table.m_slots[idx].store(node, AtomicMemoryOrder::RELEASE);
+}
+
+template<typename TKey, typename TValue, typename THasher>
+template<typename TAllocator>
+void ConcurrentHashMap<TKey, TValue, THasher>::insertNode(TAllocator alloc, Node* node)
+{
+	Table* table = m_table.load(AtomicMemoryOrder::RELAXED);
+	const U32 newSize = m_size.load() + 1;
+
+	// Keep the load factor under 0.5 to have short probe sequences
+	if(table == nullptr || newSize * 2 > table->m_capacity)
+	{
+		// Build a new table privately and then publish it
+		Table* newTable = alloc.template newInstance<Table>();
+		newTable->m_capacity = (table) ? table->m_capacity * 2 : INITIAL_CAPACITY;
+		newTable->m_slots = alloc.template newArray<Atomic<Node*>>(newTable->m_capacity);
+		for(U32 i = 0; i < newTable->m_capacity; ++i)
+		{
+			newTable->m_slots[i].set(nullptr);
+		}
+
+		if(table)
+		{
+			for(U32 i = 0; i < table->m_capacity; ++i)
+			{
+				Node* oldNode = table->m_slots[i].load(AtomicMemoryOrder::RELAXED);
+				if(oldNode)
+				{
+					insertNodeToTable(*newTable, oldNode);
+				}
+			}
+		}
+
+		newTable->m_prev = table;
+		insertNodeToTable(*newTable, node);
+		m_table.store(newTable, AtomicMemoryOrder::RELEASE);
+	}
+	else
+	{
+		insertNodeToTable(*table, node);
+	}
+
+	m_size.store(newSize);
+}
+
+template<typename TKey, typename TValue, typename THasher>
+template<typename TAllocator, typename TFunc>
+Error ConcurrentHashMap<TKey, TValue, THasher>::findOrCreate(
+	TAllocator alloc, const TKey& key, TFunc createCallback, TValue*& value)
+{
+	const U64 hash = THasher()(key);
+
+	// Fast path
+	Node* node = findNode(hash);
+	if(node)
+	{
+		value = &node->m_value;
+		return Error::NONE;
+	}
+
+	LockGuard<Mutex> lock(m_mtx);
+
+	// Check again, someone might have created it while waiting for the lock
+	node = findNode(hash);
+	if(node)
+	{
+		value = &node->m_value;
+		return Error::NONE;
+	}
+
+	node = alloc.template newInstance<Node>(hash);
+	const Error err = createCallback(node->m_value);
+	if(err)
+	{
+		alloc.deleteInstance(node);
+		value = nullptr;
+		return err;
+	}
+
+	insertNode(alloc, node);
+	value = &node->m_value;
+	return Error::NONE;
+}
+
+template<typename TKey, typename TValue, typename THasher>
+template<typename TAllocator, typename... TArgs>
+TValue& ConcurrentHashMap<TKey, TValue, THasher>::emplace(TAllocator alloc, const TKey& key, TArgs&&... args)
+{
+	const U64 hash = THasher()(key);
+
+	Node* node = findNode(hash);
+	if(node)
+	{
+		return node->m_value;
+	}
+
+	LockGuard<Mutex> lock(m_mtx);
+
+	node = findNode(hash);
+	if(node == nullptr)
+	{
+		node = alloc.template newInstance<Node>(hash, std::forward<TArgs>(args)...);
+		insertNode(alloc, node);
+	}
+
+	return node->m_value;
+}
+
+template<typename TKey, typename TValue, typename THasher>
+template<typename TFunc>
+void ConcurrentHashMap<TKey, TValue, THasher>::iterate(TFunc func)
+{
+	Table* table = m_table.load(AtomicMemoryOrder::ACQUIRE);
+	if(table == nullptr)
+	{
+		return;
+	}
+
+	for(U32 i = 0; i < table->m_capacity; ++i)
+	{
+		Node* node = table->m_slots[i].load(AtomicMemoryOrder::ACQUIRE);
+		if(node)
+		{
+			func(node->m_value);
+		}
+	}
+}
+
+template<typename TKey, typename TValue, typename THasher>
+template<typename TAllocator>
+void ConcurrentHashMap<TKey, TValue, THasher>::destroy(TAllocator alloc)
+{
+	Table* table = m_table.get();
+	if(table == nullptr)
+	{
+		return;
+	}
+
+	// Only the latest table has all the nodes
+	for(U32 i = 0; i < table->m_capacity; ++i)
+	{
+		Node* node = table->m_slots[i].get();
+		if(node)
+		{
+			alloc.deleteInstance(node);
+		}
+	}
+
+	while(table)
+	{
+		Table* prev = table->m_prev;
+		alloc.deleteArray(table->m_slots, table->m_capacity);
+		alloc.deleteInstance(table);
+		table = prev;
+	}
+
+	m_table.set(nullptr);
+	m_size.set(0);
+}
+/// @}
+
+} // end namespace anki
@@ -25,6 +25,9 @@ void getFilepathFilename(const CString& filename, StringAuto& out);
 /// Return true if directory exists?
 Bool directoryExists(const CString& dir);
 
+/// Get the time a file was last modified. The value can only be compared with other values of this function.
+ANKI_USE_RESULT Error getFileModificationTime(const CString& filename, U64& time);
+
 /// Callback for the @ref walkDirectoryTree.
 /// @param filename The file or directory name.
 /// @param userData User data passed to walkDirectoryTree.
@@ -40,6 +43,9 @@ ANKI_USE_RESULT Error removeDirectory(const CString& dir);
 /// Equivalent to: mkdir dir
 ANKI_USE_RESULT Error createDirectory(const CString& dir);
 
+/// Rename a file. If @a newName exists it's replaced in one go, readers will see either the old or the new file.
+ANKI_USE_RESULT Error renameFile(const CString& oldName, const CString& newName);
+
 /// Get the home directory.
 /// Write the home directory to @a buff. The @a buffSize is the size of the @a buff. If the @buffSize is not enough the
 /// function will throw an exception.
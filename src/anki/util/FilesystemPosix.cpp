@@ -7,6 +7,7 @@
 #include <anki/util/Assert.h>
 #include <anki/util/Thread.h>
 #include <cstring>
+#include <cstdio>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <dirent.h>
@@ -48,6 +49,24 @@ Bool directoryExists(const CString& filename)
 	}
 }
 
+Error getFileModificationTime(const CString& filename, U64& time)
+{
+	struct stat s;
+	if(stat(filename.get(), &s) != 0)
+	{
+		ANKI_UTIL_LOGE("stat() failed for %s", filename.get());
+		return Error::FUNCTION_FAILED;
+	}
+
+#if ANKI_OS == ANKI_OS_LINUX
+	// Use nanoseconds, a file might be saved more than once in a second
+	time = U64(s.st_mtim.tv_sec) * 1000000000 + U64(s.st_mtim.tv_nsec);
+#else
+	time = U64(s.st_mtime);
+#endif
+	return Error::NONE;
+}
+
 Error walkDirectoryTree(const CString& dir, void* userData, WalkDirectoryTreeCallback callback)
 {
 	ANKI_ASSERT(callback != nullptr);
@@ -175,6 +194,17 @@ Error createDirectory(const CString& dir)
 	return err;
 }
 
+Error renameFile(const CString& oldName, const CString& newName)
+{
+	if(rename(oldName.get(), newName.get()))
+	{
+		ANKI_UTIL_LOGE("%s : %s -> %s", strerror(errno), oldName.get(), newName.get());
+		return Error::FUNCTION_FAILED;
+	}
+
+	return Error::NONE;
+}
+
 Error getHomeDirectory(GenericMemoryPoolAllocator<U8> alloc, String& out)
 {
 	const char* home = getenv("HOME");
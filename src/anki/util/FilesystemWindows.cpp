@@ -33,6 +33,19 @@ Bool directoryExists(const CString& filename)
 	return dwAttrib != INVALID_FILE_ATTRIBUTES && (dwAttrib & FILE_ATTRIBUTE_DIRECTORY);
 }
 
+Error getFileModificationTime(const CString& filename, U64& time)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if(!GetFileAttributesEx(filename.get(), GetFileExInfoStandard, &data))
+	{
+		ANKI_UTIL_LOGE("GetFileAttributesEx() failed for %s", filename.get());
+		return Error::FUNCTION_FAILED;
+	}
+
+	time = (U64(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+	return Error::NONE;
+}
+
 Error removeDirectory(const CString& dirname)
 {
 	// For some reason dirname should be double null terminated
@@ -72,6 +85,17 @@ Error createDirectory(const CString& dir)
 	return err;
 }
 
+Error renameFile(const CString& oldName, const CString& newName)
+{
+	if(MoveFileEx(oldName.get(), newName.get(), MOVEFILE_REPLACE_EXISTING) == 0)
+	{
+		ANKI_UTIL_LOGE("Failed to rename %s to %s", oldName.get(), newName.get());
+		return Error::FUNCTION_FAILED;
+	}
+
+	return Error::NONE;
+}
+
 Error getHomeDirectory(GenericMemoryPoolAllocator<U8> alloc, String& out)
 {
 	const char* homed = getenv("HOMEDRIVE");
@@ -161,6 +161,9 @@ void* BaseMemoryPool::allocate(PtrSize size, PtrSize alignmentBytes)
 	case Type::CHAIN:
 		out = static_cast<ChainMemoryPool*>(this)->allocate(size, alignmentBytes);
 		break;
+	case Type::THREAD_CACHING:
+		out = static_cast<ThreadCachingMemoryPool*>(this)->allocate(size, alignmentBytes);
+		break;
 	default:
 		ANKI_ASSERT(0);
 	}
@@ -168,6 +171,16 @@ void* BaseMemoryPool::allocate(PtrSize size, PtrSize alignmentBytes)
 	return out;
 }
 
+U32 BaseMemoryPool::getAllocationsCount() const
+{
+	if(m_type == Type::THREAD_CACHING)
+	{
+		return static_cast<const ThreadCachingMemoryPool*>(this)->getAllocationsCount();
+	}
+
+	return m_allocationsCount.load();
+}
+
 void BaseMemoryPool::free(void* ptr)
 {
 	switch(m_type)
@@ -181,6 +194,9 @@ void BaseMemoryPool::free(void* ptr)
 	case Type::CHAIN:
 		static_cast<ChainMemoryPool*>(this)->free(ptr);
 		break;
+	case Type::THREAD_CACHING:
+		static_cast<ThreadCachingMemoryPool*>(this)->free(ptr);
+		break;
 	default:
 		ANKI_ASSERT(0);
 	}
@@ -301,7 +317,8 @@ void StackMemoryPool::create(AllocAlignedCallback allocCb,
 	F32 nextChunkScale,
 	PtrSize nextChunkBias,
 	Bool ignoreDeallocationErrors,
-	PtrSize alignmentBytes)
+	PtrSize alignmentBytes,
+	Bool threadSafe)
 {
 	ANKI_ASSERT(!isCreated());
 	ANKI_ASSERT(allocCb);
@@ -316,6 +333,7 @@ void StackMemoryPool::create(AllocAlignedCallback allocCb,
 	m_nextChunkScale = nextChunkScale;
 	m_nextChunkBias = nextChunkBias;
 	m_ignoreDeallocationErrors = ignoreDeallocationErrors;
+	m_threadSafe = threadSafe;
 
 	// Create the first chunk
 	void* mem = m_allocCb(m_allocCbUserData, nullptr, m_initialChunkSize, m_alignmentBytes);
@@ -355,7 +373,15 @@ void* StackMemoryPool::allocate(PtrSize size, PtrSize alignment)
 		crntChunk = &m_chunks[m_crntChunkIdx.load()];
 		crntChunk->check();
 
-		out = crntChunk->m_mem.fetchAdd(size);
+		if(m_threadSafe)
+		{
+			out = crntChunk->m_mem.fetchAdd(size);
+		}
+		else
+		{
+			out = crntChunk->m_mem.load();
+			crntChunk->m_mem.store(out + size);
+		}
 		ANKI_ASSERT(out >= crntChunk->m_baseMem);
 
 		if(PtrSize(out + size - crntChunk->m_baseMem) <= crntChunk->m_size)
@@ -363,7 +389,14 @@ void* StackMemoryPool::allocate(PtrSize size, PtrSize alignment)
 			// All is fine, there is enough space in the chunk
 
 			retry = false;
-			m_allocationsCount.fetchAdd(1);
+			if(m_threadSafe)
+			{
+				m_allocationsCount.fetchAdd(1);
+			}
+			else
+			{
+				m_allocationsCount.store(m_allocationsCount.load() + 1);
+			}
 		}
 		else
 		{
@@ -437,7 +470,16 @@ void StackMemoryPool::free(void* ptr)
 	// allocated by this class
 	ANKI_ASSERT(ptr != nullptr && isAligned(m_alignmentBytes, ptr));
 
-	auto count = m_allocationsCount.fetchSub(1);
+	U32 count;
+	if(m_threadSafe)
+	{
+		count = m_allocationsCount.fetchSub(1);
+	}
+	else
+	{
+		count = m_allocationsCount.load();
+		m_allocationsCount.store(count - 1);
+	}
 	ANKI_ASSERT(count > 0);
 	(void)count;
 }
@@ -486,6 +528,20 @@ PtrSize StackMemoryPool::getMemoryCapacity() const
 	return sum;
 }
 
+PtrSize StackMemoryPool::getMemoryUsed() const
+{
+	PtrSize sum = 0;
+	U crntChunkIdx = m_crntChunkIdx.load();
+	for(U i = 0; i <= crntChunkIdx; ++i)
+	{
+		// The pointer can go past the end of the chunk when the allocation didn't fit
+		const Chunk& ch = m_chunks[i];
+		sum += min<PtrSize>(ch.m_size, ch.m_mem.load() - ch.m_baseMem);
+	}
+
+	return sum;
+}
+
 ChainMemoryPool::ChainMemoryPool()
 	: BaseMemoryPool(Type::CHAIN)
 {
@@ -776,4 +832,497 @@ void ChainMemoryPool::destroyChunk(Chunk* ch)
 	m_allocCb(m_allocCbUserData, ch, 0, 0);
 }
 
+/// Free blocks form a list through their memory.
+class ThreadCachingMemoryPool::FreeBlock
+{
+public:
+	FreeBlock* m_next;
+};
+
+/// It's placed at the start of every span and every large allocation. Freeing finds it by rounding down the pointer.
+class ThreadCachingMemoryPool::SpanHeader
+{
+public:
+	const ThreadCachingMemoryPool* m_pool;
+
+	/// What the allocation callback returned. Only large allocations and the first span of every span allocation have
+	/// it. The rest of the spans have nullptr.
+	void* m_allocation;
+
+	SpanHeader* m_nextAllocation; ///< Chains the first spans of the span allocations.
+	U32 m_classIdx; ///< It's MAX_U32 for large allocations.
+};
+
+/// The size of the span header. The first block needs the max alignment.
+static const PtrSize SPAN_HEADER_SIZE = ThreadCachingMemoryPool::MAX_SMALL_ALLOCATION_ALIGNMENT;
+
+/// The free lists of a thread. Only the owner thread touches it.
+class ThreadCachingMemoryPool::ThreadCache
+{
+public:
+	class List
+	{
+	public:
+		FreeBlock* m_head = nullptr;
+		U32 m_count = 0;
+	};
+
+	Array<List, CLASS_COUNT> m_lists;
+
+	/// Allocations minus frees of this thread. The owner writes it without atomic read-modify-write operations and
+	/// the others only read it.
+	Atomic<I32> m_allocationsCount = {0};
+
+	ThreadId m_threadId = 0; ///< The owner.
+	ThreadCache* m_next = nullptr;
+
+	void incrementAllocationsCount(I32 val)
+	{
+		m_allocationsCount.store(m_allocationsCount.load() + val);
+	}
+};
+
+/// The blocks of a class that are not in any thread cache.
+class alignas(ANKI_CACHE_LINE_SIZE) ThreadCachingMemoryPool::CentralList
+{
+public:
+	SpinLock m_lock;
+	FreeBlock* m_head = nullptr;
+
+	/// The part of the latest span that was never used.
+	U8* m_carveBegin = nullptr;
+	U8* m_carveEnd = nullptr;
+};
+
+static Atomic<U64> g_threadCachingMemoryPoolUuid = {0};
+
+ThreadCachingMemoryPool::ThreadCachingMemoryPool()
+	: BaseMemoryPool(Type::THREAD_CACHING)
+{
+}
+
+ThreadCachingMemoryPool::~ThreadCachingMemoryPool()
+{
+	if(!isCreated())
+	{
+		return;
+	}
+
+	const U32 count = getAllocationsCount();
+	if(count != 0)
+	{
+		ANKI_UTIL_LOGW("Memory pool destroyed before all memory being released "
+					   "(%u deallocations missed)",
+			count);
+	}
+
+	ThreadCache* cache = m_threadCaches.load();
+	while(cache)
+	{
+		ThreadCache* next = cache->m_next;
+		cache->~ThreadCache();
+		m_allocCb(m_allocCbUserData, cache, 0, 0);
+		cache = next;
+	}
+
+	SpanHeader* span = m_spanAllocations;
+	while(span)
+	{
+		SpanHeader* next = span->m_nextAllocation;
+		m_allocCb(m_allocCbUserData, span->m_allocation, 0, 0);
+		span = next;
+	}
+
+	for(U32 i = 0; i < CLASS_COUNT; ++i)
+	{
+		m_centralLists[i].~CentralList();
+	}
+
+	m_allocCb(m_allocCbUserData, m_centralLists, 0, 0);
+}
+
+void ThreadCachingMemoryPool::create(AllocAlignedCallback allocCb, void* allocCbUserData)
+{
+	ANKI_ASSERT(!isCreated());
+	ANKI_ASSERT(allocCb != nullptr);
+
+	m_allocCb = allocCb;
+	m_allocCbUserData = allocCbUserData;
+	m_uuid = g_threadCachingMemoryPoolUuid.fetchAdd(1) + 1;
+
+	// Size classes. Fine grained for the small sizes and 4 classes per power of two after that
+	U32 classIdx = 0;
+	for(U32 size = CLASS_GRANULARITY; size <= 256; size += CLASS_GRANULARITY)
+	{
+		m_classSizes[classIdx++] = size;
+	}
+
+	for(U32 pow2 = 256; pow2 < MAX_SMALL_ALLOCATION_SIZE; pow2 *= 2)
+	{
+		for(U32 i = 1; i <= 4; ++i)
+		{
+			m_classSizes[classIdx++] = pow2 + pow2 / 4 * i;
+		}
+	}
+
+	ANKI_ASSERT(classIdx == CLASS_COUNT && m_classSizes[CLASS_COUNT - 1] == MAX_SMALL_ALLOCATION_SIZE);
+
+	// Move around 16K between the caches at once
+	for(U32 i = 0; i < CLASS_COUNT; ++i)
+	{
+		m_classBatchSizes[i] = max<U32>(2, min<U32>(64, (16 * 1024) / m_classSizes[i]));
+	}
+
+	// Size to class lookup
+	classIdx = 0;
+	for(U32 i = 0; i < m_sizeToClass.getSize(); ++i)
+	{
+		const U32 size = (i + 1) * CLASS_GRANULARITY;
+		while(m_classSizes[classIdx] < size)
+		{
+			++classIdx;
+		}
+
+		m_sizeToClass[i] = classIdx;
+	}
+
+	// Central lists
+	m_centralLists = static_cast<CentralList*>(
+		m_allocCb(m_allocCbUserData, nullptr, sizeof(CentralList) * CLASS_COUNT, alignof(CentralList)));
+	if(!m_centralLists)
+	{
+		ANKI_CREATION_OOM_ACTION();
+	}
+
+	for(U32 i = 0; i < CLASS_COUNT; ++i)
+	{
+		::new(&m_centralLists[i]) CentralList();
+	}
+}
+
+U32 ThreadCachingMemoryPool::computeClass(PtrSize size, PtrSize alignment) const
+{
+	ANKI_ASSERT(size > 0 && size <= MAX_SMALL_ALLOCATION_SIZE);
+	ANKI_ASSERT(alignment <= MAX_SMALL_ALLOCATION_ALIGNMENT);
+
+	// The blocks are aligned to the greatest power of two that divides the class size
+	if(alignment > CLASS_GRANULARITY)
+	{
+		size = getAlignedRoundUp(alignment, size);
+	}
+
+	U32 classIdx = m_sizeToClass[(size - 1) / CLASS_GRANULARITY];
+	while((m_classSizes[classIdx] % alignment) != 0)
+	{
+		++classIdx;
+		ANKI_ASSERT(classIdx < CLASS_COUNT);
+	}
+
+	return classIdx;
+}
+
+ThreadCachingMemoryPool::ThreadCache& ThreadCachingMemoryPool::getThreadCache()
+{
+	class Slot
+	{
+	public:
+		U64 m_poolUuid;
+		ThreadCache* m_cache;
+	};
+
+	static const U32 MAX_POOLS_PER_THREAD = 8;
+	static thread_local Array<Slot, MAX_POOLS_PER_THREAD> slots;
+	static thread_local U32 nextSlotToEvict;
+
+	for(Slot& slot : slots)
+	{
+		if(slot.m_poolUuid == m_uuid)
+		{
+			return *slot.m_cache;
+		}
+	}
+
+	// First time this thread uses the pool or its slot was stolen. Find an empty slot or steal one. The stolen cache
+	// stays in its pool and it's found again if its thread comes back
+	Slot* slot = nullptr;
+	for(Slot& s : slots)
+	{
+		if(s.m_poolUuid == 0)
+		{
+			slot = &s;
+			break;
+		}
+	}
+
+	if(slot == nullptr)
+	{
+		slot = &slots[nextSlotToEvict++ % MAX_POOLS_PER_THREAD];
+	}
+
+	slot->m_poolUuid = m_uuid;
+	slot->m_cache = findOrCreateThreadCache();
+	return *slot->m_cache;
+}
+
+ThreadCachingMemoryPool::ThreadCache* ThreadCachingMemoryPool::findOrCreateThreadCache()
+{
+	const ThreadId threadId = Thread::getCurrentThreadId();
+
+	// Only this thread creates caches with its ID so the cache can't be added while searching
+	for(ThreadCache* cache = m_threadCaches.load(AtomicMemoryOrder::ACQUIRE); cache; cache = cache->m_next)
+	{
+		if(cache->m_threadId == threadId)
+		{
+			return cache;
+		}
+	}
+
+	void* mem = m_allocCb(m_allocCbUserData, nullptr, sizeof(ThreadCache), alignof(ThreadCache));
+	if(!mem)
+	{
+		ANKI_CREATION_OOM_ACTION();
+	}
+
+	ThreadCache* cache = ::new(mem) ThreadCache();
+	cache->m_threadId = threadId;
+
+	LockGuard<Mutex> lock(m_threadCachesMtx);
+	cache->m_next = m_threadCaches.load();
+	m_threadCaches.store(cache, AtomicMemoryOrder::RELEASE);
+
+	return cache;
+}
+
+void* ThreadCachingMemoryPool::allocate(PtrSize size, PtrSize alignment)
+{
+	ANKI_ASSERT(isCreated());
+	ANKI_ASSERT(size > 0 && alignment > 0);
+
+	ThreadCache& cache = getThreadCache();
+	void* out;
+
+	if(size <= MAX_SMALL_ALLOCATION_SIZE && alignment <= MAX_SMALL_ALLOCATION_ALIGNMENT)
+	{
+		const U32 classIdx = computeClass(size, alignment);
+		ThreadCache::List& list = cache.m_lists[classIdx];
+
+		if(ANKI_UNLIKELY(list.m_head == nullptr))
+		{
+			fetchBatch(cache, classIdx);
+		}
+
+		FreeBlock* block = list.m_head;
+		if(block)
+		{
+			list.m_head = block->m_next;
+			--list.m_count;
+		}
+
+		out = block;
+	}
+	else
+	{
+		out = allocateLarge(size, alignment);
+	}
+
+	if(out)
+	{
+		ANKI_ASSERT(isAligned(alignment, out));
+		cache.incrementAllocationsCount(1);
+	}
+	else
+	{
+		ANKI_OOM_ACTION();
+	}
+
+	return out;
+}
+
+void ThreadCachingMemoryPool::free(void* ptr)
+{
+	ANKI_ASSERT(isCreated());
+	ANKI_ASSERT(ptr);
+
+	SpanHeader* span = numberToPtr<SpanHeader*>(getAlignedRoundDown(SPAN_SIZE, ptrToNumber(ptr)));
+	ANKI_ASSERT(span->m_pool == this && "Freeing memory of another pool");
+
+	ThreadCache& cache = getThreadCache();
+
+	if(span->m_classIdx != MAX_U32)
+	{
+		const U32 classIdx = span->m_classIdx;
+		invalidateMemory(ptr, m_classSizes[classIdx]);
+
+		ThreadCache::List& list = cache.m_lists[classIdx];
+		FreeBlock* block = static_cast<FreeBlock*>(ptr);
+		block->m_next = list.m_head;
+		list.m_head = block;
+		++list.m_count;
+
+		if(ANKI_UNLIKELY(list.m_count > m_classBatchSizes[classIdx] * 2))
+		{
+			releaseBatch(cache, classIdx);
+		}
+	}
+	else
+	{
+		m_allocCb(m_allocCbUserData, span->m_allocation, 0, 0);
+	}
+
+	cache.incrementAllocationsCount(-1);
+}
+
+U32 ThreadCachingMemoryPool::getAllocationsCount() const
+{
+	I32 count = 0;
+	for(const ThreadCache* cache = m_threadCaches.load(AtomicMemoryOrder::ACQUIRE); cache; cache = cache->m_next)
+	{
+		count += cache->m_allocationsCount.load();
+	}
+
+	// Memory allocated by one thread and freed by another makes the counters of single threads negative but the sum
+	// can only be negative if the counters are read while they change
+	return U32(max<I32>(0, count));
+}
+
+void ThreadCachingMemoryPool::fetchBatch(ThreadCache& cache, U32 classIdx)
+{
+	CentralList& central = m_centralLists[classIdx];
+	ThreadCache::List& list = cache.m_lists[classIdx];
+	const U32 classSize = m_classSizes[classIdx];
+	const U32 batchSize = m_classBatchSizes[classIdx];
+
+	LockGuard<SpinLock> lock(central.m_lock);
+
+	while(list.m_count < batchSize)
+	{
+		FreeBlock* block;
+		if(central.m_head)
+		{
+			block = central.m_head;
+			central.m_head = block->m_next;
+		}
+		else
+		{
+			if(central.m_carveBegin + classSize > central.m_carveEnd)
+			{
+				// Need a new span
+				SpanHeader* span = static_cast<SpanHeader*>(newSpan());
+				if(ANKI_UNLIKELY(!span))
+				{
+					break;
+				}
+
+				span->m_classIdx = classIdx;
+
+				central.m_carveBegin = reinterpret_cast<U8*>(span) + SPAN_HEADER_SIZE;
+				central.m_carveEnd = reinterpret_cast<U8*>(span) + SPAN_SIZE;
+			}
+
+			block = reinterpret_cast<FreeBlock*>(central.m_carveBegin);
+			central.m_carveBegin += classSize;
+		}
+
+		block->m_next = list.m_head;
+		list.m_head = block;
+		++list.m_count;
+	}
+}
+
+void ThreadCachingMemoryPool::releaseBatch(ThreadCache& cache, U32 classIdx)
+{
+	ThreadCache::List& list = cache.m_lists[classIdx];
+	const U32 batchSize = m_classBatchSizes[classIdx];
+	ANKI_ASSERT(list.m_count > batchSize);
+
+	// Detach the first blocks of the list
+	FreeBlock* first = list.m_head;
+	FreeBlock* last = first;
+	for(U32 i = 1; i < batchSize; ++i)
+	{
+		last = last->m_next;
+	}
+
+	list.m_head = last->m_next;
+	list.m_count -= batchSize;
+
+	// Give them to the central list
+	CentralList& central = m_centralLists[classIdx];
+	LockGuard<SpinLock> lock(central.m_lock);
+	last->m_next = central.m_head;
+	central.m_head = first;
+}
+
+void* ThreadCachingMemoryPool::newSpan()
+{
+	LockGuard<SpinLock> lock(m_spansLock);
+
+	void* allocation = nullptr;
+	if(m_spansBegin == m_spansEnd)
+	{
+		m_spansBegin = static_cast<U8*>(allocateSpanAligned(SPAN_SIZE * SPANS_PER_ALLOCATION, allocation));
+		if(ANKI_UNLIKELY(!m_spansBegin))
+		{
+			m_spansEnd = nullptr;
+			return nullptr;
+		}
+
+		m_spansEnd = m_spansBegin + SPAN_SIZE * SPANS_PER_ALLOCATION;
+	}
+
+	SpanHeader* span = reinterpret_cast<SpanHeader*>(m_spansBegin);
+	m_spansBegin += SPAN_SIZE;
+
+	span->m_pool = this;
+	span->m_allocation = allocation;
+	span->m_nextAllocation = nullptr;
+	span->m_classIdx = MAX_U32;
+
+	if(allocation)
+	{
+		span->m_nextAllocation = m_spanAllocations;
+		m_spanAllocations = span;
+	}
+
+	m_spanCount.fetchAdd(1);
+	return span;
+}
+
+void* ThreadCachingMemoryPool::allocateSpanAligned(PtrSize size, void*& allocation)
+{
+	// The callbacks might not support big alignments (the App's doesn't) so over-allocate and align by hand. Only the
+	// pages that are touched cost memory
+	allocation = m_allocCb(
+		m_allocCbUserData, nullptr, size + SPAN_SIZE - MAX_SMALL_ALLOCATION_ALIGNMENT, MAX_SMALL_ALLOCATION_ALIGNMENT);
+	if(ANKI_UNLIKELY(!allocation))
+	{
+		return nullptr;
+	}
+
+	ANKI_ASSERT(isAligned(MAX_SMALL_ALLOCATION_ALIGNMENT, allocation));
+	return numberToPtr<void*>(getAlignedRoundUp(SPAN_SIZE, ptrToNumber(allocation)));
+}
+
+void* ThreadCachingMemoryPool::allocateLarge(PtrSize size, PtrSize alignment)
+{
+	ANKI_ASSERT(alignment < SPAN_SIZE);
+
+	// Start at a span aligned address to be able to find the header on free
+	const PtrSize offset = max<PtrSize>(SPAN_HEADER_SIZE, alignment);
+	void* allocation;
+	void* mem = allocateSpanAligned(size + offset, allocation);
+	if(ANKI_UNLIKELY(!mem))
+	{
+		return nullptr;
+	}
+
+	SpanHeader* span = static_cast<SpanHeader*>(mem);
+	span->m_pool = this;
+	span->m_allocation = allocation;
+	span->m_nextAllocation = nullptr;
+	span->m_classIdx = MAX_U32;
+
+	return static_cast<U8*>(mem) + offset;
+}
+
 } // end namespace anki
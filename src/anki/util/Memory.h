@@ -49,7 +49,7 @@ using AllocationSignature = U32;
 ///         returns nullptr
 void* allocAligned(void* userData, void* ptr, PtrSize size, PtrSize alignment);
 
-/// Generic memory pool. The base of HeapMemoryPool or StackMemoryPool or ChainMemoryPool.
+/// Generic memory pool. The base of HeapMemoryPool or StackMemoryPool or ChainMemoryPool or ThreadCachingMemoryPool.
 class BaseMemoryPool : public NonCopyable
 {
 public:
@@ -59,7 +59,8 @@ public:
 		NONE,
 		HEAP,
 		STACK,
-		CHAIN
+		CHAIN,
+		THREAD_CACHING
 	};
 
 	BaseMemoryPool(Type type)
@@ -104,10 +105,7 @@ public:
 	}
 
 	/// Return number of allocations
-	U32 getAllocationsCount() const
-	{
-		return m_allocationsCount.load();
-	}
+	U32 getAllocationsCount() const;
 
 protected:
 	/// User allocation function.
@@ -184,15 +182,18 @@ public:
 	/// @param ignoreDeallocationErrors Method free() may fail if the ptr is not in the top of the stack. Set that to
 	///        true to suppress such errors
 	/// @param alignmentBytes The maximum supported alignment for returned memory
+	/// @param threadSafe If false the pool should be used by a single thread at a time. The allocations then don't use
+	///        atomic read-modify-write operations.
 	void create(AllocAlignedCallback allocCb,
 		void* allocCbUserData,
 		PtrSize initialChunkSize,
 		F32 nextChunkScale = 2.0,
 		PtrSize nextChunkBias = 0,
 		Bool ignoreDeallocationErrors = true,
-		PtrSize alignmentBytes = ANKI_SAFE_ALIGNMENT);
+		PtrSize alignmentBytes = ANKI_SAFE_ALIGNMENT,
+		Bool threadSafe = true);
 
-	/// Allocate aligned memory. The operation is thread safe
+	/// Allocate aligned memory. The operation is thread safe if the pool was created thread safe
 	/// @param size The size to allocate
 	/// @param alignmentBytes The alignment of the returned address
 	/// @return The allocated memory or nullptr on failure
@@ -208,6 +209,9 @@ public:
 	/// Get the current capacity of the pool. It's not thread safe.
 	PtrSize getMemoryCapacity() const;
 
+	/// Get the memory that was allocated since the last reset. It's not thread safe.
+	PtrSize getMemoryUsed() const;
+
 private:
 	/// The memory chunk.
 	class Chunk
@@ -254,6 +258,9 @@ private:
 	/// Ignore deallocation errors.
 	Bool8 m_ignoreDeallocationErrors = false;
 
+	/// Use atomic read-modify-write operations.
+	Bool8 m_threadSafe = true;
+
 	/// The current chunk. Chose the more strict memory order to avoid compiler
 	/// re-ordering of instructions
 	Atomic<U32, AtomicMemoryOrder::SEQ_CST> m_crntChunkIdx = {0};
@@ -268,6 +275,108 @@ private:
 	Mutex m_lock;
 };
 
+/// A general purpose pool that serves small allocations from per-thread caches. It's an alternative to HeapMemoryPool
+/// for allocations that happen from many threads at the same time. Small allocations are rounded up to a number of
+/// size classes. Every thread has its own free lists of those classes and it doesn't need any atomic operation or lock
+/// to allocate or free. The threads exchange blocks with a central cache in batches. The central cache carves the
+/// blocks from big spans that it gets from the allocation callback. Large allocations go to the callback directly.
+/// The callback is never asked for alignment bigger than MAX_SMALL_ALLOCATION_ALIGNMENT.
+/// @note The spans are not given back to the allocation callback before the pool is destroyed.
+class ThreadCachingMemoryPool : public BaseMemoryPool
+{
+public:
+	/// The size of the big chunks of memory that the pool gets from the allocation callback.
+	static const PtrSize SPAN_SIZE = 128 * 1024;
+
+	/// Allocations bigger than that will use the allocation callback.
+	static const PtrSize MAX_SMALL_ALLOCATION_SIZE = 16 * 1024;
+
+	/// Small allocations can't have bigger alignment than that.
+	static const PtrSize MAX_SMALL_ALLOCATION_ALIGNMENT = 64;
+
+	/// How many spans are taken from the allocation callback at once.
+	static const U32 SPANS_PER_ALLOCATION = 8;
+
+	/// Default constructor.
+	ThreadCachingMemoryPool();
+
+	/// Destroy
+	~ThreadCachingMemoryPool() final;
+
+	/// The real constructor.
+	/// @param allocCb The allocation function callback
+	/// @param allocCbUserData The user data to pass to the allocation function
+	void create(AllocAlignedCallback allocCb, void* allocCbUserData);
+
+	/// Allocate memory. It's thread safe.
+	void* allocate(PtrSize size, PtrSize alignment);
+
+	/// Free memory. It's thread safe.
+	/// @param[in, out] ptr Memory block to deallocate.
+	void free(void* ptr);
+
+	/// Get the number of live allocations. It sums the counters of all the threads so the result might be a bit behind
+	/// if other threads allocate at the same time.
+	U32 getAllocationsCount() const;
+
+	/// Get the memory of the spans that the small allocations use.
+	PtrSize getSpansMemory() const
+	{
+		return m_spanCount.load() * SPAN_SIZE;
+	}
+
+private:
+	class FreeBlock;
+	class SpanHeader;
+	class ThreadCache;
+	class CentralList;
+
+	static const U32 CLASS_COUNT = 40;
+	static const U32 CLASS_GRANULARITY = 16;
+
+	U64 m_uuid = 0; ///< Identifies the pool in the thread local storage.
+	Array<U32, CLASS_COUNT> m_classSizes;
+	Array<U32, CLASS_COUNT> m_classBatchSizes; ///< How many blocks move between the caches at once.
+	Array<U8, MAX_SMALL_ALLOCATION_SIZE / CLASS_GRANULARITY> m_sizeToClass;
+
+	CentralList* m_centralLists = nullptr;
+
+	/// All the thread caches of the pool.
+	Atomic<ThreadCache*> m_threadCaches = {nullptr};
+	Mutex m_threadCachesMtx;
+
+	/// The spans that are not given to any size class yet.
+	SpinLock m_spansLock;
+	U8* m_spansBegin = nullptr;
+	U8* m_spansEnd = nullptr;
+	SpanHeader* m_spanAllocations = nullptr; ///< The first spans of all the span allocations.
+
+	Atomic<U32> m_spanCount = {0};
+
+	/// Get the cache of the calling thread.
+	ThreadCache& getThreadCache();
+
+	/// Find the cache of the calling thread or create a new one.
+	ThreadCache* findOrCreateThreadCache();
+
+	/// Get an unused span. It's aligned to SPAN_SIZE.
+	void* newSpan();
+
+	/// Allocate from the callback a block that starts at a SPAN_SIZE aligned address.
+	/// @param[out] allocation What the callback returned. Give that to the callback to free the memory.
+	void* allocateSpanAligned(PtrSize size, void*& allocation);
+
+	U32 computeClass(PtrSize size, PtrSize alignment) const;
+
+	/// Move a batch from the central cache to a thread cache.
+	void fetchBatch(ThreadCache& cache, U32 classIdx);
+
+	/// Move a batch from a thread cache to the central cache.
+	void releaseBatch(ThreadCache& cache, U32 classIdx);
+
+	void* allocateLarge(PtrSize size, PtrSize alignment);
+};
+
 /// Chain memory pool. Almost similar to StackMemoryPool but more flexible and at the same time a bit slower.
 class ChainMemoryPool : public BaseMemoryPool
 {
@@ -0,0 +1,312 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/util/RadixSort.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/Functions.h>
+#include <cstring>
+
+namespace anki
+{
+
+static const U32 RADIX_BITS = 8;
+static const U32 BUCKET_COUNT = 1 << RADIX_BITS;
+static const U32 PASS_COUNT = 64 / RADIX_BITS;
+
+/// Don't split the work into chunks smaller than that.
+static const U32 MIN_KEYS_PER_CHUNK = 1024 * 4;
+
+static U32 getDigit(U64 key, U32 pass)
+{
+	return (key >> (pass * RADIX_BITS)) & (BUCKET_COUNT - 1);
+}
+
+void radixSort(WeakArray<RadixSortKey> keys, WeakArray<RadixSortKey> scratch)
+{
+	const U32 count = keys.getSize();
+	ANKI_ASSERT(scratch.getSize() >= count);
+	if(count < 2)
+	{
+		return;
+	}
+
+	// Compute the histograms of all passes in one go
+	Array2d<U32, PASS_COUNT, BUCKET_COUNT> histograms;
+	zeroMemory(histograms);
+	for(const RadixSortKey& k : keys)
+	{
+		for(U32 pass = 0; pass < PASS_COUNT; ++pass)
+		{
+			++histograms[pass][getDigit(k.m_key, pass)];
+		}
+	}
+
+	RadixSortKey* src = &keys[0];
+	RadixSortKey* dst = &scratch[0];
+	for(U32 pass = 0; pass < PASS_COUNT; ++pass)
+	{
+		// Skip the pass if all the keys share the same digit
+		if(histograms[pass][getDigit(src[0].m_key, pass)] == count)
+		{
+			continue;
+		}
+
+		Array<U32, BUCKET_COUNT> offsets;
+		U32 offset = 0;
+		for(U32 b = 0; b < BUCKET_COUNT; ++b)
+		{
+			offsets[b] = offset;
+			offset += histograms[pass][b];
+		}
+
+		for(U32 i = 0; i < count; ++i)
+		{
+			dst[offsets[getDigit(src[i].m_key, pass)]++] = src[i];
+		}
+
+		std::swap(src, dst);
+	}
+
+	if(src != &keys[0])
+	{
+		memcpy(&keys[0], src, sizeof(RadixSortKey) * count);
+	}
+}
+
+/// The shared state of radixSortParallel.
+class RadixSortParallelContext
+{
+public:
+	static const U32 MAX_CHUNKS = ThreadHive::MAX_THREADS;
+
+	GenericMemoryPoolAllocator<U8> m_alloc;
+	RadixSortKey* m_keys;
+	RadixSortKey* m_src;
+	RadixSortKey* m_dst;
+	U32 m_count;
+	U32 m_chunkCount;
+	U32 m_chunkSize;
+	U32 m_pass;
+
+	Array2d<U32, MAX_CHUNKS, BUCKET_COUNT> m_chunkHistograms;
+	Atomic<U32> m_pendingTasks;
+
+	RadixSortDoneCallback m_doneCallback;
+	void* m_doneCallbackUserData;
+
+	class ChunkTask
+	{
+	public:
+		RadixSortParallelContext* m_ctx;
+		U32 m_chunk;
+	};
+
+	ChunkTask* m_chunkTasks;
+
+	void getChunkRange(U32 chunk, U32& begin, U32& end) const
+	{
+		begin = chunk * m_chunkSize;
+		end = min(begin + m_chunkSize, m_count);
+	}
+
+	void submitHistogramTasks(ThreadHive& hive);
+	void submitScatterTasks(ThreadHive& hive);
+
+	/// Called by the last histogram task.
+	void histogramsDone(ThreadHive& hive);
+
+	/// Called when a pass is done or skipped.
+	void passDone(ThreadHive& hive);
+
+	void computeHistogram(U32 chunk);
+	void scatter(U32 chunk);
+};
+
+void RadixSortParallelContext::submitHistogramTasks(ThreadHive& hive)
+{
+	m_pendingTasks.store(m_chunkCount);
+
+	Array<ThreadHiveTask, MAX_CHUNKS> tasks;
+	for(U32 c = 0; c < m_chunkCount; ++c)
+	{
+		tasks[c] = ANKI_THREAD_HIVE_TASK(
+			{
+				RadixSortParallelContext& ctx = *self->m_ctx;
+				ctx.computeHistogram(self->m_chunk);
+
+				if(ctx.m_pendingTasks.fetchSub(1, AtomicMemoryOrder::ACQ_REL) == 1)
+				{
+					ctx.histogramsDone(hive);
+				}
+			},
+			&m_chunkTasks[c],
+			nullptr,
+			nullptr);
+	}
+
+	hive.submitTasks(&tasks[0], m_chunkCount);
+}
+
+void RadixSortParallelContext::submitScatterTasks(ThreadHive& hive)
+{
+	m_pendingTasks.store(m_chunkCount);
+
+	Array<ThreadHiveTask, MAX_CHUNKS> tasks;
+	for(U32 c = 0; c < m_chunkCount; ++c)
+	{
+		tasks[c] = ANKI_THREAD_HIVE_TASK(
+			{
+				RadixSortParallelContext& ctx = *self->m_ctx;
+				ctx.scatter(self->m_chunk);
+
+				if(ctx.m_pendingTasks.fetchSub(1, AtomicMemoryOrder::ACQ_REL) == 1)
+				{
+					std::swap(ctx.m_src, ctx.m_dst);
+					ctx.passDone(hive);
+				}
+			},
+			&m_chunkTasks[c],
+			nullptr,
+			nullptr);
+	}
+
+	hive.submitTasks(&tasks[0], m_chunkCount);
+}
+
+void RadixSortParallelContext::histogramsDone(ThreadHive& hive)
+{
+	// Skip the pass if all the keys share the same digit
+	const U32 digit = getDigit(m_src[0].m_key, m_pass);
+	U32 digitCount = 0;
+	for(U32 c = 0; c < m_chunkCount; ++c)
+	{
+		digitCount += m_chunkHistograms[c][digit];
+	}
+
+	if(digitCount == m_count)
+	{
+		passDone(hive);
+	}
+	else
+	{
+		submitScatterTasks(hive);
+	}
+}
+
+void RadixSortParallelContext::passDone(ThreadHive& hive)
+{
+	++m_pass;
+	if(m_pass < PASS_COUNT)
+	{
+		submitHistogramTasks(hive);
+		return;
+	}
+
+	// Done
+	if(m_src != m_keys)
+	{
+		memcpy(m_keys, m_src, sizeof(RadixSortKey) * m_count);
+	}
+
+	// Free the context before the callback, the callback might free the memory pool
+	const RadixSortDoneCallback doneCallback = m_doneCallback;
+	void* const doneCallbackUserData = m_doneCallbackUserData;
+	GenericMemoryPoolAllocator<U8> alloc = m_alloc;
+	alloc.deleteArray(m_chunkTasks, m_chunkCount);
+	alloc.deleteInstance(this);
+
+	if(doneCallback)
+	{
+		doneCallback(doneCallbackUserData);
+	}
+}
+
+void RadixSortParallelContext::computeHistogram(U32 chunk)
+{
+	Array<U32, BUCKET_COUNT>& histogram = m_chunkHistograms[chunk];
+	zeroMemory(histogram);
+
+	U32 begin, end;
+	getChunkRange(chunk, begin, end);
+	for(U32 i = begin; i < end; ++i)
+	{
+		++histogram[getDigit(m_src[i].m_key, m_pass)];
+	}
+}
+
+void RadixSortParallelContext::scatter(U32 chunk)
+{
+	// The keys of a digit go after the keys of the smaller digits and after the keys of the same digit that live in
+	// the previous chunks. That keeps the sort stable
+	Array<U32, BUCKET_COUNT> offsets;
+	U32 offset = 0;
+	for(U32 b = 0; b < BUCKET_COUNT; ++b)
+	{
+		for(U32 c = 0; c < m_chunkCount; ++c)
+		{
+			if(c == chunk)
+			{
+				offsets[b] = offset;
+			}
+
+			offset += m_chunkHistograms[c][b];
+		}
+	}
+
+	U32 begin, end;
+	getChunkRange(chunk, begin, end);
+	for(U32 i = begin; i < end; ++i)
+	{
+		m_dst[offsets[getDigit(m_src[i].m_key, m_pass)]++] = m_src[i];
+	}
+}
+
+void radixSortParallel(ThreadHive& hive,
+	GenericMemoryPoolAllocator<U8> alloc,
+	WeakArray<RadixSortKey> keys,
+	WeakArray<RadixSortKey> scratch,
+	RadixSortDoneCallback doneCallback,
+	void* doneCallbackUserData)
+{
+	ANKI_ASSERT(scratch.getSize() >= keys.getSize());
+
+	const U32 maxChunkCount = min<U32>(hive.getThreadCount(), RadixSortParallelContext::MAX_CHUNKS);
+	const U32 chunkCount = min<U32>(maxChunkCount, keys.getSize() / MIN_KEYS_PER_CHUNK);
+
+	if(chunkCount < 2)
+	{
+		// Not worth it
+		radixSort(keys, scratch);
+		if(doneCallback)
+		{
+			doneCallback(doneCallbackUserData);
+		}
+
+		return;
+	}
+
+	RadixSortParallelContext* ctx = alloc.newInstance<RadixSortParallelContext>();
+	ctx->m_alloc = alloc;
+	ctx->m_keys = &keys[0];
+	ctx->m_src = &keys[0];
+	ctx->m_dst = &scratch[0];
+	ctx->m_count = keys.getSize();
+	ctx->m_chunkCount = chunkCount;
+	ctx->m_chunkSize = (ctx->m_count + chunkCount - 1) / chunkCount;
+	ctx->m_pass = 0;
+	ctx->m_doneCallback = doneCallback;
+	ctx->m_doneCallbackUserData = doneCallbackUserData;
+
+	ctx->m_chunkTasks = alloc.newArray<RadixSortParallelContext::ChunkTask>(chunkCount);
+	for(U32 c = 0; c < chunkCount; ++c)
+	{
+		ctx->m_chunkTasks[c].m_ctx = ctx;
+		ctx->m_chunkTasks[c].m_chunk = c;
+	}
+
+	ctx->submitHistogramTasks(hive);
+}
+
+} // end namespace anki
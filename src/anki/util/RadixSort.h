@@ -0,0 +1,55 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#pragma once
+
+#include <anki/util/WeakArray.h>
+#include <anki/util/Allocator.h>
+
+namespace anki
+{
+
+// Forward
+class ThreadHive;
+
+/// @addtogroup util_other
+/// @{
+
+/// An element of the radix sort. It's a 64bit key and the index of the element it was computed from.
+class RadixSortKey
+{
+public:
+	U64 m_key;
+	U32 m_index;
+	U32 _m_padding;
+};
+
+/// Called when radixSortParallel() is done.
+using RadixSortDoneCallback = void (*)(void* userData);
+
+/// Stable LSD radix sort of 64bit keys. It does 8 passes of 8 bits but the passes where all the keys share the same
+/// digit are skipped.
+/// @param[in,out] keys The keys to sort.
+/// @param scratch Scratch memory. Should have the same size as @a keys.
+void radixSort(WeakArray<RadixSortKey> keys, WeakArray<RadixSortKey> scratch);
+
+/// Same as radixSort() but the work is split into ThreadHive tasks. Every pass is a number of histogram tasks followed
+/// by a number of scatter tasks, one for every chunk of the keys. It returns immediately and the last task calls the
+/// @a doneCallback. If the keys are few it sorts them in the calling thread and calls @a doneCallback before returning.
+/// @param hive The hive. It can be called from a task of this hive.
+/// @param alloc The allocator of the state of the sort. The state is freed before @a doneCallback is called.
+/// @param[in,out] keys The keys to sort.
+/// @param scratch Scratch memory. Should have the same size as @a keys.
+/// @param doneCallback Called when the sorting is done. Can be nullptr.
+/// @param doneCallbackUserData The user data of doneCallback.
+void radixSortParallel(ThreadHive& hive,
+	GenericMemoryPoolAllocator<U8> alloc,
+	WeakArray<RadixSortKey> keys,
+	WeakArray<RadixSortKey> scratch,
+	RadixSortDoneCallback doneCallback,
+	void* doneCallbackUserData);
+/// @}
+
+} // end namespace anki
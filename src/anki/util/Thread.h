@@ -149,6 +149,93 @@ private:
 	std::atomic_flag m_lock = ATOMIC_FLAG_INIT;
 };
 
+/// Reader-writer lock. Many readers can hold it at the same time but a writer holds it exclusively.
+class RWMutex : public NonCopyable
+{
+public:
+	RWMutex();
+
+	~RWMutex();
+
+	/// Lock for reading.
+	void lockRead();
+
+	/// Unlock a read lock.
+	void unlockRead();
+
+	/// Lock for writing.
+	void lockWrite();
+
+	/// Unlock a write lock.
+	void unlockWrite();
+
+private:
+	void* m_impl = nullptr; ///< The system native type
+};
+
+/// Reader-writer lock that spins. Like RWMutex but good only for very short critical sections. A waiting writer blocks
+/// new readers so the writers won't starve.
+class RWSpinLock : public NonCopyable
+{
+public:
+	/// Lock for reading.
+	void lockRead()
+	{
+		while(true)
+		{
+			U32 val = m_state.load(std::memory_order_relaxed);
+			if((val & (WRITER_BIT | WRITER_PENDING_BIT)) == 0
+				&& m_state.compare_exchange_weak(val, val + 1, std::memory_order_acquire, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+	}
+
+	/// Unlock a read lock.
+	void unlockRead()
+	{
+		ANKI_ASSERT((m_state.load() & READER_MASK) > 0);
+		m_state.fetch_sub(1, std::memory_order_release);
+	}
+
+	/// Lock for writing.
+	void lockWrite()
+	{
+		while(true)
+		{
+			U32 val = m_state.load(std::memory_order_relaxed);
+			if((val & (WRITER_BIT | READER_MASK)) == 0)
+			{
+				// Nobody holds the lock, try to take it
+				if(m_state.compare_exchange_weak(val, WRITER_BIT, std::memory_order_acquire, std::memory_order_relaxed))
+				{
+					break;
+				}
+			}
+			else if(!(val & WRITER_PENDING_BIT))
+			{
+				// Block new readers
+				m_state.compare_exchange_weak(val, val | WRITER_PENDING_BIT, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	/// Unlock a write lock.
+	void unlockWrite()
+	{
+		ANKI_ASSERT(m_state.load() & WRITER_BIT);
+		m_state.fetch_and(~WRITER_BIT, std::memory_order_release);
+	}
+
+private:
+	static constexpr U32 WRITER_BIT = 1u << 31u;
+	static constexpr U32 WRITER_PENDING_BIT = 1u << 30u;
+	static constexpr U32 READER_MASK = WRITER_PENDING_BIT - 1;
+
+	std::atomic<U32> m_state = {0};
+};
+
 /// Lock guard. When constructed it locks a TMutex and unlocks it when it gets destroyed.
 /// @tparam TMutex Can be Mutex or SpinLock.
 template<typename TMutex>
@@ -185,6 +272,48 @@ private:
 	TMutex* m_mtx;
 };
 
+/// Read lock guard. When constructed it read-locks a TRWMutex and unlocks it when it gets destroyed.
+/// @tparam TRWMutex Can be RWMutex or RWSpinLock.
+template<typename TRWMutex>
+class ReadLockGuard : public NonCopyable
+{
+public:
+	ReadLockGuard(TRWMutex& mtx)
+		: m_mtx(&mtx)
+	{
+		m_mtx->lockRead();
+	}
+
+	~ReadLockGuard()
+	{
+		m_mtx->unlockRead();
+	}
+
+private:
+	TRWMutex* m_mtx;
+};
+
+/// Write lock guard. When constructed it write-locks a TRWMutex and unlocks it when it gets destroyed.
+/// @tparam TRWMutex Can be RWMutex or RWSpinLock.
+template<typename TRWMutex>
+class WriteLockGuard : public NonCopyable
+{
+public:
+	WriteLockGuard(TRWMutex& mtx)
+		: m_mtx(&mtx)
+	{
+		m_mtx->lockWrite();
+	}
+
+	~WriteLockGuard()
+	{
+		m_mtx->unlockWrite();
+	}
+
+private:
+	TRWMutex* m_mtx;
+};
+
 /// A barrier for thread synchronization. It works almost like boost::barrier.
 class Barrier : public NonCopyable
 {
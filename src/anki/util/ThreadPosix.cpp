@@ -185,6 +185,81 @@ void Mutex::unlock()
 	}
 }
 
+RWMutex::RWMutex()
+{
+	pthread_rwlock_t* mtx = static_cast<pthread_rwlock_t*>(malloc(sizeof(pthread_rwlock_t)));
+	if(mtx == nullptr)
+	{
+		ANKI_UTIL_LOGF("Out of memory");
+	}
+
+	I err = pthread_rwlock_init(mtx, nullptr);
+	if(err)
+	{
+		free(mtx);
+		ANKI_UTIL_LOGF("pthread_rwlock_init() failed");
+	}
+
+	m_impl = mtx;
+}
+
+RWMutex::~RWMutex()
+{
+	pthread_rwlock_t* mtx = static_cast<pthread_rwlock_t*>(m_impl);
+	pthread_rwlock_destroy(mtx);
+
+	free(m_impl);
+	m_impl = nullptr;
+}
+
+void RWMutex::lockRead()
+{
+	ANKI_ASSERT(m_impl);
+	pthread_rwlock_t* mtx = static_cast<pthread_rwlock_t*>(m_impl);
+
+	I err = pthread_rwlock_rdlock(mtx);
+	if(err)
+	{
+		ANKI_UTIL_LOGF("pthread_rwlock_rdlock() failed");
+	}
+}
+
+void RWMutex::unlockRead()
+{
+	ANKI_ASSERT(m_impl);
+	pthread_rwlock_t* mtx = static_cast<pthread_rwlock_t*>(m_impl);
+
+	I err = pthread_rwlock_unlock(mtx);
+	if(err)
+	{
+		ANKI_UTIL_LOGF("pthread_rwlock_unlock() failed");
+	}
+}
+
+void RWMutex::lockWrite()
+{
+	ANKI_ASSERT(m_impl);
+	pthread_rwlock_t* mtx = static_cast<pthread_rwlock_t*>(m_impl);
+
+	I err = pthread_rwlock_wrlock(mtx);
+	if(err)
+	{
+		ANKI_UTIL_LOGF("pthread_rwlock_wrlock() failed");
+	}
+}
+
+void RWMutex::unlockWrite()
+{
+	ANKI_ASSERT(m_impl);
+	pthread_rwlock_t* mtx = static_cast<pthread_rwlock_t*>(m_impl);
+
+	I err = pthread_rwlock_unlock(mtx);
+	if(err)
+	{
+		ANKI_UTIL_LOGF("pthread_rwlock_unlock() failed");
+	}
+}
+
 ConditionVariable::ConditionVariable()
 {
 	pthread_cond_t* cond = static_cast<pthread_cond_t*>(malloc(sizeof(pthread_cond_t)));
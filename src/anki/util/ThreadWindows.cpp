@@ -159,6 +159,49 @@ void Mutex::unlock()
 	LeaveCriticalSection(mtx);
 }
 
+RWMutex::RWMutex()
+{
+	SRWLOCK* mtx = reinterpret_cast<SRWLOCK*>(malloc(sizeof(SRWLOCK)));
+	if(mtx == nullptr)
+	{
+		ANKI_UTIL_LOGF("Out of memory");
+	}
+
+	m_impl = mtx;
+
+	InitializeSRWLock(mtx);
+}
+
+RWMutex::~RWMutex()
+{
+	free(m_impl);
+	m_impl = nullptr;
+}
+
+void RWMutex::lockRead()
+{
+	SRWLOCK* mtx = reinterpret_cast<SRWLOCK*>(m_impl);
+	AcquireSRWLockShared(mtx);
+}
+
+void RWMutex::unlockRead()
+{
+	SRWLOCK* mtx = reinterpret_cast<SRWLOCK*>(m_impl);
+	ReleaseSRWLockShared(mtx);
+}
+
+void RWMutex::lockWrite()
+{
+	SRWLOCK* mtx = reinterpret_cast<SRWLOCK*>(m_impl);
+	AcquireSRWLockExclusive(mtx);
+}
+
+void RWMutex::unlockWrite()
+{
+	SRWLOCK* mtx = reinterpret_cast<SRWLOCK*>(m_impl);
+	ReleaseSRWLockExclusive(mtx);
+}
+
 ConditionVariable::ConditionVariable()
 {
 	CONDITION_VARIABLE* cond = reinterpret_cast<CONDITION_VARIABLE*>(malloc(sizeof(CONDITION_VARIABLE)));
@@ -4,6 +4,8 @@
 // http://www.anki3d.org/LICENSE
 
 #include <anki/gr/common/ClassGpuAllocator.h>
+#include <anki/gr/common/ShardedClassGpuAllocator.h>
+#include <anki/util/HighRezTimer.h>
 #include <tests/framework/Framework.h>
 #include <random>
 #include <algorithm>
@@ -37,6 +39,7 @@ public:
 	std::vector<Class> m_classes;
 	PtrSize m_maxSize = 128 * 1024 * 1024;
 	PtrSize m_crntSize = 0;
+	Mutex m_mtx;
 
 	Interface()
 	{
@@ -53,6 +56,7 @@ public:
 	{
 		PtrSize size = m_classes[classIdx].m_clusterSize;
 
+		LockGuard<Mutex> lock(m_mtx);
 		if(m_crntSize + size > m_maxSize)
 		{
 			return Error::OUT_OF_MEMORY;
@@ -74,6 +78,8 @@ public:
 	void free(ClassGpuAllocatorMemory* mem)
 	{
 		Mem* m = static_cast<Mem*>(mem);
+
+		LockGuard<Mutex> lock(m_mtx);
 		m_crntSize -= m->m_size;
 
 		freeAligned(m->m_mem);
@@ -202,4 +208,449 @@ ANKI_TEST(Gr, ClassGpuAllocator)
 	}
 }
 
+static U8* getHandleAddress(const ClassGpuAllocatorHandle& handle)
+{
+	return static_cast<U8*>(static_cast<Mem*>(handle.m_memory)->m_mem) + handle.m_offset;
+}
+
+static Bool handlesEqual(const ClassGpuAllocatorHandle& a, const ClassGpuAllocatorHandle& b)
+{
+	return a.m_memory == b.m_memory && a.m_offset == b.m_offset;
+}
+
+ANKI_TEST(Gr, ShardedClassGpuAllocator)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	Interface iface;
+
+	// Deferred frees and recycling
+	{
+		ShardedClassGpuAllocator calloc;
+		calloc.init(alloc, &iface);
+
+		ClassGpuAllocatorHandle a;
+		ANKI_TEST_EXPECT_NO_ERR(calloc.allocate(100, 16, a));
+		const ClassGpuAllocatorHandle oldA = a;
+		calloc.free(a);
+		ANKI_TEST_EXPECT_EQ(!!a, false);
+
+		// The freed slot can't be reused before the flush
+		ClassGpuAllocatorHandle b;
+		ANKI_TEST_EXPECT_NO_ERR(calloc.allocate(100, 16, b));
+		ANKI_TEST_EXPECT_EQ(handlesEqual(b, oldA), false);
+
+		// After the flush it goes back to the cache of the thread
+		calloc.flushDeferredFrees();
+		ClassGpuAllocatorHandle c;
+		ANKI_TEST_EXPECT_NO_ERR(calloc.allocate(200, 256, c));
+		ANKI_TEST_EXPECT_EQ(handlesEqual(c, oldA), true);
+
+		// Big allocations are not cached
+		ClassGpuAllocatorHandle d;
+		ANKI_TEST_EXPECT_NO_ERR(calloc.allocate(512 * 1024, 16, d));
+
+		calloc.free(b);
+		calloc.free(c);
+		calloc.free(d);
+		calloc.destroy();
+		ANKI_TEST_EXPECT_EQ(iface.m_crntSize, 0);
+	}
+
+	// Many threads. Every thread writes its allocations and checks that nobody else overwrote them
+	{
+		class Ctx
+		{
+		public:
+			ShardedClassGpuAllocator* m_calloc;
+			Barrier* m_barrier;
+			U32 m_threadIdx;
+			Bool m_overlap;
+		};
+
+		const U32 THREAD_COUNT = 8;
+		ShardedClassGpuAllocator calloc;
+		calloc.init(alloc, &iface);
+		Barrier barrier(THREAD_COUNT);
+
+		Array<Ctx, THREAD_COUNT> ctxs;
+		Array<Thread*, THREAD_COUNT> threads;
+		for(U32 i = 0; i < THREAD_COUNT; ++i)
+		{
+			ctxs[i] = {&calloc, &barrier, i, false};
+			threads[i] = alloc.newInstance<Thread>(nullptr);
+			threads[i]->start(&ctxs[i], [](ThreadCallbackInfo& info) -> Error {
+				Ctx& ctx = *static_cast<Ctx*>(info.m_userData);
+				const U32 ALLOC_COUNT = 200;
+				const U32 FRAME_COUNT = 10;
+
+				for(U32 frame = 0; frame < FRAME_COUNT; ++frame)
+				{
+					Array<ClassGpuAllocatorHandle, ALLOC_COUNT> handles;
+					Array<PtrSize, ALLOC_COUNT> sizes;
+					for(U32 i = 0; i < ALLOC_COUNT; ++i)
+					{
+						handles[i] = {};
+						sizes[i] = 32 << ((i + ctx.m_threadIdx) % 8);
+						ANKI_CHECK(ctx.m_calloc->allocate(sizes[i], 16, handles[i]));
+						memset(getHandleAddress(handles[i]), I32(ctx.m_threadIdx + 1), sizes[i]);
+					}
+
+					ctx.m_barrier->wait();
+
+					for(U32 i = 0; i < ALLOC_COUNT; ++i)
+					{
+						const U8* addr = getHandleAddress(handles[i]);
+						for(PtrSize j = 0; j < sizes[i]; ++j)
+						{
+							ctx.m_overlap = ctx.m_overlap || addr[j] != ctx.m_threadIdx + 1;
+						}
+
+						ctx.m_calloc->free(handles[i]);
+					}
+
+					// End of the frame
+					ctx.m_barrier->wait();
+					if(ctx.m_threadIdx == 0)
+					{
+						ctx.m_calloc->flushDeferredFrees();
+					}
+					ctx.m_barrier->wait();
+				}
+
+				return Error::NONE;
+			});
+		}
+
+		for(U32 i = 0; i < THREAD_COUNT; ++i)
+		{
+			ANKI_TEST_EXPECT_NO_ERR(threads[i]->join());
+			alloc.deleteInstance(threads[i]);
+			ANKI_TEST_EXPECT_EQ(ctxs[i].m_overlap, false);
+		}
+
+		calloc.destroy();
+		ANKI_TEST_EXPECT_EQ(iface.m_crntSize, 0);
+	}
+}
+
+/// An allocation of the compaction tests. It has a unique tag written in its memory.
+class TaggedAllocation
+{
+public:
+	ClassGpuAllocatorHandle m_handle;
+	U32 m_tag;
+};
+
+static Bool moveTaggedAllocation(
+	const ClassGpuAllocatorHandle& oldHandle, const ClassGpuAllocatorHandle& newHandle, void* userData)
+{
+	std::vector<TaggedAllocation>& allocs = *static_cast<std::vector<TaggedAllocation>*>(userData);
+	for(TaggedAllocation& a : allocs)
+	{
+		if(handlesEqual(a.m_handle, oldHandle))
+		{
+			memcpy(getHandleAddress(newHandle), getHandleAddress(oldHandle), sizeof(U32));
+			a.m_handle = newHandle;
+			return true;
+		}
+	}
+
+	ANKI_TEST_EXPECT_EQ(0, 1); // Moving something that wasn't allocated
+	return false;
+}
+
+static Bool taggedAllocationsIntact(const std::vector<TaggedAllocation>& allocs)
+{
+	for(const TaggedAllocation& a : allocs)
+	{
+		U32 tag;
+		memcpy(&tag, getHandleAddress(a.m_handle), sizeof(tag));
+		if(tag != a.m_tag)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ANKI_TEST(Gr, ClassGpuAllocatorCompaction)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	Interface iface;
+	std::mt19937 gen(0);
+	U32 nextTag = 1;
+
+	auto allocateTagged = [&](ClassGpuAllocator& calloc, PtrSize size, std::vector<TaggedAllocation>& allocs) {
+		TaggedAllocation a;
+		a.m_tag = nextTag++;
+		ANKI_TEST_EXPECT_NO_ERR(calloc.allocate(size, 16, a.m_handle));
+		memcpy(getHandleAddress(a.m_handle), &a.m_tag, sizeof(a.m_tag));
+		allocs.push_back(a);
+	};
+
+	// Streaming trace: fill a class, free most of it randomly and compact
+	{
+		ClassGpuAllocator calloc;
+		calloc.init(alloc, &iface);
+		const U classIdx = calloc.getClassIndex(4 * 1024, 16);
+		const U32 CHUNK_COUNT = 20;
+		const U32 SLOTS_PER_CHUNK = 64;
+
+		std::vector<TaggedAllocation> allocs;
+		for(U32 i = 0; i < CHUNK_COUNT * SLOTS_PER_CHUNK; ++i)
+		{
+			allocateTagged(calloc, 4 * 1024, allocs);
+		}
+
+		std::shuffle(allocs.begin(), allocs.end(), gen);
+		while(allocs.size() > CHUNK_COUNT * SLOTS_PER_CHUNK / 8)
+		{
+			calloc.free(allocs.back().m_handle);
+			allocs.pop_back();
+		}
+
+		ClassGpuAllocatorClassStats stats;
+		calloc.getClassStats(classIdx, 0.5f, stats);
+		ANKI_TEST_EXPECT_EQ(stats.m_slotsPerChunk, SLOTS_PER_CHUNK);
+		ANKI_TEST_EXPECT_EQ(stats.m_usedSlotCount, allocs.size());
+		ANKI_TEST_EXPECT_EQ(stats.m_chunkCount, CHUNK_COUNT);
+		ANKI_TEST_EXPECT_EQ(stats.m_sparseChunkCount, CHUNK_COUNT);
+		ANKI_TEST_EXPECT_GT(stats.getFragmentation(), 0.8f);
+
+		// No time, nothing moves
+		ClassGpuAllocatorCompactionStats compactionStats;
+		calloc.compact(0.5f, 0.0, moveTaggedAllocation, &allocs, compactionStats);
+		ANKI_TEST_EXPECT_EQ(compactionStats.m_moveCount, 0);
+		ANKI_TEST_EXPECT_EQ(compactionStats.m_outOfTime, true);
+
+		// The owner refuses to move, nothing is released
+		calloc.compact(0.5f,
+			10.0,
+			[](const ClassGpuAllocatorHandle&, const ClassGpuAllocatorHandle&, void*) -> Bool { return false; },
+			nullptr,
+			compactionStats);
+		ANKI_TEST_EXPECT_EQ(compactionStats.m_moveCount, 0);
+		ANKI_TEST_EXPECT_EQ(compactionStats.m_releasedChunkCount, 0);
+		ANKI_TEST_EXPECT_EQ(compactionStats.m_outOfTime, false);
+		ANKI_TEST_EXPECT_EQ(taggedAllocationsIntact(allocs), true);
+
+		// Compact for real
+		const PtrSize memBefore = iface.m_crntSize;
+		calloc.compact(0.5f, 10.0, moveTaggedAllocation, &allocs, compactionStats);
+		ANKI_TEST_EXPECT_EQ(compactionStats.m_outOfTime, false);
+		ANKI_TEST_EXPECT_GT(compactionStats.m_releasedChunkCount, 0);
+		ANKI_TEST_EXPECT_EQ(taggedAllocationsIntact(allocs), true);
+
+		calloc.getClassStats(classIdx, 0.5f, stats);
+		const U32 minChunkCount = (allocs.size() + SLOTS_PER_CHUNK - 1) / SLOTS_PER_CHUNK;
+		ANKI_TEST_EXPECT_LEQ(stats.m_chunkCount, minChunkCount + 1);
+		ANKI_TEST_EXPECT_EQ(stats.m_usedSlotCount, allocs.size());
+		ANKI_TEST_EXPECT_EQ(iface.m_crntSize, memBefore - compactionStats.m_releasedChunkCount * 256 * 1024);
+
+		for(TaggedAllocation& a : allocs)
+		{
+			calloc.free(a.m_handle);
+		}
+		ANKI_TEST_EXPECT_EQ(iface.m_crntSize, 0);
+	}
+
+	// Random trace of mixed sizes with a compaction of a small budget every frame
+	{
+		ClassGpuAllocator calloc;
+		calloc.init(alloc, &iface);
+		std::vector<TaggedAllocation> allocs;
+		std::uniform_int_distribution<U32> sizeDis(4, 15);
+
+		PtrSize peakMem = 0;
+		for(U32 frame = 0; frame < 190; ++frame)
+		{
+			// Allocate a lot in the first frames and then free more than allocating. Some stragglers stay
+			const U32 allocCount = (frame < 100) ? 64 : 8;
+			for(U32 i = 0; i < allocCount; ++i)
+			{
+				allocateTagged(calloc, PtrSize(1) << sizeDis(gen), allocs);
+			}
+
+			std::shuffle(allocs.begin(), allocs.end(), gen);
+			const U32 freeCount = (frame < 100) ? 32 : 40;
+			for(U32 i = 0; i < freeCount; ++i)
+			{
+				calloc.free(allocs.back().m_handle);
+				allocs.pop_back();
+			}
+
+			peakMem = max(peakMem, iface.m_crntSize);
+
+			ClassGpuAllocatorCompactionStats compactionStats;
+			calloc.compact(0.25f, 0.0005, moveTaggedAllocation, &allocs, compactionStats);
+			ANKI_TEST_EXPECT_EQ(taggedAllocationsIntact(allocs), true);
+		}
+
+		// The memory shouldn't stay at the peak
+		ANKI_TEST_EXPECT_LT(iface.m_crntSize, peakMem / 2);
+
+		for(TaggedAllocation& a : allocs)
+		{
+			calloc.free(a.m_handle);
+		}
+		ANKI_TEST_EXPECT_EQ(iface.m_crntSize, 0);
+	}
+}
+
+/// ClassGpuAllocator as is. Every allocation and free locks the class.
+class PlainAllocatorBench
+{
+public:
+	ClassGpuAllocator m_calloc;
+
+	void init(HeapAllocator<U8> alloc, Interface* iface)
+	{
+		m_calloc.init(alloc, iface);
+	}
+
+	Error allocate(PtrSize size, ClassGpuAllocatorHandle& handle)
+	{
+		return m_calloc.allocate(size, 16, handle);
+	}
+
+	void free(ClassGpuAllocatorHandle& handle)
+	{
+		m_calloc.free(handle);
+	}
+
+	void endFrame()
+	{
+	}
+
+	void destroy()
+	{
+	}
+};
+
+class ShardedAllocatorBench
+{
+public:
+	ShardedClassGpuAllocator m_calloc;
+
+	void init(HeapAllocator<U8> alloc, Interface* iface)
+	{
+		m_calloc.init(alloc, iface);
+	}
+
+	Error allocate(PtrSize size, ClassGpuAllocatorHandle& handle)
+	{
+		return m_calloc.allocate(size, 16, handle);
+	}
+
+	void free(ClassGpuAllocatorHandle& handle)
+	{
+		m_calloc.free(handle);
+	}
+
+	void endFrame()
+	{
+		m_calloc.flushDeferredFrees();
+	}
+
+	void destroy()
+	{
+		m_calloc.destroy();
+	}
+};
+
+/// Every thread allocates a number of small buffers and frees them, like the resource loading and the transient
+/// allocations do. Returns the time of the slowest thread.
+template<typename TAllocator>
+static Second benchClassGpuAllocator(U32 threadCount)
+{
+	static const U32 FRAME_COUNT = 64;
+	static const U32 ALLOCS_PER_FRAME = 64;
+
+	class Ctx
+	{
+	public:
+		TAllocator* m_calloc;
+		Barrier* m_barrier;
+		U32 m_threadIdx;
+		Second m_time;
+	};
+
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	Interface iface;
+	TAllocator calloc;
+	calloc.init(alloc, &iface);
+	Barrier barrier(threadCount);
+
+	DynamicArrayAuto<Thread*> threads(alloc);
+	DynamicArrayAuto<Ctx> ctxs(alloc);
+	threads.create(threadCount);
+	ctxs.create(threadCount);
+
+	for(U32 i = 0; i < threadCount; ++i)
+	{
+		ctxs[i] = {&calloc, &barrier, i, 0.0};
+		threads[i] = alloc.newInstance<Thread>(nullptr);
+		threads[i]->start(&ctxs[i], [](ThreadCallbackInfo& info) -> Error {
+			Ctx& ctx = *static_cast<Ctx*>(info.m_userData);
+			Array<ClassGpuAllocatorHandle, ALLOCS_PER_FRAME> handles;
+
+			ctx.m_barrier->wait();
+
+			HighRezTimer timer;
+			timer.start();
+			for(U32 frame = 0; frame < FRAME_COUNT; ++frame)
+			{
+				for(U32 i = 0; i < ALLOCS_PER_FRAME; ++i)
+				{
+					handles[i] = {};
+					ANKI_CHECK(ctx.m_calloc->allocate(64 << ((i + frame) % 7), handles[i]));
+				}
+
+				for(U32 i = 0; i < ALLOCS_PER_FRAME; ++i)
+				{
+					ctx.m_calloc->free(handles[i]);
+				}
+
+				ctx.m_barrier->wait();
+				if(ctx.m_threadIdx == 0)
+				{
+					ctx.m_calloc->endFrame();
+				}
+				ctx.m_barrier->wait();
+			}
+			timer.stop();
+
+			ctx.m_time = timer.getElapsedTime();
+			return Error::NONE;
+		});
+	}
+
+	Second maxTime = 0.0;
+	for(U32 i = 0; i < threadCount; ++i)
+	{
+		ANKI_TEST_EXPECT_NO_ERR(threads[i]->join());
+		alloc.deleteInstance(threads[i]);
+		maxTime = max(maxTime, ctxs[i].m_time);
+	}
+
+	calloc.destroy();
+	ANKI_TEST_EXPECT_EQ(iface.m_crntSize, 0);
+	return maxTime;
+}
+
+ANKI_TEST(Gr, ClassGpuAllocatorContentionBench)
+{
+	for(U32 threadCount = 2; threadCount <= 16; threadCount *= 2)
+	{
+		const Second plainTime = benchClassGpuAllocator<PlainAllocatorBench>(threadCount);
+		const Second shardedTime = benchClassGpuAllocator<ShardedAllocatorBench>(threadCount);
+
+		ANKI_TEST_LOGI("GPU allocations with %2u threads: ClassGpuAllocator %f ShardedClassGpuAllocator %f",
+			threadCount,
+			plainTime,
+			shardedTime);
+	}
+}
+
 } // end namespace anki
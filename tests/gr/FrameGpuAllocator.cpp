@@ -0,0 +1,139 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/gr/common/FrameGpuAllocator.h>
+#include <anki/util/ThreadHive.h>
+#include <tests/framework/Framework.h>
+#include <algorithm>
+#include <vector>
+
+namespace anki
+{
+
+ANKI_TEST(Gr, FrameGpuAllocator)
+{
+	const PtrSize ALIGNMENT = 256;
+
+	// A heavy frame borrows the space of the light frames
+	{
+		const PtrSize SIZE = 1024 * ALIGNMENT;
+		FrameGpuAllocator alloc;
+		alloc.init(SIZE, ALIGNMENT, MAX_PTR_SIZE, 0);
+
+		PtrSize offset;
+		ANKI_TEST_EXPECT_NO_ERR(alloc.allocate(SIZE / 2, offset));
+		ANKI_TEST_EXPECT_NO_ERR(alloc.allocate(SIZE / 4, offset));
+		ANKI_TEST_EXPECT_EQ(offset, SIZE / 2);
+		ANKI_TEST_EXPECT_EQ(alloc.endFrame(), SIZE / 4);
+		ANKI_TEST_EXPECT_EQ(alloc.getFrameHighWaterMark(), SIZE * 3 / 4);
+
+		// The memory of the heavy frame is not reclaimed while it's in flight
+		for(U i = 1; i < MAX_FRAMES_IN_FLIGHT; ++i)
+		{
+			ANKI_TEST_EXPECT_ANY_ERR(alloc.allocate(SIZE / 2, offset));
+			ANKI_TEST_EXPECT_EQ(offset, MAX_PTR_SIZE);
+			ANKI_TEST_EXPECT_NO_ERR(alloc.allocate(ALIGNMENT, offset));
+			alloc.endFrame();
+		}
+
+		// Now it is. The allocation that doesn't fit before the end of the buffer wraps around
+		ANKI_TEST_EXPECT_NO_ERR(alloc.allocate(SIZE / 2, offset));
+		ANKI_TEST_EXPECT_EQ(offset, 0);
+		ANKI_TEST_EXPECT_EQ(alloc.getHighWaterMark(), SIZE * 3 / 4 + (MAX_FRAMES_IN_FLIGHT - 1) * ALIGNMENT);
+		alloc.endFrame();
+	}
+
+	// Many threads. The windows shouldn't overlap and the frames in flight shouldn't overlap
+	{
+		const PtrSize SIZE = 4 * 1024 * 1024;
+		const U32 THREAD_COUNT = 4;
+		const U32 ALLOCS_PER_THREAD = 128;
+		FrameGpuAllocator alloc;
+		alloc.init(SIZE, ALIGNMENT, MAX_PTR_SIZE, 64 * 1024);
+
+		HeapAllocator<U8> halloc(allocAligned, nullptr);
+		ThreadHive hive(THREAD_COUNT, halloc);
+
+		class Range
+		{
+		public:
+			PtrSize m_begin;
+			PtrSize m_end;
+			U64 m_frame;
+		};
+
+		class Ctx
+		{
+		public:
+			FrameGpuAllocator* m_alloc;
+			U64 m_frame;
+			Array<std::vector<Range>, THREAD_COUNT> m_ranges;
+			Atomic<U32> m_failures = {0};
+		} ctx;
+		ctx.m_alloc = &alloc;
+
+		std::vector<Range> inFlight;
+		for(U64 frame = 0; frame < 8; ++frame)
+		{
+			ctx.m_frame = frame;
+
+			Array<ThreadHiveTask, THREAD_COUNT> tasks;
+			for(U32 i = 0; i < THREAD_COUNT; ++i)
+			{
+				tasks[i].m_callback = [](void* ud, U32 threadId, ThreadHive&, ThreadHiveSemaphore*) {
+					Ctx& ctx = *static_cast<Ctx*>(ud);
+					for(U32 j = 0; j < ALLOCS_PER_THREAD; ++j)
+					{
+						const PtrSize size = 16 + ((j * 7919 + threadId * 13) % 2048);
+						PtrSize offset;
+						if(ctx.m_alloc->allocate(size, offset))
+						{
+							ctx.m_failures.fetchAdd(1);
+						}
+						else
+						{
+							ctx.m_ranges[threadId].push_back({offset, offset + size, ctx.m_frame});
+						}
+					}
+				};
+				tasks[i].m_argument = &ctx;
+			}
+
+			hive.submitTasks(&tasks[0], THREAD_COUNT);
+			hive.waitAllTasks();
+			alloc.endFrame();
+
+			// Drop the ranges of the frames that are done
+			inFlight.erase(std::remove_if(inFlight.begin(),
+							   inFlight.end(),
+							   [&](const Range& r) { return r.m_frame + MAX_FRAMES_IN_FLIGHT <= frame; }),
+				inFlight.end());
+
+			for(std::vector<Range>& ranges : ctx.m_ranges)
+			{
+				inFlight.insert(inFlight.end(), ranges.begin(), ranges.end());
+				ranges.clear();
+			}
+
+			std::sort(inFlight.begin(), inFlight.end(), [](const Range& a, const Range& b) {
+				return a.m_begin < b.m_begin;
+			});
+
+			Bool overlap = false;
+			for(U i = 1; i < inFlight.size(); ++i)
+			{
+				overlap = overlap || inFlight[i - 1].m_end > inFlight[i].m_begin;
+			}
+
+			ANKI_TEST_EXPECT_EQ(overlap, false);
+			ANKI_TEST_EXPECT_LEQ(inFlight.back().m_end, SIZE);
+		}
+
+		ANKI_TEST_EXPECT_EQ(ctx.m_failures.load(), 0);
+		ANKI_TEST_EXPECT_LEQ(alloc.getHighWaterMark(), SIZE);
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,120 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/misc/Xml.h"
+#include "anki/util/File.h"
+
+namespace anki
+{
+
+static void testXmlDocument(const XmlDocument& doc)
+{
+	XmlElement root;
+	ANKI_TEST_EXPECT_NO_ERR(doc.getChildElement("root", root));
+
+	// Attributes
+	CString txt;
+	ANKI_TEST_EXPECT_NO_ERR(root.getAttributeText("name", txt));
+	ANKI_TEST_EXPECT_EQ(txt, "test");
+
+	U32 u;
+	ANKI_TEST_EXPECT_NO_ERR(root.getAttributeNumber("count", u));
+	ANKI_TEST_EXPECT_EQ(u, 3);
+
+	I8 i8;
+	ANKI_TEST_EXPECT_ERR(root.getAttributeNumber("big", i8), Error::USER_DATA);
+
+	// Unsigned values past MAX_I64
+	U64 u64;
+	ANKI_TEST_EXPECT_NO_ERR(root.getAttributeNumber("huge", u64));
+	ANKI_TEST_EXPECT_EQ(u64, MAX_U64);
+
+	I64 i64;
+	ANKI_TEST_EXPECT_ERR(root.getAttributeNumber("huge", i64), Error::USER_DATA);
+	ANKI_TEST_EXPECT_ERR(root.getAttributeNumber("negative", u), Error::USER_DATA);
+	ANKI_TEST_EXPECT_NO_ERR(root.getAttributeNumber("negative", i64));
+	ANKI_TEST_EXPECT_EQ(i64, -1);
+
+	Vec3 v3;
+	ANKI_TEST_EXPECT_NO_ERR(root.getAttributeVector("pos", v3));
+	ANKI_TEST_EXPECT_EQ(v3, Vec3(1.0f, 2.5f, -3.0f));
+
+	Bool present;
+	ANKI_TEST_EXPECT_NO_ERR(root.getAttributeTextOptional("missing", txt, present));
+	ANKI_TEST_EXPECT_EQ(present, false);
+
+	// Siblings
+	XmlElement item;
+	ANKI_TEST_EXPECT_NO_ERR(root.getChildElement("item", item));
+	U32 count;
+	ANKI_TEST_EXPECT_NO_ERR(item.getSiblingElementsCount(count));
+	ANKI_TEST_EXPECT_EQ(count, 2);
+
+	F32 f;
+	ANKI_TEST_EXPECT_NO_ERR(item.getNumber(f));
+	ANKI_TEST_EXPECT_EQ(f, 1.5f);
+
+	ANKI_TEST_EXPECT_NO_ERR(item.getNextSiblingElement("item", item));
+	Vec4 v4;
+	ANKI_TEST_EXPECT_NO_ERR(item.getVec4(v4));
+	ANKI_TEST_EXPECT_EQ(v4, Vec4(1.0f, 2.0f, 3.0f, 4.0f));
+
+	ANKI_TEST_EXPECT_NO_ERR(item.getNextSiblingElement("item", item));
+	ANKI_TEST_EXPECT_NO_ERR(item.getText(txt));
+	ANKI_TEST_EXPECT_EQ(txt, "text");
+
+	ANKI_TEST_EXPECT_NO_ERR(item.getNextSiblingElement("item", item));
+	ANKI_TEST_EXPECT_EQ(!!item, false);
+
+	// Children
+	XmlElement other;
+	ANKI_TEST_EXPECT_NO_ERR(root.getChildElement("other", other));
+	XmlElement child;
+	ANKI_TEST_EXPECT_NO_ERR(other.getChildElementOptional("child", child));
+	ANKI_TEST_EXPECT_NO_ERR(child.getNumber(i8));
+	ANKI_TEST_EXPECT_EQ(i8, -7);
+
+	ANKI_TEST_EXPECT_NO_ERR(other.getChildElementOptional("missing", child));
+	ANKI_TEST_EXPECT_EQ(!!child, false);
+}
+
+ANKI_TEST(Misc, XmlBinary)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	const char* XML = R"(<?xml version="1.0" encoding="UTF-8" ?>
+<!-- Comment -->
+<root name="test" count="3" big="300" huge="18446744073709551615" negative="-1" pos="1.0 2.5 -3">
+	<item>1.5</item>
+	<other><child>-7</child></other>
+	<item>1 2 3 4</item>
+	<item>text</item>
+</root>)";
+
+	// Parse the text
+	XmlDocument doc;
+	ANKI_TEST_EXPECT_NO_ERR(doc.parse(XML, alloc));
+	testXmlDocument(doc);
+
+	// Write and read the compiled document
+	ANKI_TEST_EXPECT_NO_ERR(doc.writeBinaryFile("./test.xmlbin"));
+
+	XmlDocument doc2;
+	ANKI_TEST_EXPECT_NO_ERR(doc2.loadBinaryFile("./test.xmlbin", alloc));
+	testXmlDocument(doc2);
+
+	// Corrupted files are not used
+	{
+		File file;
+		ANKI_TEST_EXPECT_NO_ERR(file.open("./test.xmlbin", FileOpenFlag::WRITE | FileOpenFlag::BINARY));
+		ANKI_TEST_EXPECT_NO_ERR(file.write(XML, 64));
+	}
+
+	XmlDocument doc3;
+	ANKI_TEST_EXPECT_ERR(doc3.loadBinaryFile("./test.xmlbin", alloc), Error::USER_DATA);
+}
+
+} // end namespace anki
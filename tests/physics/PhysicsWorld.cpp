@@ -0,0 +1,357 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/physics/PhysicsWorld.h>
+#include <anki/physics/PhysicsBody.h>
+#include <anki/physics/PhysicsCollisionShape.h>
+#include <anki/physics/PhysicsJoint.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/HighRezTimer.h>
+#include <vector>
+
+namespace anki
+{
+
+/// A scene with stacks of boxes, ragdolls and a rain of spheres.
+class PhysicsBenchScene
+{
+public:
+	std::vector<PhysicsBodyPtr> m_bodies;
+	std::vector<PhysicsJointPtr> m_joints;
+	PhysicsBodyPtr m_probe; ///< A sphere that falls freely.
+
+	void create(PhysicsWorld& world)
+	{
+		// Ground
+		PhysicsCollisionShapePtr groundShape = world.newInstance<PhysicsBox>(Vec3(200.0f, 1.0f, 200.0f));
+		PhysicsBodyInitInfo init;
+		init.m_shape = groundShape;
+		init.m_mass = 0.0f;
+		init.m_transform = Transform(Vec4(0.0f, -1.0f, 0.0f, 0.0f), Mat3x4::getIdentity(), 1.0f);
+		PhysicsBodyPtr ground = world.newInstance<PhysicsBody>(init);
+		ground->setMaterialGroup(PhysicsMaterialBit::STATIC_GEOMETRY);
+		m_bodies.push_back(ground);
+
+		// Stacks
+		PhysicsCollisionShapePtr boxShape = world.newInstance<PhysicsBox>(Vec3(0.5f));
+		for(U32 stack = 0; stack < 16; ++stack)
+		{
+			for(U32 i = 0; i < 12; ++i)
+			{
+				init.m_shape = boxShape;
+				init.m_mass = 1.0f;
+				init.m_transform = Transform(
+					Vec4(F32(stack % 4) * 10.0f - 15.0f, 0.5f + F32(i), F32(stack / 4) * 10.0f - 15.0f, 0.0f),
+					Mat3x4::getIdentity(),
+					1.0f);
+				addDynamicBody(world, init);
+			}
+		}
+
+		// Ragdolls. A chain of bodies for the spine and the limbs
+		PhysicsCollisionShapePtr limbShape = world.newInstance<PhysicsBox>(Vec3(0.15f, 0.3f, 0.15f));
+		for(U32 ragdoll = 0; ragdoll < 32; ++ragdoll)
+		{
+			const Vec3 origin(F32(ragdoll % 8) * 5.0f - 17.5f, 20.0f, F32(ragdoll / 8) * 5.0f - 35.0f);
+
+			Array<PhysicsBodyPtr, 3> spine;
+			for(U32 i = 0; i < 3; ++i)
+			{
+				init.m_shape = limbShape;
+				init.m_mass = 2.0f;
+				init.m_transform =
+					Transform((origin + Vec3(0.0f, F32(i) * 0.7f, 0.0f)).xyz0(), Mat3x4::getIdentity(), 1.0f);
+				spine[i] = addDynamicBody(world, init);
+
+				if(i > 0)
+				{
+					m_joints.push_back(world.newInstance<PhysicsPoint2PointJoint>(
+						spine[i - 1], Vec3(0.0f, 0.35f, 0.0f), spine[i], Vec3(0.0f, -0.35f, 0.0f)));
+				}
+			}
+
+			// Limbs hang from the top and the bottom of the spine
+			const Array<Vec3, 4> limbOffsets = {
+				{Vec3(-0.4f, 1.4f, 0.0f), Vec3(0.4f, 1.4f, 0.0f), Vec3(-0.2f, -0.7f, 0.0f), Vec3(0.2f, -0.7f, 0.0f)}};
+			for(const Vec3& offset : limbOffsets)
+			{
+				PhysicsBodyPtr parent = (offset.y() > 0.0f) ? spine[2] : spine[0];
+				for(U32 i = 0; i < 2; ++i)
+				{
+					init.m_shape = limbShape;
+					init.m_mass = 1.0f;
+					init.m_transform = Transform(
+						(origin + offset - Vec3(0.0f, F32(i) * 0.7f, 0.0f)).xyz0(), Mat3x4::getIdentity(), 1.0f);
+					PhysicsBodyPtr body = addDynamicBody(world, init);
+
+					m_joints.push_back(world.newInstance<PhysicsPoint2PointJoint>(
+						parent, Vec3(0.0f, -0.35f, 0.0f), body, Vec3(0.0f, 0.35f, 0.0f)));
+					parent = body;
+				}
+			}
+		}
+
+		// Rain of spheres
+		PhysicsCollisionShapePtr sphereShape = world.newInstance<PhysicsSphere>(0.3f);
+		for(U32 i = 0; i < 2000; ++i)
+		{
+			init.m_shape = sphereShape;
+			init.m_mass = 0.5f;
+			init.m_transform = Transform(
+				Vec4(F32(i % 20) * 2.0f - 20.0f, 10.0f + F32(i / 400) * 2.0f, F32((i / 20) % 20) * 2.0f + 5.0f, 0.0f),
+				Mat3x4::getIdentity(),
+				1.0f);
+			addDynamicBody(world, init);
+		}
+
+		// The probe is far from the rest
+		init.m_shape = sphereShape;
+		init.m_mass = 1.0f;
+		init.m_transform = Transform(Vec4(150.0f, 200.0f, 150.0f, 0.0f), Mat3x4::getIdentity(), 1.0f);
+		m_probe = addDynamicBody(world, init);
+	}
+
+	PhysicsBodyPtr addDynamicBody(PhysicsWorld& world, const PhysicsBodyInitInfo& init)
+	{
+		PhysicsBodyPtr body = world.newInstance<PhysicsBody>(init);
+		body->setMaterialGroup(PhysicsMaterialBit::DYNAMIC_GEOMETRY);
+		m_bodies.push_back(body);
+		return body;
+	}
+};
+
+ANKI_TEST(Physics, FixedTimeStep)
+{
+	const Second STEP = 1.0 / 30.0;
+	const Second FRAME = 1.0 / 60.0;
+
+	PhysicsWorld world;
+	ANKI_TEST_EXPECT_NO_ERR(world.create(allocAligned, nullptr));
+	world.setFixedTimeStep(STEP, 4);
+
+	PhysicsCollisionShapePtr shape = world.newInstance<PhysicsSphere>(1.0f);
+	PhysicsBodyInitInfo init;
+	init.m_shape = shape;
+	init.m_mass = 1.0f;
+	init.m_transform = Transform(Vec4(0.0f, 100.0f, 0.0f, 0.0f), Mat3x4::getIdentity(), 1.0f);
+	PhysicsBodyPtr body = world.newInstance<PhysicsBody>(init);
+
+	// Half a step, nothing moves
+	ANKI_TEST_EXPECT_NO_ERR(world.update(FRAME));
+	ANKI_TEST_EXPECT_EQ(world.getLastSubStepCount(), 0);
+	ANKI_TEST_EXPECT_EQ(body->getTransform().getOrigin().y(), 100.0f);
+
+	// A full step. The interpolated transform is the previous step
+	ANKI_TEST_EXPECT_NO_ERR(world.update(FRAME));
+	ANKI_TEST_EXPECT_EQ(world.getLastSubStepCount(), 1);
+	const F32 y1 = body->getTransform().getOrigin().y();
+	ANKI_TEST_EXPECT_LT(y1, 100.0f);
+	ANKI_TEST_EXPECT_NEAR(body->getInterpolatedTransform().getOrigin().y(), 100.0f, 0.0001f);
+
+	// Half a step. The interpolated transform is in the middle of the last two steps
+	ANKI_TEST_EXPECT_NO_ERR(world.update(FRAME));
+	ANKI_TEST_EXPECT_EQ(world.getLastSubStepCount(), 0);
+	ANKI_TEST_EXPECT_NEAR(body->getInterpolatedTransform().getOrigin().y(), (100.0f + y1) / 2.0f, 0.0001f);
+
+	// A long frame is clamped to the max steps and the time that doesn't fit is dropped
+	ANKI_TEST_EXPECT_NO_ERR(world.update(1.0));
+	ANKI_TEST_EXPECT_EQ(world.getLastSubStepCount(), 4);
+	ANKI_TEST_EXPECT_NO_ERR(world.update(FRAME));
+	ANKI_TEST_EXPECT_EQ(world.getLastSubStepCount(), 0);
+}
+
+ANKI_TEST(Physics, AsyncUpdate)
+{
+	const Second STEP = 1.0 / 60.0;
+	const Second FRAME = 1.0 / 45.0;
+
+	// Two worlds with the same falling sphere. One updates synchronously and the other asynchronously
+	Array<PhysicsWorld, 2> worlds;
+	Array<PhysicsCollisionShapePtr, 2> shapes;
+	Array<PhysicsBodyPtr, 2> bodies;
+	for(U32 i = 0; i < 2; ++i)
+	{
+		ANKI_TEST_EXPECT_NO_ERR(worlds[i].create(allocAligned, nullptr));
+		worlds[i].setFixedTimeStep(STEP, 4);
+
+		shapes[i] = worlds[i].newInstance<PhysicsSphere>(1.0f);
+		PhysicsBodyInitInfo init;
+		init.m_shape = shapes[i];
+		init.m_mass = 1.0f;
+		init.m_transform = Transform(Vec4(0.0f, 100.0f, 0.0f, 0.0f), Mat3x4::getIdentity(), 1.0f);
+		bodies[i] = worlds[i].newInstance<PhysicsBody>(init);
+	}
+
+	// Nothing to wait for
+	worlds[1].waitUpdate();
+
+	for(U32 frame = 0; frame < 32; ++frame)
+	{
+		ANKI_TEST_EXPECT_NO_ERR(worlds[0].update(FRAME));
+
+		worlds[1].updateAsync(FRAME);
+
+		// The published transform doesn't change while the step runs
+		const Transform before = bodies[1]->getInterpolatedTransform();
+		HighRezTimer::sleep(0.001);
+		ANKI_TEST_EXPECT_EQ(bodies[1]->getInterpolatedTransform(), before);
+
+		worlds[1].waitUpdate();
+
+		ANKI_TEST_EXPECT_EQ(worlds[1].getLastSubStepCount(), worlds[0].getLastSubStepCount());
+		ANKI_TEST_EXPECT_EQ(bodies[1]->getTransform(), bodies[0]->getTransform());
+		ANKI_TEST_EXPECT_EQ(bodies[1]->getInterpolatedTransform(), bodies[0]->getInterpolatedTransform());
+	}
+
+	ANKI_TEST_EXPECT_LT(bodies[1]->getInterpolatedTransform().getOrigin().y(), 100.0f);
+
+	// Leave an update pending. Releasing the objects and destroying the world wait for it
+	worlds[1].updateAsync(FRAME);
+}
+
+/// Run a batch of queries against a grid of boxes. A null hive means the single threaded world.
+static void testQueryBatch(ThreadHive* hive)
+{
+	PhysicsWorld world;
+	ANKI_TEST_EXPECT_NO_ERR(world.create(allocAligned, nullptr, hive));
+
+	// A grid of static boxes with their tops at y=1
+	const U32 GRID_SIZE = 16;
+	PhysicsCollisionShapePtr shape = world.newInstance<PhysicsBox>(Vec3(0.25f, 1.0f, 0.25f));
+	std::vector<PhysicsBodyPtr> boxes;
+	for(U32 i = 0; i < GRID_SIZE * GRID_SIZE; ++i)
+	{
+		PhysicsBodyInitInfo init;
+		init.m_shape = shape;
+		init.m_transform =
+			Transform(Vec4(F32(i % GRID_SIZE), 0.0f, F32(i / GRID_SIZE), 0.0f), Mat3x4::getIdentity(), 1.0f);
+		boxes.push_back(world.newInstance<PhysicsBody>(init));
+	}
+
+	// Rays straight down. The even ones hit a box and the odd ones pass between them
+	const U32 QUERY_COUNT = 1024;
+	std::vector<PhysicsRayQuery> rays(QUERY_COUNT);
+	std::vector<PhysicsQueryHit> rayHits(QUERY_COUNT);
+	std::vector<PhysicsSweepQuery> sweeps(QUERY_COUNT);
+	std::vector<PhysicsQueryHit> sweepHits(QUERY_COUNT);
+	for(U32 i = 0; i < QUERY_COUNT; ++i)
+	{
+		const U32 box = (i / 2) % (GRID_SIZE * GRID_SIZE);
+		const F32 offset = (i % 2) ? 0.5f : 0.0f;
+		rays[i].m_from = Vec3(F32(box % GRID_SIZE) + offset, 10.0f, F32(box / GRID_SIZE) + offset);
+		rays[i].m_to = rays[i].m_from - Vec3(0.0f, 20.0f, 0.0f);
+
+		// The sweeps are big enough to hit the boxes even if they pass between them
+		sweeps[i].m_from = rays[i].m_from;
+		sweeps[i].m_to = rays[i].m_to;
+		sweeps[i].m_radius = 0.4f;
+	}
+
+	// An overlap query covers 4 boxes but has space for 2 results
+	Array<PhysicsOverlapQuery, 2> overlaps;
+	Array<PhysicsFilteredObject*, 4> overlapObjects = {};
+	Array<U32, 2> overlapCounts;
+	overlaps[0].m_aabbMin = Vec3(-0.1f, 0.0f, -0.1f);
+	overlaps[0].m_aabbMax = Vec3(1.1f, 0.5f, 1.1f);
+	overlaps[0].m_objects = WeakArray<PhysicsFilteredObject*>(&overlapObjects[0], 2);
+	overlaps[1].m_aabbMin = Vec3(-10.0f, 5.0f, -10.0f);
+	overlaps[1].m_aabbMax = Vec3(-5.0f, 6.0f, -5.0f);
+	overlaps[1].m_objects = WeakArray<PhysicsFilteredObject*>(&overlapObjects[2], 2);
+
+	PhysicsQueryBatch batch;
+	batch.m_rays = ConstWeakArray<PhysicsRayQuery>(&rays[0], QUERY_COUNT);
+	batch.m_rayHits = WeakArray<PhysicsQueryHit>(&rayHits[0], QUERY_COUNT);
+	batch.m_sweeps = ConstWeakArray<PhysicsSweepQuery>(&sweeps[0], QUERY_COUNT);
+	batch.m_sweepHits = WeakArray<PhysicsQueryHit>(&sweepHits[0], QUERY_COUNT);
+	batch.m_overlaps = ConstWeakArray<PhysicsOverlapQuery>(&overlaps[0], overlaps.getSize());
+	batch.m_overlapCounts = WeakArray<U32>(&overlapCounts[0], overlapCounts.getSize());
+	world.query(batch);
+
+	for(U32 i = 0; i < QUERY_COUNT; ++i)
+	{
+		if(i % 2)
+		{
+			ANKI_TEST_EXPECT_EQ(rayHits[i].m_object, static_cast<PhysicsFilteredObject*>(nullptr));
+		}
+		else
+		{
+			const U32 box = (i / 2) % (GRID_SIZE * GRID_SIZE);
+			ANKI_TEST_EXPECT_EQ(rayHits[i].m_object, static_cast<PhysicsFilteredObject*>(boxes[box].get()));
+			ANKI_TEST_EXPECT_NEAR(rayHits[i].m_position.y(), 1.0f, 0.05f);
+			ANKI_TEST_EXPECT_NEAR(rayHits[i].m_normal.y(), 1.0f, 0.01f);
+		}
+
+		ANKI_TEST_EXPECT_NEQ(sweepHits[i].m_object, static_cast<PhysicsFilteredObject*>(nullptr));
+	}
+
+	ANKI_TEST_EXPECT_EQ(overlapCounts[0], 4);
+	ANKI_TEST_EXPECT_NEQ(overlapObjects[0], static_cast<PhysicsFilteredObject*>(nullptr));
+	ANKI_TEST_EXPECT_NEQ(overlapObjects[1], static_cast<PhysicsFilteredObject*>(nullptr));
+	ANKI_TEST_EXPECT_EQ(overlapCounts[1], 0);
+}
+
+ANKI_TEST(Physics, QueryBatch)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ThreadHive hive(4, alloc);
+	testQueryBatch(&hive);
+}
+
+ANKI_TEST(Physics, QueryBatchNoHive)
+{
+	testQueryBatch(nullptr);
+}
+
+ANKI_TEST(Physics, MultithreadedStepBench)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 STEP_COUNT = 240;
+	const Second DT = 1.0 / 60.0;
+
+	// Zero threads means the single threaded world
+	for(U32 threadCount = 0; threadCount <= 8; threadCount = (threadCount) ? threadCount * 2 : 2)
+	{
+		ThreadHive* hive = (threadCount) ? alloc.newInstance<ThreadHive>(threadCount, alloc) : nullptr;
+
+		{
+			PhysicsWorld world;
+			ANKI_TEST_EXPECT_NO_ERR(world.create(allocAligned, nullptr, hive));
+
+			PhysicsBenchScene scene;
+			scene.create(world);
+
+			Second stepTime = 0.0;
+			Second maxStepTime = 0.0;
+			for(U32 i = 0; i < STEP_COUNT; ++i)
+			{
+				const Second begin = HighRezTimer::getCurrentTime();
+				ANKI_TEST_EXPECT_NO_ERR(world.update(DT));
+				const Second time = HighRezTimer::getCurrentTime() - begin;
+
+				stepTime += time;
+				maxStepTime = max(maxStepTime, time);
+			}
+
+			// Sanity check. The probe fell freely for STEP_COUNT * DT seconds
+			const F32 fallen = 200.0f - scene.m_probe->getTransform().getOrigin().y();
+			const F32 expectedFall = 0.5f * 9.8f * F32(STEP_COUNT * DT) * F32(STEP_COUNT * DT);
+			ANKI_TEST_EXPECT_NEAR(fallen, expectedFall, expectedFall * 0.05f);
+
+			ANKI_TEST_LOGI("Physics step with %u bodies and %u hive threads: avg %fms max %fms",
+				U32(scene.m_bodies.size()),
+				threadCount,
+				stepTime / F64(STEP_COUNT) * 1000.0,
+				maxStepTime * 1000.0);
+		}
+
+		if(hive)
+		{
+			alloc.deleteInstance(hive);
+		}
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,155 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/renderer/TileAllocator.h>
+
+namespace anki
+{
+
+static Bool viewportsOverlap(const Array<U32, 4>& a, const Array<U32, 4>& b)
+{
+	return a[0] < b[0] + b[2] && b[0] < a[0] + a[2] && a[1] < b[1] + b[3] && b[1] < a[1] + a[3];
+}
+
+static Bool viewportsEqual(const Array<U32, 4>& a, const Array<U32, 4>& b)
+{
+	return a[0] == b[0] && a[1] == b[1] && a[2] == b[2] && a[3] == b[3];
+}
+
+ANKI_TEST(Renderer, TileAllocator)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	const U32 TILE_COUNT = 4;
+	const U32 RESOLUTION = 512;
+
+	// Top level tiles
+	{
+		TileAllocator talloc;
+		talloc.init(alloc, TILE_COUNT, TILE_COUNT, 3, RESOLUTION);
+		talloc.reserveTile(0, 0);
+		ANKI_TEST_EXPECT_EQ(talloc.getTileResolution(2), RESOLUTION / 4);
+
+		// Fill the atlas
+		Timestamp crntTimestamp = 10;
+		Array<Array<U32, 4>, TILE_COUNT * TILE_COUNT> viewports;
+		for(U32 i = 0; i < TILE_COUNT * TILE_COUNT - 1; ++i)
+		{
+			const TileAllocatorResult res = talloc.allocate(crntTimestamp, 1, i + 1, 0, 1, 0, viewports[i]);
+			ANKI_TEST_EXPECT_EQ(res, TileAllocatorResult::ALLOCATION_SUCCEEDED);
+			ANKI_TEST_EXPECT_EQ(viewports[i][2], RESOLUTION);
+			ANKI_TEST_EXPECT_EQ(viewportsOverlap(viewports[i], {{0, 0, RESOLUTION, RESOLUTION}}), false);
+
+			for(U32 j = 0; j < i; ++j)
+			{
+				ANKI_TEST_EXPECT_EQ(viewportsOverlap(viewports[i], viewports[j]), false);
+			}
+		}
+
+		// Full, no tile can be evicted because all are used this frame
+		Array<U32, 4> viewport;
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, 100, 0, 1, 0, viewport),
+			TileAllocatorResult::ALLOCATION_FAILED);
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, 100, 0, 1, 2, viewport),
+			TileAllocatorResult::ALLOCATION_FAILED);
+
+		// Next frame. Nothing changed so the tiles are cached. Skip the 1st light
+		++crntTimestamp;
+		for(U32 i = 1; i < TILE_COUNT * TILE_COUNT - 1; ++i)
+		{
+			const TileAllocatorResult res = talloc.allocate(crntTimestamp, 1, i + 1, 0, 1, 0, viewport);
+			ANKI_TEST_EXPECT_EQ(res, TileAllocatorResult::CACHED);
+			ANKI_TEST_EXPECT_EQ(viewportsEqual(viewport, viewports[i]), true);
+		}
+
+		// A new light kicks the 1st light that wasn't used this frame
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, 100, 0, 1, 0, viewport),
+			TileAllocatorResult::ALLOCATION_SUCCEEDED);
+		ANKI_TEST_EXPECT_EQ(viewportsEqual(viewport, viewports[0]), true);
+
+		// Next frame. The light changed or what it sees changed so the tiles need to be re-rendered
+		++crntTimestamp;
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, crntTimestamp, 2, 0, 1, 0, viewport),
+			TileAllocatorResult::ALLOCATION_SUCCEEDED);
+		ANKI_TEST_EXPECT_EQ(viewportsEqual(viewport, viewports[1]), true);
+		ANKI_TEST_EXPECT_EQ(
+			talloc.allocate(crntTimestamp, 1, 3, 0, 2, 0, viewport), TileAllocatorResult::ALLOCATION_SUCCEEDED);
+		ANKI_TEST_EXPECT_EQ(viewportsEqual(viewport, viewports[2]), true);
+
+		// The 1st light is gone from the cache. It kicks some light that wasn't used this frame
+		ANKI_TEST_EXPECT_EQ(
+			talloc.allocate(crntTimestamp, 1, 1, 0, 1, 0, viewport), TileAllocatorResult::ALLOCATION_SUCCEEDED);
+		ANKI_TEST_EXPECT_EQ(viewportsOverlap(viewport, viewports[1]), false);
+		ANKI_TEST_EXPECT_EQ(viewportsOverlap(viewport, viewports[2]), false);
+
+		// Invalidate
+		++crntTimestamp;
+		talloc.invalidateCache(3, 0);
+		ANKI_TEST_EXPECT_EQ(
+			talloc.allocate(crntTimestamp, 1, 3, 0, 2, 0, viewport), TileAllocatorResult::ALLOCATION_SUCCEEDED);
+	}
+
+	// Hierarchies
+	{
+		TileAllocator talloc;
+		talloc.init(alloc, 1, 1, 3, RESOLUTION);
+
+		// 16 small tiles fill the atlas
+		Timestamp crntTimestamp = 1;
+		Array<Array<U32, 4>, 16> viewports;
+		for(U32 i = 0; i < 16; ++i)
+		{
+			ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, i + 1, 0, 1, 2, viewports[i]),
+				TileAllocatorResult::ALLOCATION_SUCCEEDED);
+			ANKI_TEST_EXPECT_EQ(viewports[i][2], RESOLUTION / 4);
+
+			for(U32 j = 0; j < i; ++j)
+			{
+				ANKI_TEST_EXPECT_EQ(viewportsOverlap(viewports[i], viewports[j]), false);
+			}
+		}
+
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, 100, 0, 1, 1, viewports[0]),
+			TileAllocatorResult::ALLOCATION_FAILED);
+
+		// Next frame use only the small tiles of the 1st quadrant. A big tile will kick the rest
+		++crntTimestamp;
+		for(U32 i = 0; i < 16; ++i)
+		{
+			if(viewports[i][0] < RESOLUTION / 2 && viewports[i][1] < RESOLUTION / 2)
+			{
+				Array<U32, 4> viewport;
+				ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, i + 1, 0, 1, 2, viewport),
+					TileAllocatorResult::CACHED);
+			}
+		}
+
+		Array<U32, 4> viewport;
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, 100, 0, 1, 1, viewport),
+			TileAllocatorResult::ALLOCATION_SUCCEEDED);
+		ANKI_TEST_EXPECT_EQ(viewport[2], RESOLUTION / 2);
+		ANKI_TEST_EXPECT_EQ(viewportsOverlap(viewport, {{0, 0, RESOLUTION / 2, RESOLUTION / 2}}), false);
+
+		// The whole atlas can't be allocated because a quadrant is used this frame
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, 101, 0, 1, 0, viewport),
+			TileAllocatorResult::ALLOCATION_FAILED);
+
+		// Next frame it can and it kicks everything
+		++crntTimestamp;
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, 101, 0, 1, 0, viewport),
+			TileAllocatorResult::ALLOCATION_SUCCEEDED);
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, 1, 0, 1, 2, viewport),
+			TileAllocatorResult::ALLOCATION_FAILED);
+
+		// A light that changes resolution gets a new tile
+		++crntTimestamp;
+		ANKI_TEST_EXPECT_EQ(talloc.allocate(crntTimestamp, 1, 101, 0, 1, 1, viewport),
+			TileAllocatorResult::ALLOCATION_SUCCEEDED);
+		ANKI_TEST_EXPECT_EQ(viewport[2], RESOLUTION / 2);
+	}
+}
+
+} // end namespace anki
@@ -69,10 +69,10 @@ public:
 class MemTask : public AsyncLoaderTask
 {
 public:
-	HeapAllocator<U8> m_alloc;
+	ResourceAllocator<U8> m_alloc;
 	Barrier* m_barrier = nullptr;
 
-	MemTask(HeapAllocator<U8> alloc, Barrier* barrier)
+	MemTask(ResourceAllocator<U8> alloc, Barrier* barrier)
 		: m_alloc(alloc)
 		, m_barrier(barrier)
 	{
@@ -99,7 +99,7 @@ public:
 
 ANKI_TEST(Resource, AsyncLoader)
 {
-	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	ResourceAllocator<U8> alloc(allocAligned, nullptr);
 
 	// Simple create destroy
 	{
@@ -0,0 +1,185 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/resource/MeshOptimizer.h>
+#include <algorithm>
+
+namespace anki
+{
+
+/// Create a sphere with the triangles in random order.
+static void createSphere(U32 rings, U32 sectors, DynamicArrayAuto<U32>& indices, DynamicArrayAuto<Vec3>& positions)
+{
+	for(U r = 0; r < rings; ++r)
+	{
+		const F32 theta = PI * F32(r) / F32(rings - 1);
+		for(U s = 0; s < sectors; ++s)
+		{
+			const F32 phi = 2.0f * PI * F32(s) / F32(sectors);
+			positions.emplaceBack(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+		}
+	}
+
+	for(U r = 0; r < rings - 1; ++r)
+	{
+		for(U s = 0; s < sectors; ++s)
+		{
+			const U32 a = r * sectors + s;
+			const U32 b = r * sectors + (s + 1) % sectors;
+			const U32 c = (r + 1) * sectors + s;
+			const U32 d = (r + 1) * sectors + (s + 1) % sectors;
+
+			indices.emplaceBack(a);
+			indices.emplaceBack(c);
+			indices.emplaceBack(b);
+
+			indices.emplaceBack(b);
+			indices.emplaceBack(c);
+			indices.emplaceBack(d);
+		}
+	}
+
+	// Shuffle the triangles
+	U32 seed = 12345;
+	const U32 triCount = indices.getSize() / 3;
+	for(U t = triCount - 1; t > 0; --t)
+	{
+		seed = seed * 1103515245u + 12345u;
+		const U32 other = (seed >> 8) % (t + 1);
+		for(U i = 0; i < 3; ++i)
+		{
+			std::swap(indices[t * 3 + i], indices[other * 3 + i]);
+		}
+	}
+}
+
+/// Sort the triangles to compare triangle lists.
+static void sortTriangles(DynamicArrayAuto<U32>& indices)
+{
+	class Triangle
+	{
+	public:
+		Array<U32, 3> m_idx;
+	};
+
+	Triangle* begin = reinterpret_cast<Triangle*>(&indices[0]);
+	std::sort(begin, begin + indices.getSize() / 3, [](const Triangle& a, const Triangle& b) {
+		return memcmp(&a.m_idx[0], &b.m_idx[0], sizeof(a.m_idx)) < 0;
+	});
+}
+
+ANKI_TEST(Resource, MeshOptimizer)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	DynamicArrayAuto<U32> indices(alloc);
+	DynamicArrayAuto<Vec3> positions(alloc);
+	createSphere(32, 32, indices, positions);
+	const U32 vertCount = positions.getSize();
+
+	// Vertex cache
+	{
+		DynamicArrayAuto<U32> optimized(alloc);
+		optimized.create(indices.getSize());
+		memcpy(&optimized[0], &indices[0], indices.getSizeInBytes());
+
+		const F32 acmrBefore = computeMeshAcmr(indices, vertCount, MESH_OPTIMIZER_VERTEX_CACHE_SIZE, alloc);
+		optimizeMeshVertexCache(WeakArray<U32>(optimized), vertCount, alloc);
+		const F32 acmrAfter = computeMeshAcmr(optimized, vertCount, MESH_OPTIMIZER_VERTEX_CACHE_SIZE, alloc);
+
+		ANKI_TEST_EXPECT_LT(acmrAfter, acmrBefore);
+		ANKI_TEST_EXPECT_LT(acmrAfter, 1.0f);
+
+		// Overdraw optimization shouldn't destroy the vertex cache optimization
+		optimizeMeshOverdraw(WeakArray<U32>(optimized), positions, alloc);
+		const F32 acmrOverdraw = computeMeshAcmr(optimized, vertCount, MESH_OPTIMIZER_VERTEX_CACHE_SIZE, alloc);
+		ANKI_TEST_EXPECT_LT(acmrOverdraw, acmrBefore);
+
+		// The triangles should be the same
+		DynamicArrayAuto<U32> original(alloc);
+		original.create(indices.getSize());
+		memcpy(&original[0], &indices[0], indices.getSizeInBytes());
+
+		sortTriangles(original);
+		sortTriangles(optimized);
+		ANKI_TEST_EXPECT_EQ(memcmp(&original[0], &optimized[0], original.getSizeInBytes()), 0);
+	}
+
+	// Vertex fetch
+	{
+		DynamicArrayAuto<U32> optimized(alloc);
+		optimized.create(indices.getSize());
+		memcpy(&optimized[0], &indices[0], indices.getSizeInBytes());
+
+		DynamicArrayAuto<U32> remap(alloc);
+		remap.create(vertCount);
+		const U32 newVertCount = optimizeMeshVertexFetch(WeakArray<U32>(optimized), WeakArray<U32>(remap));
+		ANKI_TEST_EXPECT_EQ(newVertCount, vertCount);
+
+		// The vertices should be referenced in order
+		U32 maxIdx = 0;
+		for(U i = 0; i < optimized.getSize(); ++i)
+		{
+			ANKI_TEST_EXPECT_LEQ(optimized[i], maxIdx);
+			maxIdx = max(maxIdx, optimized[i] + 1);
+		}
+
+		// The remapped positions should give the same triangles
+		DynamicArrayAuto<Vec3> newPositions(alloc);
+		newPositions.create(vertCount);
+		memcpy(&newPositions[0], &positions[0], positions.getSizeInBytes());
+		remapMeshVertices(remap, newVertCount, newPositions, alloc);
+
+		for(U i = 0; i < optimized.getSize(); ++i)
+		{
+			ANKI_TEST_EXPECT_EQ(newPositions[optimized[i]], positions[indices[i]]);
+		}
+	}
+
+	// Simplification
+	{
+		DynamicArrayAuto<U32> simplified(alloc);
+		simplifyMesh(indices, positions, indices.getSize() / 4, alloc, simplified);
+
+		ANKI_TEST_EXPECT_GT(simplified.getSize(), 0);
+		ANKI_TEST_EXPECT_LEQ(simplified.getSize(), indices.getSize() / 4);
+		ANKI_TEST_EXPECT_EQ(simplified.getSize() % 3, 0);
+
+		for(U32 idx : simplified)
+		{
+			ANKI_TEST_EXPECT_LT(idx, vertCount);
+		}
+	}
+
+	// All together
+	{
+		DynamicArrayAuto<U32> outIndices(alloc);
+		DynamicArrayAuto<U32> remap(alloc);
+		Array<U32, MAX_LOD_COUNT> lodIndexCounts;
+		U32 newVertCount;
+		const U32 lodCount = optimizeMeshAndGenerateLods(
+			indices, positions, MAX_LOD_COUNT, alloc, outIndices, lodIndexCounts, remap, newVertCount);
+
+		ANKI_TEST_EXPECT_EQ(lodCount, MAX_LOD_COUNT);
+		ANKI_TEST_EXPECT_EQ(lodIndexCounts[0], indices.getSize());
+
+		U32 totalIndexCount = 0;
+		for(U lod = 0; lod < lodCount; ++lod)
+		{
+			if(lod > 0)
+			{
+				ANKI_TEST_EXPECT_LT(lodIndexCounts[lod], lodIndexCounts[lod - 1]);
+			}
+
+			totalIndexCount += lodIndexCounts[lod];
+		}
+
+		ANKI_TEST_EXPECT_EQ(totalIndexCount, outIndices.getSize());
+		ANKI_TEST_EXPECT_EQ(newVertCount, vertCount);
+	}
+}
+
+} // end namespace anki
@@ -7,6 +7,8 @@
 #include "anki/resource/DummyResource.h"
 #include "anki/resource/ResourceManager.h"
 #include "anki/core/Config.h"
+#include "anki/core/App.h"
+#include "anki/util/ThreadPool.h"
 
 namespace anki
 {
@@ -87,4 +89,69 @@ ANKI_TEST(Resource, ResourceManager)
 	alloc.deleteInstance(resources);
 }
 
+ANKI_TEST(Resource, ResourceAllocator)
+{
+	// Use the allocation callback of the App. It supports only small alignments and it doesn't return the memory that
+	// its callback returned
+	App::MemStats stats;
+	stats.m_originalAllocCallback = allocAligned;
+
+	{
+		const U THREAD_COUNT = 4;
+		const U ALLOCATION_COUNT = 512;
+		ResourceAllocator<U8> alloc(App::MemStats::allocCallback, &stats);
+		ThreadPool threadPool(THREAD_COUNT);
+
+		class Task : public ThreadPoolTask
+		{
+		public:
+			ResourceAllocator<U8> m_alloc;
+			Bool m_ok = true;
+
+			Error operator()(U32 taskId, PtrSize threadsCount)
+			{
+				const Array<PtrSize, 4> alignments = {{1, 16, 64, 256}};
+				Array<U8*, ALLOCATION_COUNT> ptrs;
+				Array<PtrSize, ALLOCATION_COUNT> sizes;
+
+				for(U i = 0; i < ALLOCATION_COUNT; ++i)
+				{
+					// Mostly small and some large allocations
+					sizes[i] = (i % 16 == 0) ? 20 * 1024 + i : 8 + (i * 7919) % 2048;
+					const PtrSize alignment = alignments[i % alignments.getSize()];
+					ptrs[i] = static_cast<U8*>(m_alloc.getMemoryPool().allocate(sizes[i], alignment));
+					m_ok = m_ok && isAligned(alignment, ptrs[i]);
+					memset(ptrs[i], U8(taskId), sizes[i]);
+				}
+
+				for(U i = 0; i < ALLOCATION_COUNT; ++i)
+				{
+					m_ok = m_ok && ptrs[i][0] == U8(taskId) && ptrs[i][sizes[i] - 1] == U8(taskId);
+					m_alloc.getMemoryPool().free(ptrs[i]);
+				}
+
+				return Error::NONE;
+			}
+		};
+
+		Array<Task, THREAD_COUNT> tasks;
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			tasks[i].m_alloc = alloc;
+			threadPool.assignNewTask(i, &tasks[i]);
+		}
+		ANKI_TEST_EXPECT_NO_ERR(threadPool.waitForAllThreadsToFinish());
+
+		for(const Task& task : tasks)
+		{
+			ANKI_TEST_EXPECT_EQ(task.m_ok, true);
+		}
+		ANKI_TEST_EXPECT_EQ(alloc.getMemoryPool().getAllocationsCount(), 0);
+	}
+
+	// The pool gave everything back
+	ANKI_TEST_EXPECT_EQ(stats.m_allocCount.load(), stats.m_freeCount.load());
+	ANKI_TEST_EXPECT_EQ(stats.m_allocatedMem.load(), 0);
+}
+
 } // end namespace anki
@@ -0,0 +1,93 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/resource/ShaderProgramPackage.h"
+
+namespace anki
+{
+
+ANKI_TEST(Resource, ShaderProgramPackage)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	ShaderCompilerOptions options;
+	options.m_outLanguage = ShaderLanguage::SPIRV;
+	options.m_gpuCapabilities.m_gpuVendor = GpuVendor::NVIDIA;
+
+	const Array<U8, 6> binA = {{1, 2, 3, 4, 5, 6}};
+	const Array<U8, 3> binB = {{7, 8, 9}};
+	const Array<U8, 5> binC = {{10, 11, 12, 13, 14}};
+
+	// Build
+	{
+		ShaderProgramPackageBuilder builder(alloc, options);
+
+		Array<ConstWeakArray<U8>, U(ShaderType::COUNT)> bins;
+		bins[ShaderType::VERTEX] = ConstWeakArray<U8>(&binA[0], binA.getSize());
+		bins[ShaderType::FRAGMENT] = ConstWeakArray<U8>(&binB[0], binB.getSize());
+		const Array<I32, 2> values0 = {{0, 1}};
+		builder.addVariant("programs/A.glslp", 123, values0, false, bins);
+
+		// Shares the vertex binary
+		bins[ShaderType::FRAGMENT] = ConstWeakArray<U8>(&binC[0], binC.getSize());
+		const Array<I32, 2> values1 = {{1, 1}};
+		builder.addVariant("programs/A.glslp", 123, values1, true, bins);
+
+		Array<ConstWeakArray<U8>, U(ShaderType::COUNT)> compBins;
+		compBins[ShaderType::COMPUTE] = ConstWeakArray<U8>(&binB[0], binB.getSize());
+		builder.addVariant("programs/B.glslp", 456, ConstWeakArray<I32>(), false, compBins);
+
+		ANKI_TEST_EXPECT_EQ(builder.getVariantCount(), 3);
+		ANKI_TEST_EXPECT_EQ(builder.getBinaryCount(), 3);
+		ANKI_TEST_EXPECT_NO_ERR(builder.write("./tmp.ankispk"));
+	}
+
+	// Load and find
+	{
+		ShaderProgramPackage package;
+		ANKI_TEST_EXPECT_NO_ERR(package.load(alloc, "./tmp.ankispk", options));
+		ANKI_TEST_EXPECT_EQ(package.isLoaded(), true);
+
+		const Array<I32, 2> values1 = {{1, 1}};
+		const ShaderProgramPackageFile::Variant* variant = package.findVariant("programs/A.glslp", 123, values1);
+		ANKI_TEST_EXPECT_NEQ(variant, nullptr);
+		ANKI_TEST_EXPECT_EQ(variant->m_usesPushConstants, 1);
+
+		ConstWeakArray<U8> bin = package.getBinary(*variant, ShaderType::VERTEX);
+		ANKI_TEST_EXPECT_EQ(bin.getSize(), binA.getSize());
+		ANKI_TEST_EXPECT_EQ(memcmp(&bin[0], &binA[0], binA.getSize()), 0);
+		bin = package.getBinary(*variant, ShaderType::FRAGMENT);
+		ANKI_TEST_EXPECT_EQ(bin.getSize(), binC.getSize());
+		ANKI_TEST_EXPECT_EQ(memcmp(&bin[0], &binC[0], binC.getSize()), 0);
+		ANKI_TEST_EXPECT_EQ(variant->m_binaries[ShaderType::COMPUTE], MAX_U32);
+
+		variant = package.findVariant("programs/B.glslp", 456, ConstWeakArray<I32>());
+		ANKI_TEST_EXPECT_NEQ(variant, nullptr);
+		bin = package.getBinary(*variant, ShaderType::COMPUTE);
+		ANKI_TEST_EXPECT_EQ(bin.getSize(), binB.getSize());
+		ANKI_TEST_EXPECT_EQ(memcmp(&bin[0], &binB[0], binB.getSize()), 0);
+
+		// Missing variant and program
+		const Array<I32, 2> values2 = {{1, 0}};
+		ANKI_TEST_EXPECT_EQ(package.findVariant("programs/A.glslp", 123, values2), nullptr);
+		ANKI_TEST_EXPECT_EQ(package.findVariant("programs/C.glslp", 123, values1), nullptr);
+
+		// The source of the program changed
+		ANKI_TEST_EXPECT_EQ(package.findVariant("programs/A.glslp", 124, values1), nullptr);
+	}
+
+	// Different options
+	{
+		ShaderCompilerOptions otherOptions = options;
+		otherOptions.m_gpuCapabilities.m_gpuVendor = GpuVendor::AMD;
+
+		ShaderProgramPackage package;
+		ANKI_TEST_EXPECT_NO_ERR(package.load(alloc, "./tmp.ankispk", otherOptions));
+		ANKI_TEST_EXPECT_EQ(package.isLoaded(), false);
+	}
+}
+
+} // end namespace anki
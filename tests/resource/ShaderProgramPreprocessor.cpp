@@ -0,0 +1,90 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/resource/ShaderProgramPreProcessor.h"
+#include "anki/resource/ResourceFilesystem.h"
+#include "anki/util/Filesystem.h"
+#include "anki/util/File.h"
+
+namespace anki
+{
+
+ANKI_TEST(Resource, ShaderProgramPreprocessorCache)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	// Create the files
+	if(directoryExists("./ppdir"))
+	{
+		ANKI_TEST_EXPECT_NO_ERR(removeDirectory("./ppdir"));
+	}
+	ANKI_TEST_EXPECT_NO_ERR(createDirectory("./ppdir"));
+
+	{
+		File file;
+		ANKI_TEST_EXPECT_NO_ERR(file.open("./ppdir/common.glsl", FileOpenFlag::WRITE));
+		ANKI_TEST_EXPECT_NO_ERR(file.writeText("#pragma once\nconst float PI = 3.14;\n"));
+	}
+
+	const char* PROGRAM = R"(#pragma anki mutator INSTANCE_COUNT 1 2
+#pragma anki input Vec4 u_color
+#include <common.glsl>
+#pragma anki start vert
+void main() {}
+#pragma anki end
+#pragma anki start frag
+#include "common.glsl"
+void main() {}
+#pragma anki end
+)";
+
+	for(const char* fname : {"./ppdir/a.glslp", "./ppdir/b.glslp"})
+	{
+		File file;
+		ANKI_TEST_EXPECT_NO_ERR(file.open(fname, FileOpenFlag::WRITE));
+		ANKI_TEST_EXPECT_NO_ERR(file.writeText("%s", PROGRAM));
+	}
+
+	ResourceFilesystem fs(alloc);
+	ANKI_TEST_EXPECT_NO_ERR(fs.addNewPath("./ppdir"));
+
+	// Without cache
+	StringAuto expectedSource(alloc);
+	{
+		ShaderProgramPreprocessor pp("a.glslp", &fs, alloc);
+		ANKI_TEST_EXPECT_NO_ERR(pp.parse());
+		expectedSource.create(pp.getSource());
+
+		// The include appears once in the dependencies
+		ANKI_TEST_EXPECT_EQ(pp.getDependencies().getSize(), 2);
+		ANKI_TEST_EXPECT_EQ(pp.getDependencies().getFront(), "a.glslp");
+		ANKI_TEST_EXPECT_EQ(pp.getDependencies().getBack(), "common.glsl");
+	}
+
+	// With cache the result is the same
+	ShaderProgramPreprocessorCache cache(alloc, &fs);
+	for(CString fname : {"a.glslp", "b.glslp", "a.glslp"})
+	{
+		ShaderProgramPreprocessor pp(fname, &fs, alloc, &cache);
+		ANKI_TEST_EXPECT_NO_ERR(pp.parse());
+		ANKI_TEST_EXPECT_EQ(pp.getSource(), expectedSource);
+		ANKI_TEST_EXPECT_EQ(pp.getMutators().getSize(), 1);
+		ANKI_TEST_EXPECT_EQ(pp.getInputs().getSize(), 1);
+	}
+
+	// The include is shared
+	const ShaderProgramPreprocessorFile* file0 = nullptr;
+	const ShaderProgramPreprocessorFile* file1 = nullptr;
+	ANKI_TEST_EXPECT_NO_ERR(cache.getFile("common.glsl", file0));
+	ANKI_TEST_EXPECT_NO_ERR(cache.getFile("common.glsl", file1));
+	ANKI_TEST_EXPECT_EQ(file0, file1);
+
+	ANKI_TEST_EXPECT_ERR(cache.getFile("missing.glsl", file0), Error::USER_DATA);
+
+	ANKI_TEST_EXPECT_NO_ERR(removeDirectory("./ppdir"));
+}
+
+} // end namespace anki
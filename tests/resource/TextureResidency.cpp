@@ -0,0 +1,173 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/resource/TextureResidency.h>
+
+namespace anki
+{
+
+/// Register a square texture with mips of 4 bytes per texel.
+static TextureResidency::Entry* registerTexture(TextureResidency& residency, U32 size, U32 residentFirstMip, U32 id)
+{
+	Array<PtrSize, MAX_STREAMED_TEXTURE_MIPS> mipSizes;
+	U32 mipCount = 0;
+	while((size >> mipCount) > 0)
+	{
+		const PtrSize mipSize = size >> mipCount;
+		mipSizes[mipCount] = mipSize * mipSize * 4;
+		++mipCount;
+	}
+
+	return residency.registerTexture(ConstWeakArray<PtrSize>(&mipSizes[0], mipCount),
+		residentFirstMip,
+		reinterpret_cast<void*>(PtrSize(id)));
+}
+
+/// Complete all the changes the way the streamer would.
+static void completeChanges(TextureResidency& residency,
+	ConstWeakArray<TextureResidencyChange> changes,
+	ConstWeakArray<TextureResidency::Entry*> entries)
+{
+	for(const TextureResidencyChange& change : changes)
+	{
+		residency.completeChange(entries[PtrSize(change.m_userData)], change.m_toFirstMip);
+	}
+}
+
+ANKI_TEST(Resource, TextureResidency)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	// Required mip
+	{
+		ANKI_TEST_EXPECT_EQ(TextureResidency::computeRequiredMip(1024, 2048.0f), 0);
+		ANKI_TEST_EXPECT_EQ(TextureResidency::computeRequiredMip(1024, 1024.0f), 0);
+		ANKI_TEST_EXPECT_EQ(TextureResidency::computeRequiredMip(1024, 512.0f), 1);
+		ANKI_TEST_EXPECT_EQ(TextureResidency::computeRequiredMip(1024, 300.0f), 1);
+		ANKI_TEST_EXPECT_EQ(TextureResidency::computeRequiredMip(1024, 1.0f), 10);
+		ANKI_TEST_EXPECT_EQ(TextureResidency::computeRequiredMip(1024, 0.0f), MAX_STREAMED_TEXTURE_MIPS - 1);
+	}
+
+	// Stream in and evict unused
+	{
+		TextureResidency residency(alloc);
+		residency.init(MAX_PTR_SIZE, 2, 1);
+
+		// 256x256 with the 64x64 always resident
+		TextureResidency::Entry* entry = registerTexture(residency, 256, 2, 0);
+		const PtrSize initialMemory = residency.getResidentMemory();
+		ANKI_TEST_EXPECT_EQ(initialMemory, (64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2 + 1) * 4);
+
+		DynamicArrayAuto<TextureResidencyChange> changes(alloc);
+
+		// Nothing requested
+		residency.update(changes);
+		ANKI_TEST_EXPECT_EQ(changes.getSize(), 0);
+
+		// Request more detail than there is
+		residency.requestMip(entry, 1);
+		residency.requestMip(entry, 0);
+		residency.requestMip(entry, 3);
+		residency.update(changes);
+		ANKI_TEST_EXPECT_EQ(changes.getSize(), 1);
+		ANKI_TEST_EXPECT_EQ(changes[0].m_fromFirstMip, 2);
+		ANKI_TEST_EXPECT_EQ(changes[0].m_toFirstMip, 0);
+
+		// No new changes while one is pending
+		residency.requestMip(entry, 0);
+		residency.update(changes);
+		ANKI_TEST_EXPECT_EQ(changes.getSize(), 0);
+
+		residency.completeChange(entry, 0);
+		ANKI_TEST_EXPECT_EQ(residency.getResidentFirstMip(entry), 0);
+		ANKI_TEST_EXPECT_EQ(residency.getResidentMemory(), initialMemory + (256 * 256 + 128 * 128) * 4);
+
+		// Stop requesting. It should drop to the minimum after some frames
+		U32 frames = 0;
+		do
+		{
+			residency.update(changes);
+			++frames;
+		} while(changes.getSize() == 0 && frames < 10);
+
+		ANKI_TEST_EXPECT_EQ(frames, 3);
+		ANKI_TEST_EXPECT_EQ(changes.getSize(), 1);
+		ANKI_TEST_EXPECT_EQ(changes[0].m_toFirstMip, 2);
+
+		// Fail the eviction. It should be retried
+		residency.cancelChange(entry);
+		residency.update(changes);
+		ANKI_TEST_EXPECT_EQ(changes.getSize(), 1);
+		residency.completeChange(entry, changes[0].m_toFirstMip);
+		ANKI_TEST_EXPECT_EQ(residency.getResidentMemory(), initialMemory);
+
+		residency.unregisterTexture(entry);
+		ANKI_TEST_EXPECT_EQ(residency.getResidentMemory(), 0);
+	}
+
+	// Budget and per frame limits
+	{
+		const U32 textureCount = 8;
+		const PtrSize fullMemory = (256 * 256 + 128 * 128) * 4;
+		const PtrSize residentMemory = (64 * 64 + 32 * 32 + 16 * 16 + 8 * 8 + 4 * 4 + 2 * 2 + 1) * 4;
+
+		// Space for half of the textures at full resolution
+		TextureResidency residency(alloc);
+		residency.init(textureCount * residentMemory + textureCount / 2 * fullMemory, 100, 3);
+
+		Array<TextureResidency::Entry*, textureCount> entries;
+		for(U32 i = 0; i < textureCount; ++i)
+		{
+			entries[i] = registerTexture(residency, 256, 2, i);
+		}
+
+		DynamicArrayAuto<TextureResidencyChange> changes(alloc);
+		U32 streamedCount = 0;
+		for(U32 frame = 0; frame < 10; ++frame)
+		{
+			for(TextureResidency::Entry* entry : entries)
+			{
+				residency.requestMip(entry, 0);
+			}
+
+			residency.update(changes);
+			ANKI_TEST_EXPECT_LEQ(changes.getSize(), 3);
+			completeChanges(residency, changes, entries);
+
+			ANKI_TEST_EXPECT_LEQ(residency.getResidentMemory(), residency.getMemoryBudget());
+			streamedCount += changes.getSize();
+		}
+
+		// All of them got something but the budget was respected
+		ANKI_TEST_EXPECT_GEQ(streamedCount, textureCount);
+		for(TextureResidency::Entry* entry : entries)
+		{
+			ANKI_TEST_EXPECT_LT(residency.getResidentFirstMip(entry), 2);
+		}
+
+		// Request only the first texture. The rest should give their memory to it
+		for(U32 frame = 0; frame < 200; ++frame)
+		{
+			residency.requestMip(entries[0], 0);
+			residency.update(changes);
+			completeChanges(residency, changes, entries);
+			ANKI_TEST_EXPECT_LEQ(residency.getResidentMemory(), residency.getMemoryBudget());
+		}
+
+		ANKI_TEST_EXPECT_EQ(residency.getResidentFirstMip(entries[0]), 0);
+		for(U32 i = 1; i < textureCount; ++i)
+		{
+			ANKI_TEST_EXPECT_EQ(residency.getResidentFirstMip(entries[i]), 2);
+		}
+
+		for(TextureResidency::Entry* entry : entries)
+		{
+			residency.unregisterTexture(entry);
+		}
+	}
+}
+
+} // end namespace anki
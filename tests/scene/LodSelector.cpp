@@ -0,0 +1,96 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/scene/LodSelector.h>
+
+namespace anki
+{
+
+ANKI_TEST(Scene, LodSelector)
+{
+	const Array<F32, MAX_LOD_COUNT - 1> thresholds = {{0.25f, 0.1f}};
+
+	// Projected size
+	{
+		const Mat4 proj = Mat4::calculatePerspectiveProjectionMatrix(toRad(90.0f), toRad(90.0f), 0.1f, 1000.0f);
+		const Vec4 eye(0.0f);
+
+		// With 90 degrees fov a sphere with radius 1 at distance 10 covers 1/10 of the screen
+		const F32 size = LodSelector::computeProjectedSize(Vec4(0.0f, 0.0f, -10.0f, 0.0f), 1.0f, eye, proj);
+		ANKI_TEST_EXPECT_NEAR(size, 0.1f, 0.001f);
+
+		// Further objects are smaller
+		const F32 size2 = LodSelector::computeProjectedSize(Vec4(0.0f, 0.0f, -20.0f, 0.0f), 1.0f, eye, proj);
+		ANKI_TEST_EXPECT_LT(size2, size);
+
+		// Eye inside the sphere
+		const F32 size3 = LodSelector::computeProjectedSize(Vec4(0.0f, 0.0f, -1.0f, 0.0f), 2.0f, eye, proj);
+		ANKI_TEST_EXPECT_EQ(size3, MAX_F32);
+	}
+
+	// Selection
+	{
+		LodSelector sel;
+		sel.init(ConstWeakArray<F32>(&thresholds[0], thresholds.getSize()), 0.0f, 0);
+
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.5f, 3), 0);
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.2f, 3), 1);
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.05f, 3), 2);
+
+		// Clamp to the LODs of the renderable
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.05f, 2), 1);
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.05f, 1), 0);
+	}
+
+	// Hysteresis
+	{
+		LodSelector sel;
+		sel.init(ConstWeakArray<F32>(&thresholds[0], thresholds.getSize()), 0.2f, 0);
+
+		// Slightly bigger than the threshold, should stay to the previous LOD
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.26f, 3, 1), 1);
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.26f, 3, 0), 0);
+
+		// Slightly smaller than the threshold, should stay to the previous LOD
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.24f, 3, 0), 0);
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.24f, 3, 1), 1);
+
+		// Far from the threshold, should switch
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.35f, 3, 1), 0);
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.15f, 3, 0), 1);
+	}
+
+	// Triangle budget
+	{
+		LodSelector sel;
+		sel.init(ConstWeakArray<F32>(&thresholds[0], thresholds.getSize()), 0.0f, 1000);
+
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.3f, 3), 0);
+
+		// Exceed the budget for some frames
+		for(U i = 0; i < 4; ++i)
+		{
+			sel.accountTriangles(0, 2000);
+			sel.endFrame();
+		}
+
+		ANKI_TEST_EXPECT_EQ(sel.getLastFrameTriangleCount(0), 2000);
+		ANKI_TEST_EXPECT_GT(sel.getBudgetBias(), 1.0f);
+		ANKI_TEST_EXPECT_GT(sel.selectLod(0.3f, 3), 0);
+
+		// Go bellow the budget and the bias should relax
+		for(U i = 0; i < 200; ++i)
+		{
+			sel.accountTriangles(0, 100);
+			sel.endFrame();
+		}
+
+		ANKI_TEST_EXPECT_EQ(sel.getBudgetBias(), 1.0f);
+		ANKI_TEST_EXPECT_EQ(sel.selectLod(0.3f, 3), 0);
+	}
+}
+
+} // end namespace anki
@@ -0,0 +1,83 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/scene/ParticleStore.h>
+
+namespace anki
+{
+
+ANKI_TEST(Scene, ParticleStore)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+	const U32 MAX_PARTICLES = 11;
+	const F32 DT = 0.1f;
+
+	ParticleStore store;
+	store.init(alloc, MAX_PARTICLES);
+
+	// Emit more than it can hold
+	for(U32 i = 0; i < MAX_PARTICLES + 1; ++i)
+	{
+		ParticleInitInfo init;
+		init.m_position = Vec3(F32(i), 0.0f, 0.0f);
+		init.m_velocity = Vec3(0.0f, 1.0f, 0.0f);
+		init.m_acceleration = Vec3(0.0f, 0.0f, -2.0f);
+		init.m_life = (i % 2) ? 1.0f : 0.15f;
+		init.m_initialSize = 1.0f;
+		init.m_finalSize = 3.0f;
+		init.m_initialAlpha = 1.0f;
+		init.m_finalAlpha = -1.0f;
+
+		const U32 idx = store.emit(init);
+		ANKI_TEST_EXPECT_EQ(idx, (i < MAX_PARTICLES) ? i : MAX_U32);
+	}
+
+	// Simulate in two ranges that don't share packets
+	Array<F32, MAX_PARTICLES * ParticleStore::VERTEX_SIZE / sizeof(F32)> verts;
+	const U32 split = 8;
+	ParticleBounds bounds, bounds2;
+	store.simulate(0, split, DT, true, &verts[0], bounds);
+	store.simulate(split, MAX_PARTICLES, DT, true, &verts[split * 5], bounds2);
+	bounds.merge(bounds2);
+
+	for(U32 i = 0; i < MAX_PARTICLES; ++i)
+	{
+		const F32* vert = &verts[i * 5];
+		const F32 lifeFactor = DT / ((i % 2) ? 1.0f : 0.15f);
+
+		ANKI_TEST_EXPECT_NEAR(vert[0], F32(i), 0.0001f);
+		ANKI_TEST_EXPECT_NEAR(vert[1], DT, 0.0001f);
+		ANKI_TEST_EXPECT_NEAR(vert[2], -2.0f * DT * DT, 0.0001f);
+		ANKI_TEST_EXPECT_NEAR(vert[3], 1.0f + 2.0f * lifeFactor, 0.0001f);
+		ANKI_TEST_EXPECT_NEAR(vert[4], max(0.0f, 1.0f - 2.0f * lifeFactor), 0.0001f);
+	}
+
+	ANKI_TEST_EXPECT_NEAR(bounds.m_min.x(), 0.0f, 0.0001f);
+	ANKI_TEST_EXPECT_NEAR(bounds.m_max.x(), F32(MAX_PARTICLES - 1), 0.0001f);
+	ANKI_TEST_EXPECT_NEAR(bounds.m_max.y(), DT, 0.0001f);
+	ANKI_TEST_EXPECT_NEAR(bounds.m_maxSize, 1.0f + 2.0f * DT / 0.15f, 0.0001f);
+
+	// The short lived die and the rest stay packed
+	U32 killCount = 0;
+	store.killDeadParticles(DT, [&](U32 deadIdx, U32 lastAliveIdx) {
+		ANKI_TEST_EXPECT_LEQ(deadIdx, lastAliveIdx);
+		++killCount;
+	});
+
+	ANKI_TEST_EXPECT_EQ(killCount, (MAX_PARTICLES + 1) / 2);
+	ANKI_TEST_EXPECT_EQ(store.getAliveParticleCount(), MAX_PARTICLES / 2);
+
+	ParticleBounds bounds3;
+	store.simulate(0, store.getAliveParticleCount(), DT, false, &verts[0], bounds3);
+	for(U32 i = 0; i < store.getAliveParticleCount(); ++i)
+	{
+		// Only the odd ones survived
+		ANKI_TEST_EXPECT_EQ(U32(verts[i * 5]) % 2, 1);
+		ANKI_TEST_EXPECT_NEAR(verts[i * 5 + 3], 1.0f + 2.0f * 2.0f * DT, 0.0001f);
+	}
+}
+
+} // end namespace anki
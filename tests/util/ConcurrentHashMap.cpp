@@ -0,0 +1,279 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include "tests/framework/Framework.h"
+#include "anki/util/ConcurrentHashMap.h"
+#include "anki/util/HighRezTimer.h"
+
+namespace anki
+{
+
+ANKI_TEST(Util, ConcurrentHashMap)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	// Simple
+	{
+		ConcurrentHashMap<U64, U32> map;
+		ANKI_TEST_EXPECT_EQ(map.find(10), nullptr);
+
+		map.emplace(alloc, 10, 100);
+		map.emplace(alloc, 20, 200);
+		ANKI_TEST_EXPECT_EQ(*map.find(10), 100);
+		ANKI_TEST_EXPECT_EQ(*map.find(20), 200);
+		ANKI_TEST_EXPECT_EQ(map.find(30), nullptr);
+
+		// Emplacing an existing key returns the old value
+		ANKI_TEST_EXPECT_EQ(map.emplace(alloc, 10, 666), 100);
+		ANKI_TEST_EXPECT_EQ(map.getSize(), 2);
+
+		map.destroy(alloc);
+		ANKI_TEST_EXPECT_EQ(map.isEmpty(), true);
+	}
+
+	// Grow and iterate
+	{
+		ConcurrentHashMap<U64, U64> map;
+		const U COUNT = 1000;
+		for(U i = 0; i < COUNT; ++i)
+		{
+			map.emplace(alloc, i * 7, i);
+		}
+
+		// Pointers stay valid after growing
+		const U64* first = map.find(0);
+		for(U i = COUNT; i < COUNT * 2; ++i)
+		{
+			map.emplace(alloc, i * 7, i);
+		}
+		ANKI_TEST_EXPECT_EQ(map.find(0), first);
+
+		U64 sum = 0;
+		U count = 0;
+		map.iterate([&](U64& val) {
+			sum += val;
+			++count;
+		});
+		ANKI_TEST_EXPECT_EQ(count, COUNT * 2);
+		ANKI_TEST_EXPECT_EQ(sum, (COUNT * 2 - 1) * COUNT);
+
+		map.destroy(alloc);
+	}
+
+	// Create callback
+	{
+		ConcurrentHashMap<U64, U32> map;
+		U32* val;
+
+		Error err = map.findOrCreate(alloc, 1, [](U32& v) -> Error { return Error::FUNCTION_FAILED; }, val);
+		ANKI_TEST_EXPECT_EQ(err, Error::FUNCTION_FAILED);
+		ANKI_TEST_EXPECT_EQ(map.find(1), nullptr);
+
+		err = map.findOrCreate(alloc, 1,
+			[](U32& v) -> Error {
+				v = 123;
+				return Error::NONE;
+			},
+			val);
+		ANKI_TEST_EXPECT_NO_ERR(err);
+		ANKI_TEST_EXPECT_EQ(*val, 123);
+
+		// Not called again
+		err = map.findOrCreate(alloc, 1, [](U32& v) -> Error { return Error::FUNCTION_FAILED; }, val);
+		ANKI_TEST_EXPECT_NO_ERR(err);
+		ANKI_TEST_EXPECT_EQ(*val, 123);
+
+		map.destroy(alloc);
+	}
+}
+
+/// The common part of the contention benchmarks. Every thread looks up keys of a small set. The first lookup of a key
+/// inserts it, like what the caches of the renderer do.
+class CacheBenchContext
+{
+public:
+	static const U KEY_COUNT = 1024;
+	static const U LOOKUPS_PER_THREAD = 1024 * 512;
+
+	HeapAllocator<U8> m_alloc;
+	Barrier* m_barrier = nullptr;
+	Atomic<U64> m_checksum = {0};
+	void* m_cache = nullptr;
+
+	static U64 getKey(U threadIdx, U i)
+	{
+		return ((i + threadIdx * 131) * 2654435761u) % KEY_COUNT;
+	}
+};
+
+/// HashMap protected by a lock.
+template<typename TMutex>
+class LockedCache
+{
+public:
+	HashMap<U64, U64> m_map;
+	TMutex m_mtx;
+
+	U64 find(CacheBenchContext& ctx, U64 key)
+	{
+		{
+			ReadLockGuard<TMutex> lock(m_mtx);
+			auto it = m_map.find(key);
+			if(it != m_map.getEnd())
+			{
+				return *it;
+			}
+		}
+
+		WriteLockGuard<TMutex> lock(m_mtx);
+		auto it = m_map.find(key);
+		if(it == m_map.getEnd())
+		{
+			it = m_map.emplace(ctx.m_alloc, key, key * 3);
+		}
+
+		return *it;
+	}
+
+	void destroy(CacheBenchContext& ctx)
+	{
+		m_map.destroy(ctx.m_alloc);
+	}
+};
+
+/// Wraps a Mutex to look like a RWMutex.
+class ExclusiveMutex
+{
+public:
+	Mutex m_mtx;
+
+	void lockRead()
+	{
+		m_mtx.lock();
+	}
+
+	void unlockRead()
+	{
+		m_mtx.unlock();
+	}
+
+	void lockWrite()
+	{
+		m_mtx.lock();
+	}
+
+	void unlockWrite()
+	{
+		m_mtx.unlock();
+	}
+};
+
+class LockFreeCache
+{
+public:
+	ConcurrentHashMap<U64, U64> m_map;
+
+	U64 find(CacheBenchContext& ctx, U64 key)
+	{
+		return m_map.emplace(ctx.m_alloc, key, key * 3);
+	}
+
+	void destroy(CacheBenchContext& ctx)
+	{
+		m_map.destroy(ctx.m_alloc);
+	}
+};
+
+template<typename TCache>
+static Second benchCache(U threadCount)
+{
+	CacheBenchContext ctx;
+	ctx.m_alloc = HeapAllocator<U8>(allocAligned, nullptr);
+	Barrier barrier(threadCount + 1);
+	ctx.m_barrier = &barrier;
+	TCache cache;
+	ctx.m_cache = &cache;
+
+	class ThreadCtx
+	{
+	public:
+		CacheBenchContext* m_ctx;
+		U m_idx;
+		Second m_time;
+	};
+
+	DynamicArrayAuto<Thread*> threads(ctx.m_alloc);
+	DynamicArrayAuto<ThreadCtx> threadCtxs(ctx.m_alloc);
+	threads.create(threadCount);
+	threadCtxs.create(threadCount);
+
+	for(U i = 0; i < threadCount; ++i)
+	{
+		threadCtxs[i].m_ctx = &ctx;
+		threadCtxs[i].m_idx = i;
+		threads[i] = ctx.m_alloc.newInstance<Thread>(nullptr);
+		threads[i]->start(&threadCtxs[i], [](ThreadCallbackInfo& info) -> Error {
+			ThreadCtx& tctx = *static_cast<ThreadCtx*>(info.m_userData);
+			CacheBenchContext& ctx = *tctx.m_ctx;
+			TCache& cache = *static_cast<TCache*>(ctx.m_cache);
+
+			ctx.m_barrier->wait();
+
+			HighRezTimer timer;
+			timer.start();
+			U64 checksum = 0;
+			for(U i = 0; i < CacheBenchContext::LOOKUPS_PER_THREAD; ++i)
+			{
+				checksum += cache.find(ctx, CacheBenchContext::getKey(tctx.m_idx, i));
+			}
+			timer.stop();
+
+			tctx.m_time = timer.getElapsedTime();
+			ctx.m_checksum.fetchAdd(checksum);
+			return Error::NONE;
+		});
+	}
+
+	// Start all of them together
+	barrier.wait();
+
+	Second maxTime = 0.0;
+	U64 expectedChecksum = 0;
+	for(U i = 0; i < threadCount; ++i)
+	{
+		ANKI_TEST_EXPECT_NO_ERR(threads[i]->join());
+		ctx.m_alloc.deleteInstance(threads[i]);
+		maxTime = max(maxTime, threadCtxs[i].m_time);
+
+		for(U j = 0; j < CacheBenchContext::LOOKUPS_PER_THREAD; ++j)
+		{
+			expectedChecksum += CacheBenchContext::getKey(i, j) * 3;
+		}
+	}
+
+	ANKI_TEST_EXPECT_EQ(ctx.m_checksum.load(), expectedChecksum);
+	cache.destroy(ctx);
+	return maxTime;
+}
+
+ANKI_TEST(Util, ConcurrentHashMapContentionBench)
+{
+	for(U threadCount = 1; threadCount <= 32; threadCount *= 2)
+	{
+		const Second mtxTime = benchCache<LockedCache<ExclusiveMutex>>(threadCount);
+		const Second rwTime = benchCache<LockedCache<RWMutex>>(threadCount);
+		const Second rwSpinTime = benchCache<LockedCache<RWSpinLock>>(threadCount);
+		const Second lockFreeTime = benchCache<LockFreeCache>(threadCount);
+
+		ANKI_TEST_LOGI("Cache lookups with %2u threads: Mutex %f RWMutex %f RWSpinLock %f ConcurrentHashMap %f",
+			threadCount,
+			mtxTime,
+			rwTime,
+			rwSpinTime,
+			lockFreeTime);
+	}
+}
+
+} // end namespace anki
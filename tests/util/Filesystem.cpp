@@ -18,6 +18,20 @@ ANKI_TEST(Util, FileExists)
 	ANKI_TEST_EXPECT_EQ(fileExists("./tmp"), true);
 }
 
+ANKI_TEST(Util, FileModificationTime)
+{
+	File file;
+	ANKI_TEST_EXPECT_NO_ERR(file.open("./tmp", FileOpenFlag::WRITE));
+	file.close();
+
+	U64 time0 = 0, time1 = 1;
+	ANKI_TEST_EXPECT_NO_ERR(getFileModificationTime("./tmp", time0));
+	ANKI_TEST_EXPECT_NO_ERR(getFileModificationTime("./tmp", time1));
+	ANKI_TEST_EXPECT_EQ(time0, time1);
+
+	ANKI_TEST_EXPECT_ERR(getFileModificationTime("./this_file_doesnt_exist", time0), Error::FUNCTION_FAILED);
+}
+
 ANKI_TEST(Util, Directory)
 {
 	// Destroy previous
@@ -7,6 +7,7 @@
 #include "tests/util/Foo.h"
 #include "anki/util/Memory.h"
 #include "anki/util/ThreadPool.h"
+#include "anki/util/HighRezTimer.h"
 #include <type_traits>
 #include <cstring>
 
@@ -90,6 +91,34 @@ ANKI_TEST(Util, StackMemoryPool)
 		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 4);
 	}
 
+	// Not thread safe
+	{
+		StackMemoryPool pool;
+
+		pool.create(allocAligned, nullptr, 128, 2.0, 0, true, 16, false);
+		ANKI_TEST_EXPECT_EQ(pool.getMemoryUsed(), 0);
+
+		void* a = pool.allocate(32, 16);
+		ANKI_TEST_EXPECT_NEQ(a, nullptr);
+		a = pool.allocate(64, 16);
+		ANKI_TEST_EXPECT_NEQ(a, nullptr);
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 2);
+		ANKI_TEST_EXPECT_EQ(pool.getMemoryUsed(), 96);
+
+		// Doesn't fit, a new chunk will be created
+		a = pool.allocate(64, 16);
+		ANKI_TEST_EXPECT_NEQ(a, nullptr);
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 3);
+		ANKI_TEST_EXPECT_GEQ(pool.getMemoryUsed(), 96 + 64);
+
+		pool.free(a);
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 2);
+
+		pool.reset();
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 0);
+		ANKI_TEST_EXPECT_EQ(pool.getMemoryUsed(), 0);
+	}
+
 	// Parallel
 	{
 		StackMemoryPool pool;
@@ -218,3 +247,188 @@ ANKI_TEST(Util, ChainMemoryPool)
 		ANKI_TEST_EXPECT_EQ(pool.getChunksCount(), 0);
 	}
 }
+
+ANKI_TEST(Util, ThreadCachingMemoryPool)
+{
+	// Simple
+	{
+		ThreadCachingMemoryPool pool;
+		pool.create(allocAligned, nullptr);
+
+		void* ptr = pool.allocate(123, 1);
+		ANKI_TEST_EXPECT_NEQ(ptr, nullptr);
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 1);
+
+		pool.free(ptr);
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 0);
+
+		// The block should be reused
+		void* ptr2 = pool.allocate(120, 1);
+		ANKI_TEST_EXPECT_EQ(ptr2, ptr);
+		pool.free(ptr2);
+	}
+
+	// Sizes and alignments
+	{
+		ThreadCachingMemoryPool pool;
+		pool.create(allocAligned, nullptr);
+
+		const Array<PtrSize, 9> sizes = {{1, 16, 17, 100, 256, 1000, 4097, 16 * 1024, 100 * 1024}};
+		const Array<PtrSize, 5> alignments = {{1, 8, 16, 64, 256}};
+		Array<void*, sizes.getSize() * alignments.getSize()> ptrs;
+
+		U count = 0;
+		for(PtrSize size : sizes)
+		{
+			for(PtrSize alignment : alignments)
+			{
+				void* ptr = pool.allocate(size, alignment);
+				ANKI_TEST_EXPECT_NEQ(ptr, nullptr);
+				ANKI_TEST_EXPECT_EQ(isAligned(alignment, ptr), true);
+				memset(ptr, U8(count), size);
+				ptrs[count++] = ptr;
+			}
+		}
+
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), count);
+
+		count = 0;
+		for(PtrSize size : sizes)
+		{
+			for(U i = 0; i < alignments.getSize(); ++i)
+			{
+				const U8* ptr = static_cast<const U8*>(ptrs[count]);
+				ANKI_TEST_EXPECT_EQ(ptr[0], U8(count));
+				ANKI_TEST_EXPECT_EQ(ptr[size - 1], U8(count));
+				pool.free(ptrs[count++]);
+			}
+		}
+
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 0);
+	}
+
+	// Parallel. Every thread frees the allocations of the next one to test the exchange of blocks between threads
+	{
+		const U THREAD_COUNT = 8;
+		const U ALLOCATION_COUNT = 1024 * 4;
+		ThreadCachingMemoryPool pool;
+		pool.create(allocAligned, nullptr);
+		ThreadPool threadPool(THREAD_COUNT);
+
+		class Task : public ThreadPoolTask
+		{
+		public:
+			ThreadCachingMemoryPool* m_pool = nullptr;
+			Array<void*, ALLOCATION_COUNT> m_allocations;
+			Task* m_other = nullptr;
+			Bool m_allocate = true;
+			Bool m_ok = true;
+
+			Error operator()(U32 taskId, PtrSize threadsCount)
+			{
+				if(m_allocate)
+				{
+					for(U i = 0; i < ALLOCATION_COUNT; ++i)
+					{
+						const PtrSize size = 8 + (i * 7919) % 2048;
+						U8* ptr = static_cast<U8*>(m_pool->allocate(size, 8));
+						memset(ptr, U8(taskId), size);
+						m_allocations[i] = ptr;
+					}
+				}
+				else
+				{
+					for(U i = 0; i < ALLOCATION_COUNT; ++i)
+					{
+						const U8* ptr = static_cast<const U8*>(m_other->m_allocations[i]);
+						m_ok = m_ok && ptr[0] == U8((taskId + 1) % threadsCount);
+						m_pool->free(m_other->m_allocations[i]);
+					}
+				}
+
+				return Error::NONE;
+			}
+		};
+
+		Array<Task, THREAD_COUNT> tasks;
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			tasks[i].m_pool = &pool;
+			tasks[i].m_other = &tasks[(i + 1) % THREAD_COUNT];
+			threadPool.assignNewTask(i, &tasks[i]);
+		}
+		ANKI_TEST_EXPECT_NO_ERR(threadPool.waitForAllThreadsToFinish());
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), THREAD_COUNT * ALLOCATION_COUNT);
+
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			tasks[i].m_allocate = false;
+			threadPool.assignNewTask(i, &tasks[i]);
+		}
+		ANKI_TEST_EXPECT_NO_ERR(threadPool.waitForAllThreadsToFinish());
+
+		for(U i = 0; i < THREAD_COUNT; ++i)
+		{
+			ANKI_TEST_EXPECT_EQ(tasks[i].m_ok, true);
+		}
+		ANKI_TEST_EXPECT_EQ(pool.getAllocationsCount(), 0);
+	}
+
+	// Compare with the heap pool
+	{
+		const U THREAD_COUNT = 8;
+		const U ITERATIONS = 1024 * 64;
+		ThreadPool threadPool(THREAD_COUNT);
+
+		class Task : public ThreadPoolTask
+		{
+		public:
+			BaseMemoryPool* m_pool = nullptr;
+
+			Error operator()(U32 taskId, PtrSize threadsCount)
+			{
+				Array<void*, 32> live = {};
+				for(U i = 0; i < ITERATIONS; ++i)
+				{
+					void*& slot = live[i % live.getSize()];
+					if(slot)
+					{
+						m_pool->free(slot);
+					}
+					slot = m_pool->allocate(16 + (i * 31) % 512, 16);
+				}
+
+				for(void* ptr : live)
+				{
+					m_pool->free(ptr);
+				}
+
+				return Error::NONE;
+			}
+		};
+
+		auto run = [&](BaseMemoryPool& pool) {
+			Array<Task, THREAD_COUNT> tasks;
+			HighRezTimer timer;
+			timer.start();
+			for(U i = 0; i < THREAD_COUNT; ++i)
+			{
+				tasks[i].m_pool = &pool;
+				threadPool.assignNewTask(i, &tasks[i]);
+			}
+			ANKI_TEST_EXPECT_NO_ERR(threadPool.waitForAllThreadsToFinish());
+			timer.stop();
+			return timer.getElapsedTime();
+		};
+
+		HeapMemoryPool heapPool;
+		heapPool.create(allocAligned, nullptr);
+		const Second heapTime = run(heapPool);
+
+		ThreadCachingMemoryPool cachingPool;
+		cachingPool.create(allocAligned, nullptr);
+		const Second cachingTime = run(cachingPool);
+
+		ANKI_TEST_LOGI("HeapMemoryPool %fms, ThreadCachingMemoryPool %fms", heapTime * 1000.0, cachingTime * 1000.0);
+	}
+}
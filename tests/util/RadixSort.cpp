@@ -0,0 +1,111 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <tests/framework/Framework.h>
+#include <anki/util/RadixSort.h>
+#include <anki/util/ThreadHive.h>
+#include <anki/util/HighRezTimer.h>
+#include <algorithm>
+#include <vector>
+
+namespace anki
+{
+
+static void fillRadixSortKeys(std::vector<RadixSortKey>& keys, U64 keyMask)
+{
+	U64 seed = 0x12345;
+	for(U32 i = 0; i < keys.size(); ++i)
+	{
+		// xorshift
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+
+		keys[i].m_key = seed & keyMask;
+		keys[i].m_index = i;
+	}
+}
+
+static Bool radixSortKeysSorted(const std::vector<RadixSortKey>& keys)
+{
+	for(U32 i = 1; i < keys.size(); ++i)
+	{
+		const RadixSortKey& a = keys[i - 1];
+		const RadixSortKey& b = keys[i];
+
+		// Sorted and stable
+		if(a.m_key > b.m_key || (a.m_key == b.m_key && a.m_index > b.m_index))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+ANKI_TEST(Util, RadixSort)
+{
+	HeapAllocator<U8> alloc(allocAligned, nullptr);
+
+	// Serial
+	for(U64 mask : {U64(0xFF), U64(0xFFFFFFFF), U64(0xFF00FF00FF00FF00), MAX_U64})
+	{
+		std::vector<RadixSortKey> keys(10000);
+		std::vector<RadixSortKey> scratch(keys.size());
+		fillRadixSortKeys(keys, mask);
+
+		radixSort(WeakArray<RadixSortKey>(&keys[0], keys.size()), WeakArray<RadixSortKey>(&scratch[0], keys.size()));
+		ANKI_TEST_EXPECT_EQ(radixSortKeysSorted(keys), true);
+	}
+
+	// Parallel
+	{
+		ThreadHive hive(4, alloc);
+
+		for(U32 count : {10u, 1024u * 64u})
+		{
+			std::vector<RadixSortKey> keys(count);
+			std::vector<RadixSortKey> scratch(keys.size());
+			fillRadixSortKeys(keys, U64(0xFFFF0000FFFF));
+
+			Atomic<U32> done = {0};
+			radixSortParallel(hive,
+				alloc,
+				WeakArray<RadixSortKey>(&keys[0], keys.size()),
+				WeakArray<RadixSortKey>(&scratch[0], keys.size()),
+				[](void* ud) { static_cast<Atomic<U32>*>(ud)->fetchAdd(1); },
+				&done);
+			hive.waitAllTasks();
+
+			ANKI_TEST_EXPECT_EQ(done.load(), 1);
+			ANKI_TEST_EXPECT_EQ(radixSortKeysSorted(keys), true);
+		}
+	}
+
+	// Bench against std::sort
+	{
+		std::vector<RadixSortKey> keys(1024 * 64);
+		std::vector<RadixSortKey> scratch(keys.size());
+		fillRadixSortKeys(keys, MAX_U64);
+		std::vector<RadixSortKey> keys2 = keys;
+
+		HighRezTimer timer;
+		timer.start();
+		radixSort(WeakArray<RadixSortKey>(&keys[0], keys.size()), WeakArray<RadixSortKey>(&scratch[0], keys.size()));
+		timer.stop();
+		const Second radixTime = timer.getElapsedTime();
+
+		timer.start();
+		std::stable_sort(keys2.begin(), keys2.end(), [](const RadixSortKey& a, const RadixSortKey& b) {
+			return a.m_key < b.m_key;
+		});
+		timer.stop();
+		const Second stlTime = timer.getElapsedTime();
+
+		ANKI_TEST_LOGI("Sorting %u keys: radix %f STL %f", U32(keys.size()), radixTime, stlTime);
+	}
+}
+
+} // end namespace anki
@@ -5,6 +5,7 @@
 
 #include "tests/framework/Framework.h"
 #include "anki/util/Thread.h"
+#include "anki/util/Atomic.h"
 #include "anki/util/StdTypes.h"
 #include "anki/util/HighRezTimer.h"
 #include "anki/util/ThreadPool.h"
@@ -99,6 +100,72 @@ ANKI_TEST(Util, Mutex)
 	ANKI_TEST_EXPECT_EQ(in.m_num, ITERATIONS * 2);
 }
 
+/// Readers check that the two numbers that the writers change are always the same.
+template<typename TRWMutex>
+static void testRWMutex()
+{
+	static const U ITERATIONS = 100000;
+	static const U THREAD_COUNT = 4;
+
+	class In
+	{
+	public:
+		TRWMutex m_mtx;
+		U64 m_a = 0;
+		U64 m_b = 0;
+		Atomic<U32> m_errors = {0};
+	};
+
+	In in;
+	Array<Thread*, THREAD_COUNT> threads;
+	for(U i = 0; i < THREAD_COUNT; ++i)
+	{
+		threads[i] = new Thread(nullptr);
+
+		// Half of the threads write
+		if(i & 1)
+		{
+			threads[i]->start(&in, [](ThreadCallbackInfo& info) -> Error {
+				In& in = *reinterpret_cast<In*>(info.m_userData);
+				for(U i = 0; i < ITERATIONS; i++)
+				{
+					WriteLockGuard<TRWMutex> lock(in.m_mtx);
+					++in.m_a;
+					++in.m_b;
+				}
+
+				return Error::NONE;
+			});
+		}
+		else
+		{
+			threads[i]->start(&in, [](ThreadCallbackInfo& info) -> Error {
+				In& in = *reinterpret_cast<In*>(info.m_userData);
+				for(U i = 0; i < ITERATIONS; i++)
+				{
+					ReadLockGuard<TRWMutex> lock(in.m_mtx);
+					if(in.m_a != in.m_b)
+					{
+						in.m_errors.fetchAdd(1);
+					}
+				}
+
+				return Error::NONE;
+			});
+		}
+	}
+
+	for(U i = 0; i < THREAD_COUNT; ++i)
+	{
+		ANKI_TEST_EXPECT_NO_ERR(threads[i]->join());
+		delete threads[i];
+	}
+
+	ANKI_TEST_EXPECT_EQ(in.m_errors.load(), 0);
+	ANKI_TEST_EXPECT_EQ(in.m_a, ITERATIONS * THREAD_COUNT / 2);
+	ANKI_TEST_EXPECT_EQ(in.m_b, ITERATIONS * THREAD_COUNT / 2);
+}
+
 /// Struct for our tests
 struct TestJobTP : ThreadPoolTask
 {
@@ -179,6 +246,12 @@ ANKI_TEST(Util, ThreadPool)
 	}
 }
 
+ANKI_TEST(Util, RWMutex)
+{
+	testRWMutex<RWMutex>();
+	testRWMutex<RWSpinLock>();
+}
+
 ANKI_TEST(Util, Barrier)
 {
 	// Simple test
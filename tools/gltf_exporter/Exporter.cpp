@@ -5,6 +5,7 @@
 
 #include "Exporter.h"
 #include <anki/resource/MeshLoader.h>
+#include <anki/resource/MeshOptimizer.h>
 #include <anki/util/File.h>
 #include <string>
 
@@ -433,9 +434,43 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 		}
 	}
 
+	// Optimize for the vertex cache, overdraw and vertex fetch and generate the LODs
+	Array<U32, MAX_LOD_COUNT> lodIndexCounts;
+	U32 lodCount;
+	{
+		DynamicArrayAuto<U32> inIndices(m_alloc);
+		inIndices.create(indices.getSize());
+		for(U i = 0; i < indices.getSize(); ++i)
+		{
+			inIndices[i] = indices[i];
+		}
+
+		DynamicArrayAuto<U32> outIndices(m_alloc);
+		DynamicArrayAuto<U32> remap(m_alloc);
+		U32 newVertCount;
+		lodCount = optimizeMeshAndGenerateLods(
+			inIndices, positions, MAX_LOD_COUNT, m_alloc, outIndices, lodIndexCounts, remap, newVertCount);
+
+		remapMeshVertices(remap, newVertCount, positions, m_alloc);
+		remapMeshVertices(remap, newVertCount, normals, m_alloc);
+		remapMeshVertices(remap, newVertCount, uvs, m_alloc);
+		remapMeshVertices(remap, newVertCount, tangents, m_alloc);
+		if(weights.getSize())
+		{
+			remapMeshVertices(remap, newVertCount, weights, m_alloc);
+		}
+		vertCount = newVertCount;
+
+		indices.resize(outIndices.getSize());
+		for(U i = 0; i < outIndices.getSize(); ++i)
+		{
+			indices[i] = outIndices[i];
+		}
+	}
+
 	// Find if it's a convex shape
 	Bool convex = true;
-	for(U i = 0; i < indices.getSize(); i += 3)
+	for(U i = 0; i < lodIndexCounts[0]; i += 3)
 	{
 		const U i0 = indices[i + 0];
 		const U i1 = indices[i + 1];
@@ -567,6 +602,7 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 		header.m_subMeshCount = 1;
 		header.m_aabbMin = aabbMin;
 		header.m_aabbMax = aabbMax;
+		header.m_lodCount = lodCount;
 	}
 
 	// Open file
@@ -582,11 +618,22 @@ Error Exporter::exportMesh(const tinygltf::Mesh& mesh)
 	{
 		MeshBinaryFile::SubMesh smesh;
 		smesh.m_firstIndex = 0;
-		smesh.m_indexCount = header.m_totalIndexCount;
+		smesh.m_indexCount = lodIndexCounts[0];
 		smesh.m_aabbMin = aabbMin;
 		smesh.m_aabbMax = aabbMax;
 
 		ANKI_CHECK(file.write(&smesh, sizeof(smesh)));
+
+		U32 firstIndex = lodIndexCounts[0];
+		for(U lod = 1; lod < lodCount; ++lod)
+		{
+			MeshBinaryFile::SubMeshLod smeshLod;
+			smeshLod.m_firstIndex = firstIndex;
+			smeshLod.m_indexCount = lodIndexCounts[lod];
+
+			ANKI_CHECK(file.write(&smeshLod, sizeof(smeshLod)));
+			firstIndex += lodIndexCounts[lod];
+		}
 	}
 
 	// Write indices
@@ -321,6 +321,7 @@ void Exporter::exportMesh(const aiMesh& mesh, const aiMatrix4x4* transform, unsi
 		header.m_subMeshCount = 1;
 		header.m_aabbMin = aabbMin;
 		header.m_aabbMax = aabbMax;
+		header.m_lodCount = 1;
 	}
 
 	// Open file
@@ -0,0 +1,118 @@
+// Copyright (C) 2009-2018, Panagiotis Christopoulos Charitos and contributors.
+// All rights reserved.
+// Code licensed under the BSD License.
+// http://www.anki3d.org/LICENSE
+
+#include <anki/AnKi.h>
+#include <anki/resource/ShaderProgramPackage.h>
+
+using namespace anki;
+
+static const char* USAGE = R"(Usage: %s out_file program_or_dir [program_or_dir...]
+Compile all the variants of shader programs for the GPU of this machine and store them in a shader program
+package. Set the rsrc.shaderProgramPackage option to the package to use it. The programs are named the way
+the engine loads them. The directories are searched for *.glslp files.
+)";
+
+class ShaderPackageApp : public App
+{
+public:
+	ANKI_USE_RESULT Error addProgram(CString filename, ShaderProgramPackageBuilder& builder)
+	{
+		ShaderProgramResourcePtr prog;
+		ANKI_CHECK(getResourceManager().loadResource(filename, prog, false));
+		ANKI_CHECK(prog->addToPackage(builder));
+		return Error::NONE;
+	}
+
+	ANKI_USE_RESULT Error addDirectory(CString dir, ShaderProgramPackageBuilder& builder)
+	{
+		DynamicArrayAuto<String> filenames(getAllocator());
+		Context ctx{this, &filenames, dir};
+		Error err = walkDirectoryTree(dir, &ctx, [](const CString& filename, void* ud, Bool isDir) -> Error {
+			Context& ctx = *static_cast<Context*>(ud);
+			StringAuto ext(ctx.m_app->getAllocator());
+			getFilepathExtension(filename, ext);
+			if(!isDir && ext == "glslp")
+			{
+				String& fname = *ctx.m_filenames->emplaceBack();
+				fname.sprintf(ctx.m_app->getAllocator(), "%s/%s", &ctx.m_dir[0], &filename[0]);
+			}
+
+			return Error::NONE;
+		});
+
+		for(U i = 0; i < filenames.getSize() && !err; ++i)
+		{
+			err = addProgram(filenames[i].toCString(), builder);
+		}
+
+		for(String& fname : filenames)
+		{
+			fname.destroy(getAllocator());
+		}
+
+		return err;
+	}
+
+private:
+	class Context
+	{
+	public:
+		ShaderPackageApp* m_app;
+		DynamicArrayAuto<String>* m_filenames;
+		CString m_dir;
+	};
+};
+
+static Error work(int argc, char** argv)
+{
+	ShaderPackageApp app;
+	Config config;
+	config.set("window.fullscreen", false);
+	config.set("width", 64);
+	config.set("height", 64);
+	config.set("rsrc.dataPaths", ".");
+	ANKI_CHECK(app.init(config, allocAligned, nullptr));
+
+	ShaderCompilerOptions options;
+	options.setFromGrManager(app.getResourceManager().getGrManager());
+	ShaderProgramPackageBuilder builder(app.getAllocator(), options);
+
+	for(I i = 2; i < argc; ++i)
+	{
+		if(directoryExists(argv[i]))
+		{
+			ANKI_CHECK(app.addDirectory(argv[i], builder));
+		}
+		else
+		{
+			ANKI_CHECK(app.addProgram(argv[i], builder));
+		}
+	}
+
+	ANKI_LOGI("Writing %u variants and %u binaries to %s",
+		builder.getVariantCount(),
+		builder.getBinaryCount(),
+		argv[1]);
+	ANKI_CHECK(builder.write(argv[1]));
+
+	return Error::NONE;
+}
+
+int main(int argc, char** argv)
+{
+	if(argc < 3)
+	{
+		ANKI_LOGE(USAGE, argv[0]);
+		return 1;
+	}
+
+	if(work(argc, argv))
+	{
+		ANKI_LOGE("Failed to create the shader program package");
+		return 1;
+	}
+
+	return 0;
+}